@@ -0,0 +1,495 @@
+// This file is part of Notepad++ project
+// Copyright (C)2023 Thomas Knoefel
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+// Runs the hot paths of the engine on a generated CSV corpus held in a
+// GapBufferDocument and prints the time and throughput of each.
+//
+// Usage: MultiReplaceBenchmark [--size MB] [--runs N] [--filter TEXT] [--seed N]
+//                              [--profile] [--trace DIR]
+
+#include "GapBufferDocument.h"
+#include "MultiReplaceEngine.h"
+#include "SearchPrefetcher.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+    struct BenchmarkOptions {
+        size_t sizeMB = 10;
+        int runs = 3;
+        std::string filter;
+        uint32_t seed = 1;
+        bool profile = false;
+        std::string traceDirectory; // One Chrome trace per benchmark, written for the last run
+    };
+
+    // Small deterministic generator so every run measures the same corpus
+    class Lcg {
+    public:
+        explicit Lcg(uint32_t seed) : state(seed) {}
+        uint32_t next() {
+            state = state * 1664525u + 1013904223u;
+            return state >> 8;
+        }
+        uint32_t below(uint32_t n) {
+            return next() % n;
+        }
+    private:
+        uint32_t state;
+    };
+
+    // CSV with a header line, CRLF line ends and a mix of words, numbers and quoted fields
+    std::string generateCorpus(size_t targetBytes, uint32_t seed)
+    {
+        static const char* const cities[] = { "Berlin", "Paris", "Madrid", "Rome", "Vienna", "Prague", "Oslo", "Lisbon" };
+        static const char* const words[] = { "alpha", "beta", "gamma", "delta", "epsilon", "zeta", "eta", "theta", "iota", "kappa" };
+
+        Lcg rng(seed);
+        std::string corpus;
+        corpus.reserve(targetBytes + 256);
+        corpus += "id,city,amount,comment\r\n";
+
+        char line[256];
+        size_t id = 1;
+        while (corpus.size() < targetBytes) {
+            int n = std::snprintf(line, sizeof(line), "%zu,%s,%u.%02u,\"%s %s %s\"\r\n",
+                id++,
+                cities[rng.below(8)],
+                rng.below(100000), rng.below(100),
+                words[rng.below(10)], words[rng.below(10)], words[rng.below(10)]);
+            corpus.append(line, static_cast<size_t>(n));
+        }
+        return corpus;
+    }
+
+    void setupColumns(MultiReplaceEngine& engine, int column)
+    {
+        ColumnDelimiterData& data = engine.columnDelimiterData;
+        data.inputColumns = { column };
+        data.columns = { column };
+        data.extendedDelimiter = ",";
+        data.delimiterLength = 1;
+        data.quoteChar = "\"";
+        engine.CSVheaderLinesCount = 1;
+    }
+
+    struct Benchmark {
+        const char* name;
+        // Prepares the document and engine, not timed
+        std::function<void(GapBufferDocument&, MultiReplaceEngine&)> setup;
+        // The measured operation, returns a count that is printed for plausibility
+        std::function<long long(GapBufferDocument&, MultiReplaceEngine&)> run;
+    };
+
+    std::vector<Benchmark> createBenchmarks()
+    {
+        auto noSetup = [](GapBufferDocument&, MultiReplaceEngine&) {};
+
+        auto replaceRule = [](const std::string& find, const std::string& replace, bool regex, bool wholeWord) {
+            ReplaceRule rule;
+            rule.findText = find;
+            rule.replaceText = replace;
+            rule.regex = regex;
+            rule.wholeWord = wholeWord;
+            rule.matchCase = true;
+            return rule;
+        };
+
+        auto replaceAll = [](ReplaceRule rule) {
+            return [rule](GapBufferDocument& doc, MultiReplaceEngine& engine) -> long long {
+                int findCount = 0;
+                int replaceCount = 0;
+                BulkEditTransaction transaction(doc);
+                engine.replaceAll(rule, findCount, replaceCount, transaction);
+                return replaceCount;
+            };
+        };
+
+        // Replace All with a list renaming the cities and some rules that never occur
+        auto listRules = [replaceRule]() {
+            std::vector<ReplaceRule> rules;
+            for (const char* city : { "Berlin", "Paris", "Madrid", "Rome", "Vienna", "Prague", "Oslo", "Lisbon" }) {
+                rules.push_back(replaceRule(city, std::string(city, 3) + "_", false, false));
+            }
+            for (int i = 0; i < 100; ++i) {
+                rules.push_back(replaceRule("rule" + std::to_string(i), "-", false, false));
+            }
+            return rules;
+        };
+        auto replaceAllList = [listRules](GapBufferDocument& doc, MultiReplaceEngine& engine) -> long long {
+            std::vector<RuleCount> counts;
+            BulkEditTransaction transaction(doc);
+            engine.replaceAllList(listRules(), counts, transaction);
+            long long replaced = 0;
+            for (const RuleCount& count : counts) {
+                replaced += count.replaceCount;
+            }
+            return replaced;
+        };
+        auto replaceAllSequential = [listRules](GapBufferDocument& doc, MultiReplaceEngine& engine) -> long long {
+            BulkEditTransaction transaction(doc);
+            long long replaced = 0;
+            for (const ReplaceRule& rule : listRules()) {
+                int findCount = 0;
+                int replaceCount = 0;
+                engine.replaceAll(rule, findCount, replaceCount, transaction);
+                replaced += replaceCount;
+            }
+            return replaced;
+        };
+
+        // Live replace of the same list after 64 lines were pasted into the middle of the
+        // document, only the pasted lines are searched
+        auto replacePasted = [listRules](GapBufferDocument& doc, MultiReplaceEngine& engine) -> long long {
+            const Sci_Position firstLine = doc.send(SCI_GETLINECOUNT, 0, 0) / 2;
+            std::vector<SelectionRange> ranges{ { doc.send(SCI_POSITIONFROMLINE, firstLine, 0), doc.send(SCI_POSITIONFROMLINE, firstLine + 64, 0) } };
+            std::vector<RuleCount> counts;
+            BulkEditTransaction transaction(doc);
+            engine.replaceInRanges(listRules(), ranges, counts);
+            long long replaced = 0;
+            for (const RuleCount& count : counts) {
+                replaced += count.replaceCount;
+            }
+            return replaced;
+        };
+
+        // Mark with a long list in which few rules occur, most of them would scan the
+        // document in vain
+        auto markManyRules = [](GapBufferDocument&, MultiReplaceEngine& engine) -> long long {
+            long long marked = 0;
+            for (int i = 0; i < 1000; ++i) {
+                const std::string text = (i % 100 == 0) ? "theta alpha" : "rule" + std::to_string(i);
+                marked += engine.markString(text, SCFIND_MATCHCASE);
+            }
+            return marked;
+        };
+
+        // Mark with a list of regex rules, the way the panel does it
+        auto markRegexRules = [](GapBufferDocument&, MultiReplaceEngine& engine) -> long long {
+            std::vector<RuleSearch> searches;
+            for (const char* pattern : { "\"e[a-z]+", "[0-9]+\\.99", "ta\\b", "\\d{5}\\.", "(alpha|beta) gamma", "ka[a-z]*a\"",
+                "[A-Z][a-z]+,[0-9]{2}\\.", ",rome,", "eta\\s+zeta", "\\w+ \\w+ iota" }) {
+                searches.push_back({ pattern, SCFIND_REGEXP | ((searches.size() % 2 == 0) ? SCFIND_MATCHCASE : 0) });
+            }
+            engine.scanRegexRules(searches);
+            long long marked = 0;
+            for (const RuleSearch& search : searches) {
+                marked += engine.markString(search.findTextUtf8, search.searchFlags);
+            }
+            return marked;
+        };
+
+        // A rare word every 2 MB, for stepping from match to match
+        auto sparseWords = [](GapBufferDocument& doc, MultiReplaceEngine&) {
+            const Sci_Position length = doc.send(SCI_GETLENGTH, 0, 0);
+            for (Sci_Position pos = length - 1024; pos > 0; pos -= 2 * 1024 * 1024) {
+                doc.send(SCI_INSERTTEXT, static_cast<uptr_t>(pos), reinterpret_cast<sptr_t>(" Quux "));
+            }
+        };
+
+        // Find Next pressed until nothing is left. Without the look-ahead every press searches
+        // up to the next match, with it the presses find what the worker found while the user
+        // looked at the first match.
+        CountRule sparseRule;
+        sparseRule.findTextUtf8 = "Quux";
+        sparseRule.searchFlags = SCFIND_MATCHCASE;
+        auto prefetcher = std::make_shared<SearchPrefetcher>();
+        auto warmLookAhead = [sparseWords, sparseRule, prefetcher](GapBufferDocument& doc, MultiReplaceEngine& engine) {
+            sparseWords(doc, engine);
+            prefetcher->prepare({ sparseRule }, 0, engine.getDocumentVersion());
+            while (prefetcher->copySlice(doc, engine)) {
+            }
+            while (!prefetcher->isIdle()) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        };
+        auto stepFindNext = [sparseRule](std::shared_ptr<SearchPrefetcher> prefetcher) {
+            return [sparseRule, prefetcher](GapBufferDocument&, MultiReplaceEngine& engine) -> long long {
+                long long presses = 0;
+                Sci_Position pos = 0;
+                for (;; ++presses) {
+                    SearchResult result;
+                    PrefetchedMatch match;
+                    const SearchPrefetcher::Lookup lookup = prefetcher ? prefetcher->next(pos, engine.getDocumentVersion(), match)
+                        : SearchPrefetcher::Lookup::Unknown;
+                    if (lookup == SearchPrefetcher::Lookup::Found) {
+                        result.pos = match.start;
+                        result.length = match.end - match.start;
+                    }
+                    else if (lookup == SearchPrefetcher::Lookup::Unknown) {
+                        result = engine.performSearchForward(sparseRule.findTextUtf8, sparseRule.searchFlags, false, pos);
+                    }
+                    if (result.pos < 0) {
+                        break;
+                    }
+                    pos = result.pos + result.length;
+                }
+                return presses;
+            };
+        };
+
+        return {
+            { "replaceAll/literal", noSetup, replaceAll(replaceRule("Berlin", "Hamburg", false, false)) },
+            { "replaceAll/wholeWord", noSetup, replaceAll(replaceRule("beta", "b", false, true)) },
+            { "replaceAll/regex", noSetup, replaceAll(replaceRule("[0-9]+\\.99", "N/A", true, false)) },
+            { "replaceAll/list", noSetup, replaceAllList },
+            { "replaceAll/listSequential", noSetup, replaceAllSequential },
+            { "replaceInRanges/pasted", noSetup, replacePasted },
+            { "replaceAll/selection", [](GapBufferDocument& doc, MultiReplaceEngine& engine) {
+                // One selection per line over the amount column, like a rectangular selection
+                const Sci_Position lineCount = doc.send(SCI_GETLINECOUNT, 0, 0);
+                for (Sci_Position line = 1; line < lineCount - 1; ++line) {
+                    const Sci_Position start = doc.send(SCI_POSITIONFROMLINE, line, 0);
+                    const Sci_Position end = doc.send(SCI_GETLINEENDPOSITION, line, 0);
+                    if (line == 1) {
+                        doc.send(SCI_SETSELECTION, end, start);
+                    }
+                    else {
+                        doc.send(SCI_ADDSELECTION, end, start);
+                    }
+                }
+                engine.options.scope = SearchScope::Selection;
+            }, replaceAll(replaceRule("Berlin", "Hamburg", false, false)) },
+            { "markString/column", [](GapBufferDocument&, MultiReplaceEngine& engine) {
+                setupColumns(engine, 2);
+                engine.columnDelimiterData.columns = { 2, 4 };
+                engine.options.scope = SearchScope::Column;
+                engine.findAllDelimitersInDocument();
+            }, [](GapBufferDocument&, MultiReplaceEngine& engine) -> long long {
+                return engine.markString("Oslo", SCFIND_MATCHCASE);
+            } },
+            { "markString/literal", noSetup, [](GapBufferDocument&, MultiReplaceEngine& engine) -> long long {
+                return engine.markString("gamma", SCFIND_MATCHCASE);
+            } },
+            { "markString/ignoreCase", noSetup, [](GapBufferDocument&, MultiReplaceEngine& engine) -> long long {
+                return engine.markString("GAMMA", SCFIND_WHOLEWORD);
+            } },
+            { "markString/searchInTarget", [](GapBufferDocument&, MultiReplaceEngine& engine) {
+                // The same rule through SCI_SEARCHINTARGET, for comparison with the native search
+                engine.nativeLiteralSearch = false;
+            }, [](GapBufferDocument&, MultiReplaceEngine& engine) -> long long {
+                return engine.markString("GAMMA", SCFIND_WHOLEWORD);
+            } },
+            { "markString/regex", noSetup, [](GapBufferDocument&, MultiReplaceEngine& engine) -> long long {
+                return engine.markString("\"e[a-z]+", SCFIND_REGEXP | SCFIND_MATCHCASE);
+            } },
+            { "markString/regexWatched", [](GapBufferDocument&, MultiReplaceEngine& engine) {
+                engine.regexWatchdog.beginOperation(10000);
+            }, [](GapBufferDocument&, MultiReplaceEngine& engine) -> long long {
+                return engine.markString("\"e[a-z]+", SCFIND_REGEXP | SCFIND_MATCHCASE);
+            } },
+            { "markString/regexBacktracking", [](GapBufferDocument&, MultiReplaceEngine& engine) {
+                // Tries every split of each word, the watchdog stops it after a slice over 200 ms
+                engine.regexWatchdog.beginOperation(200);
+            }, [](GapBufferDocument&, MultiReplaceEngine& engine) -> long long {
+                return engine.markString("(\\w|\\w\\w|\\w\\w\\w)+[@~]", SCFIND_REGEXP | SCFIND_MATCHCASE);
+            } },
+            { "markString/fuzzy", noSetup, [](GapBufferDocument&, MultiReplaceEngine& engine) -> long long {
+                return engine.markString("gammma", fuzzySearchFlags(1));
+            } },
+            { "markString/folded", [](GapBufferDocument&, MultiReplaceEngine& engine) {
+                // Includes building the folded shadow of the document
+                engine.options.foldCharacters = true;
+            }, [](GapBufferDocument&, MultiReplaceEngine& engine) -> long long {
+                return engine.markString("GAMMA", SCFIND_WHOLEWORD);
+            } },
+            { "markString/manyRules", [](GapBufferDocument&, MultiReplaceEngine& engine) {
+                engine.options.useList = true;
+            }, markManyRules },
+            { "markString/manyRulesUnindexed", [](GapBufferDocument&, MultiReplaceEngine& engine) {
+                engine.options.useList = true;
+                engine.options.indexTrigrams = false;
+            }, markManyRules },
+            { "markString/regexRules", [](GapBufferDocument&, MultiReplaceEngine& engine) {
+                engine.options.useList = true;
+                engine.unionRegex = true;
+            }, markRegexRules },
+            { "markString/regexRulesSeparate", [](GapBufferDocument&, MultiReplaceEngine& engine) {
+                // The same rules searched one by one, for comparison with the union scan
+                engine.options.useList = true;
+                engine.unionRegex = false;
+            }, markRegexRules },
+            { "findNext/list", noSetup, [](GapBufferDocument& doc, MultiReplaceEngine& engine) -> long long {
+                // Find Next with "Use List" pressed repeatedly, each press searches every rule.
+                // A rule without matches makes every press scan the rest of the document.
+                std::vector<ReplaceRule> rules;
+                for (const char* text : { "Oslo", "kappa", "Lisbon", "zeta", "Zurich" }) {
+                    ReplaceRule rule;
+                    rule.findText = text;
+                    rule.matchCase = true;
+                    rules.push_back(rule);
+                }
+                long long presses = 0;
+                size_t matchIndex = 0;
+                Sci_Position pos = 0;
+                for (; presses < 500; ++presses) {
+                    SearchResult result = engine.performListSearchForward(rules, pos, matchIndex);
+                    if (result.pos < 0) {
+                        break;
+                    }
+                    pos = doc.send(SCI_GETCURRENTPOS, 0, 0);
+                }
+                return presses;
+            } },
+            { "findNext/sparse", sparseWords, stepFindNext(nullptr) },
+            { "findNext/sparsePrefetched", warmLookAhead, stepFindNext(prefetcher) },
+            { "findAllDelimitersInDocument", [](GapBufferDocument&, MultiReplaceEngine& engine) {
+                setupColumns(engine, 2);
+            }, [](GapBufferDocument&, MultiReplaceEngine& engine) -> long long {
+                engine.findAllDelimitersInDocument();
+                return static_cast<long long>(engine.lineDelimiterPositions.size());
+            } },
+            { "findAllDelimitersInDocument/singleLine", [](GapBufferDocument& doc, MultiReplaceEngine& engine) {
+                // The corpus as one line, like a minified file
+                std::string text(reinterpret_cast<const char*>(doc.send(SCI_GETCHARACTERPOINTER, 0, 0)), static_cast<size_t>(doc.send(SCI_GETLENGTH, 0, 0)));
+                text.erase(std::remove(text.begin(), text.end(), '\r'), text.end());
+                std::replace(text.begin(), text.end(), '\n', ',');
+                doc.send(SCI_SETTEXT, 0, reinterpret_cast<sptr_t>(text.c_str()));
+                setupColumns(engine, 2);
+            }, [](GapBufferDocument&, MultiReplaceEngine& engine) -> long long {
+                engine.findAllDelimitersInDocument();
+                return static_cast<long long>(engine.lineDelimiterPositions[0].positions.size());
+            } },
+            { "sortRowsByColumn", [](GapBufferDocument&, MultiReplaceEngine& engine) {
+                setupColumns(engine, 2);
+                engine.options.scope = SearchScope::Column;
+                engine.findAllDelimitersInDocument();
+            }, [](GapBufferDocument&, MultiReplaceEngine& engine) -> long long {
+                std::vector<size_t> originalLineOrder;
+                return engine.sortRowsByColumn(SortDirection::Ascending, originalLineOrder)
+                    ? static_cast<long long>(engine.lineDelimiterPositions.size()) : 0;
+            } },
+        };
+    }
+
+    bool parseArguments(int argc, char* argv[], BenchmarkOptions& options)
+    {
+        for (int i = 1; i < argc; ++i) {
+            const std::string arg = argv[i];
+            const bool hasValue = i + 1 < argc;
+            if (arg == "--size" && hasValue) {
+                options.sizeMB = static_cast<size_t>(std::strtoull(argv[++i], nullptr, 10));
+            }
+            else if (arg == "--runs" && hasValue) {
+                options.runs = std::max(1, std::atoi(argv[++i]));
+            }
+            else if (arg == "--filter" && hasValue) {
+                options.filter = argv[++i];
+            }
+            else if (arg == "--seed" && hasValue) {
+                options.seed = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+            }
+            else if (arg == "--profile") {
+                options.profile = true;
+            }
+            else if (arg == "--trace" && hasValue) {
+                options.profile = true;
+                options.traceDirectory = argv[++i];
+            }
+            else {
+                std::fprintf(stderr, "Usage: %s [--size MB] [--runs N] [--filter TEXT] [--seed N] [--profile] [--trace DIR]\n", argv[0]);
+                return false;
+            }
+        }
+        if (options.sizeMB == 0 || options.sizeMB > 1024) {
+            std::fprintf(stderr, "--size must be between 1 and 1024 MB\n");
+            return false;
+        }
+        return true;
+    }
+
+}
+
+int main(int argc, char* argv[])
+{
+    BenchmarkOptions options;
+    if (!parseArguments(argc, argv, options)) {
+        return 1;
+    }
+
+    const std::string corpus = generateCorpus(options.sizeMB * 1024 * 1024, options.seed);
+    const double corpusMB = static_cast<double>(corpus.size()) / (1024.0 * 1024.0);
+    std::printf("corpus: %.1f MB, runs: %d\n", corpusMB, options.runs);
+    std::printf("%-30s %12s %12s %12s %14s\n", "benchmark", "best ms", "mean ms", "MB/s", "count");
+
+    for (const Benchmark& benchmark : createBenchmarks()) {
+        if (!options.filter.empty() && std::string(benchmark.name).find(options.filter) == std::string::npos) {
+            continue;
+        }
+
+        double bestMs = 0.0;
+        double totalMs = 0.0;
+        long long count = 0;
+        size_t unhandled = 0;
+        std::string profileSummary;
+        for (int run = 0; run < options.runs; ++run) {
+            // Every run starts from the pristine corpus since several benchmarks edit the document
+            GapBufferDocument doc(corpus);
+            doc.setEOLMode(SC_EOL_CRLF);
+            MultiReplaceEngine engine(doc);
+            engine.luaErrorHandler = [](LuaErrorType, const std::string& message) {
+                std::fprintf(stderr, "Lua error: %s\n", message.c_str());
+            };
+            benchmark.setup(doc, engine);
+
+            engine.profiler.setEnabled(options.profile);
+            engine.profiler.setTraceEnabled(!options.traceDirectory.empty() && run == options.runs - 1);
+            engine.profiler.beginOperation(benchmark.name);
+
+            const auto start = std::chrono::steady_clock::now();
+            count = benchmark.run(doc, engine);
+            const auto end = std::chrono::steady_clock::now();
+
+            engine.profiler.endOperation();
+            if (options.profile) {
+                profileSummary = engine.profiler.summary();
+            }
+            if (!options.traceDirectory.empty() && run == options.runs - 1) {
+                std::string traceFile = options.traceDirectory + "/" + benchmark.name + ".json";
+                std::replace(traceFile.begin() + static_cast<std::ptrdiff_t>(options.traceDirectory.size()) + 1, traceFile.end(), '/', '_');
+                if (!engine.profiler.writeChromeTrace(traceFile)) {
+                    std::fprintf(stderr, "  warning: could not write %s\n", traceFile.c_str());
+                }
+            }
+
+            const double ms = std::chrono::duration<double, std::milli>(end - start).count();
+            bestMs = (run == 0) ? ms : std::min(bestMs, ms);
+            totalMs += ms;
+            unhandled = doc.unhandledMessages();
+        }
+
+        const double throughput = (bestMs > 0.0) ? corpusMB / (bestMs / 1000.0) : 0.0;
+        std::printf("%-30s %12.1f %12.1f %12.1f %14lld\n", benchmark.name, bestMs, totalMs / options.runs, throughput, count);
+        if (!profileSummary.empty()) {
+            std::printf("  %s\n", profileSummary.c_str());
+        }
+        if (unhandled > 0) {
+            std::fprintf(stderr, "  warning: %zu messages not implemented by GapBufferDocument\n", unhandled);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,1008 @@
+// This file is part of Notepad++ project
+// Copyright (C)2023 Thomas Knoefel
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+// Differential tests of the engine's search shortcuts. Each shortcut is compared with the
+// search it stands in for: the same engine with the shortcut switched off, which searches
+// through the reference std::regex engine of GapBufferDocument, a brute-force search of
+// the text, or the rules replaced one by one. Documents are generated and large enough to
+// cross the chunks the scanners poll for cancellation in. LuaLargePositions checks the Lua
+// variables of matches beyond 4 GB in a backend that only pretends to be that large.
+// LiveReplaceTyping checks that live replace leaves text alone that was not typed.
+//
+// Usage: MultiReplaceEngineTests [TEST]   (ctest runs each test on its own)
+
+#include "FoldedText.h"
+#include "GapBufferDocument.h"
+#include "MultiReplaceEngine.h"
+#include "RegexUnion.h"
+#include "TypedText.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <regex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef MULTIREPLACE_BOOST_REFERENCE
+#include <boost/regex.hpp>
+#endif
+
+namespace {
+
+    int failures = 0;
+
+    void fail(const char* test, const std::string& what)
+    {
+        if (++failures <= 20) {
+            std::printf("FAIL %s: %s\n", test, what.c_str());
+        }
+    }
+
+    // The same generator as the benchmarks, every run tests the same documents
+    class Lcg {
+    public:
+        explicit Lcg(uint32_t seed) : state(seed) {}
+        uint32_t next() {
+            state = state * 1664525u + 1013904223u;
+            return state >> 8;
+        }
+        uint32_t below(uint32_t n) {
+            return next() % n;
+        }
+    private:
+        uint32_t state;
+    };
+
+    // Words in both cases, accented and full-width letters, both line ends and punctuation
+    std::string generateText(uint32_t seed, size_t targetBytes)
+    {
+        static const char* const pieces[] = {
+            "foo", "Foo", "FOO", "bar", "bar,", "ab", "aB", "Ab", "abab", "x1", "x12", "\xC3\xA4rger", "\xC3\x84rger", "Arger",
+            "caf\xC3\xA9", "CAF\xC3\x89", "cafe", "na\xC3\xAFve", "naive", "\xEF\xBD\x86\xEF\xBD\x8F\xEF\xBD\x8F", "foobar", "_foo",
+            " ", " ", " ", "  ", "\t", ".", "-", "\r\n", "\r\n", "\n", "42", "2024"
+        };
+        Lcg rng(seed);
+        std::string text;
+        while (text.size() < targetBytes) {
+            text += pieces[rng.below(sizeof(pieces) / sizeof(pieces[0]))];
+        }
+        return text;
+    }
+
+    std::string describe(const std::string& findText, int searchFlags)
+    {
+        return "'" + findText + "' flags 0x" + [searchFlags]() {
+            char hex[16];
+            std::snprintf(hex, sizeof(hex), "%x", searchFlags);
+            return std::string(hex);
+            }();
+    }
+
+    bool sameMatch(const MatchInterval& a, const MatchInterval& b)
+    {
+        return a.start == b.start && a.end == b.end;
+    }
+
+    std::string firstDifference(const std::vector<MatchInterval>& actual, const std::vector<MatchInterval>& expected)
+    {
+        const size_t common = std::min(actual.size(), expected.size());
+        size_t i = 0;
+        while (i < common && sameMatch(actual[i], expected[i])) {
+            ++i;
+        }
+        char text[160];
+        if (i < common) {
+            std::snprintf(text, sizeof(text), "match %zu is [%lld, %lld), expected [%lld, %lld)", i,
+                static_cast<long long>(actual[i].start), static_cast<long long>(actual[i].end),
+                static_cast<long long>(expected[i].start), static_cast<long long>(expected[i].end));
+        }
+        else {
+            std::snprintf(text, sizeof(text), "%zu matches, expected %zu", actual.size(), expected.size());
+        }
+        return text;
+    }
+
+    void expectSame(const char* test, const std::string& rule, const std::vector<MatchInterval>& actual, const std::vector<MatchInterval>& expected)
+    {
+        if (actual.size() != expected.size() || !std::equal(actual.begin(), actual.end(), expected.begin(), sameMatch)) {
+            fail(test, rule + ": " + firstDifference(actual, expected));
+        }
+    }
+
+    // All matches of a forward scan from the start, as Find Next steps through them
+    std::vector<MatchInterval> scanMatches(MultiReplaceEngine& engine, const std::string& findText, int searchFlags)
+    {
+        std::vector<MatchInterval> matches;
+        Sci_Position pos = 0;
+        while (true) {
+            const SearchResult result = engine.performSearchForward(findText, searchFlags, false, pos);
+            if (result.pos < 0) {
+                return matches;
+            }
+            matches.push_back({ result.pos, result.pos + result.length });
+            pos = result.pos + std::max<Sci_Position>(result.length, 1);
+        }
+    }
+
+    std::vector<MatchInterval> bruteForceMatches(const std::string& text, const std::string& findText)
+    {
+        std::vector<MatchInterval> matches;
+        for (size_t pos = text.find(findText); pos != std::string::npos; pos = text.find(findText, pos + findText.size())) {
+            matches.push_back({ static_cast<Sci_Position>(pos), static_cast<Sci_Position>(pos + findText.size()) });
+        }
+        return matches;
+    }
+
+    std::string asciiLower(std::string text)
+    {
+        for (char& ch : text) {
+            if (ch >= 'A' && ch <= 'Z') {
+                ch = static_cast<char>(ch - 'A' + 'a');
+            }
+        }
+        return text;
+    }
+
+    std::vector<uint32_t> codePoints(const std::string& text, bool foldCase)
+    {
+        std::vector<uint32_t> points;
+        for (size_t i = 0; i < text.size();) {
+            const unsigned char lead = static_cast<unsigned char>(text[i]);
+            const size_t length = (lead < 0x80) ? 1 : (lead < 0xE0) ? 2 : (lead < 0xF0) ? 3 : 4;
+            uint32_t point = (length == 1) ? lead : lead & (0x3F >> (length - 1));
+            for (size_t j = 1; j < length && i + j < text.size(); ++j) {
+                point = (point << 6) | (static_cast<unsigned char>(text[i + j]) & 0x3F);
+            }
+            if (foldCase && point >= 'A' && point <= 'Z') {
+                point += 'a' - 'A';
+            }
+            points.push_back(point);
+            i += length;
+        }
+        return points;
+    }
+
+    size_t editDistance(const std::vector<uint32_t>& a, const std::vector<uint32_t>& b)
+    {
+        std::vector<size_t> row(b.size() + 1);
+        for (size_t j = 0; j <= b.size(); ++j) {
+            row[j] = j;
+        }
+        for (size_t i = 1; i <= a.size(); ++i) {
+            size_t diagonal = row[0];
+            row[0] = i;
+            for (size_t j = 1; j <= b.size(); ++j) {
+                const size_t above = row[j];
+                row[j] = std::min({ row[j] + 1, row[j - 1] + 1, diagonal + (a[i - 1] == b[j - 1] ? 0 : 1) });
+                diagonal = above;
+            }
+        }
+        return row[b.size()];
+    }
+
+    // Fewest edits of the pattern to any text ending somewhere in the text (Sellers)
+    size_t bestDistanceInside(const std::vector<uint32_t>& pattern, const std::vector<uint32_t>& text)
+    {
+        std::vector<size_t> column(pattern.size() + 1);
+        for (size_t i = 0; i <= pattern.size(); ++i) {
+            column[i] = i;
+        }
+        size_t best = pattern.size();
+        for (uint32_t ch : text) {
+            size_t diagonal = column[0];
+            column[0] = 0;
+            for (size_t i = 1; i <= pattern.size(); ++i) {
+                const size_t left = column[i];
+                column[i] = std::min({ column[i] + 1, column[i - 1] + 1, diagonal + (pattern[i - 1] == ch ? 0 : 1) });
+                diagonal = left;
+            }
+            best = std::min(best, column[pattern.size()]);
+        }
+        return best;
+    }
+
+    std::string textOf(GapBufferDocument& doc, const MatchInterval& match)
+    {
+        std::string text(static_cast<size_t>(match.end - match.start) + 1, '\0');
+        Sci_TextRangeFull tr{ { match.start, match.end }, &text[0] };
+        doc.send(SCI_GETTEXTRANGEFULL, 0, reinterpret_cast<sptr_t>(&tr));
+        text.resize(static_cast<size_t>(match.end - match.start));
+        return text;
+    }
+
+    void followEdits(GapBufferDocument& doc, MultiReplaceEngine& engine)
+    {
+        doc.setModificationHandler([&engine](const SCNotification& scn) {
+            engine.notifyTextModified(scn.modificationType, scn.position, scn.length, scn.text);
+            });
+    }
+
+    // LiteralSearch against SCI_SEARCHINTARGET, with and without polling for cancellation
+    void testLiteralSearch()
+    {
+        const char* const test = "LiteralSearch";
+        const std::string text = generateText(1, 300 * 1024);
+        GapBufferDocument doc(text);
+        MultiReplaceEngine native(doc);
+        MultiReplaceEngine polled(doc);
+        polled.cancellationCheck = []() { return false; };
+        MultiReplaceEngine reference(doc);
+        reference.nativeLiteralSearch = false;
+
+        const char* const finds[] = { "foo", "Foo", "ab", "aB", "abab", "x1", "bar,", "\xC3\xA4rger", "\xC3\x84RGER", "r\r\nf", "o\nb", "foobarfoo" };
+        const int flagSets[] = { 0, SCFIND_MATCHCASE, SCFIND_WHOLEWORD, SCFIND_MATCHCASE | SCFIND_WHOLEWORD };
+        for (const char* find : finds) {
+            for (int flags : flagSets) {
+                const std::vector<MatchInterval> expected = scanMatches(reference, find, flags);
+                expectSame(test, describe(find, flags), scanMatches(native, find, flags), expected);
+                expectSame(test, describe(find, flags) + " polled", scanMatches(polled, find, flags), expected);
+                if (flags == SCFIND_MATCHCASE) {
+                    expectSame(test, describe(find, flags) + " brute force", expected, bruteForceMatches(text, find));
+                }
+            }
+        }
+
+        // Ranges that start and end anywhere, also inside a match or a chunk
+        Lcg rng(2);
+        for (int i = 0; i < 300; ++i) {
+            const char* find = finds[rng.below(sizeof(finds) / sizeof(finds[0]))];
+            const int flags = flagSets[rng.below(4)];
+            const Sci_Position start = rng.below(static_cast<uint32_t>(text.size()));
+            const Sci_Position end = std::min<Sci_Position>(start + rng.below(200 * 1024), static_cast<Sci_Position>(text.size()));
+            const SearchResult actual = polled.performSingleSearch(find, flags, false, { start, end });
+            const SearchResult expected = reference.performSingleSearch(find, flags, false, { start, end });
+            if (actual.pos != expected.pos || actual.length != expected.length) {
+                fail(test, describe(find, flags) + " in range " + std::to_string(start) + "-" + std::to_string(end));
+            }
+        }
+    }
+
+    // RegexPrefilter against searching every line
+    void testRegexPrefilter()
+    {
+        const char* const test = "RegexPrefilter";
+        GapBufferDocument doc(generateText(3, 200 * 1024));
+        MultiReplaceEngine filtered(doc);
+        MultiReplaceEngine reference(doc);
+        reference.prefilterRegex = false;
+
+        const char* const finds[] = { "foo\\w*", "\\bab\\b", "^x1", "r$", "[0-9]+", "ab|Foo", "\xC3\xA4\\w+", "x1\\s+", "o\\r\\nb",
+            "(bar|foo),", "caf.", "\\d{3,}", "b[a-z]*r" };
+        for (const char* find : finds) {
+            for (int flags : { SCFIND_REGEXP, SCFIND_REGEXP | SCFIND_MATCHCASE }) {
+                expectSame(test, describe(find, flags), scanMatches(filtered, find, flags), scanMatches(reference, find, flags));
+            }
+        }
+    }
+
+    // Fuzzy matches have to be within their edits, and no text between two of them may be
+    void testFuzzySearch()
+    {
+        const char* const test = "FuzzySearch";
+        GapBufferDocument doc(generateText(4, 160 * 1024));
+        MultiReplaceEngine engine(doc);
+        MultiReplaceEngine polled(doc);
+        polled.cancellationCheck = []() { return false; };
+
+        // A loaded list may have both modes set, Fuzzy mode wins
+        if (searchFlagsOf(true, false, true, 2) != (SCFIND_WHOLEWORD | fuzzySearchFlags(2))) {
+            fail(test, "regex flag kept in Fuzzy mode");
+        }
+
+        const char* const finds[] = { "foo", "barfoo", "\xC3\xA4rger", "abcab", "naive", "x12 42" };
+        for (const char* find : finds) {
+            for (int edits : { 1, 2 }) {
+                for (bool matchCase : { false, true }) {
+                    const int flags = fuzzySearchFlags(edits) | (matchCase ? SCFIND_MATCHCASE : 0);
+                    const std::string rule = describe(find, flags);
+                    const std::vector<MatchInterval> matches = scanMatches(engine, find, flags);
+                    expectSame(test, rule + " polled", scanMatches(polled, find, flags), matches);
+
+                    const std::vector<uint32_t> pattern = codePoints(find, !matchCase);
+                    Sci_Position gapStart = 0;
+                    for (size_t i = 0; i <= matches.size(); ++i) {
+                        const Sci_Position gapEnd = (i < matches.size()) ? matches[i].start : doc.length();
+                        if (gapEnd > gapStart && bestDistanceInside(pattern, codePoints(textOf(doc, { gapStart, gapEnd }), !matchCase)) <= static_cast<size_t>(edits)) {
+                            fail(test, rule + ": missed a match before " + std::to_string(gapEnd));
+                            break;
+                        }
+                        if (i < matches.size()) {
+                            if (editDistance(pattern, codePoints(textOf(doc, matches[i]), !matchCase)) > static_cast<size_t>(edits)) {
+                                fail(test, rule + ": match at " + std::to_string(matches[i].start) + " needs too many edits");
+                                break;
+                            }
+                            gapStart = matches[i].end;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // Accent-insensitive matches against a search of the folded document, also after edits
+    void testFoldedText()
+    {
+        const char* const test = "FoldedText";
+        GapBufferDocument doc(generateText(5, 120 * 1024));
+        MultiReplaceEngine engine(doc);
+        engine.options.foldCharacters = true;
+        followEdits(doc, engine);
+
+        const char* const finds[] = { "cafe", "arger", "foo", "naive", "Foo", "e\r\nf" };
+        Lcg rng(6);
+        for (int round = 0; round < 3; ++round) {
+            const std::string folded = FoldedText::fold(doc.getText());
+            for (const char* find : finds) {
+                for (int flags : { 0, SCFIND_MATCHCASE }) {
+                    const std::string rule = describe(find, flags) + " round " + std::to_string(round);
+                    const std::vector<MatchInterval> matches = scanMatches(engine, find, flags);
+                    const bool matchCase = (flags & SCFIND_MATCHCASE) != 0;
+                    const size_t expected = matchCase ? bruteForceMatches(folded, find).size() : bruteForceMatches(asciiLower(folded), asciiLower(find)).size();
+                    if (matches.size() != expected) {
+                        fail(test, rule + ": " + std::to_string(matches.size()) + " matches, expected " + std::to_string(expected));
+                    }
+                    for (const MatchInterval& match : matches) {
+                        const std::string matched = FoldedText::fold(textOf(doc, match));
+                        if ((matchCase ? matched : asciiLower(matched)) != (matchCase ? std::string(find) : asciiLower(find))) {
+                            fail(test, rule + ": match at " + std::to_string(match.start) + " is '" + matched + "'");
+                            break;
+                        }
+                    }
+                }
+            }
+
+            // The shadow follows inserted and deleted characters
+            for (int i = 0; i < 50; ++i) {
+                const Sci_Position pos = doc.send(SCI_POSITIONBEFORE, doc.send(SCI_POSITIONAFTER, rng.below(static_cast<uint32_t>(doc.length())), 0), 0);
+                if (rng.below(2) == 0) {
+                    const char* inserted = (i % 2 == 0) ? "CAF\xC3\x89 " : "n\xC3\xA4ive\r\n";
+                    doc.send(SCI_INSERTTEXT, static_cast<uptr_t>(pos), reinterpret_cast<sptr_t>(inserted));
+                }
+                else {
+                    doc.send(SCI_DELETERANGE, static_cast<uptr_t>(pos), doc.send(SCI_POSITIONAFTER, pos, 0) - pos);
+                }
+            }
+        }
+    }
+
+    std::vector<ReplaceRule> literalRules()
+    {
+        std::vector<ReplaceRule> rules(7);
+        rules[0].findText = "foo";
+        rules[0].replaceText = "bar";
+        rules[1].findText = "bar";
+        rules[1].replaceText = "x1";
+        rules[2].findText = "ab";
+        rules[2].replaceText = "";
+        rules[2].wholeWord = true;
+        rules[3].findText = "Ab";
+        rules[3].replaceText = "AB";
+        rules[3].matchCase = true;
+        rules[4].findText = "x12";
+        rules[4].replaceText = "foo foo";
+        rules[5].findText = "\xC3\xA4rger";
+        rules[5].replaceText = "aerger";
+        rules[5].matchCase = true;
+        rules[6].findText = "zzz";
+        rules[6].replaceText = "never";
+        return rules;
+    }
+
+    // Find Next through the list and Replace All with and without the trigram index
+    void testTrigramIndex()
+    {
+        const char* const test = "TrigramIndex";
+        const std::string text = generateText(7, 400 * 1024);
+        GapBufferDocument indexedDoc(text);
+        GapBufferDocument referenceDoc(text);
+        MultiReplaceEngine indexed(indexedDoc);
+        MultiReplaceEngine reference(referenceDoc);
+        followEdits(indexedDoc, indexed);
+        followEdits(referenceDoc, reference);
+        indexed.options.useList = true;
+        reference.options.useList = true;
+        reference.options.indexTrigrams = false;
+
+        const std::vector<ReplaceRule> rules = literalRules();
+        for (int round = 0; round < 2; ++round) {
+            Sci_Position pos = 0;
+            for (int step = 0; step < 2000; ++step) {
+                size_t indexedRule = 0;
+                size_t referenceRule = 0;
+                const SearchResult actual = indexed.performListSearchForward(rules, pos, indexedRule);
+                const SearchResult expected = reference.performListSearchForward(rules, pos, referenceRule);
+                if (actual.pos != expected.pos || actual.length != expected.length || (expected.pos >= 0 && indexedRule != referenceRule)) {
+                    fail(test, "round " + std::to_string(round) + " step " + std::to_string(step) + " from " + std::to_string(pos));
+                    break;
+                }
+                if (expected.pos < 0) {
+                    break;
+                }
+                pos = expected.pos + std::max<Sci_Position>(expected.length, 1);
+            }
+
+            // Edited documents have to rebuild or follow the index
+            std::vector<RuleCount> indexedCounts;
+            std::vector<RuleCount> referenceCounts;
+            std::vector<ReplaceRule> round0(rules.begin() + round * 3, rules.begin() + round * 3 + 3);
+            {
+                BulkEditTransaction transaction(indexedDoc);
+                indexed.replaceAllList(round0, indexedCounts, transaction);
+            }
+            {
+                BulkEditTransaction transaction(referenceDoc);
+                reference.replaceAllList(round0, referenceCounts, transaction);
+            }
+            if (indexedDoc.getText() != referenceDoc.getText()) {
+                fail(test, "Replace All round " + std::to_string(round) + " differs");
+            }
+        }
+    }
+
+    // Rules replaced together against Replace All of one rule after the other
+    void testFusedReplace()
+    {
+        const char* const test = "FusedReplace";
+        const std::string text = generateText(8, 300 * 1024);
+        std::vector<ReplaceRule> rules = literalRules();
+        rules[4].isEnabled = false;
+
+        for (bool ascii : { true, false }) {
+            std::string start = text;
+            if (ascii) {
+                start.erase(std::remove_if(start.begin(), start.end(), [](char ch) { return static_cast<unsigned char>(ch) >= 0x80; }), start.end());
+            }
+            GapBufferDocument fusedDoc(start);
+            GapBufferDocument referenceDoc(start);
+            MultiReplaceEngine fused(fusedDoc);
+            MultiReplaceEngine reference(referenceDoc);
+
+            std::vector<RuleCount> counts;
+            {
+                BulkEditTransaction transaction(fusedDoc);
+                fused.replaceAllList(rules, counts, transaction);
+            }
+            {
+                BulkEditTransaction transaction(referenceDoc);
+                for (size_t i = 0; i < rules.size(); ++i) {
+                    if (!rules[i].isEnabled) {
+                        continue;
+                    }
+                    int findCount = 0;
+                    int replaceCount = 0;
+                    reference.replaceAll(rules[i], findCount, replaceCount, transaction);
+                    if (findCount != counts[i].findCount || replaceCount != counts[i].replaceCount) {
+                        fail(test, std::string(ascii ? "ASCII" : "UTF-8") + " rule " + std::to_string(i) + ": " + std::to_string(counts[i].replaceCount)
+                            + " replaced, expected " + std::to_string(replaceCount));
+                    }
+                }
+            }
+            if (fusedDoc.getText() != referenceDoc.getText()) {
+                fail(test, std::string(ascii ? "ASCII" : "UTF-8") + " documents differ");
+            }
+        }
+    }
+
+    // Regex rules scanned together against each rule searched on its own
+    void testRegexUnion()
+    {
+        const char* const test = "RegexUnion";
+        GapBufferDocument doc(generateText(9, 200 * 1024));
+        MultiReplaceEngine united(doc);
+        united.unionRegex = true;
+        MultiReplaceEngine reference(doc);
+
+        std::vector<RuleSearch> searches;
+        for (const char* find : { "foo\\w*", "[0-9]+", "ab|aB", "^x1", "r$", "\\bbar\\b", "\xC3\xA4\\w*", "caf.", "o\\r\\nb", "(ab)+" }) {
+            searches.push_back({ find, SCFIND_REGEXP });
+            searches.push_back({ find, SCFIND_REGEXP | SCFIND_MATCHCASE });
+        }
+        united.scanRegexRules(searches);
+        for (const RuleSearch& search : searches) {
+            const std::vector<MatchInterval>* actual = united.collectMatches(search.findTextUtf8, search.searchFlags);
+            const std::vector<MatchInterval>* expected = reference.collectMatches(search.findTextUtf8, search.searchFlags);
+            if (!actual || !expected) {
+                fail(test, describe(search.findTextUtf8, search.searchFlags) + ": no match set");
+                continue;
+            }
+            expectSame(test, describe(search.findTextUtf8, search.searchFlags), *actual, *expected);
+        }
+    }
+
+#ifdef MULTIREPLACE_BOOST_REFERENCE
+    constexpr bool boostReference = true;
+
+    // Matches of a forward scan as Notepad++ finds them with Boost, continuing at the end
+    // of each match. False if Boost rejects the pattern or gives up on it.
+    bool referenceMatches(const std::string& pattern, bool matchCase, const std::string& text, std::vector<MatchInterval>& matches)
+    {
+        try {
+            const boost::regex re(pattern, matchCase ? boost::regex_constants::ECMAScript : boost::regex_constants::ECMAScript | boost::regex_constants::icase);
+            const char* const first = text.data();
+            const char* const last = first + text.size();
+            const char* from = first;
+            boost::cmatch match;
+            while (from <= last) {
+                boost::regex_constants::match_flag_type flags = boost::regex_constants::match_default | boost::regex_constants::match_not_dot_newline;
+                if (from != first) {
+                    flags |= boost::regex_constants::match_prev_avail;
+                }
+                if (!boost::regex_search(from, last, match, re, flags)) {
+                    break;
+                }
+                matches.push_back({ match[0].first - first, match[0].second - first });
+                from = match[0].second + (match.length(0) == 0 ? 1 : 0);
+            }
+        }
+        catch (const std::exception&) {
+            return false;
+        }
+        return true;
+    }
+#else
+    constexpr bool boostReference = false;
+
+    // Without Boost the reference is std::regex, which agrees with it on texts without
+    // CR and form feed only
+    bool referenceMatches(const std::string& pattern, bool matchCase, const std::string& text, std::vector<MatchInterval>& matches)
+    {
+        try {
+            auto syntax = std::regex_constants::ECMAScript | std::regex_constants::multiline;
+            const std::regex re(pattern, matchCase ? syntax : syntax | std::regex_constants::icase);
+            const char* const first = text.data();
+            const char* const last = first + text.size();
+            const char* from = first;
+            std::cmatch match;
+            while (from <= last) {
+                auto flags = std::regex_constants::match_default;
+                if (from != first) {
+                    flags |= std::regex_constants::match_prev_avail;
+                }
+                if (!std::regex_search(from, last, match, re, flags)) {
+                    break;
+                }
+                matches.push_back({ match[0].first - first, match[0].second - first });
+                from = match[0].second + (match.length(0) == 0 ? 1 : 0);
+            }
+        }
+        catch (const std::regex_error&) {
+            return false;
+        }
+        return true;
+    }
+#endif
+
+    // Random patterns of the syntax RegexUnion compiles, with lazy quantifiers, alternatives
+    // whose order decides the match, and assertions next to line ends
+    std::string generatePattern(Lcg& rng, int depth)
+    {
+        static const char* const atoms[] = { "a", "b", "x", "y", "0", "1", " ", "-", "\\.", "\\r", "\\n", "\\r\\n",
+            "[ab]", "[^a\\n]", "[0-9]", "[a-y]", "\\d", "\\w", "\\s", "\\W", "." };
+        static const char* const assertions[] = { "^", "$", "\\b", "\\B" };
+        static const char* const quantifiers[] = { "*", "+", "?", "*?", "+?", "??", "{1,2}", "{2}", "{0,3}?", "{1,}" };
+
+        std::string pattern;
+        const int alternatives = (rng.below(3) == 0) ? 2 + static_cast<int>(rng.below(2)) : 1;
+        for (int alternative = 0; alternative < alternatives; ++alternative) {
+            if (alternative > 0) {
+                pattern += '|';
+            }
+            const int items = 1 + static_cast<int>(rng.below(4));
+            for (int item = 0; item < items; ++item) {
+                const uint32_t kind = rng.below(10);
+                if (kind == 0) {
+                    pattern += assertions[rng.below(4)];
+                    continue;
+                }
+                if (kind == 1 && depth < 2) {
+                    pattern += (rng.below(2) == 0 ? "(" : "(?:") + generatePattern(rng, depth + 1) + ")";
+                }
+                else {
+                    pattern += atoms[rng.below(sizeof(atoms) / sizeof(atoms[0]))];
+                }
+                if (rng.below(5) < 2) {
+                    pattern += quantifiers[rng.below(sizeof(quantifiers) / sizeof(quantifiers[0]))];
+                }
+            }
+        }
+        return pattern;
+    }
+
+    std::string generateRegexText(uint32_t seed, const char* lineEnd, bool formFeed, bool utf8)
+    {
+        static const char* const pieces[] = { "ab", "ba", "xy", "x", "y", "a", "b", "01", "10", "1", " ", "  ", "a1", "b_", "-", ".", "aab", "yx0" };
+        Lcg rng(seed);
+        std::string text;
+        while (text.size() < 6000) {
+            const uint32_t pick = rng.below(24);
+            if (pick < 18) {
+                text += pieces[pick];
+            }
+            else if (pick < 21) {
+                text += lineEnd;
+            }
+            else if (pick == 21 && formFeed) {
+                text += '\f';
+            }
+            else if (pick == 22 && utf8) {
+                text += "\xC3\xA4";
+            }
+        }
+        return text;
+    }
+
+    // RegexUnion on generated patterns against the search Notepad++ runs for each of them
+    void testRegexUnionPatterns()
+    {
+        const char* const test = "RegexUnionPatterns";
+        struct Text {
+            const char* name;
+            std::string text;
+        };
+        std::vector<Text> texts = {
+            { "LF", generateRegexText(11, "\n", false, false) },
+            { "UTF-8", generateRegexText(12, "\n", false, true) },
+        };
+        if (boostReference) {
+            texts.push_back({ "CRLF", generateRegexText(13, "\r\n", false, false) });
+            texts.push_back({ "CR", generateRegexText(14, "\r", false, false) });
+            texts.push_back({ "form feed", generateRegexText(15, "\r\n", true, false) });
+        }
+
+        const char* const fixed[] = { "b\\b", "\\bx", "y$", "^x", "\\b$", "a+?b", "(a|ab)(b|bab)", "(ab|a)b*?", "x\\r\\n", "\\s+$",
+            "a.*?y", "(?:a|b)+?x", "a|ab", "ab|a", "[ab]{2}?", "\\w+\\b", "\\B\\w", "1\\r?$", "(x|xy)y?" };
+
+        Lcg rng(16);
+        size_t compared = 0;
+        size_t generated = 0;
+        size_t unsearchable = 0;
+        for (const Text& text : texts) {
+            const RegexUnion::TextTraits traits = RegexUnion::traitsOf(text.text.data(), static_cast<Sci_Position>(text.text.size()));
+            for (int batch = 0; batch < 40; ++batch) {
+                // Rules of one union run side by side, each has to find what it finds alone
+                std::vector<std::pair<std::string, bool>> rules;
+                if (batch == 0) {
+                    for (const char* pattern : fixed) {
+                        rules.emplace_back(pattern, true);
+                    }
+                }
+                while (rules.size() < 24) {
+                    rules.emplace_back(generatePattern(rng, 0), rng.below(2) == 0);
+                }
+
+                RegexUnion regexUnion;
+                std::vector<std::pair<std::string, bool>> added;
+                for (const auto& rule : rules) {
+                    ++generated;
+                    if (regexUnion.add(rule.first, rule.second, SC_CP_UTF8, traits)) {
+                        added.push_back(rule);
+                    }
+                }
+                std::vector<std::vector<MatchInterval>> matches;
+                std::vector<bool> oversized;
+                regexUnion.scan(text.text.data(), static_cast<Sci_Position>(text.text.size()), text.text.size() + 1, matches, oversized);
+
+                for (size_t i = 0; i < added.size(); ++i) {
+                    const std::string rule = std::string(text.name) + " " + describe(added[i].first, added[i].second ? SCFIND_MATCHCASE : 0);
+                    std::vector<MatchInterval> expected;
+                    // Boost gives up on some backtracking-heavy patterns the union runs in linear time
+                    if (!referenceMatches(added[i].first, added[i].second, text.text, expected)) {
+                        ++unsearchable;
+                        continue;
+                    }
+                    expectSame(test, rule, matches[i], expected);
+                    ++compared;
+                }
+            }
+        }
+        std::printf("%zu of %zu patterns compared against %s, %zu too complex for it\n", compared, generated,
+            boostReference ? "Boost" : "std::regex", unsearchable);
+    }
+
+    // Presents a small document as the end of one larger than 4 GB: more than 2^32 empty
+    // lines, then a first line padded by more than 2^32 spaces. Only positions inside the
+    // real text can be searched, read or replaced, the messages the engine may send are
+    // translated and anything else is reported.
+    class FarDocument : public DocumentBackend
+    {
+    public:
+        static constexpr Sci_Position EMPTY_LINES = (Sci_Position(1) << 32) + 1;
+        static constexpr Sci_Position PADDING = (Sci_Position(1) << 32) + 3;
+        static constexpr Sci_Position OFFSET = EMPTY_LINES + PADDING; // Position of the real text
+
+        explicit FarDocument(const std::string& text) : real(text) {}
+
+        std::string text() {
+            return textOf(real, { 0, real.send(SCI_GETLENGTH, 0, 0) });
+        }
+
+        std::vector<unsigned int> unexpected;
+
+        sptr_t send(unsigned int message, uptr_t wParam = 0, sptr_t lParam = 0) override {
+            const Sci_Position position = static_cast<Sci_Position>(wParam);
+            switch (message) {
+            case SCI_GETLENGTH:
+            case SCI_GETTEXTLENGTH:
+                return OFFSET + real.send(message, 0, 0);
+            case SCI_GETLINECOUNT:
+                return EMPTY_LINES + real.send(message, 0, 0);
+            case SCI_LINEFROMPOSITION:
+                return position < EMPTY_LINES ? position : EMPTY_LINES + real.send(message, toReal(position), 0);
+            case SCI_POSITIONFROMLINE:
+                if (position <= EMPTY_LINES) {
+                    return position;
+                }
+                return OFFSET + real.send(message, static_cast<uptr_t>(position - EMPTY_LINES), 0);
+            case SCI_SETTARGETRANGE:
+                return real.send(message, toReal(position), toReal(lParam));
+            case SCI_GETTARGETSTART:
+            case SCI_GETTARGETEND:
+                return OFFSET + real.send(message, 0, 0);
+            case SCI_SEARCHINTARGET: {
+                const sptr_t found = real.send(message, wParam, lParam);
+                return found >= 0 ? OFFSET + found : found;
+            }
+            case SCI_GETRANGEPOINTER:
+                return position >= OFFSET ? real.send(message, toReal(position), lParam) : 0;
+            case SCI_GETCHARACTERPOINTER:
+                return 0; // Not in memory as a whole
+            case SCI_GETTEXTRANGEFULL: {
+                Sci_TextRangeFull* range = reinterpret_cast<Sci_TextRangeFull*>(lParam);
+                if (range->chrg.cpMin < OFFSET) {
+                    unexpected.push_back(message);
+                    return 0;
+                }
+                Sci_TextRangeFull shifted{ { range->chrg.cpMin - OFFSET, range->chrg.cpMax - OFFSET }, range->lpstrText };
+                return real.send(message, 0, reinterpret_cast<sptr_t>(&shifted));
+            }
+            case SCI_SETEMPTYSELECTION:
+            case SCI_GOTOPOS:
+                return real.send(message, toReal(position), 0);
+            case SCI_GETCODEPAGE:
+            case SCI_SETSEARCHFLAGS:
+            case SCI_REPLACETARGET:
+            case SCI_BEGINUNDOACTION:
+            case SCI_ENDUNDOACTION:
+            case SCI_GETMODEVENTMASK:
+            case SCI_SETMODEVENTMASK:
+                return real.send(message, wParam, lParam);
+            default:
+                unexpected.push_back(message);
+                return real.send(message, wParam, lParam);
+            }
+        }
+
+    private:
+        static uptr_t toReal(Sci_Position position) {
+            return static_cast<uptr_t>(std::max<Sci_Position>(position - OFFSET, 0));
+        }
+
+        GapBufferDocument real;
+    };
+
+    // The Lua variables of matches beyond 4 GB, which int and double used to cut short
+    void testLuaLargePositions()
+    {
+        const char* const test = "LuaLargePositions";
+        FarDocument doc("x alpha\nalpha beta alpha\n");
+        MultiReplaceEngine engine(doc);
+        engine.nativeLiteralSearch = false;
+        engine.options.indexTrigrams = false;
+
+        ReplaceRule rule;
+        rule.findText = "alpha";
+        rule.replaceText = "set(LINE..\":\"..LPOS..\":\"..APOS..\":\"..CNT..\":\"..LCNT)";
+        rule.matchCase = true;
+        rule.useVariables = true;
+        int findCount = 0;
+        int replaceCount = 0;
+        {
+            BulkEditTransaction transaction(doc);
+            engine.replaceAll(rule, findCount, replaceCount, transaction);
+        }
+
+        // The first line starts after the empty ones, its text after the padding. Positions
+        // are those of the document at the time, after the replacements before.
+        std::string expected;
+        auto replaced = [&expected](Sci_Position line, Sci_Position lineStart, int count, int lineCount) {
+            const Sci_Position pos = FarDocument::OFFSET + static_cast<Sci_Position>(expected.size());
+            expected += std::to_string(line + 1) + ":" + std::to_string(pos - lineStart + 1) + ":" + std::to_string(pos + 1) + ":" +
+                std::to_string(count) + ":" + std::to_string(lineCount);
+        };
+        expected = "x ";
+        replaced(FarDocument::EMPTY_LINES, FarDocument::EMPTY_LINES, 1, 1);
+        expected += "\n";
+        const Sci_Position secondLineStart = FarDocument::OFFSET + static_cast<Sci_Position>(expected.size());
+        replaced(FarDocument::EMPTY_LINES + 1, secondLineStart, 2, 1);
+        expected += " beta ";
+        replaced(FarDocument::EMPTY_LINES + 1, secondLineStart, 3, 2);
+        expected += "\n";
+        const std::string actual = doc.text();
+        if (replaceCount != 3 || actual != expected) {
+            fail(test, std::to_string(replaceCount) + " replacements, text '" + actual + "', expected '" + expected + "'");
+        }
+        for (unsigned int message : doc.unexpected) {
+            fail(test, "untranslated message " + std::to_string(message));
+        }
+    }
+
+    // A document whose searches from slowFrom on take longer than the watchdog allows
+    class SlowDocument : public DocumentBackend
+    {
+    public:
+        SlowDocument(const std::string& text, Sci_Position slowFrom) : real(text), slowFrom(slowFrom) {}
+
+        GapBufferDocument real;
+
+        sptr_t send(unsigned int message, uptr_t wParam = 0, sptr_t lParam = 0) override {
+            if (message == SCI_SETTARGETRANGE) {
+                targetStart = static_cast<Sci_Position>(wParam);
+            }
+            else if (message == SCI_SEARCHINTARGET && targetStart >= slowFrom) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(30));
+            }
+            return real.send(message, wParam, lParam);
+        }
+
+    private:
+        Sci_Position slowFrom;
+        Sci_Position targetStart = 0;
+    };
+
+    // Replace All of a regex rule the watchdog stops part way leaves the document as it was
+    void testWatchdogReplaceAll()
+    {
+        const char* const test = "WatchdogReplaceAll";
+        std::string text;
+        for (int i = 0; i < 40; ++i) {
+            text += "item " + std::to_string(i) + "\n";
+        }
+        const Sci_Position middle = static_cast<Sci_Position>(text.size() / 2);
+
+        // Searched in slices of lines and as a whole
+        for (const char* pattern : { "item (\\d+)", "item\\s(\\d+)" }) {
+            ReplaceRule rule;
+            rule.findText = pattern;
+            rule.replaceText = "entry \\1 of many";
+            rule.regex = true;
+            rule.matchCase = true;
+
+            for (int budget : { 10, 0 }) {
+                SlowDocument doc(text, middle);
+                MultiReplaceEngine engine(doc);
+                engine.regexWatchdog.beginOperation(budget);
+                int findCount = 0;
+                int replaceCount = 0;
+                {
+                    BulkEditTransaction transaction(doc);
+                    engine.replaceAll(rule, findCount, replaceCount, transaction);
+                }
+
+                const std::string name = std::string(pattern) + " with a budget of " + std::to_string(budget) + " ms";
+                const bool stopped = engine.regexWatchdog.isStopped(pattern, SCFIND_REGEXP | SCFIND_MATCHCASE);
+                if (stopped != (budget > 0)) {
+                    fail(test, name + (stopped ? ": stopped" : ": not stopped"));
+                }
+                const int expected = stopped ? 0 : 40;
+                if (findCount != expected || replaceCount != expected) {
+                    fail(test, name + ": " + std::to_string(replaceCount) + " replaced, expected " + std::to_string(expected));
+                }
+                if (stopped && doc.real.getText() != text) {
+                    fail(test, name + ": the document was changed");
+                }
+            }
+        }
+    }
+
+    // Live replace only replaces typed text. Text auto-completion, a macro or another plugin
+    // inserts next to or into it is reported by SCN_MODIFIED alike but gets no SCN_CHARADDED.
+    void testLiveReplaceTyping()
+    {
+        const char* const test = "LiveReplaceTyping";
+        GapBufferDocument doc("");
+        MultiReplaceEngine engine(doc);
+        TypedText typedText;
+        doc.setModificationHandler([&typedText](const SCNotification& scn) {
+            if (scn.modificationType & SC_MOD_INSERTTEXT) {
+                typedText.inserted(scn.position, scn.length);
+            }
+            else if (scn.modificationType & SC_MOD_DELETETEXT) {
+                typedText.deleted(scn.position, scn.length);
+            }
+            });
+        auto insert = [&doc](Sci_Position pos, const std::string& text) {
+            doc.send(SCI_INSERTTEXT, static_cast<uptr_t>(pos), reinterpret_cast<sptr_t>(text.c_str()));
+        };
+        auto type = [&](const std::string& text) {
+            for (char ch : text) {
+                const Sci_Position caret = doc.length() + 1;
+                insert(doc.length(), std::string(1, ch));
+                if (!typedText.charAdded(caret)) {
+                    fail(test, std::string("typed '") + ch + "' not tracked");
+                }
+            }
+        };
+
+        type("ab teh ");
+        insert(1, "teh");
+        insert(doc.length(), "teh");
+        // An insert that does not end at the caret, like a closing bracket added after it
+        insert(doc.length(), "teh");
+        if (typedText.charAdded(doc.length() - 3)) {
+            fail(test, "insert behind the caret tracked");
+        }
+
+        ReplaceRule rule;
+        rule.findText = "teh";
+        rule.replaceText = "the";
+        rule.matchCase = true;
+        std::vector<SelectionRange> ranges = typedText.take();
+        std::vector<RuleCount> counts;
+        {
+            BulkEditTransaction transaction(doc);
+            engine.replaceInRanges({ rule }, ranges, counts);
+        }
+        const std::string expected = "atehb the tehteh";
+        if (doc.getText() != expected) {
+            fail(test, "\"" + doc.getText() + "\", expected \"" + expected + "\"");
+        }
+    }
+
+    struct Test {
+        const char* name;
+        void (*run)();
+    };
+
+    const Test tests[] = {
+        { "LiteralSearch", testLiteralSearch },
+        { "RegexPrefilter", testRegexPrefilter },
+        { "FuzzySearch", testFuzzySearch },
+        { "FoldedText", testFoldedText },
+        { "TrigramIndex", testTrigramIndex },
+        { "FusedReplace", testFusedReplace },
+        { "RegexUnion", testRegexUnion },
+        { "RegexUnionPatterns", testRegexUnionPatterns },
+        { "LuaLargePositions", testLuaLargePositions },
+        { "WatchdogReplaceAll", testWatchdogReplaceAll },
+        { "LiveReplaceTyping", testLiveReplaceTyping },
+    };
+
+}
+
+int main(int argc, char* argv[])
+{
+    bool found = false;
+    for (const Test& test : tests) {
+        if (argc > 1 && std::strcmp(argv[1], test.name) != 0) {
+            continue;
+        }
+        found = true;
+        const int before = failures;
+        test.run();
+        std::printf("%-16s %s\n", test.name, failures == before ? "ok" : "FAILED");
+    }
+    if (!found) {
+        std::fprintf(stderr, "unknown test: %s\n", argv[1]);
+        return 2;
+    }
+    return failures == 0 ? 0 : 1;
+}
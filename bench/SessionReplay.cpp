@@ -0,0 +1,88 @@
+// This file is part of Notepad++ project
+// Copyright (C)2023 Thomas Knoefel
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+// Replays a session recorded in Notepad++ against a GapBufferDocument, so a slow
+// session can be reproduced and measured without the editor.
+//
+// Usage: MultiReplaceReplay <session.mrtrace> [--runs N] [--rows N]
+
+#include "GapBufferDocument.h"
+#include "MessageRecorder.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+
+int main(int argc, char* argv[])
+{
+    std::string sessionFile;
+    int runs = 1;
+    size_t rows = 25;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--runs" && hasValue) {
+            runs = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (arg == "--rows" && hasValue) {
+            rows = static_cast<size_t>(std::strtoull(argv[++i], nullptr, 10));
+        }
+        else if (sessionFile.empty() && arg.compare(0, 2, "--") != 0) {
+            sessionFile = arg;
+        }
+        else {
+            sessionFile.clear();
+            break;
+        }
+    }
+    if (sessionFile.empty()) {
+        std::fprintf(stderr, "Usage: %s <session.mrtrace> [--runs N] [--rows N]\n", argv[0]);
+        return 1;
+    }
+
+    std::ifstream in(sessionFile, std::ios::binary);
+    RecordedSession session;
+    if (!in.is_open() || !MessageRecorder::load(in, session)) {
+        std::fprintf(stderr, "Could not read session %s\n", sessionFile.c_str());
+        return 1;
+    }
+
+    int64_t recordedNanoseconds = 0;
+    for (const RecordedMessage& m : session.messages) {
+        recordedNanoseconds += m.nanoseconds;
+    }
+    std::printf("session: %zu messages%s, %.1f ms in Notepad++\n", session.messages.size(),
+        session.truncated ? " (truncated)" : "", static_cast<double>(recordedNanoseconds) / 1e6);
+
+    ReplayResult best;
+    for (int run = 0; run < runs; ++run) {
+        GapBufferDocument doc;
+        ReplayResult result = MessageRecorder::replay(session, doc);
+        std::printf("run %d: %.1f ms, %zu replayed, %zu skipped, %zu mismatches\n", run + 1,
+            static_cast<double>(result.nanoseconds) / 1e6, result.replayed, result.skipped, result.mismatches);
+        if (doc.unhandledMessages() > 0) {
+            std::fprintf(stderr, "  warning: %zu messages not implemented by GapBufferDocument\n", doc.unhandledMessages());
+        }
+        if (run == 0 || result.nanoseconds < best.nanoseconds) {
+            best = std::move(result);
+        }
+    }
+
+    std::printf("\n%s", MessageRecorder::formatHistogram(best.histogram, rows).c_str());
+    return 0;
+}
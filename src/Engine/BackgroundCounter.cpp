@@ -0,0 +1,197 @@
+// This file is part of Notepad++ project
+// Copyright (C)2023 Thomas Knoefel
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "BackgroundCounter.h"
+#include "GapBufferDocument.h"
+
+#include <algorithm>
+
+std::shared_ptr<const std::string> CountSnapshot::captureText(DocumentBackend& doc, size_t maxBytes)
+{
+    Sci_Position length = doc.send(SCI_GETLENGTH, 0, 0);
+    length = static_cast<Sci_Position>(std::min(static_cast<size_t>(length), maxBytes));
+
+    auto text = std::make_shared<std::string>(static_cast<size_t>(length) + 1, '\0');
+    Sci_TextRangeFull tr{ { 0, length }, &(*text)[0] };
+    doc.send(SCI_GETTEXTRANGEFULL, 0, reinterpret_cast<sptr_t>(&tr));
+    text->resize(static_cast<size_t>(length));
+    return text;
+}
+
+static std::string charsOfClass(DocumentBackend& doc, unsigned int message)
+{
+    std::string chars(static_cast<size_t>(doc.send(message, 0, 0)), '\0');
+    if (!chars.empty()) {
+        doc.send(message, 0, reinterpret_cast<sptr_t>(&chars[0]));
+    }
+    return chars;
+}
+
+CountSnapshot CountSnapshot::capture(DocumentBackend& doc, const MultiReplaceEngine& engine, std::shared_ptr<const std::string> text)
+{
+    CountSnapshot snapshot;
+    snapshot.text = text ? std::move(text) : captureText(doc);
+    snapshot.documentLength = doc.send(SCI_GETLENGTH, 0, 0);
+    snapshot.codePage = static_cast<int>(doc.send(SCI_GETCODEPAGE, 0, 0));
+    snapshot.wordChars = charsOfClass(doc, SCI_GETWORDCHARS);
+    snapshot.whitespaceChars = charsOfClass(doc, SCI_GETWHITESPACECHARS);
+    snapshot.punctuationChars = charsOfClass(doc, SCI_GETPUNCTUATIONCHARS);
+    snapshot.options = engine.options;
+
+    if (engine.options.scope == SearchScope::Selection) {
+        Sci_Position selectionCount = doc.send(SCI_GETSELECTIONS, 0, 0);
+        for (Sci_Position i = 0; i < selectionCount; ++i) {
+            snapshot.selections.push_back({ doc.send(SCI_GETSELECTIONNSTART, i, 0), doc.send(SCI_GETSELECTIONNEND, i, 0) });
+        }
+    }
+    else if (engine.options.scope == SearchScope::Column) {
+        snapshot.columnDelimiterData = engine.columnDelimiterData;
+        snapshot.lineDelimiterPositions = engine.lineDelimiterPositions;
+    }
+    return snapshot;
+}
+
+void CountSnapshot::applyTo(DocumentBackend& copy) const
+{
+    copy.send(SCI_SETCODEPAGE, static_cast<uptr_t>(codePage), 0);
+    // Word characters first, setting them makes all others that are no space punctuation
+    copy.send(SCI_SETWORDCHARS, 0, reinterpret_cast<sptr_t>(wordChars.c_str()));
+    copy.send(SCI_SETWHITESPACECHARS, 0, reinterpret_cast<sptr_t>(whitespaceChars.c_str()));
+    copy.send(SCI_SETPUNCTUATIONCHARS, 0, reinterpret_cast<sptr_t>(punctuationChars.c_str()));
+}
+
+BackgroundCounter::~BackgroundCounter()
+{
+    join();
+}
+
+uint64_t BackgroundCounter::start(CountSnapshot snapshot, std::vector<CountRule> rules, ResultHandler onResult, FinishHandler onFinished)
+{
+    cancel();
+    job = std::make_unique<Job>();
+    ++jobId;
+    job->thread = std::thread(&BackgroundCounter::run, std::ref(*job), jobId, std::move(snapshot), std::move(rules), std::move(onResult), std::move(onFinished));
+    return jobId;
+}
+
+void BackgroundCounter::cancel()
+{
+    if (job) {
+        job->cancelRequested = true;
+        retired.push_back(std::move(job));
+    }
+    reap();
+}
+
+void BackgroundCounter::join()
+{
+    cancel();
+    for (const std::unique_ptr<Job>& retiredJob : retired) {
+        retiredJob->thread.join();
+    }
+    retired.clear();
+}
+
+void BackgroundCounter::reap()
+{
+    retired.erase(std::remove_if(retired.begin(), retired.end(), [](const std::unique_ptr<Job>& retiredJob) {
+        if (!retiredJob->finished) {
+            return false;
+        }
+        retiredJob->thread.join(); // Only the finish handler is left to run
+        return true;
+        }), retired.end());
+}
+
+bool BackgroundCounter::searchesLikeScintilla(const CountRule& rule, const CountSnapshot& snapshot, bool asciiText)
+{
+    if (rule.searchFlags & SEARCH_FUZZY) {
+        return true; // Searched by the engine itself on the copy as well
+    }
+    if (snapshot.options.foldCharacters && snapshot.codePage == SC_CP_UTF8 &&
+        FoldedText::appliesTo(FoldedText::fold(rule.findTextUtf8), rule.searchFlags)) {
+        return true; // The same folded shadow search as on the UI thread
+    }
+    if (rule.searchFlags & SCFIND_REGEXP) {
+        return false;
+    }
+    const bool asciiFind = std::none_of(rule.findTextUtf8.begin(), rule.findTextUtf8.end(), [](char ch) {
+        return static_cast<unsigned char>(ch) >= 0x80;
+        });
+    if (!(rule.searchFlags & SCFIND_MATCHCASE) && !asciiFind) {
+        return false;
+    }
+    if (asciiText) {
+        return true;
+    }
+
+    // Non-ASCII text: no character boundaries in DBCS code pages, no Unicode word classes
+    return (snapshot.codePage == 0 || snapshot.codePage == SC_CP_UTF8) && !(rule.searchFlags & SCFIND_WHOLEWORD);
+}
+
+void BackgroundCounter::run(Job& job, uint64_t id, CountSnapshot snapshot, std::vector<CountRule> rules, ResultHandler onResult, FinishHandler onFinished)
+{
+    // The copy and its engine are gone before the job is marked finished
+    {
+        const bool asciiText = std::none_of(snapshot.text->begin(), snapshot.text->end(), [](char ch) {
+            return static_cast<unsigned char>(ch) >= 0x80;
+            });
+
+        GapBufferDocument doc(snapshot.text);
+        snapshot.applyTo(doc);
+        const bool sample = snapshot.isSample();
+        const double scale = sample ? static_cast<double>(snapshot.documentLength) / std::max<size_t>(snapshot.text->size(), 1) : 1.0;
+        snapshot.text.reset();
+
+        for (size_t i = 0; i < snapshot.selections.size(); ++i) {
+            const SelectionRange& selection = snapshot.selections[i];
+            doc.send(i == 0 ? SCI_SETSELECTION : SCI_ADDSELECTION, static_cast<uptr_t>(selection.end), selection.start);
+        }
+
+        MultiReplaceEngine engine(doc);
+        engine.options = snapshot.options;
+        engine.columnDelimiterData = std::move(snapshot.columnDelimiterData);
+        engine.lineDelimiterPositions = std::move(snapshot.lineDelimiterPositions);
+        engine.cancellationCheck = [&job]() { return job.cancelRequested.load(); };
+
+        for (const CountRule& rule : rules) {
+            if (job.cancelRequested) {
+                break;
+            }
+            CountResult result;
+            result.index = rule.index;
+            result.exact = searchesLikeScintilla(rule, snapshot, asciiText);
+            if (result.exact || rule.allowApproximate) {
+                result.count = engine.countString(rule.findTextUtf8, rule.searchFlags, rule.maxCount);
+                if (sample) {
+                    result.count = static_cast<int>(std::min<double>(result.count * scale, rule.maxCount));
+                    result.exact = false;
+                }
+            }
+            else {
+                result.count = DEFERRED;
+            }
+            if (!job.cancelRequested) {
+                onResult(id, result);
+            }
+        }
+    }
+
+    // Finished before the handler, which may ask isRunning()
+    const bool cancelled = job.cancelRequested;
+    job.finished = true;
+    onFinished(id, cancelled);
+}
@@ -0,0 +1,138 @@
+// This file is part of Notepad++ project
+// Copyright (C)2023 Thomas Knoefel
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef BACKGROUND_COUNTER_H
+#define BACKGROUND_COUNTER_H
+
+#include "MultiReplaceEngine.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct CountRule {
+    size_t index = 0; // Row in the list
+    std::string findTextUtf8;
+    int searchFlags = 0;
+    int maxCount = std::numeric_limits<int>::max(); // Counting stops here
+    bool allowApproximate = false; // Count on the copy even if Scintilla could find something else
+};
+
+struct CountResult {
+    size_t index = 0;
+    int count = 0;
+    bool exact = true; // False for approximate rules and counts extrapolated from a sample
+};
+
+// Everything the counting engine needs, copied on the UI thread
+struct CountSnapshot {
+    std::shared_ptr<const std::string> text; // Whole document, or its start for a sample
+    Sci_Position documentLength = 0;
+    int codePage = 0;
+    std::string wordChars; // Character classes for whole word searches, as SCI_GET*CHARS returns them
+    std::string whitespaceChars;
+    std::string punctuationChars;
+    EngineOptions options;
+    std::vector<SelectionRange> selections;
+    ColumnDelimiterData columnDelimiterData;
+    std::vector<LineInfo> lineDelimiterPositions;
+
+    bool isSample() const {
+        return static_cast<Sci_Position>(text->size()) < documentLength;
+    }
+
+    // Takes the scope state of the engine and the text, which is copied if none is given.
+    // Texts can be shared between snapshots of the same document version.
+    static CountSnapshot capture(DocumentBackend& doc, const MultiReplaceEngine& engine, std::shared_ptr<const std::string> text = nullptr);
+
+    // At most maxBytes from the start of the document
+    static std::shared_ptr<const std::string> captureText(DocumentBackend& doc, size_t maxBytes = std::numeric_limits<size_t>::max());
+
+    // Sets code page and character classes of the copy the worker searches
+    void applyTo(DocumentBackend& copy) const;
+};
+
+// Counts the matches of a rule list on a worker thread. The worker searches its own
+// GapBufferDocument copy with its own engine, the editor is never touched. Each job has
+// its own thread and cancel flag: a cancelled job is retired and runs on until its next
+// check, while the next job already starts. Retired threads are joined once they ended.
+class BackgroundCounter
+{
+public:
+    static constexpr int DEFERRED = -1; // Count of a rule the copy cannot search like Scintilla
+
+    // Both run on the worker thread. Results arrive in rule order, DEFERRED rules have to
+    // be counted against the editor instead. Counts of a sample are scaled to the document.
+    using ResultHandler = std::function<void(uint64_t job, const CountResult& result)>;
+    using FinishHandler = std::function<void(uint64_t job, bool cancelled)>;
+
+    BackgroundCounter() = default;
+    BackgroundCounter(const BackgroundCounter&) = delete;
+    BackgroundCounter& operator=(const BackgroundCounter&) = delete;
+    ~BackgroundCounter();
+
+    // Cancels a running job and starts a new one, returns its id
+    uint64_t start(CountSnapshot snapshot, std::vector<CountRule> rules, ResultHandler onResult, FinishHandler onFinished);
+
+    // Retires the running job without waiting for its thread. Its handlers may still be
+    // called until it notices, with its own job id.
+    void cancel();
+
+    // Asks the running job to stop, it stays the current one until it has
+    void requestCancel() noexcept {
+        if (job) {
+            job->cancelRequested = true;
+        }
+    }
+
+    // Cancels all jobs and waits for their threads, e.g. before the handlers' target goes away
+    void join();
+
+    bool isRunning() const noexcept {
+        return job && !job->finished;
+    }
+
+    uint64_t currentJob() const noexcept {
+        return jobId;
+    }
+
+    // True if searching the copy finds exactly what Scintilla finds. The copy folds case
+    // and classifies word characters for ASCII only, and it has a different regex engine.
+    static bool searchesLikeScintilla(const CountRule& rule, const CountSnapshot& snapshot, bool asciiText);
+
+private:
+    struct Job {
+        std::atomic<bool> cancelRequested{ false };
+        std::atomic<bool> finished{ false }; // Set last, the thread touches nothing of the job after it
+        std::thread thread;
+    };
+
+    static void run(Job& job, uint64_t id, CountSnapshot snapshot, std::vector<CountRule> rules, ResultHandler onResult, FinishHandler onFinished);
+
+    // Joins the retired jobs that ended
+    void reap();
+
+    std::unique_ptr<Job> job; // Current job, null before the first start
+    std::vector<std::unique_ptr<Job>> retired;
+    uint64_t jobId = 0;
+};
+
+#endif // BACKGROUND_COUNTER_H
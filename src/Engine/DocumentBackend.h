@@ -0,0 +1,36 @@
+// This file is part of Notepad++ project
+// Copyright (C)2023 Thomas Knoefel
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef DOCUMENT_BACKEND_H
+#define DOCUMENT_BACKEND_H
+
+#include "../Scintilla.h"
+
+// Everything the engine does with a document goes through this interface using
+// Scintilla's message protocol. In Notepad++ it is backed by the Scintilla view,
+// headless builds use GapBufferDocument instead.
+class DocumentBackend
+{
+public:
+    virtual ~DocumentBackend() = default;
+
+    virtual sptr_t send(unsigned int iMessage, uptr_t wParam = 0, sptr_t lParam = 0) = 0;
+
+    // Turns repainting of the view on or off, a no-op for documents without a view
+    virtual void setRedraw(bool enable) { (void)enable; }
+};
+
+#endif // DOCUMENT_BACKEND_H
@@ -0,0 +1,407 @@
+// This file is part of Notepad++ project
+// Copyright (C)2023 Thomas Knoefel
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "FoldedText.h"
+
+#include <algorithm>
+
+namespace {
+
+    // Base letters of U+00C0 to U+017F, 0 where the character stays as it is. Characters
+    // that fold to two letters are handled in foldCharacter.
+    constexpr char LATIN_BASE[] =
+        "AAAAAA\0CEEEEIIII"   // U+00C0
+        "DNOOOOO\0OUUUUY\0\0" // U+00D0
+        "aaaaaa\0ceeeeiiii"   // U+00E0
+        "dnooooo\0ouuuuy\0y"  // U+00F0
+        "AaAaAaCcCcCcCcDd"    // U+0100
+        "DdEeEeEeEeEeGgGg"    // U+0110
+        "GgGgHhHhIiIiIiIi"    // U+0120
+        "Ii\0\0JjKk\0LlLlLlL" // U+0130
+        "lLlNnNnNn\0\0\0OoOo" // U+0140
+        "Oo\0\0RrRrRrSsSsSs"  // U+0150
+        "SsTtTtTtUuUuUuUu"    // U+0160
+        "UuUuWwYyYZzZzZzs";   // U+0170
+    static_assert(sizeof(LATIN_BASE) == 0x180 - 0xC0 + 1, "One entry per character");
+
+    constexpr Sci_Position BLOCK_SIZE = 65536;
+
+    bool isCombiningMark(uint32_t ch) {
+        return (ch >= 0x0300 && ch <= 0x036F) || (ch >= 0x1AB0 && ch <= 0x1AFF) ||
+            (ch >= 0x1DC0 && ch <= 0x1DFF) || (ch >= 0x20D0 && ch <= 0x20FF) || (ch >= 0xFE20 && ch <= 0xFE2F);
+    }
+
+    // Folds the character at p and moves p behind it. Writes at most 4 bytes to out and
+    // returns their number. Bytes that are no UTF-8 sequence are kept one by one. A combining
+    // mark after CR is kept, dropping it could join the CR with an LF behind it.
+    size_t foldCharacter(const char*& p, const char* last, bool afterCr, char* out)
+    {
+        const unsigned char lead = static_cast<unsigned char>(*p);
+        if (lead < 0x80) {
+            *out = *p++;
+            return 1;
+        }
+
+        const ptrdiff_t trailCount = (lead >= 0xF8) ? -1 : (lead >= 0xF0) ? 3 : (lead >= 0xE0) ? 2 : (lead >= 0xC2) ? 1 : -1;
+        bool valid = trailCount > 0 && last - p > trailCount;
+        uint32_t ch = lead & (0x3F >> trailCount);
+        for (ptrdiff_t i = 1; valid && i <= trailCount; ++i) {
+            const unsigned char trail = static_cast<unsigned char>(p[i]);
+            valid = (trail & 0xC0) == 0x80;
+            ch = (ch << 6) | (trail & 0x3F);
+        }
+        if (!valid) {
+            *out = *p++;
+            return 1;
+        }
+
+        const char* const sequence = p;
+        p += trailCount + 1;
+        if (ch >= 0xC0 && ch < 0x180) {
+            const char* pair = nullptr;
+            switch (ch) {
+            case 0xC6: pair = "AE"; break;
+            case 0xDF: pair = "ss"; break;
+            case 0xE6: pair = "ae"; break;
+            case 0x132: pair = "IJ"; break;
+            case 0x133: pair = "ij"; break;
+            case 0x152: pair = "OE"; break;
+            case 0x153: pair = "oe"; break;
+            default: break;
+            }
+            if (pair) {
+                out[0] = pair[0];
+                out[1] = pair[1];
+                return 2;
+            }
+            if (LATIN_BASE[ch - 0xC0] != '\0') {
+                *out = LATIN_BASE[ch - 0xC0];
+                return 1;
+            }
+        }
+        else if (isCombiningMark(ch) && !afterCr) {
+            return 0;
+        }
+        else if (ch >= 0xFF01 && ch <= 0xFF5E) {
+            *out = static_cast<char>(ch - 0xFEE0); // Full-width ASCII
+            return 1;
+        }
+        else if (ch == 0x3000) {
+            *out = ' '; // Ideographic space
+            return 1;
+        }
+        std::copy(sequence, p, out);
+        return static_cast<size_t>(p - sequence);
+    }
+
+    // Steps through the document from a position, reading it in blocks
+    class DocumentWalker
+    {
+    public:
+        DocumentWalker(DocumentBackend& document, Sci_Position start, Sci_Position length)
+            : doc(document), pos(start), documentLength(length)
+        {
+            afterCr = start > 0 && doc.send(SCI_GETCHARAT, start - 1, 0) == '\r';
+            fetch();
+        }
+
+        Sci_Position position() const noexcept {
+            return pos;
+        }
+
+        bool atEnd() const noexcept {
+            return pos >= documentLength || !block;
+        }
+
+        // Folds the next character and returns its folded length
+        size_t next(char* out) {
+            // A character must not be cut at the end of the block
+            if (blockEnd - pos < 4 && blockEnd < documentLength) {
+                fetch();
+            }
+            const char* p = block + (pos - blockStart);
+            const char* const start = p;
+            const size_t foldedLength = foldCharacter(p, block + (blockEnd - blockStart), afterCr, out);
+            afterCr = *start == '\r';
+            pos += p - start;
+            return foldedLength;
+        }
+
+        // Folded length of the next character without moving on
+        size_t peek() {
+            const Sci_Position savedPos = pos;
+            const bool savedAfterCr = afterCr;
+            char out[4];
+            const size_t foldedLength = next(out);
+            pos = savedPos;
+            afterCr = savedAfterCr;
+            return foldedLength;
+        }
+
+    private:
+        void fetch() {
+            blockStart = pos;
+            blockEnd = std::min(documentLength, pos + BLOCK_SIZE);
+            block = reinterpret_cast<const char*>(doc.send(SCI_GETRANGEPOINTER, blockStart, blockEnd - blockStart));
+        }
+
+        DocumentBackend& doc;
+        Sci_Position pos;
+        Sci_Position documentLength;
+        const char* block = nullptr;
+        Sci_Position blockStart = 0;
+        Sci_Position blockEnd = 0;
+        bool afterCr = false;
+    };
+
+    void foldInto(const char* first, const char* last, bool afterCr, std::string& folded)
+    {
+        char out[4];
+        while (first < last) {
+            // Runs of ASCII are copied as they are
+            const char* ascii = first;
+            while (ascii < last && static_cast<unsigned char>(*ascii) < 0x80) {
+                ++ascii;
+            }
+            if (ascii > first) {
+                folded.append(first, ascii);
+                afterCr = ascii[-1] == '\r';
+                first = ascii;
+            }
+            if (first < last) {
+                folded.append(out, foldCharacter(first, last, afterCr, out));
+                afterCr = false;
+            }
+        }
+    }
+
+    bool isAfterCr(DocumentBackend& doc, Sci_Position pos)
+    {
+        return pos > 0 && doc.send(SCI_GETCHARAT, pos - 1, 0) == '\r';
+    }
+
+    // A combining mark at pos is folded depending on the character before it
+    bool isCombiningMarkAt(DocumentBackend& doc, Sci_Position pos, Sci_Position documentLength)
+    {
+        const Sci_Position available = std::min<Sci_Position>(4, documentLength - pos);
+        const char* p = (available > 0) ? reinterpret_cast<const char*>(doc.send(SCI_GETRANGEPOINTER, pos, available)) : nullptr;
+        char out[4];
+        return p && foldCharacter(p, p + available, false, out) == 0;
+    }
+
+}
+
+std::string FoldedText::fold(const std::string& text)
+{
+    std::string folded;
+    folded.reserve(text.size());
+    foldInto(text.data(), text.data() + text.size(), false, folded);
+    return folded;
+}
+
+bool FoldedText::appliesTo(const std::string& foldedFindText, int searchFlags)
+{
+    if (foldedFindText.empty() || (searchFlags & SCFIND_REGEXP)) {
+        return false;
+    }
+    return (searchFlags & SCFIND_MATCHCASE) || !LiteralMatcher::hasNonAscii(foldedFindText.data(), foldedFindText.data() + foldedFindText.size());
+}
+
+void FoldedText::reset()
+{
+    if (built) {
+        shadow.setText(std::string());
+    }
+    built = false;
+    documentLength = 0;
+    cursor = Cursor();
+    literalSearch.reset();
+    fuzzySearch.reset();
+}
+
+bool FoldedText::sync(DocumentBackend& doc)
+{
+    const Sci_Position length = doc.send(SCI_GETLENGTH, 0, 0);
+    if (built && length == documentLength) {
+        return true;
+    }
+    reset();
+
+    // Other line ends would give the document lines the shadow does not have
+    if (doc.send(SCI_GETCODEPAGE, 0, 0) != SC_CP_UTF8 || doc.send(SCI_GETLINEENDTYPESACTIVE, 0, 0) != SC_LINE_END_TYPE_DEFAULT) {
+        return false;
+    }
+    const char* text = reinterpret_cast<const char*>(doc.send(SCI_GETCHARACTERPOINTER, 0, 0));
+    if (!text && length > 0) {
+        return false;
+    }
+
+    std::string folded;
+    folded.reserve(static_cast<size_t>(length));
+    foldInto(text, text + length, false, folded);
+    shadow.setText(folded);
+    documentLength = length;
+    built = true;
+    return true;
+}
+
+Sci_Position FoldedText::toFolded(DocumentBackend& doc, Sci_Position pos)
+{
+    if (pos <= 0) {
+        return 0;
+    }
+    if (pos >= documentLength) {
+        return shadow.length();
+    }
+
+    // The line of the character before pos starts at the same place in both, even while an
+    // edit at pos is being applied
+    const Sci_Position line = doc.send(SCI_LINEFROMPOSITION, pos - 1, 0);
+    Cursor from{ doc.send(SCI_POSITIONFROMLINE, line, 0), shadow.send(SCI_POSITIONFROMLINE, line, 0) };
+    if (cursor.original >= from.original && cursor.original <= pos) {
+        from = cursor;
+    }
+
+    DocumentWalker walker(doc, from.original, documentLength);
+    Sci_Position foldedPos = from.folded;
+    char out[4];
+    while (!walker.atEnd() && walker.position() < pos) {
+        foldedPos += static_cast<Sci_Position>(walker.next(out));
+    }
+    cursor = { walker.position(), foldedPos };
+    return foldedPos;
+}
+
+Sci_Position FoldedText::toOriginal(DocumentBackend& doc, Sci_Position foldedPos, bool isEnd)
+{
+    if (foldedPos <= 0) {
+        return 0;
+    }
+    if (foldedPos >= shadow.length()) {
+        return documentLength;
+    }
+
+    const Sci_Position line = shadow.send(SCI_LINEFROMPOSITION, foldedPos - 1, 0);
+    Cursor from{ doc.send(SCI_POSITIONFROMLINE, line, 0), shadow.send(SCI_POSITIONFROMLINE, line, 0) };
+    if (cursor.folded >= from.folded && cursor.folded <= foldedPos) {
+        from = cursor;
+    }
+
+    DocumentWalker walker(doc, from.original, documentLength);
+    Sci_Position folded = from.folded;
+    char out[4];
+    while (!walker.atEnd() && folded < foldedPos) {
+        const Sci_Position before = walker.position();
+        const Sci_Position foldedLength = static_cast<Sci_Position>(walker.next(out));
+        if (folded + foldedLength > foldedPos) {
+            // Inside the letters of one character, e.g. the first s of sharp s: the match
+            // takes the whole character
+            cursor = { before, folded };
+            return isEnd ? walker.position() : before;
+        }
+        folded += foldedLength;
+    }
+
+    // Combining marks belong to the character before them, matches ending there keep them
+    // and matches starting there begin behind them
+    while (!walker.atEnd() && walker.peek() == 0) {
+        walker.next(out);
+    }
+    cursor = { walker.position(), folded };
+    return walker.position();
+}
+
+void FoldedText::update(DocumentBackend& doc, int modificationType, Sci_Position position, Sci_Position length, const char* text)
+{
+    if (!built || length <= 0) {
+        return;
+    }
+
+    // Mapped positions before the edit stay valid
+    if (cursor.original > position) {
+        cursor = Cursor();
+    }
+
+    std::string folded;
+    if (modificationType & SC_MOD_INSERTTEXT) {
+        // The text before position is unchanged, so is the mapping up to it
+        documentLength += length;
+        const Sci_Position foldedPos = toFolded(doc, position);
+        const char* inserted = text ? text : reinterpret_cast<const char*>(doc.send(SCI_GETRANGEPOINTER, position, length));
+        // The text must not complete a character before it or change how a mark after it folds
+        if (!inserted || (position > 0 && cursor.original != position) || isCombiningMarkAt(doc, position + length, documentLength)) {
+            reset();
+            return;
+        }
+        foldInto(inserted, inserted + length, isAfterCr(doc, position), folded);
+        shadow.send(SCI_SETTARGETRANGE, foldedPos, foldedPos);
+        shadow.send(SCI_REPLACETARGET, folded.size(), reinterpret_cast<sptr_t>(folded.data()));
+    }
+    else if (modificationType & SC_MOD_DELETETEXT) {
+        documentLength -= length;
+        if (!text || isCombiningMarkAt(doc, position, documentLength)) {
+            reset();
+            return;
+        }
+        foldInto(text, text + length, isAfterCr(doc, position), folded);
+        const Sci_Position foldedPos = (position < documentLength) ? toFolded(doc, position) :
+            shadow.length() - static_cast<Sci_Position>(folded.size());
+        shadow.send(SCI_SETTARGETRANGE, foldedPos, foldedPos + static_cast<Sci_Position>(folded.size()));
+        shadow.send(SCI_REPLACETARGET, 0, reinterpret_cast<sptr_t>(""));
+    }
+}
+
+bool FoldedText::find(DocumentBackend& doc, const std::string& findTextUtf8, int searchFlags,
+    Sci_Position start, Sci_Position end, Sci_Position& pos, Sci_Position& matchEnd)
+{
+    if (findTextUtf8 != findText) {
+        findText = findTextUtf8;
+        foldedFindText = fold(findText);
+    }
+    if (!appliesTo(foldedFindText, searchFlags) || !sync(doc)) {
+        return false;
+    }
+
+    // The end first, so mapping continues from the start when the match is mapped back
+    const Sci_Position foldedEnd = toFolded(doc, end);
+    const Sci_Position foldedStart = toFolded(doc, start);
+    Sci_Position foldedPos = -1;
+    Sci_Position foldedMatchEnd = -1;
+    if (searchFlags & SEARCH_FUZZY) {
+        if (fuzzySearch.prepare(shadow, foldedFindText, searchFlags)) {
+            foldedPos = fuzzySearch.find(shadow, foldedStart, foldedEnd, foldedMatchEnd);
+        }
+    }
+    else if (foldedStart <= foldedEnd && literalSearch.prepare(shadow, foldedFindText, searchFlags) &&
+        literalSearch.find(shadow, foldedStart, foldedEnd, foldedPos)) {
+        foldedMatchEnd = (foldedPos >= 0) ? foldedPos + literalSearch.matchLength() : -1;
+    }
+    else {
+        shadow.send(SCI_SETTARGETRANGE, foldedStart, foldedEnd);
+        shadow.send(SCI_SETSEARCHFLAGS, searchFlags, 0);
+        foldedPos = shadow.send(SCI_SEARCHINTARGET, foldedFindText.length(), reinterpret_cast<sptr_t>(foldedFindText.c_str()));
+        foldedMatchEnd = (foldedPos >= 0) ? shadow.send(SCI_GETTARGETEND, 0, 0) : -1;
+    }
+
+    if (foldedPos < 0) {
+        pos = -1;
+        matchEnd = -1;
+        return true;
+    }
+    pos = toOriginal(doc, foldedPos, false);
+    matchEnd = toOriginal(doc, foldedMatchEnd, true);
+    return true;
+}
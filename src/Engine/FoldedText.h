@@ -0,0 +1,84 @@
+// This file is part of Notepad++ project
+// Copyright (C)2023 Thomas Knoefel
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef FOLDED_TEXT_H
+#define FOLDED_TEXT_H
+
+#include "DocumentBackend.h"
+#include "FuzzySearch.h"
+#include "GapBufferDocument.h"
+#include "LiteralSearch.h"
+
+#include <cstdint>
+#include <string>
+
+// Only part of match cache keys, marks match sets found in the folded text
+constexpr int SEARCH_FOLDED = 0x00800000;
+
+// Accent- and width-insensitive search in UTF-8 documents. The shadow is a folded copy of
+// the document: Latin letters lose their accents, combining marks are dropped and
+// full-width ASCII forms become ASCII. Line ends are never folded or joined, so both have
+// the same lines and positions are mapped by folding the document from a line start onwards.
+// The shadow follows the document through its SCN_MODIFIED notifications.
+class FoldedText
+{
+public:
+    static std::string fold(const std::string& text);
+
+    // Regular expressions are not folded. Without case matching the folded find text has to
+    // be ASCII, only Scintilla compares other letters case-insensitively.
+    static bool appliesTo(const std::string& foldedFindText, int searchFlags);
+
+    // Searches the shadow like SCI_SEARCHINTARGET in [start, end), backwards if start > end.
+    // Positions are those of the document. False if the rule or document cannot be folded,
+    // then the caller searches the document itself.
+    bool find(DocumentBackend& doc, const std::string& findTextUtf8, int searchFlags,
+        Sci_Position start, Sci_Position end, Sci_Position& pos, Sci_Position& matchEnd);
+
+    // Called for SCN_MODIFIED after text was inserted or deleted. Deleted text comes with
+    // the notification, without it the shadow is built again on the next search.
+    void update(DocumentBackend& doc, int modificationType, Sci_Position position, Sci_Position length, const char* text);
+
+    void reset();
+
+    // Polled while the shadow is searched, see LiteralSearch::cancellationCheck
+    void setCancellationCheck(const std::function<bool()>* cancellationCheck) noexcept {
+        literalSearch.cancellationCheck = cancellationCheck;
+        fuzzySearch.cancellationCheck = cancellationCheck;
+    }
+
+private:
+    struct Cursor {
+        Sci_Position original = -1;
+        Sci_Position folded = -1;
+    };
+
+    bool sync(DocumentBackend& doc);
+    Sci_Position toFolded(DocumentBackend& doc, Sci_Position pos);
+    Sci_Position toOriginal(DocumentBackend& doc, Sci_Position foldedPos, bool isEnd);
+
+    GapBufferDocument shadow;
+    bool built = false;
+    Sci_Position documentLength = 0;
+    Cursor cursor; // Last mapped position pair, mapping continues from it
+
+    std::string findText;
+    std::string foldedFindText;
+    LiteralSearch literalSearch;
+    FuzzySearch fuzzySearch;
+};
+
+#endif // FOLDED_TEXT_H
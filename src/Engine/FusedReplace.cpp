@@ -0,0 +1,256 @@
+// This file is part of Notepad++ project
+// Copyright (C)2023 Thomas Knoefel
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "FusedReplace.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <queue>
+
+namespace {
+
+    inline unsigned char lowerAscii(char ch) noexcept {
+        const unsigned char byte = static_cast<unsigned char>(ch);
+        return (byte >= 'A' && byte <= 'Z') ? byte | 0x20 : byte;
+    }
+
+    inline bool isHighByte(char ch) noexcept {
+        return static_cast<unsigned char>(ch) >= 0x80;
+    }
+
+    inline bool sameByte(char a, char b, bool matchCase) noexcept {
+        return matchCase ? a == b : lowerAscii(a) == lowerAscii(b);
+    }
+
+}
+
+bool FusedReplace::canFollow(const FusedRule& earlier, const FusedRule& later, const LiteralSearch::CharacterClasses& classes, bool utf8)
+{
+    const std::string& replacement = earlier.replaceText;
+    const std::string& findText = later.findText;
+
+    // Removing text joins its neighbours, which may then match
+    if (replacement.empty() && (findText.size() > 1 || later.wholeWord)) {
+        return false;
+    }
+
+    // The find text must not agree with the replacement wherever the two overlap, otherwise
+    // the replacement and the text around it could form a match
+    const ptrdiff_t findLength = static_cast<ptrdiff_t>(findText.size());
+    const ptrdiff_t replacementLength = static_cast<ptrdiff_t>(replacement.size());
+    for (ptrdiff_t offset = 1 - findLength; offset < replacementLength; ++offset) {
+        const ptrdiff_t first = std::max<ptrdiff_t>(0, -offset);
+        const ptrdiff_t last = std::min(findLength, replacementLength - offset);
+        ptrdiff_t k = first;
+        while (k < last && sameByte(findText[k], replacement[offset + k], later.matchCase)) {
+            ++k;
+        }
+        if (k == last) {
+            return false;
+        }
+    }
+
+    // Word boundaries next to a replacement must stay where they were
+    if (later.wholeWord) {
+        auto sameClass = [&](char a, char b) {
+            if (utf8 && (isHighByte(a) || isHighByte(b))) {
+                return false; // Unicode classes, only Scintilla knows them
+            }
+            return classes[static_cast<unsigned char>(a)] == classes[static_cast<unsigned char>(b)];
+        };
+        if (!sameClass(earlier.findText.front(), replacement.front()) || !sameClass(earlier.findText.back(), replacement.back())) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool FusedReplace::tryAdd(const FusedRule& rule, const LiteralSearch::CharacterClasses& classes, bool utf8)
+{
+    if (rule.findText.empty() || group.size() >= MAX_RULES) {
+        return false;
+    }
+
+    // A whole word rule also follows its own replacements
+    if (rule.wholeWord && !canFollow(rule, rule, classes, utf8)) {
+        return false;
+    }
+    for (const FusedRule& earlier : group) {
+        if (!canFollow(earlier, rule, classes, utf8)) {
+            return false;
+        }
+    }
+
+    std::array<bool, 256> bytes = usedBytes;
+    size_t classCount = byteClassCount;
+    for (char ch : rule.findText) {
+        if (!bytes[lowerAscii(ch)]) {
+            bytes[lowerAscii(ch)] = true;
+            ++classCount;
+        }
+    }
+    if ((patternBytes + rule.findText.size() + 1) * classCount > MAX_TABLE_ENTRIES) {
+        return false;
+    }
+
+    usedBytes = bytes;
+    byteClassCount = classCount;
+    patternBytes += rule.findText.size();
+    group.push_back(rule);
+    return true;
+}
+
+void FusedReplace::findMatches(const char* text, Sci_Position length, const LiteralSearch::CharacterClasses& classes, bool utf8,
+    const std::function<bool(size_t rule, Sci_Position pos)>& confirmWord, std::vector<FusedMatch>& matches) const
+{
+    matches.clear();
+    if (group.empty() || length <= 0) {
+        return;
+    }
+
+    // Bytes no find text has share class 0, upper case letters the class of lower case ones
+    std::array<uint16_t, 256> byteClass{};
+    uint16_t classCount = 1;
+    for (int ch = 0; ch < 256; ++ch) {
+        if (usedBytes[ch]) {
+            byteClass[ch] = classCount++;
+        }
+    }
+    for (int ch = 'A'; ch <= 'Z'; ++ch) {
+        byteClass[ch] = byteClass[ch | 0x20];
+    }
+
+    // Trie of the lower case find texts, each state a row of transitions
+    std::vector<int32_t> table(classCount, -1);
+    std::vector<int32_t> firstRule(1, -1);             // Rules whose text ends in the state
+    std::vector<int32_t> nextRule(group.size(), -1);
+    for (size_t r = 0; r < group.size(); ++r) {
+        int32_t state = 0;
+        for (char ch : group[r].findText) {
+            const size_t index = static_cast<size_t>(state) * classCount + byteClass[lowerAscii(ch)];
+            if (table[index] < 0) {
+                table[index] = static_cast<int32_t>(firstRule.size());
+                firstRule.push_back(-1);
+                table.resize(table.size() + classCount, -1);
+            }
+            state = table[index];
+        }
+        nextRule[r] = firstRule[state];
+        firstRule[state] = static_cast<int32_t>(r);
+    }
+
+    // Failure transitions folded into the table, outputLink leads to the next shorter
+    // suffix state at which find texts end
+    const size_t stateCount = firstRule.size();
+    std::vector<int32_t> failure(stateCount, 0);
+    std::vector<int32_t> outputLink(stateCount, 0);
+    std::queue<int32_t> pending;
+    for (size_t c = 0; c < classCount; ++c) {
+        if (table[c] < 0) {
+            table[c] = 0;
+        }
+        else {
+            pending.push(table[c]);
+        }
+    }
+    while (!pending.empty()) {
+        const int32_t state = pending.front();
+        pending.pop();
+        const size_t row = static_cast<size_t>(state) * classCount;
+        const size_t failureRow = static_cast<size_t>(failure[state]) * classCount;
+        for (size_t c = 0; c < classCount; ++c) {
+            const int32_t next = table[row + c];
+            if (next < 0) {
+                table[row + c] = table[failureRow + c];
+                continue;
+            }
+            const int32_t fallback = table[failureRow + c];
+            failure[next] = fallback;
+            outputLink[next] = (firstRule[fallback] >= 0) ? fallback : outputLink[fallback];
+            pending.push(next);
+        }
+    }
+
+    // All occurrences, with the exact case and word boundaries each rule asks for
+    struct Occurrence {
+        Sci_Position start;
+        bool confirm;
+    };
+    std::vector<std::vector<Occurrence>> occurrences(group.size());
+    auto classOf = [&](char ch) {
+        return classes[static_cast<unsigned char>(ch)];
+    };
+    int32_t state = 0;
+    for (Sci_Position i = 0; i < length; ++i) {
+        state = table[static_cast<size_t>(state) * classCount + byteClass[static_cast<unsigned char>(text[i])]];
+        for (int32_t output = (firstRule[state] >= 0) ? state : outputLink[state]; output > 0; output = outputLink[output]) {
+            for (int32_t r = firstRule[output]; r >= 0; r = nextRule[r]) {
+                const FusedRule& rule = group[r];
+                const Sci_Position size = static_cast<Sci_Position>(rule.findText.size());
+                const Sci_Position start = i + 1 - size;
+                const char* hit = text + start;
+                if (rule.matchCase && std::memcmp(hit, rule.findText.data(), rule.findText.size()) != 0) {
+                    continue;
+                }
+                bool confirm = false;
+                if (rule.wholeWord) {
+                    const bool hasBefore = start > 0;
+                    const bool hasAfter = i + 1 < length;
+                    if (utf8 && (isHighByte(hit[0]) || isHighByte(hit[size - 1]) || (hasBefore && isHighByte(hit[-1])) || (hasAfter && isHighByte(hit[size])))) {
+                        confirm = true;
+                    }
+                    else {
+                        const unsigned char first = classOf(hit[0]);
+                        const unsigned char last = classOf(hit[size - 1]);
+                        const bool isWord = first == LiteralSearch::Word || first == LiteralSearch::Punctuation;
+                        const bool isLastWord = last == LiteralSearch::Word || last == LiteralSearch::Punctuation;
+                        if ((hasBefore && (!isWord || first == classOf(hit[-1]))) || (hasAfter && (!isLastWord || last == classOf(hit[size])))) {
+                            continue;
+                        }
+                    }
+                }
+                occurrences[r].push_back({ start, confirm });
+            }
+        }
+    }
+
+    // Each rule takes its leftmost occurrences that no earlier rule replaced and that do not
+    // overlap its own previous match
+    std::vector<bool> claimed(static_cast<size_t>(length), false);
+    for (size_t r = 0; r < group.size(); ++r) {
+        const Sci_Position size = static_cast<Sci_Position>(group[r].findText.size());
+        Sci_Position lastEnd = 0;
+        for (const Occurrence& occurrence : occurrences[r]) {
+            if (occurrence.start < lastEnd) {
+                continue;
+            }
+            bool free = true;
+            for (Sci_Position k = occurrence.start; free && k < occurrence.start + size; ++k) {
+                free = !claimed[static_cast<size_t>(k)];
+            }
+            if (!free || (occurrence.confirm && !confirmWord(r, occurrence.start))) {
+                continue;
+            }
+            std::fill(claimed.begin() + occurrence.start, claimed.begin() + occurrence.start + size, true);
+            lastEnd = occurrence.start + size;
+            matches.push_back({ occurrence.start, r });
+        }
+    }
+    std::sort(matches.begin(), matches.end(), [](const FusedMatch& a, const FusedMatch& b) {
+        return a.start < b.start;
+    });
+}
@@ -0,0 +1,74 @@
+// This file is part of Notepad++ project
+// Copyright (C)2023 Thomas Knoefel
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef FUSED_REPLACE_H
+#define FUSED_REPLACE_H
+
+#include "DocumentBackend.h"
+#include "LiteralSearch.h"
+
+#include <array>
+#include <functional>
+#include <string>
+#include <vector>
+
+// A Normal or Extended mode list entry, both texts in the document's encoding
+struct FusedRule {
+    std::string findText;
+    std::string replaceText;
+    bool matchCase = false;
+    bool wholeWord = false;
+};
+
+struct FusedMatch {
+    Sci_Position start;
+    size_t rule; // Index in the group
+};
+
+// Replace All of consecutive literal list entries in one pass. One after another, each
+// entry sees the text the ones before it left. A group only takes entries for which that
+// makes no difference: no replacement can form a match of a later entry or change its word
+// boundaries, so each entry matches where it does in the original text, apart from text an
+// earlier entry replaces. The occurrences of all entries are found with one Aho-Corasick
+// automaton and then claimed entry by entry, as the sequential scans would.
+class FusedReplace
+{
+public:
+    static constexpr size_t MAX_RULES = 1024;                      // Compatibility is checked pairwise
+    static constexpr size_t MAX_TABLE_ENTRIES = size_t{ 1 } << 22; // 16 MB of transitions
+
+    // Adds the rule if it can follow the rules of the group in the same pass
+    bool tryAdd(const FusedRule& rule, const LiteralSearch::CharacterClasses& classes, bool utf8);
+
+    const std::vector<FusedRule>& rules() const noexcept {
+        return group;
+    }
+
+    // Matches the group makes in text, sorted by start. Whole word matches at multi-byte
+    // characters need Unicode classes, confirmWord asks the document about them.
+    void findMatches(const char* text, Sci_Position length, const LiteralSearch::CharacterClasses& classes, bool utf8,
+        const std::function<bool(size_t rule, Sci_Position pos)>& confirmWord, std::vector<FusedMatch>& matches) const;
+
+private:
+    static bool canFollow(const FusedRule& earlier, const FusedRule& later, const LiteralSearch::CharacterClasses& classes, bool utf8);
+
+    std::vector<FusedRule> group;
+    std::array<bool, 256> usedBytes{}; // Lower case bytes of the find texts
+    size_t byteClassCount = 1;         // Used bytes plus one for all others
+    size_t patternBytes = 0;
+};
+
+#endif // FUSED_REPLACE_H
@@ -0,0 +1,250 @@
+// This file is part of Notepad++ project
+// Copyright (C)2023 Thomas Knoefel
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "FuzzySearch.h"
+
+#include <algorithm>
+
+namespace {
+
+    constexpr uint32_t INVALID_BYTE_BASE = 0x110000; // Bytes that are no UTF-8 sequence map above Unicode
+
+    // Holds the characters a match can span: the pattern plus its insertions
+    constexpr size_t HISTORY_SIZE = 128;
+    static_assert(HISTORY_SIZE >= FuzzyMatcher::MAX_PATTERN_LENGTH + MAX_FUZZY_EDITS, "History too short for a match");
+
+}
+
+#pragma region FuzzyMatcher
+
+FuzzyMatcher::FuzzyMatcher(const std::string& pattern, int edits, bool matchCase, bool isUtf8)
+    : foldCase(!matchCase), utf8(isUtf8)
+{
+    const char* p = pattern.data();
+    const char* const last = p + pattern.size();
+    size_t count = 0;
+    while (p < last) {
+        if (count == MAX_PATTERN_LENGTH) {
+            return; // Too long, length stays 0
+        }
+        const uint32_t ch = next(p, last);
+        const uint64_t bit = uint64_t{ 1 } << count++;
+        if (ch < asciiMasks.size()) {
+            asciiMasks[ch] |= bit;
+            continue;
+        }
+        auto it = std::find_if(otherMasks.begin(), otherMasks.end(), [ch](const auto& entry) { return entry.first == ch; });
+        if (it != otherMasks.end()) {
+            it->second |= bit;
+        }
+        else {
+            otherMasks.emplace_back(ch, bit);
+        }
+    }
+    length = count;
+    // Allowing as many edits as the pattern has characters would match empty text
+    maxEdits = std::clamp(edits, 0, static_cast<int>(length) - 1);
+}
+
+uint32_t FuzzyMatcher::next(const char*& p, const char* last) const
+{
+    const unsigned char lead = static_cast<unsigned char>(*p++);
+    if (lead < 0x80) {
+        return (foldCase && lead >= 'A' && lead <= 'Z') ? lead - 'A' + 'a' : lead;
+    }
+    if (!utf8) {
+        return lead;
+    }
+
+    const ptrdiff_t trailCount = (lead >= 0xF0) ? 3 : (lead >= 0xE0) ? 2 : (lead >= 0xC0) ? 1 : -1;
+    if (trailCount < 0 || last - p < trailCount) {
+        return INVALID_BYTE_BASE + lead;
+    }
+    uint32_t ch = lead & (0x3F >> trailCount);
+    for (ptrdiff_t i = 0; i < trailCount; ++i) {
+        const unsigned char trail = static_cast<unsigned char>(p[i]);
+        if ((trail & 0xC0) != 0x80) {
+            return INVALID_BYTE_BASE + lead;
+        }
+        ch = (ch << 6) | (trail & 0x3F);
+    }
+    p += trailCount;
+    return ch;
+}
+
+uint64_t FuzzyMatcher::equalityMask(uint32_t ch) const
+{
+    if (ch < asciiMasks.size()) {
+        return asciiMasks[ch];
+    }
+    for (const auto& entry : otherMasks) {
+        if (entry.first == ch) {
+            return entry.second;
+        }
+    }
+    return 0;
+}
+
+bool FuzzyMatcher::find(const char* first, const char* last, size_t& matchStart, size_t& matchEnd,
+    const std::function<bool()>* cancellationCheck) const
+{
+    if (!isValid()) {
+        return false;
+    }
+
+    // Myers: vertical deltas of the distance matrix column as positive and negative bit
+    // vectors. score is the distance of the whole pattern to the text ending here.
+    const uint64_t lastRow = uint64_t{ 1 } << (length - 1);
+    uint64_t positive = ~uint64_t{ 0 };
+    uint64_t negative = 0;
+    int score = static_cast<int>(length);
+
+    std::array<uint32_t, HISTORY_SIZE> characters;
+    std::array<size_t, HISTORY_SIZE> offsets;
+    size_t count = 0;
+
+    bool found = false;
+    int bestScore = 0;
+    size_t bestCount = 0;
+    size_t bestEnd = 0;
+
+    const bool pollCancel = cancellationCheck && *cancellationCheck;
+    const char* nextPoll = pollCancel ? first + std::min<size_t>(CANCEL_CHUNK_BYTES, last - first) : last;
+    for (const char* p = first; p < last;) {
+        if (p >= nextPoll) {
+            if ((*cancellationCheck)()) {
+                return false;
+            }
+            nextPoll = p + std::min<size_t>(CANCEL_CHUNK_BYTES, last - p);
+        }
+        offsets[count % HISTORY_SIZE] = static_cast<size_t>(p - first);
+        const uint32_t ch = next(p, last);
+        characters[count % HISTORY_SIZE] = ch;
+        ++count;
+
+        const uint64_t equal = equalityMask(ch);
+        const uint64_t verticalChange = equal | negative;
+        const uint64_t horizontalChange = (((equal & positive) + positive) ^ positive) | equal;
+        uint64_t horizontalPositive = negative | ~(horizontalChange | positive);
+        uint64_t horizontalNegative = positive & horizontalChange;
+        if (horizontalPositive & lastRow) {
+            ++score;
+        }
+        else if (horizontalNegative & lastRow) {
+            --score;
+        }
+        // Matches may start anywhere, so the top row stays 0 and nothing is shifted in
+        horizontalPositive <<= 1;
+        horizontalNegative <<= 1;
+        positive = horizontalNegative | ~(verticalChange | horizontalPositive);
+        negative = horizontalPositive & verticalChange;
+
+        if (found) {
+            if (score >= bestScore) {
+                break;
+            }
+        }
+        else if (score > maxEdits) {
+            continue;
+        }
+        found = true;
+        bestScore = score;
+        bestCount = count;
+        bestEnd = static_cast<size_t>(p - first);
+    }
+    if (!found) {
+        return false;
+    }
+
+    // The start: distances of the pattern to the text ending at bestEnd, growing backwards
+    const size_t available = std::min(bestCount, length + static_cast<size_t>(maxEdits));
+    std::array<int, MAX_PATTERN_LENGTH + 1> column;
+    for (size_t i = 0; i <= length; ++i) {
+        column[i] = static_cast<int>(i);
+    }
+    int bestDistance = static_cast<int>(length);
+    size_t bestCharacters = 0;
+    for (size_t j = 1; j <= available; ++j) {
+        const uint64_t equal = equalityMask(characters[(bestCount - j) % HISTORY_SIZE]);
+        int diagonal = column[0];
+        column[0] = static_cast<int>(j);
+        for (size_t i = 1; i <= length; ++i) {
+            const int above = column[i];
+            const int cost = ((equal >> (length - i)) & 1) ? 0 : 1;
+            column[i] = std::min({ above + 1, column[i - 1] + 1, diagonal + cost });
+            diagonal = above;
+        }
+        if (column[length] < bestDistance) {
+            bestDistance = column[length];
+            bestCharacters = j;
+        }
+    }
+
+    matchStart = offsets[(bestCount - bestCharacters) % HISTORY_SIZE];
+    matchEnd = bestEnd;
+    return true;
+}
+
+#pragma endregion
+
+#pragma region FuzzySearch
+
+bool FuzzySearch::prepare(DocumentBackend& doc, const std::string& findTextUtf8, int flags)
+{
+    if (prepared && flags == searchFlags && findTextUtf8 == findText) {
+        return usable;
+    }
+    prepared = true;
+    findText = findTextUtf8;
+    searchFlags = flags;
+
+    const bool utf8 = doc.send(SCI_GETCODEPAGE, 0, 0) == SC_CP_UTF8;
+    matcher = FuzzyMatcher(findText, fuzzyEditsOf(flags), (flags & SCFIND_MATCHCASE) != 0, utf8);
+    usable = matcher.isValid();
+    return usable;
+}
+
+Sci_Position FuzzySearch::find(DocumentBackend& doc, Sci_Position start, Sci_Position end, Sci_Position& matchEnd)
+{
+    matchEnd = -1;
+    const Sci_Position from = std::min(start, end);
+    const Sci_Position to = std::max(start, end);
+    if (!usable || from >= to) {
+        return -1;
+    }
+    const char* first = reinterpret_cast<const char*>(doc.send(SCI_GETRANGEPOINTER, from, to - from));
+    if (!first) {
+        return -1;
+    }
+    const char* const last = first + (to - from);
+
+    // Backwards the matches of the range are walked through to the last one
+    Sci_Position pos = -1;
+    const char* scan = first;
+    size_t matchStart = 0;
+    size_t matchStop = 0;
+    while (scan < last && matcher.find(scan, last, matchStart, matchStop, cancellationCheck)) {
+        pos = from + (scan - first) + static_cast<Sci_Position>(matchStart);
+        matchEnd = from + (scan - first) + static_cast<Sci_Position>(matchStop);
+        if (start <= end) {
+            break;
+        }
+        scan += matchStop;
+    }
+    return pos;
+}
+
+#pragma endregion
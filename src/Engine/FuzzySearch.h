@@ -0,0 +1,116 @@
+// This file is part of Notepad++ project
+// Copyright (C)2023 Thomas Knoefel
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef FUZZY_SEARCH_H
+#define FUZZY_SEARCH_H
+
+#include "DocumentBackend.h"
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Fuzzy mode is an engine search flag next to Scintilla's SCFIND_ flags, the maximum number
+// of edits is kept in the bits above it. Scintilla never sees either.
+constexpr int SEARCH_FUZZY = 0x01000000;
+constexpr int SEARCH_FUZZY_EDITS_SHIFT = 25;
+constexpr int MAX_FUZZY_EDITS = 9;
+
+inline int fuzzySearchFlags(int maxEdits) {
+    if (maxEdits <= 0) {
+        return 0;
+    }
+    return SEARCH_FUZZY | ((maxEdits < MAX_FUZZY_EDITS ? maxEdits : MAX_FUZZY_EDITS) << SEARCH_FUZZY_EDITS_SHIFT);
+}
+
+// The flags of a rule. Fuzzy mode takes precedence over regular expressions, a loaded
+// list may have both set.
+inline int searchFlagsOf(bool wholeWord, bool matchCase, bool regex, int fuzzyEdits) {
+    const int fuzzy = fuzzySearchFlags(fuzzyEdits);
+    return (wholeWord ? SCFIND_WHOLEWORD : 0) | (matchCase ? SCFIND_MATCHCASE : 0) | ((regex && !fuzzy) ? SCFIND_REGEXP : 0) | fuzzy;
+}
+
+inline int fuzzyEditsOf(int searchFlags) {
+    return (searchFlags & SEARCH_FUZZY) ? (searchFlags >> SEARCH_FUZZY_EDITS_SHIFT) & 0xF : 0;
+}
+
+// Finds text that differs from the pattern by at most maxEdits inserted, deleted or
+// substituted characters. The edit distance of the pattern to the text ending at each
+// position is computed with Myers' bit-vector algorithm, one machine word per character.
+// Characters are code points in UTF-8 and bytes otherwise, case is folded for ASCII only.
+class FuzzyMatcher
+{
+public:
+    static constexpr size_t MAX_PATTERN_LENGTH = 64; // Characters
+    static constexpr size_t CANCEL_CHUNK_BYTES = 64 * 1024;
+
+    FuzzyMatcher() = default;
+    FuzzyMatcher(const std::string& pattern, int maxEdits, bool matchCase, bool utf8);
+
+    // False for empty patterns and patterns longer than MAX_PATTERN_LENGTH
+    bool isValid() const noexcept {
+        return length > 0;
+    }
+
+    // First match in [first, last), offsets are relative to first. Where the distance
+    // keeps falling the match is extended to the closest end; of the starts with the
+    // fewest edits the latest is taken. A set cancellationCheck is polled every
+    // CANCEL_CHUNK_BYTES, a cancelled search finds nothing.
+    bool find(const char* first, const char* last, size_t& matchStart, size_t& matchEnd,
+        const std::function<bool()>* cancellationCheck = nullptr) const;
+
+private:
+    uint32_t next(const char*& p, const char* last) const;
+    uint64_t equalityMask(uint32_t ch) const;
+
+    std::array<uint64_t, 128> asciiMasks{};                 // Pattern positions of each ASCII character
+    std::vector<std::pair<uint32_t, uint64_t>> otherMasks;  // The same for all others
+    size_t length = 0;
+    int maxEdits = 0;
+    bool foldCase = false;
+    bool utf8 = false;
+};
+
+// Document side of Fuzzy mode rules. The maximum number of edits is part of the search flags.
+class FuzzySearch
+{
+public:
+    // Passed on to the matcher, see LiteralSearch::cancellationCheck
+    const std::function<bool()>* cancellationCheck = nullptr;
+
+    // False if the text is empty or too long for the matcher
+    bool prepare(DocumentBackend& doc, const std::string& findTextUtf8, int searchFlags);
+
+    // Match in the range like SCI_SEARCHINTARGET: the first one if start <= end, else the
+    // last one starting in [end, start). Returns -1 if there is none.
+    Sci_Position find(DocumentBackend& doc, Sci_Position start, Sci_Position end, Sci_Position& matchEnd);
+
+    void reset() noexcept {
+        prepared = false;
+    }
+
+private:
+    std::string findText;
+    int searchFlags = 0;
+    bool prepared = false;
+    bool usable = false;
+    FuzzyMatcher matcher;
+};
+
+#endif // FUZZY_SEARCH_H
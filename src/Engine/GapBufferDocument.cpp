@@ -0,0 +1,1227 @@
+// This file is part of Notepad++ project
+// Copyright (C)2023 Thomas Knoefel
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "GapBufferDocument.h"
+
+#include <cctype>
+#include <iterator>
+#include <regex>
+#include <string_view>
+
+#pragma region LineStartIndex
+
+LineStartIndex::LineStartIndex()
+{
+    reset();
+}
+
+void LineStartIndex::reset()
+{
+    starts.clear();
+    const Sci_Position initial[2] = { 0, 0 };
+    starts.insertFromArray(0, initial, 2);
+    stepPartition = 0;
+    stepLength = 0;
+}
+
+void LineStartIndex::applyStep(Sci_Position partitionUpTo)
+{
+    if (stepLength != 0) {
+        starts.rangeAddDelta(stepPartition + 1, partitionUpTo - stepPartition, stepLength);
+    }
+    stepPartition = partitionUpTo;
+    if (stepPartition >= starts.length() - 1) {
+        stepPartition = starts.length() - 1;
+        stepLength = 0;
+    }
+}
+
+void LineStartIndex::backStep(Sci_Position partitionDownTo)
+{
+    if (stepLength != 0) {
+        starts.rangeAddDelta(partitionDownTo + 1, stepPartition - partitionDownTo, -stepLength);
+    }
+    stepPartition = partitionDownTo;
+}
+
+Sci_Position LineStartIndex::lineStart(Sci_Position line) const noexcept
+{
+    if (line < 0 || line >= starts.length()) {
+        return 0;
+    }
+    Sci_Position pos = starts.valueAt(line);
+    if (line > stepPartition) {
+        pos += stepLength;
+    }
+    return pos;
+}
+
+Sci_Position LineStartIndex::lineFromPosition(Sci_Position pos) const noexcept
+{
+    if (starts.length() <= 1) {
+        return 0;
+    }
+    if (pos >= lineStart(lines())) {
+        return lines() - 1;
+    }
+    Sci_Position lower = 0;
+    Sci_Position upper = lines();
+    do {
+        const Sci_Position middle = (upper + lower + 1) / 2;
+        Sci_Position posMiddle = starts.valueAt(middle);
+        if (middle > stepPartition) {
+            posMiddle += stepLength;
+        }
+        if (pos < posMiddle) {
+            upper = middle - 1;
+        }
+        else {
+            lower = middle;
+        }
+    } while (lower < upper);
+    return lower;
+}
+
+void LineStartIndex::insertText(Sci_Position line, Sci_Position delta)
+{
+    // Keep the pending step when the edit is at or shortly before it
+    if (stepLength != 0) {
+        if (line >= stepPartition) {
+            applyStep(line);
+            stepLength += delta;
+        }
+        else if (line >= (stepPartition - starts.length() / 10)) {
+            backStep(line);
+            stepLength += delta;
+        }
+        else {
+            applyStep(starts.length() - 1);
+            stepPartition = line;
+            stepLength = delta;
+        }
+    }
+    else {
+        stepPartition = line;
+        stepLength = delta;
+    }
+}
+
+void LineStartIndex::insertLine(Sci_Position line, Sci_Position pos)
+{
+    if (stepPartition < line) {
+        applyStep(line);
+    }
+    starts.insertValue(line, pos);
+    stepPartition++;
+}
+
+void LineStartIndex::removeLine(Sci_Position line)
+{
+    if (line > stepPartition) {
+        applyStep(line);
+    }
+    stepPartition--;
+    starts.deleteRange(line, 1);
+}
+
+void LineStartIndex::setLineStart(Sci_Position line, Sci_Position pos)
+{
+    applyStep(line + 1);
+    if (line < 0 || line > starts.length()) {
+        return;
+    }
+    starts.setValueAt(line, pos);
+}
+
+#pragma endregion
+
+
+#pragma region Text
+
+GapBufferDocument::GapBufferDocument()
+{
+    setDefaultCharClasses(true);
+}
+
+GapBufferDocument::GapBufferDocument(const std::string& text)
+    : GapBufferDocument()
+{
+    setText(text);
+}
+
+GapBufferDocument::GapBufferDocument(std::shared_ptr<const std::string> text)
+    : GapBufferDocument()
+{
+    const char* values = text->c_str();
+    const Sci_Position textLength = static_cast<Sci_Position>(text->size());
+    substance.adopt(std::move(text), values, textLength);
+    insertLineStarts(0, values, textLength, '\0');
+}
+
+void GapBufferDocument::setText(const std::string& text)
+{
+    deleteChars(0, substance.length());
+    insertString(0, text.data(), static_cast<Sci_Position>(text.size()));
+    selections.assign(1, Selection());
+    mainSelection = 0;
+    targetStart = 0;
+    targetEnd = 0;
+}
+
+std::string GapBufferDocument::getText()
+{
+    std::string text(static_cast<size_t>(substance.length()), '\0');
+    if (!text.empty()) {
+        substance.getRange(&text[0], 0, substance.length());
+    }
+    return text;
+}
+
+char GapBufferDocument::charAt(Sci_Position pos) const noexcept
+{
+    return substance.valueAt(pos);
+}
+
+Sci_Position GapBufferDocument::lineEndPosition(Sci_Position line) const noexcept
+{
+    if (line >= lineStarts.lines() - 1) {
+        return substance.length();
+    }
+    Sci_Position position = lineStarts.lineStart(line + 1);
+    if (charAt(position - 1) == '\n') {
+        position--;
+        if (charAt(position - 1) == '\r') {
+            position--;
+        }
+    }
+    else if (charAt(position - 1) == '\r') {
+        position--;
+    }
+    return position;
+}
+
+Sci_Position GapBufferDocument::copyRange(char* buffer, Sci_Position start, Sci_Position end) const
+{
+    start = std::clamp<Sci_Position>(start, 0, substance.length());
+    end = std::clamp<Sci_Position>(end, start, substance.length());
+    substance.getRange(buffer, start, end - start);
+    buffer[end - start] = '\0';
+    return end - start;
+}
+
+void GapBufferDocument::insertString(Sci_Position position, const char* s, Sci_Position insertLength)
+{
+    if (readOnly || insertLength <= 0 || position < 0 || position > substance.length()) {
+        return;
+    }
+
+    const Sci_Position linesBefore = lineStarts.lines();
+    const char chAfter = charAt(position);
+    substance.insertFromArray(position, s, insertLength);
+    insertLineStarts(position, s, insertLength, chAfter);
+
+    moveSelectionsForInsert(position, insertLength);
+    moveIndicatorsForInsert(position, insertLength);
+    notifyModified(SC_MOD_INSERTTEXT | SC_PERFORMED_USER, position, insertLength, lineStarts.lines() - linesBefore, s);
+}
+
+// Lines of text just inserted at position, chAfter followed position before the insert
+void GapBufferDocument::insertLineStarts(Sci_Position position, const char* s, Sci_Position insertLength, char chAfter)
+{
+    // Line bookkeeping follows Scintilla's CellBuffer so CR, LF and CRLF split and join the same way
+    Sci_Position lineInsert = lineStarts.lineFromPosition(position) + 1;
+    lineStarts.insertText(lineInsert - 1, insertLength);
+
+    char chPrev = charAt(position - 1);
+    if (chPrev == '\r' && chAfter == '\n') {
+        // Splitting up a CRLF pair at position
+        lineStarts.insertLine(lineInsert, position);
+        lineInsert++;
+    }
+    char ch = ' ';
+    for (Sci_Position i = 0; i < insertLength; i++) {
+        ch = s[i];
+        if (ch == '\r') {
+            lineStarts.insertLine(lineInsert, position + i + 1);
+            lineInsert++;
+        }
+        else if (ch == '\n') {
+            if (chPrev == '\r') {
+                // Patch up what was end of line
+                lineStarts.setLineStart(lineInsert - 1, position + i + 1);
+            }
+            else {
+                lineStarts.insertLine(lineInsert, position + i + 1);
+                lineInsert++;
+            }
+        }
+        chPrev = ch;
+    }
+    // Joining two lines where last insertion is CR and following text starts with LF
+    if (chAfter == '\n' && ch == '\r') {
+        lineStarts.removeLine(lineInsert - 1);
+    }
+}
+
+void GapBufferDocument::deleteChars(Sci_Position position, Sci_Position deleteLength)
+{
+    if (readOnly || deleteLength <= 0 || position < 0 || position + deleteLength > substance.length()) {
+        return;
+    }
+
+    // Scintilla passes the deleted text with the notification
+    std::string deletedText;
+    if (modificationHandler && (modEventMask & SC_MOD_DELETETEXT)) {
+        deletedText.resize(static_cast<size_t>(deleteLength));
+        substance.getRange(&deletedText[0], position, deleteLength);
+    }
+
+    const Sci_Position linesBefore = lineStarts.lines();
+    if (position == 0 && deleteLength == substance.length()) {
+        // Whole buffer is being deleted, faster to reinitialise the line starts than to delete each line
+        lineStarts.reset();
+    }
+    else {
+        Sci_Position lineRemove = lineStarts.lineFromPosition(position) + 1;
+        lineStarts.insertText(lineRemove - 1, -deleteLength);
+        const char chBefore = charAt(position - 1);
+        char chNext = charAt(position);
+        bool ignoreNL = false;
+        if (chBefore == '\r' && chNext == '\n') {
+            // Move back one
+            lineStarts.setLineStart(lineRemove, position);
+            lineRemove++;
+            ignoreNL = true; // First \n is not real deletion
+        }
+
+        char ch = chNext;
+        for (Sci_Position i = 0; i < deleteLength; i++) {
+            chNext = charAt(position + i + 1);
+            if (ch == '\r') {
+                if (chNext != '\n') {
+                    lineStarts.removeLine(lineRemove);
+                }
+            }
+            else if (ch == '\n') {
+                if (ignoreNL) {
+                    ignoreNL = false; // Further \n are real deletions
+                }
+                else {
+                    lineStarts.removeLine(lineRemove);
+                }
+            }
+            ch = chNext;
+        }
+        // May have to fix up end if last deletion causes CR to be next to LF
+        const char chAfter = charAt(position + deleteLength);
+        if (chBefore == '\r' && chAfter == '\n') {
+            // Using lineRemove-1 as CR ended line before start of deletion
+            lineStarts.removeLine(lineRemove - 1);
+            lineStarts.setLineStart(lineRemove - 1, position + 1);
+        }
+    }
+    substance.deleteRange(position, deleteLength);
+
+    moveSelectionsForDelete(position, deleteLength);
+    moveIndicatorsForDelete(position, deleteLength);
+    notifyModified(SC_MOD_DELETETEXT | SC_PERFORMED_USER, position, deleteLength, lineStarts.lines() - linesBefore, deletedText.empty() ? nullptr : deletedText.data());
+}
+
+void GapBufferDocument::notifyModified(int modificationType, Sci_Position position, Sci_Position changeLength, Sci_Position linesAdded, const char* text)
+{
+    if (!modificationHandler || !(modEventMask & modificationType)) {
+        return;
+    }
+    SCNotification scn = {};
+    scn.nmhdr.code = SCN_MODIFIED;
+    scn.position = position;
+    scn.modificationType = modificationType;
+    scn.text = text;
+    scn.length = changeLength;
+    scn.linesAdded = linesAdded;
+    modificationHandler(scn);
+}
+
+#pragma endregion
+
+
+#pragma region Search
+
+void GapBufferDocument::setDefaultCharClasses(bool includeWordClass) noexcept
+{
+    for (int ch = 0; ch < 256; ++ch) {
+        if (ch == '\r' || ch == '\n') {
+            charClasses[ch] = 0;
+        }
+        else if (ch < 0x20 || ch == ' ') {
+            charClasses[ch] = 1;
+        }
+        else if (includeWordClass && (ch >= 0x80 || std::isalnum(ch) || ch == '_')) {
+            charClasses[ch] = 2;
+        }
+        else {
+            charClasses[ch] = 3;
+        }
+    }
+}
+
+void GapBufferDocument::setCharClasses(const char* chars, unsigned char charClass) noexcept
+{
+    for (; *chars; ++chars) {
+        charClasses[static_cast<unsigned char>(*chars)] = charClass;
+    }
+}
+
+bool GapBufferDocument::isWordStartAt(Sci_Position pos) const noexcept
+{
+    if (pos >= substance.length()) {
+        return false;
+    }
+    if (pos <= 0) {
+        return true;
+    }
+    const int ccPos = characterClass(static_cast<unsigned char>(charAt(pos)));
+    const int ccPrev = characterClass(static_cast<unsigned char>(charAt(pos - 1)));
+    return (ccPos == 2 || ccPos == 3) && (ccPos != ccPrev);
+}
+
+bool GapBufferDocument::isWordEndAt(Sci_Position pos) const noexcept
+{
+    if (pos <= 0) {
+        return false;
+    }
+    if (pos >= substance.length()) {
+        return true;
+    }
+    const int ccPos = characterClass(static_cast<unsigned char>(charAt(pos)));
+    const int ccPrev = characterClass(static_cast<unsigned char>(charAt(pos - 1)));
+    return (ccPrev == 2 || ccPrev == 3) && (ccPos != ccPrev);
+}
+
+Sci_Position GapBufferDocument::findLiteral(const std::string& needle, Sci_Position minPos, Sci_Position maxPos, bool forward)
+{
+    const Sci_Position needleLength = static_cast<Sci_Position>(needle.size());
+    if (needleLength == 0 || maxPos - minPos < needleLength) {
+        return -1;
+    }
+
+    const bool matchCase = (searchFlags & SCFIND_MATCHCASE) != 0;
+    const bool wholeWord = (searchFlags & SCFIND_WHOLEWORD) != 0;
+    const char* base = substance.rangePointer(minPos, maxPos - minPos);
+    const char* const first = base;
+    const char* const last = base + (maxPos - minPos);
+
+    // Only ASCII letters are folded, which matches Scintilla for the common case
+    auto foldEqual = [](char a, char b) {
+        return std::tolower(static_cast<unsigned char>(a)) == std::tolower(static_cast<unsigned char>(b));
+    };
+    auto isMatchAccepted = [&](const char* hit) {
+        if (!wholeWord) {
+            return true;
+        }
+        const Sci_Position pos = minPos + (hit - first);
+        return isWordStartAt(pos) && isWordEndAt(pos + needleLength);
+    };
+
+    if (forward) {
+        const char* from = first;
+        while (from < last) {
+            const char* hit;
+            if (matchCase) {
+                const std::string_view haystack(from, static_cast<size_t>(last - from));
+                const size_t found = haystack.find(needle);
+                hit = (found == std::string_view::npos) ? last : from + found;
+            }
+            else {
+                hit = std::search(from, last, needle.begin(), needle.end(), foldEqual);
+            }
+            if (hit == last) {
+                return -1;
+            }
+            if (isMatchAccepted(hit)) {
+                return minPos + (hit - first);
+            }
+            from = hit + 1;
+        }
+        return -1;
+    }
+
+    const char* to = last;
+    while (to - first >= needleLength) {
+        const char* hit = matchCase
+            ? std::find_end(first, to, needle.begin(), needle.end())
+            : std::find_end(first, to, needle.begin(), needle.end(), foldEqual);
+        if (hit == to) {
+            return -1;
+        }
+        if (isMatchAccepted(hit)) {
+            return minPos + (hit - first);
+        }
+        to = hit + needleLength - 1;
+    }
+    return -1;
+}
+
+Sci_Position GapBufferDocument::findRegex(const std::string& pattern, Sci_Position minPos, Sci_Position maxPos, bool forward, Sci_Position& matchEnd)
+{
+    auto syntax = std::regex_constants::ECMAScript | std::regex_constants::multiline;
+    if (!(searchFlags & SCFIND_MATCHCASE)) {
+        syntax |= std::regex_constants::icase;
+    }
+
+    std::regex re;
+    try {
+        re.assign(pattern, syntax);
+    }
+    catch (const std::regex_error&) {
+        return -2; // Invalid regular expression, like Scintilla
+    }
+
+    // Include the preceding character so ^ and \b see the real context
+    const Sci_Position contextStart = (minPos > 0) ? minPos - 1 : 0;
+    const char* base = substance.rangePointer(contextStart, maxPos - contextStart);
+    const char* const first = base + (minPos - contextStart);
+    const char* const last = base + (maxPos - contextStart);
+
+    auto flags = std::regex_constants::match_default;
+    if (minPos > 0) {
+        flags |= std::regex_constants::match_prev_avail;
+    }
+    const char chAfter = charAt(maxPos);
+    if (maxPos < substance.length() && chAfter != '\r' && chAfter != '\n') {
+        flags |= std::regex_constants::match_not_eol;
+    }
+
+    std::cmatch match;
+    std::cmatch lastMatch;
+    bool found = false;
+    const char* from = first;
+    try {
+        while (from <= last && std::regex_search(from, last, match, re, flags)) {
+            found = true;
+            lastMatch = match;
+            if (forward) {
+                break;
+            }
+            // Backward searches report the last match that starts inside the range
+            from = match[0].second + (match.length(0) == 0 ? 1 : 0);
+            flags |= std::regex_constants::match_prev_avail;
+        }
+    }
+    catch (const std::regex_error&) {
+        return -2; // Too complex for the matcher, Scintilla reports Boost's error the same way
+    }
+    if (!found) {
+        return -1;
+    }
+
+    regexGroups.clear();
+    for (size_t i = 0; i < lastMatch.size(); ++i) {
+        regexGroups.push_back(lastMatch[i].matched ? lastMatch[i].str() : std::string());
+    }
+    const Sci_Position matchStart = minPos + (lastMatch[0].first - first);
+    matchEnd = matchStart + lastMatch.length(0);
+    return matchStart;
+}
+
+Sci_Position GapBufferDocument::searchInTarget(const char* text, Sci_Position textLength)
+{
+    const std::string needle(text, static_cast<size_t>(textLength));
+    const bool forward = targetStart <= targetEnd;
+    const Sci_Position minPos = std::clamp<Sci_Position>(std::min(targetStart, targetEnd), 0, substance.length());
+    const Sci_Position maxPos = std::clamp<Sci_Position>(std::max(targetStart, targetEnd), 0, substance.length());
+
+    Sci_Position pos;
+    Sci_Position matchEnd = -1;
+    if (searchFlags & SCFIND_REGEXP) {
+        pos = findRegex(needle, minPos, maxPos, forward, matchEnd);
+    }
+    else {
+        pos = findLiteral(needle, minPos, maxPos, forward);
+        matchEnd = pos + textLength;
+        if (pos >= 0) {
+            regexGroups.assign(1, needle);
+        }
+    }
+
+    if (pos >= 0) {
+        targetStart = pos;
+        targetEnd = matchEnd;
+    }
+    return pos;
+}
+
+std::string GapBufferDocument::expandSubstitution(const char* text, Sci_Position textLength) const
+{
+    // Supports \0-\9, $0-$9, ${n}, $& and the usual escapes of the Boost format strings used by Notepad++
+    auto group = [this](size_t index) -> std::string {
+        return (index < regexGroups.size()) ? regexGroups[index] : std::string();
+    };
+
+    std::string result;
+    result.reserve(static_cast<size_t>(textLength));
+    for (Sci_Position i = 0; i < textLength; ++i) {
+        const char ch = text[i];
+        const char next = (i + 1 < textLength) ? text[i + 1] : '\0';
+        if (ch == '\\' && next != '\0') {
+            ++i;
+            if (next >= '0' && next <= '9') {
+                result += group(static_cast<size_t>(next - '0'));
+            }
+            else {
+                switch (next) {
+                case 'n': result += '\n'; break;
+                case 'r': result += '\r'; break;
+                case 't': result += '\t'; break;
+                case 'a': result += '\a'; break;
+                case 'f': result += '\f'; break;
+                case 'v': result += '\v'; break;
+                default: result += next; break;
+                }
+            }
+        }
+        else if (ch == '$' && next >= '0' && next <= '9') {
+            ++i;
+            result += group(static_cast<size_t>(next - '0'));
+        }
+        else if (ch == '$' && next == '&') {
+            ++i;
+            result += group(0);
+        }
+        else if (ch == '$' && next == '{') {
+            Sci_Position close = i + 2;
+            size_t index = 0;
+            while (close < textLength && text[close] >= '0' && text[close] <= '9') {
+                index = index * 10 + static_cast<size_t>(text[close] - '0');
+                ++close;
+            }
+            if (close < textLength && text[close] == '}' && close > i + 2) {
+                result += group(index);
+                i = close;
+            }
+            else {
+                result += ch;
+            }
+        }
+        else {
+            result += ch;
+        }
+    }
+    return result;
+}
+
+Sci_Position GapBufferDocument::replaceTarget(const std::string& text)
+{
+    const Sci_Position start = std::clamp<Sci_Position>(std::min(targetStart, targetEnd), 0, substance.length());
+    const Sci_Position end = std::clamp<Sci_Position>(std::max(targetStart, targetEnd), 0, substance.length());
+    deleteChars(start, end - start);
+    insertString(start, text.data(), static_cast<Sci_Position>(text.size()));
+    targetStart = start;
+    targetEnd = start + static_cast<Sci_Position>(text.size());
+    return static_cast<Sci_Position>(text.size());
+}
+
+#pragma endregion
+
+
+#pragma region Selection
+
+void GapBufferDocument::moveSelectionsForInsert(Sci_Position position, Sci_Position insertLength)
+{
+    // Text inserted at the start of a selection moves it, text inserted at its end stays outside
+    for (Selection& sel : selections) {
+        const bool empty = sel.caret == sel.anchor;
+        const Sci_Position start = sel.start();
+        auto move = [&](Sci_Position& p) {
+            const bool moveForEqual = !empty && p == start;
+            if (p > position || (p == position && moveForEqual)) {
+                p += insertLength;
+            }
+        };
+        move(sel.caret);
+        move(sel.anchor);
+    }
+}
+
+void GapBufferDocument::moveSelectionsForDelete(Sci_Position position, Sci_Position deleteLength)
+{
+    for (Selection& sel : selections) {
+        auto move = [&](Sci_Position& p) {
+            if (p > position) {
+                p = (p > position + deleteLength) ? p - deleteLength : position;
+            }
+        };
+        move(sel.caret);
+        move(sel.anchor);
+    }
+}
+
+#pragma endregion
+
+
+#pragma region Indicators
+
+void GapBufferDocument::fillIndicator(int indicator, Sci_Position position, Sci_Position fillLength)
+{
+    if (indicator < 0 || fillLength <= 0) {
+        return;
+    }
+    if (static_cast<size_t>(indicator) >= indicators.size()) {
+        indicators.resize(static_cast<size_t>(indicator) + 1);
+    }
+    std::vector<IndicatorRun>& runs = indicators[indicator];
+    IndicatorRun run{ position, position + fillLength };
+
+    // Marking proceeds front to back, so appending is the usual case
+    if (runs.empty() || runs.back().end < run.start) {
+        runs.push_back(run);
+        return;
+    }
+
+    auto first = std::lower_bound(runs.begin(), runs.end(), run.start,
+        [](const IndicatorRun& r, Sci_Position pos) { return r.end < pos; });
+    auto last = first;
+    while (last != runs.end() && last->start <= run.end) {
+        run.start = std::min(run.start, last->start);
+        run.end = std::max(run.end, last->end);
+        ++last;
+    }
+    first = runs.erase(first, last);
+    runs.insert(first, run);
+}
+
+void GapBufferDocument::clearIndicator(int indicator, Sci_Position position, Sci_Position clearLength)
+{
+    if (indicator < 0 || static_cast<size_t>(indicator) >= indicators.size() || clearLength <= 0) {
+        return;
+    }
+    std::vector<IndicatorRun>& runs = indicators[indicator];
+    const Sci_Position clearEnd = position + clearLength;
+    std::vector<IndicatorRun> kept;
+    kept.reserve(runs.size());
+    for (const IndicatorRun& r : runs) {
+        if (r.end <= position || r.start >= clearEnd) {
+            kept.push_back(r);
+            continue;
+        }
+        if (r.start < position) {
+            kept.push_back({ r.start, position });
+        }
+        if (r.end > clearEnd) {
+            kept.push_back({ clearEnd, r.end });
+        }
+    }
+    runs.swap(kept);
+}
+
+void GapBufferDocument::moveIndicatorsForInsert(Sci_Position position, Sci_Position insertLength)
+{
+    for (std::vector<IndicatorRun>& runs : indicators) {
+        for (IndicatorRun& r : runs) {
+            if (r.start >= position) {
+                r.start += insertLength;
+                r.end += insertLength;
+            }
+            else if (r.end > position) {
+                r.end += insertLength;
+            }
+        }
+    }
+}
+
+void GapBufferDocument::moveIndicatorsForDelete(Sci_Position position, Sci_Position deleteLength)
+{
+    const Sci_Position deleteEnd = position + deleteLength;
+    auto move = [&](Sci_Position p) {
+        if (p <= position) {
+            return p;
+        }
+        return (p >= deleteEnd) ? p - deleteLength : position;
+    };
+    for (std::vector<IndicatorRun>& runs : indicators) {
+        for (IndicatorRun& r : runs) {
+            r.start = move(r.start);
+            r.end = move(r.end);
+        }
+        runs.erase(std::remove_if(runs.begin(), runs.end(),
+            [](const IndicatorRun& r) { return r.start >= r.end; }), runs.end());
+    }
+}
+
+bool GapBufferDocument::indicatorValueAt(int indicator, Sci_Position position) const
+{
+    if (indicator < 0 || static_cast<size_t>(indicator) >= indicators.size()) {
+        return false;
+    }
+    const std::vector<IndicatorRun>& runs = indicators[indicator];
+    auto it = std::upper_bound(runs.begin(), runs.end(), position,
+        [](Sci_Position pos, const IndicatorRun& r) { return pos < r.end; });
+    return it != runs.end() && it->start <= position;
+}
+
+Sci_Position GapBufferDocument::indicatorEnd(int indicator, Sci_Position position) const
+{
+    if (indicator < 0 || static_cast<size_t>(indicator) >= indicators.size()) {
+        return substance.length();
+    }
+    const std::vector<IndicatorRun>& runs = indicators[indicator];
+    auto it = std::upper_bound(runs.begin(), runs.end(), position,
+        [](Sci_Position pos, const IndicatorRun& r) { return pos < r.end; });
+    if (it == runs.end()) {
+        return substance.length();
+    }
+    return (it->start <= position) ? it->end : it->start;
+}
+
+Sci_Position GapBufferDocument::indicatorStart(int indicator, Sci_Position position) const
+{
+    if (indicator < 0 || static_cast<size_t>(indicator) >= indicators.size()) {
+        return 0;
+    }
+    const std::vector<IndicatorRun>& runs = indicators[indicator];
+    auto it = std::upper_bound(runs.begin(), runs.end(), position,
+        [](Sci_Position pos, const IndicatorRun& r) { return pos < r.end; });
+    if (it != runs.end() && it->start <= position) {
+        return it->start;
+    }
+    return (it == runs.begin()) ? 0 : std::prev(it)->end;
+}
+
+#pragma endregion
+
+
+#pragma region Messages
+
+sptr_t GapBufferDocument::send(unsigned int iMessage, uptr_t wParam, sptr_t lParam)
+{
+    const Sci_Position pos = static_cast<Sci_Position>(wParam);
+    char* text = reinterpret_cast<char*>(lParam);
+    Selection& main = selections[mainSelection];
+
+    switch (iMessage) {
+
+    //Text
+    case SCI_GETLENGTH:
+    case SCI_GETTEXTLENGTH:
+        return substance.length();
+
+    case SCI_GETCHARAT:
+        return static_cast<unsigned char>(charAt(pos));
+
+    case SCI_GETTEXT: {
+        const Sci_Position count = std::min<Sci_Position>(pos, substance.length());
+        if (!text) {
+            return substance.length();
+        }
+        return copyRange(text, 0, count);
+    }
+
+    case SCI_SETTEXT:
+        setText(text ? std::string(text) : std::string());
+        return 0;
+
+    case SCI_CLEARALL:
+        deleteChars(0, substance.length());
+        selections.assign(1, Selection());
+        mainSelection = 0;
+        return 0;
+
+    case SCI_GETTEXTRANGEFULL: {
+        Sci_TextRangeFull* tr = reinterpret_cast<Sci_TextRangeFull*>(lParam);
+        if (!tr) {
+            return 0;
+        }
+        const Sci_Position cpMax = (tr->chrg.cpMax < 0) ? substance.length() : tr->chrg.cpMax;
+        return copyRange(tr->lpstrText, tr->chrg.cpMin, cpMax);
+    }
+
+    case SCI_GETCHARACTERPOINTER:
+        return reinterpret_cast<sptr_t>(substance.bufferPointer());
+
+    case SCI_GETDOCPOINTER:
+        return reinterpret_cast<sptr_t>(this);
+
+    case SCI_GETRANGEPOINTER: {
+        const Sci_Position rangeLength = std::clamp<Sci_Position>(static_cast<Sci_Position>(lParam), 0, substance.length() - pos);
+        return reinterpret_cast<sptr_t>(substance.rangePointer(pos, rangeLength));
+    }
+
+    case SCI_GETGAPPOSITION:
+        return substance.gapPosition();
+
+    case SCI_INSERTTEXT: {
+        if (!text) {
+            return 0;
+        }
+        const Sci_Position insertPos = (static_cast<Sci_Position>(wParam) == -1) ? main.caret : pos;
+        insertString(insertPos, text, static_cast<Sci_Position>(std::strlen(text)));
+        return 0;
+    }
+
+    case SCI_APPENDTEXT:
+        if (text) {
+            insertString(substance.length(), text, pos);
+        }
+        return 0;
+
+    case SCI_DELETERANGE:
+        deleteChars(pos, static_cast<Sci_Position>(lParam));
+        return 0;
+
+    case SCI_GETREADONLY:
+        return readOnly;
+
+    case SCI_SETREADONLY:
+        readOnly = wParam != 0;
+        return 0;
+
+    //Lines
+    case SCI_GETLINECOUNT:
+        return lineStarts.lines();
+
+    case SCI_LINEFROMPOSITION:
+        return (pos <= 0) ? 0 : lineStarts.lineFromPosition(pos);
+
+    case SCI_POSITIONFROMLINE:
+        if (pos < 0) {
+            return lineStarts.lineStart(lineStarts.lineFromPosition(main.caret));
+        }
+        if (pos > lineStarts.lines()) {
+            return -1;
+        }
+        return (pos == lineStarts.lines()) ? substance.length() : lineStarts.lineStart(pos);
+
+    case SCI_GETLINEENDPOSITION:
+        return lineEndPosition(pos);
+
+    case SCI_LINELENGTH:
+        if (pos < 0 || pos >= lineStarts.lines()) {
+            return 0;
+        }
+        return ((pos + 1 >= lineStarts.lines()) ? substance.length() : lineStarts.lineStart(pos + 1)) - lineStarts.lineStart(pos);
+
+    case SCI_GETLINE: {
+        if (pos < 0 || pos >= lineStarts.lines()) {
+            return 0;
+        }
+        const Sci_Position start = lineStarts.lineStart(pos);
+        const Sci_Position end = (pos + 1 >= lineStarts.lines()) ? substance.length() : lineStarts.lineStart(pos + 1);
+        if (text) {
+            substance.getRange(text, start, end - start); // No terminating NUL, like Scintilla
+        }
+        return end - start;
+    }
+
+    case SCI_GETEOLMODE:
+        return eolMode;
+
+    case SCI_SETEOLMODE:
+        eolMode = static_cast<int>(wParam);
+        return 0;
+
+    case SCI_GETCODEPAGE:
+        return codePage;
+
+    case SCI_GETLINEENDTYPESACTIVE:
+        return SC_LINE_END_TYPE_DEFAULT;
+
+    case SCI_SETCODEPAGE:
+        codePage = static_cast<int>(wParam);
+        return 0;
+
+    case SCI_GETWORDCHARS:
+    case SCI_GETWHITESPACECHARS:
+    case SCI_GETPUNCTUATIONCHARS: {
+        // Without a terminating NUL, like Scintilla
+        const int wanted = (iMessage == SCI_GETWORDCHARS) ? 2 : (iMessage == SCI_GETWHITESPACECHARS) ? 1 : 3;
+        sptr_t count = 0;
+        for (int ch = 255; ch >= 0; --ch) { // Descending as in Scintilla, a NUL comes last
+            if (characterClass(static_cast<unsigned char>(ch)) == wanted) {
+                if (text) {
+                    text[count] = static_cast<char>(ch);
+                }
+                ++count;
+            }
+        }
+        return count;
+    }
+
+    case SCI_SETWORDCHARS:
+        // Every other character that is no space becomes punctuation, as in Scintilla
+        setDefaultCharClasses(false);
+        if (text) {
+            setCharClasses(text, 2);
+        }
+        return 0;
+
+    case SCI_SETWHITESPACECHARS:
+    case SCI_SETPUNCTUATIONCHARS:
+        if (text) {
+            setCharClasses(text, (iMessage == SCI_SETWHITESPACECHARS) ? 1 : 3);
+        }
+        return 0;
+
+    case SCI_SETCHARSDEFAULT:
+        setDefaultCharClasses(true);
+        return 0;
+
+    case SCI_POSITIONBEFORE: {
+        Sci_Position p = std::clamp<Sci_Position>(pos, 0, substance.length());
+        if (p == 0) {
+            return 0;
+        }
+        if (charAt(p - 1) == '\n' && charAt(p - 2) == '\r') {
+            return p - 2;
+        }
+        p--;
+        if (codePage == SC_CP_UTF8) {
+            // Step over UTF-8 continuation bytes
+            int trail = 0;
+            while (p > 0 && trail < 3 && (static_cast<unsigned char>(charAt(p)) & 0xC0) == 0x80) {
+                p--;
+                trail++;
+            }
+        }
+        return p;
+    }
+
+    case SCI_POSITIONAFTER: {
+        Sci_Position p = std::clamp<Sci_Position>(pos, 0, substance.length());
+        if (p >= substance.length()) {
+            return substance.length();
+        }
+        if (charAt(p) == '\r' && charAt(p + 1) == '\n') {
+            return p + 2;
+        }
+        p++;
+        if (codePage == SC_CP_UTF8) {
+            int trail = 0;
+            while (p < substance.length() && trail < 3 && (static_cast<unsigned char>(charAt(p)) & 0xC0) == 0x80) {
+                p++;
+                trail++;
+            }
+        }
+        return p;
+    }
+
+    //Target and search
+    case SCI_SETTARGETSTART:
+        targetStart = pos;
+        return 0;
+
+    case SCI_SETTARGETEND:
+        targetEnd = pos;
+        return 0;
+
+    case SCI_SETTARGETRANGE:
+        targetStart = pos;
+        targetEnd = static_cast<Sci_Position>(lParam);
+        return 0;
+
+    case SCI_GETTARGETSTART:
+        return targetStart;
+
+    case SCI_GETTARGETEND:
+        return targetEnd;
+
+    case SCI_TARGETWHOLEDOCUMENT:
+        targetStart = 0;
+        targetEnd = substance.length();
+        return 0;
+
+    case SCI_SETSEARCHFLAGS:
+        searchFlags = static_cast<int>(wParam);
+        return 0;
+
+    case SCI_GETSEARCHFLAGS:
+        return searchFlags;
+
+    case SCI_SEARCHINTARGET:
+        if (!text) {
+            return -1;
+        }
+        return searchInTarget(text, pos);
+
+    case SCI_GETTAG: {
+        if (wParam >= regexGroups.size()) {
+            return -1;
+        }
+        const std::string& tag = regexGroups[wParam];
+        if (text) {
+            std::memcpy(text, tag.data(), tag.size());
+            text[tag.size()] = '\0';
+        }
+        return static_cast<sptr_t>(tag.size());
+    }
+
+    case SCI_REPLACETARGET:
+    case SCI_REPLACETARGETRE: {
+        if (!text) {
+            return 0;
+        }
+        const Sci_Position textLength = (static_cast<Sci_Position>(wParam) == -1) ? static_cast<Sci_Position>(std::strlen(text)) : pos;
+        if (iMessage == SCI_REPLACETARGETRE) {
+            return replaceTarget(expandSubstitution(text, textLength));
+        }
+        return replaceTarget(std::string(text, static_cast<size_t>(textLength)));
+    }
+
+    //Selection
+    case SCI_GETCURRENTPOS:
+        return main.caret;
+
+    case SCI_GETANCHOR:
+        return main.anchor;
+
+    case SCI_SETCURRENTPOS:
+        main.caret = pos;
+        return 0;
+
+    case SCI_SETANCHOR:
+        main.anchor = pos;
+        return 0;
+
+    case SCI_GOTOPOS:
+    case SCI_SETEMPTYSELECTION:
+        selections.assign(1, Selection{ pos, pos });
+        mainSelection = 0;
+        return 0;
+
+    case SCI_SETSEL: {
+        const Sci_Position caret = (static_cast<Sci_Position>(lParam) < 0) ? substance.length() : static_cast<Sci_Position>(lParam);
+        selections.assign(1, Selection{ caret, pos });
+        mainSelection = 0;
+        return 0;
+    }
+
+    case SCI_SETSELECTION:
+        selections.assign(1, Selection{ pos, static_cast<Sci_Position>(lParam) });
+        mainSelection = 0;
+        return 0;
+
+    case SCI_ADDSELECTION:
+        selections.push_back(Selection{ pos, static_cast<Sci_Position>(lParam) });
+        mainSelection = selections.size() - 1;
+        return 0;
+
+    case SCI_CLEARSELECTIONS:
+        selections.assign(1, Selection());
+        mainSelection = 0;
+        return 0;
+
+    case SCI_GETSELECTIONS:
+        return static_cast<sptr_t>(selections.size());
+
+    case SCI_GETMAINSELECTION:
+        return static_cast<sptr_t>(mainSelection);
+
+    case SCI_GETSELECTIONNSTART:
+        return (wParam < selections.size()) ? selections[wParam].start() : -1;
+
+    case SCI_GETSELECTIONNEND:
+        return (wParam < selections.size()) ? selections[wParam].end() : -1;
+
+    case SCI_GETSELECTIONSTART:
+        return main.start();
+
+    case SCI_GETSELECTIONEND:
+        return main.end();
+
+    case SCI_SETSELECTIONSTART:
+        main.caret = std::max(main.caret, pos);
+        main.anchor = pos;
+        return 0;
+
+    case SCI_SETSELECTIONEND:
+        main.anchor = std::min(main.anchor, pos);
+        main.caret = pos;
+        return 0;
+
+    case SCI_GETSELTEXT:
+        if (!text) {
+            return main.end() - main.start();
+        }
+        return copyRange(text, main.start(), main.end());
+
+    //Indicators
+    case SCI_SETINDICATORCURRENT:
+        indicatorCurrent = static_cast<int>(wParam);
+        return 0;
+
+    case SCI_GETINDICATORCURRENT:
+        return indicatorCurrent;
+
+    case SCI_INDICATORFILLRANGE:
+        fillIndicator(indicatorCurrent, pos, static_cast<Sci_Position>(lParam));
+        return 0;
+
+    case SCI_INDICATORCLEARRANGE:
+        clearIndicator(indicatorCurrent, pos, static_cast<Sci_Position>(lParam));
+        return 0;
+
+    case SCI_INDICATORVALUEAT:
+        return indicatorValueAt(static_cast<int>(wParam), static_cast<Sci_Position>(lParam)) ? 1 : 0;
+
+    case SCI_INDICATOREND:
+        return indicatorEnd(static_cast<int>(wParam), static_cast<Sci_Position>(lParam));
+
+    case SCI_INDICATORSTART:
+        return indicatorStart(static_cast<int>(wParam), static_cast<Sci_Position>(lParam));
+
+    //Modification events
+    case SCI_GETMODEVENTMASK:
+        return modEventMask;
+
+    case SCI_SETMODEVENTMASK:
+        modEventMask = static_cast<int>(wParam);
+        return 0;
+
+    // There is no undo history, grouping only has to balance
+    case SCI_BEGINUNDOACTION:
+        undoActionDepth++;
+        return 0;
+
+    case SCI_ENDUNDOACTION:
+        undoActionDepth = std::max(0, undoActionDepth - 1);
+        return 0;
+
+    case SCI_CANUNDO:
+    case SCI_CANREDO:
+        return 0;
+
+    // View related messages have nothing to do without a window
+    case SCI_INDICSETSTYLE:
+    case SCI_INDICSETFORE:
+    case SCI_INDICSETALPHA:
+    case SCI_INDICSETUNDER:
+    case SCI_ENSUREVISIBLE:
+    case SCI_ENSUREVISIBLEENFORCEPOLICY:
+    case SCI_SETVISIBLEPOLICY:
+    case SCI_SCROLLRANGE:
+    case SCI_SCROLLCARET:
+    case SCI_CHOOSECARETX:
+    case SCI_COLOURISE:
+    case SCI_STARTSTYLING:
+    case SCI_SETSTYLING:
+        return 0;
+
+    default:
+        unhandledMessageCount++;
+        return 0;
+    }
+}
+
+#pragma endregion
@@ -0,0 +1,361 @@
+// This file is part of Notepad++ project
+// Copyright (C)2023 Thomas Knoefel
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef GAP_BUFFER_DOCUMENT_H
+#define GAP_BUFFER_DOCUMENT_H
+
+#include "DocumentBackend.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Vector with a movable gap, laid out like Scintilla's SplitVector. Inserts and
+// deletes near the previous edit only move the gap instead of the whole tail.
+// It can also read values another object owns and copy them at the first change.
+template <typename T>
+class SplitVector
+{
+public:
+    // Reads valueLength values from values, which owner keeps alive, until the first
+    // change. values[valueLength] has to be a T(), bufferPointer() returns values as is.
+    void adopt(std::shared_ptr<const void> owner, const T* values, Sci_Position valueLength) {
+        clear();
+        sharedOwner = std::move(owner);
+        sharedValues = values;
+        lengthBody = valueLength;
+        part1Length = valueLength;
+    }
+
+    Sci_Position length() const noexcept {
+        return lengthBody;
+    }
+
+    Sci_Position gapPosition() const noexcept {
+        return part1Length;
+    }
+
+    T valueAt(Sci_Position position) const noexcept {
+        if (position < 0 || position >= lengthBody) {
+            return T();
+        }
+        if (sharedValues) {
+            return sharedValues[position];
+        }
+        return (position < part1Length) ? body[position] : body[gapLength + position];
+    }
+
+    void setValueAt(Sci_Position position, T value) {
+        if (position < 0 || position >= lengthBody) {
+            return;
+        }
+        ownValues();
+        if (position < part1Length) {
+            body[position] = value;
+        }
+        else {
+            body[gapLength + position] = value;
+        }
+    }
+
+    // Adds delta to rangeLength elements starting at start
+    void rangeAddDelta(Sci_Position start, Sci_Position rangeLength, T delta) {
+        ownValues();
+        Sci_Position i = start;
+        const Sci_Position end = std::min(start + rangeLength, lengthBody);
+        for (; i < std::min(end, part1Length); ++i) {
+            body[i] += delta;
+        }
+        for (; i < end; ++i) {
+            body[gapLength + i] += delta;
+        }
+    }
+
+    void insertFromArray(Sci_Position position, const T* values, Sci_Position insertLength) {
+        if (insertLength <= 0 || position < 0 || position > lengthBody) {
+            return;
+        }
+        ownValues();
+        roomFor(insertLength);
+        gapTo(position);
+        std::copy(values, values + insertLength, body.begin() + part1Length);
+        lengthBody += insertLength;
+        part1Length += insertLength;
+        gapLength -= insertLength;
+    }
+
+    void insertValue(Sci_Position position, T value) {
+        insertFromArray(position, &value, 1);
+    }
+
+    void deleteRange(Sci_Position position, Sci_Position deleteLength) {
+        if (deleteLength <= 0 || position < 0 || position + deleteLength > lengthBody) {
+            return;
+        }
+        if (position == 0 && deleteLength == lengthBody) {
+            // Releasing everything is cheaper than closing the gap over the whole body
+            clear();
+            return;
+        }
+        ownValues();
+        gapTo(position);
+        lengthBody -= deleteLength;
+        gapLength += deleteLength;
+    }
+
+    void clear() {
+        sharedOwner.reset();
+        sharedValues = nullptr;
+        body.clear();
+        body.shrink_to_fit();
+        lengthBody = 0;
+        part1Length = 0;
+        gapLength = 0;
+    }
+
+    // Copies a range that may span the gap into buffer
+    void getRange(T* buffer, Sci_Position position, Sci_Position retrieveLength) const {
+        if (sharedValues) {
+            std::copy(sharedValues + position, sharedValues + position + retrieveLength, buffer);
+            return;
+        }
+        Sci_Position range1Length = 0;
+        if (position < part1Length) {
+            range1Length = std::min(retrieveLength, part1Length - position);
+            std::copy(body.begin() + position, body.begin() + position + range1Length, buffer);
+        }
+        const Sci_Position range2Start = position + range1Length + gapLength;
+        std::copy(body.begin() + range2Start, body.begin() + range2Start + retrieveLength - range1Length, buffer + range1Length);
+    }
+
+    // Contiguous view of a range, moving the gap only when it lies inside the range
+    const T* rangePointer(Sci_Position position, Sci_Position rangeLength) {
+        if (sharedValues) {
+            return sharedValues + position;
+        }
+        if (body.empty()) {
+            body.resize(1);
+            gapLength = 1;
+        }
+        if (position < part1Length) {
+            if (position + rangeLength > part1Length) {
+                gapTo(position);
+                return body.data() + position + gapLength;
+            }
+            return body.data() + position;
+        }
+        return body.data() + position + gapLength;
+    }
+
+    // Whole content followed by a terminating T()
+    const T* bufferPointer() {
+        if (sharedValues) {
+            return sharedValues;
+        }
+        roomFor(1);
+        gapTo(lengthBody);
+        body[lengthBody] = T();
+        return body.data();
+    }
+
+private:
+    // Copies adopted values into the body, without a gap
+    void ownValues() {
+        if (!sharedValues) {
+            return;
+        }
+        body.assign(sharedValues, sharedValues + lengthBody);
+        sharedValues = nullptr;
+        sharedOwner.reset();
+        part1Length = lengthBody;
+        gapLength = 0;
+    }
+
+    void gapTo(Sci_Position position) {
+        if (position == part1Length) {
+            return;
+        }
+        if (position < part1Length) {
+            // Moving the gap towards start so moving elements towards end
+            std::copy_backward(body.begin() + position, body.begin() + part1Length, body.begin() + part1Length + gapLength);
+        }
+        else {
+            // Moving the gap towards end so moving elements towards start
+            std::copy(body.begin() + part1Length + gapLength, body.begin() + position + gapLength, body.begin() + part1Length);
+        }
+        part1Length = position;
+    }
+
+    void roomFor(Sci_Position insertionLength) {
+        if (gapLength > insertionLength) {
+            return;
+        }
+        Sci_Position growSize = std::max<Sci_Position>(lengthBody / 6, 8);
+        gapTo(lengthBody);
+        const Sci_Position newSize = lengthBody + insertionLength + growSize;
+        body.resize(static_cast<size_t>(newSize));
+        gapLength = newSize - lengthBody;
+    }
+
+    std::vector<T> body;
+    std::shared_ptr<const void> sharedOwner;
+    const T* sharedValues = nullptr; // Adopted values, body is empty while set
+    Sci_Position lengthBody = 0;
+    Sci_Position part1Length = 0;
+    Sci_Position gapLength = 0;
+};
+
+// Line start positions as in Scintilla's Partitioning. A pending step is applied
+// lazily so typing or replacing inside one line does not touch every later line.
+class LineStartIndex
+{
+public:
+    LineStartIndex();
+
+    Sci_Position lines() const noexcept {
+        return starts.length() - 1;
+    }
+
+    Sci_Position lineStart(Sci_Position line) const noexcept;
+    Sci_Position lineFromPosition(Sci_Position pos) const noexcept;
+    void insertText(Sci_Position line, Sci_Position delta);
+    void insertLine(Sci_Position line, Sci_Position pos);
+    void removeLine(Sci_Position line);
+    void setLineStart(Sci_Position line, Sci_Position pos);
+    void reset();
+
+private:
+    void applyStep(Sci_Position partitionUpTo);
+    void backStep(Sci_Position partitionDownTo);
+
+    SplitVector<Sci_Position> starts;
+    Sci_Position stepPartition = 0;
+    Sci_Position stepLength = 0;
+};
+
+// In-memory stand-in for a Scintilla view. It answers the subset of Scintilla
+// messages the engine sends, so search, replace and column operations can run
+// and be measured without Notepad++. Regular expressions use std::regex instead of
+// Boost, there is no undo history, and view messages are accepted but ignored.
+class GapBufferDocument : public DocumentBackend
+{
+public:
+    GapBufferDocument();
+    explicit GapBufferDocument(const std::string& text);
+
+    // Reads the shared text until the first edit copies it, a snapshot is not held twice
+    explicit GapBufferDocument(std::shared_ptr<const std::string> text);
+
+    sptr_t send(unsigned int iMessage, uptr_t wParam = 0, sptr_t lParam = 0) override;
+
+    void setText(const std::string& text);
+    std::string getText();
+    Sci_Position length() const noexcept {
+        return substance.length();
+    }
+
+    void setEOLMode(int mode) noexcept {
+        eolMode = mode;
+    }
+
+    // Called for SCN_MODIFIED with the same filtering as SCI_SETMODEVENTMASK
+    void setModificationHandler(std::function<void(const SCNotification&)> handler) {
+        modificationHandler = std::move(handler);
+    }
+
+    // Number of messages that are not implemented and were answered with 0
+    size_t unhandledMessages() const noexcept {
+        return unhandledMessageCount;
+    }
+
+private:
+    struct Selection {
+        Sci_Position caret = 0;
+        Sci_Position anchor = 0;
+        Sci_Position start() const noexcept { return std::min(caret, anchor); }
+        Sci_Position end() const noexcept { return std::max(caret, anchor); }
+    };
+
+    struct IndicatorRun {
+        Sci_Position start;
+        Sci_Position end;
+    };
+
+    //Text
+    char charAt(Sci_Position pos) const noexcept;
+    void insertString(Sci_Position position, const char* s, Sci_Position insertLength);
+    void insertLineStarts(Sci_Position position, const char* s, Sci_Position insertLength, char chAfter);
+    void deleteChars(Sci_Position position, Sci_Position deleteLength);
+    void notifyModified(int modificationType, Sci_Position position, Sci_Position changeLength, Sci_Position linesAdded, const char* text);
+    Sci_Position lineEndPosition(Sci_Position line) const noexcept;
+    Sci_Position copyRange(char* buffer, Sci_Position start, Sci_Position end) const;
+
+    //Search
+    Sci_Position searchInTarget(const char* text, Sci_Position textLength);
+    Sci_Position findLiteral(const std::string& needle, Sci_Position minPos, Sci_Position maxPos, bool forward);
+    Sci_Position findRegex(const std::string& pattern, Sci_Position minPos, Sci_Position maxPos, bool forward, Sci_Position& matchEnd);
+    bool isWordStartAt(Sci_Position pos) const noexcept;
+    bool isWordEndAt(Sci_Position pos) const noexcept;
+    int characterClass(unsigned char ch) const noexcept {
+        return charClasses[ch];
+    }
+    void setDefaultCharClasses(bool includeWordClass) noexcept;
+    void setCharClasses(const char* chars, unsigned char charClass) noexcept;
+    std::string expandSubstitution(const char* text, Sci_Position textLength) const;
+    Sci_Position replaceTarget(const std::string& text);
+
+    //Selection
+    void moveSelectionsForInsert(Sci_Position position, Sci_Position insertLength);
+    void moveSelectionsForDelete(Sci_Position position, Sci_Position deleteLength);
+
+    //Indicators
+    void fillIndicator(int indicator, Sci_Position position, Sci_Position fillLength);
+    void clearIndicator(int indicator, Sci_Position position, Sci_Position clearLength);
+    void moveIndicatorsForInsert(Sci_Position position, Sci_Position insertLength);
+    void moveIndicatorsForDelete(Sci_Position position, Sci_Position deleteLength);
+    Sci_Position indicatorEnd(int indicator, Sci_Position position) const;
+    Sci_Position indicatorStart(int indicator, Sci_Position position) const;
+    bool indicatorValueAt(int indicator, Sci_Position position) const;
+
+    SplitVector<char> substance;
+    LineStartIndex lineStarts;
+
+    Sci_Position targetStart = 0;
+    Sci_Position targetEnd = 0;
+    int searchFlags = 0;
+    std::vector<std::string> regexGroups; // Group 0 is the whole match
+
+    std::vector<Selection> selections{ Selection() };
+    size_t mainSelection = 0;
+
+    std::vector<std::vector<IndicatorRun>> indicators;
+    int indicatorCurrent = 0;
+
+    unsigned char charClasses[256] = {}; // 0 = newline, 1 = space, 2 = word, 3 = punctuation as in Scintilla's CharClassify
+
+    int eolMode = SC_EOL_CRLF;
+    int codePage = SC_CP_UTF8;
+    bool readOnly = false;
+    int undoActionDepth = 0;
+    int modEventMask = SC_MODEVENTMASKALL;
+    std::function<void(const SCNotification&)> modificationHandler;
+    size_t unhandledMessageCount = 0;
+};
+
+#endif // GAP_BUFFER_DOCUMENT_H
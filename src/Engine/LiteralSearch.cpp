@@ -0,0 +1,425 @@
+// This file is part of Notepad++ project
+// Copyright (C)2023 Thomas Knoefel
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "LiteralSearch.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#if defined(LITERAL_SEARCH_SIMD)
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define TARGET_AVX2
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace {
+
+    inline char foldAscii(char ch) {
+        return (ch >= 'A' && ch <= 'Z') ? static_cast<char>(ch - 'A' + 'a') : ch;
+    }
+
+    inline bool isAsciiLetter(char ch) {
+        return (ch >= 'A' && ch <= 'Z') || (ch >= 'a' && ch <= 'z');
+    }
+
+    inline bool isHighByte(char ch) {
+        return static_cast<unsigned char>(ch) >= 0x80;
+    }
+
+    // True for text Scintilla walks in whole characters: no continuation byte first and no
+    // sequence cut off at the end
+    bool isCompleteUtf8(const std::string& text) {
+        size_t i = 0;
+        while (i < text.size()) {
+            const unsigned char lead = static_cast<unsigned char>(text[i]);
+            size_t length = 1;
+            if (lead >= 0xF0 && lead <= 0xF4) {
+                length = 4;
+            }
+            else if (lead >= 0xE0) {
+                length = (lead <= 0xEF) ? 3 : 0;
+            }
+            else if (lead >= 0xC2) {
+                length = 2;
+            }
+            else if (lead >= 0x80) {
+                length = 0;
+            }
+            if (length == 0 || i + length > text.size()) {
+                return false;
+            }
+            for (size_t k = 1; k < length; ++k) {
+                if ((static_cast<unsigned char>(text[i + k]) & 0xC0) != 0x80) {
+                    return false;
+                }
+            }
+            i += length;
+        }
+        return true;
+    }
+
+#if defined(LITERAL_SEARCH_SIMD)
+    inline unsigned countTrailingZeros(uint32_t mask) {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanForward(&index, mask);
+        return static_cast<unsigned>(index);
+#else
+        return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+    }
+
+    bool cpuHasAvx2() {
+#if defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7) {
+            return false;
+        }
+        __cpuid(info, 1);
+        const bool osSavesYmm = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && ((_xgetbv(0) & 6) == 6);
+        if (!osSavesYmm) {
+            return false;
+        }
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+#else
+        return __builtin_cpu_supports("avx2");
+#endif
+    }
+#endif
+
+}
+
+#pragma region LiteralMatcher
+
+LiteralMatcher::LiteralMatcher(const std::string& needle, bool matchCase)
+    : pattern(needle), foldCase(!matchCase)
+{
+    if (foldCase) {
+        std::transform(pattern.begin(), pattern.end(), pattern.begin(), foldAscii);
+    }
+    if (!pattern.empty()) {
+        firstFoldMask = (foldCase && isAsciiLetter(pattern.front())) ? 0x20 : 0;
+        lastFoldMask = (foldCase && isAsciiLetter(pattern.back())) ? 0x20 : 0;
+    }
+}
+
+bool LiteralMatcher::matchesAt(const char* candidate) const
+{
+    if (!foldCase) {
+        return std::memcmp(candidate, pattern.data(), pattern.size()) == 0;
+    }
+    for (size_t i = 0; i < pattern.size(); ++i) {
+        if (foldAscii(candidate[i]) != pattern[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+const char* LiteralMatcher::find(const char* first, const char* last) const
+{
+    if (pattern.empty() || static_cast<size_t>(last - first) < pattern.size()) {
+        return nullptr;
+    }
+#if defined(LITERAL_SEARCH_SIMD)
+    static const bool avx2 = cpuHasAvx2();
+    return avx2 ? findAvx2(first, last) : findSse2(first, last);
+#else
+    return findScalar(first, last);
+#endif
+}
+
+const char* LiteralMatcher::findScalar(const char* first, const char* last) const
+{
+    const char* const lastStart = last - pattern.size();
+    const char firstByte = pattern.front();
+    for (const char* pos = first; pos <= lastStart; ++pos) {
+        if (!foldCase) {
+            pos = static_cast<const char*>(std::memchr(pos, firstByte, static_cast<size_t>(lastStart - pos) + 1));
+            if (!pos) {
+                return nullptr;
+            }
+        }
+        if (matchesAt(pos)) {
+            return pos;
+        }
+    }
+    return nullptr;
+}
+
+#if defined(LITERAL_SEARCH_SIMD)
+
+const char* LiteralMatcher::findSse2(const char* first, const char* last) const
+{
+    const size_t lastOffset = pattern.size() - 1;
+    const char* const lastStart = last - pattern.size();
+    const __m128i firstByte = _mm_set1_epi8(pattern.front());
+    const __m128i lastByte = _mm_set1_epi8(pattern.back());
+    const __m128i firstMask = _mm_set1_epi8(firstFoldMask);
+    const __m128i lastMask = _mm_set1_epi8(lastFoldMask);
+
+    // The last block read ends at lastStart + lastOffset + 15 = last - 1
+    const char* pos = first;
+    for (; pos + 15 <= lastStart; pos += 16) {
+        const __m128i blockFirst = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pos)), firstMask);
+        const __m128i blockLast = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pos + lastOffset)), lastMask);
+        uint32_t candidates = static_cast<uint32_t>(_mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(blockFirst, firstByte), _mm_cmpeq_epi8(blockLast, lastByte))));
+        while (candidates) {
+            const char* candidate = pos + countTrailingZeros(candidates);
+            if (matchesAt(candidate)) {
+                return candidate;
+            }
+            candidates &= candidates - 1;
+        }
+    }
+    return findScalar(pos, last);
+}
+
+TARGET_AVX2 const char* LiteralMatcher::findAvx2(const char* first, const char* last) const
+{
+    const size_t lastOffset = pattern.size() - 1;
+    const char* const lastStart = last - pattern.size();
+    const __m256i firstByte = _mm256_set1_epi8(pattern.front());
+    const __m256i lastByte = _mm256_set1_epi8(pattern.back());
+    const __m256i firstMask = _mm256_set1_epi8(firstFoldMask);
+    const __m256i lastMask = _mm256_set1_epi8(lastFoldMask);
+
+    const char* pos = first;
+    for (; pos + 31 <= lastStart; pos += 32) {
+        const __m256i blockFirst = _mm256_or_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(pos)), firstMask);
+        const __m256i blockLast = _mm256_or_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(pos + lastOffset)), lastMask);
+        uint32_t candidates = static_cast<uint32_t>(_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(blockFirst, firstByte), _mm256_cmpeq_epi8(blockLast, lastByte))));
+        while (candidates) {
+            const char* candidate = pos + countTrailingZeros(candidates);
+            if (matchesAt(candidate)) {
+                return candidate;
+            }
+            candidates &= candidates - 1;
+        }
+    }
+    return findSse2(pos, last);
+}
+
+#endif
+
+bool LiteralMatcher::hasNonAscii(const char* first, const char* last)
+{
+    const char* pos = first;
+#if defined(LITERAL_SEARCH_SIMD)
+    for (; last - pos >= 16; pos += 16) {
+        if (_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pos))) != 0) {
+            return true;
+        }
+    }
+#endif
+    return std::any_of(pos, last, isHighByte);
+}
+
+#pragma endregion
+
+
+#pragma region LiteralSearch
+
+bool LiteralSearch::prepare(DocumentBackend& doc, const std::string& findTextUtf8, int flags)
+{
+    if (prepared && flags == searchFlags && findTextUtf8 == findText) {
+        return usable;
+    }
+    prepared = true;
+    usable = false;
+    findText = findTextUtf8;
+    searchFlags = flags;
+
+    if ((flags & SCFIND_REGEXP) || findText.empty()) {
+        return false;
+    }
+
+    // Only in UTF-8 and single byte code pages is every byte where it looks like it is
+    codePage = static_cast<int>(doc.send(SCI_GETCODEPAGE, 0, 0));
+    if (codePage != 0 && codePage != SC_CP_UTF8) {
+        return false;
+    }
+    const bool matchCase = (flags & SCFIND_MATCHCASE) != 0;
+    const bool asciiText = !LiteralMatcher::hasNonAscii(findText.data(), findText.data() + findText.size());
+    if (!matchCase && !asciiText) {
+        return false; // Folding beyond ASCII is up to Scintilla
+    }
+    if (codePage == SC_CP_UTF8 && !asciiText && !isCompleteUtf8(findText)) {
+        return false;
+    }
+
+    if (flags & SCFIND_WHOLEWORD) {
+        loadCharacterClasses(doc, characterClasses);
+    }
+
+    // Text without letters has nothing to fold
+    foldsLetters = !matchCase && std::any_of(findText.begin(), findText.end(), isAsciiLetter);
+    matcher = LiteralMatcher(findText, !foldsLetters);
+    usable = true;
+    return true;
+}
+
+void LiteralSearch::loadCharacterClasses(DocumentBackend& doc, CharacterClasses& characterClasses)
+{
+    // Scintilla's defaults, unless the document reports its own word and space characters
+    for (int ch = 0; ch < 256; ++ch) {
+        if (ch == '\r' || ch == '\n') {
+            characterClasses[ch] = NewLine;
+        }
+        else if (ch < 0x20 || ch == ' ') {
+            characterClasses[ch] = Space;
+        }
+        else if (ch >= 0x80 || (ch >= '0' && ch <= '9') || isAsciiLetter(static_cast<char>(ch)) || ch == '_') {
+            characterClasses[ch] = Word;
+        }
+        else {
+            characterClasses[ch] = Punctuation;
+        }
+    }
+
+    char chars[257] = {};
+    const sptr_t wordCount = doc.send(SCI_GETWORDCHARS, 0, 0);
+    if (wordCount <= 0 || wordCount > 256) {
+        return;
+    }
+    for (int ch = 0; ch < 256; ++ch) {
+        if (characterClasses[ch] != NewLine) {
+            characterClasses[ch] = Punctuation;
+        }
+    }
+    doc.send(SCI_GETWORDCHARS, 0, reinterpret_cast<sptr_t>(chars));
+    for (sptr_t i = 0; i < wordCount; ++i) {
+        characterClasses[static_cast<unsigned char>(chars[i])] = Word;
+    }
+    const sptr_t spaceCount = doc.send(SCI_GETWHITESPACECHARS, 0, 0);
+    if (spaceCount > 0 && spaceCount <= 256) {
+        doc.send(SCI_GETWHITESPACECHARS, 0, reinterpret_cast<sptr_t>(chars));
+        for (sptr_t i = 0; i < spaceCount; ++i) {
+            characterClasses[static_cast<unsigned char>(chars[i])] = Space;
+        }
+    }
+}
+
+bool LiteralSearch::isWordAt(DocumentBackend& doc, const char* hit, Sci_Position pos, Sci_Position documentLength)
+{
+    const Sci_Position end = pos + matchLength();
+    const bool hasBefore = pos > 0;
+    const bool hasAfter = end < documentLength;
+
+    // Multi-byte characters have Unicode classes in UTF-8, Scintilla decides those
+    if (codePage == SC_CP_UTF8 && (isHighByte(hit[0]) || isHighByte(hit[matchLength() - 1]) ||
+        (hasBefore && isHighByte(hit[-1])) || (hasAfter && isHighByte(hit[matchLength()])))) {
+        askedDocument = true;
+        doc.send(SCI_SETTARGETRANGE, pos, end);
+        doc.send(SCI_SETSEARCHFLAGS, searchFlags, 0);
+        return doc.send(SCI_SEARCHINTARGET, findText.length(), reinterpret_cast<sptr_t>(findText.c_str())) == pos;
+    }
+
+    auto classAt = [this](char ch) {
+        return characterClasses[static_cast<unsigned char>(ch)];
+    };
+    const unsigned char first = classAt(hit[0]);
+    const unsigned char last = classAt(hit[matchLength() - 1]);
+    const bool wordStart = !hasBefore || ((first == Word || first == Punctuation) && first != classAt(hit[-1]));
+    const bool wordEnd = !hasAfter || ((last == Word || last == Punctuation) && last != classAt(hit[matchLength()]));
+    return wordStart && wordEnd;
+}
+
+bool LiteralSearch::find(DocumentBackend& doc, Sci_Position start, Sci_Position end, Sci_Position& pos)
+{
+    pos = -1;
+    if (!usable || start > end) {
+        return false;
+    }
+
+    // One character of context on both sides for the word boundaries
+    const bool wholeWord = (searchFlags & SCFIND_WHOLEWORD) != 0;
+    const Sci_Position documentLength = wholeWord ? doc.send(SCI_GETLENGTH, 0, 0) : end;
+    const Sci_Position contextStart = (wholeWord && start > 0) ? start - 1 : start;
+    const Sci_Position contextEnd = (wholeWord && end < documentLength) ? end + 1 : end;
+    auto rangeStart = [&]() {
+        const char* context = reinterpret_cast<const char*>(doc.send(SCI_GETRANGEPOINTER, contextStart, contextEnd - contextStart));
+        return context ? context + (start - contextStart) : nullptr;
+    };
+
+    const char* first = rangeStart();
+    if (!first) {
+        return false;
+    }
+    const char* last = first + (end - start);
+    const char* from = first;
+    const bool pollCancel = cancellationCheck && *cancellationCheck;
+    while (true) {
+        // Chunks overlap by a match less one byte, so none is split
+        const char* chunkLast = last;
+        if (pollCancel && last - from > CANCEL_CHUNK_BYTES + matchLength()) {
+            chunkLast = from + CANCEL_CHUNK_BYTES + matchLength() - 1;
+        }
+        const char* hit = matcher.find(from, chunkLast);
+        if (!hit) {
+            if (chunkLast == last) {
+                break;
+            }
+            if ((*cancellationCheck)()) {
+                return true;
+            }
+            from = chunkLast - (matchLength() - 1);
+            continue;
+        }
+
+        const Sci_Position hitPos = start + (hit - first);
+        askedDocument = false;
+        if (!wholeWord || isWordAt(doc, hit, hitPos, documentLength)) {
+            pos = hitPos;
+            break;
+        }
+        from = hit + 1;
+
+        // Searching in the document may have moved its gap
+        if (askedDocument) {
+            const char* moved = rangeStart();
+            if (!moved) {
+                return false;
+            }
+            from = moved + (from - first);
+            last = moved + (end - start);
+            first = moved;
+        }
+    }
+
+    // Without case matching a non-ASCII character may fold to an ASCII letter, e.g. the
+    // Kelvin sign. Rules that meet one are left to Scintilla from now on.
+    if (foldsLetters) {
+        const char* scannedEnd = (pos >= 0) ? first + (pos - start) + matchLength() : last;
+        if (LiteralMatcher::hasNonAscii(first, scannedEnd)) {
+            usable = false;
+            pos = -1;
+            return false;
+        }
+    }
+    return true;
+}
+
+#pragma endregion
@@ -0,0 +1,110 @@
+// This file is part of Notepad++ project
+// Copyright (C)2023 Thomas Knoefel
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef LITERAL_SEARCH_H
+#define LITERAL_SEARCH_H
+
+#include "DocumentBackend.h"
+
+#include <array>
+#include <functional>
+#include <string>
+
+#if defined(_M_X64) || defined(__x86_64__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || (defined(__i386__) && defined(__SSE2__))
+#define LITERAL_SEARCH_SIMD
+#endif
+
+// Finds a byte string in a contiguous buffer. Candidates are filtered on their first and
+// last byte, 32 (AVX2) or 16 (SSE2) start positions at a time, and then compared in full.
+// Without case matching ASCII letters are folded, all other bytes compare exactly.
+class LiteralMatcher
+{
+public:
+    LiteralMatcher() = default;
+    LiteralMatcher(const std::string& needle, bool matchCase);
+
+    // First match starting in [first, last - size()], nullptr if there is none
+    const char* find(const char* first, const char* last) const;
+
+    size_t size() const noexcept {
+        return pattern.size();
+    }
+
+    static bool hasNonAscii(const char* first, const char* last);
+
+private:
+    bool matchesAt(const char* candidate) const;
+    const char* findScalar(const char* first, const char* last) const;
+#if defined(LITERAL_SEARCH_SIMD)
+    const char* findSse2(const char* first, const char* last) const;
+    const char* findAvx2(const char* first, const char* last) const;
+#endif
+
+    std::string pattern;     // Lower case when case is folded
+    bool foldCase = false;
+    char firstFoldMask = 0;  // 0x20 if the first byte is a letter that is folded
+    char lastFoldMask = 0;
+};
+
+// Searches Normal and Extended mode rules directly in the document buffer instead of through
+// SCI_SEARCHINTARGET. It only answers when it finds exactly what Scintilla finds; otherwise
+// find() returns false and the caller asks Scintilla.
+class LiteralSearch
+{
+public:
+    static constexpr Sci_Position CANCEL_CHUNK_BYTES = 64 * 1024;
+
+    // Polled between chunks of a long search, which then finds nothing. Unset or empty
+    // never cancels, the range is then scanned at once.
+    const std::function<bool()>* cancellationCheck = nullptr;
+
+    // False for rules Scintilla has to search: regular expressions, empty text, DBCS
+    // code pages, non-ASCII text without case matching and incomplete UTF-8
+    bool prepare(DocumentBackend& doc, const std::string& findTextUtf8, int searchFlags);
+
+    // Forward search in [start, end) of a prepared rule; pos is -1 if there is no match
+    bool find(DocumentBackend& doc, Sci_Position start, Sci_Position end, Sci_Position& pos);
+
+    Sci_Position matchLength() const noexcept {
+        return static_cast<Sci_Position>(matcher.size());
+    }
+
+    // Another document, or the word characters may have changed
+    void reset() noexcept {
+        prepared = false;
+    }
+
+    enum CharacterClass : unsigned char { NewLine, Space, Word, Punctuation }; // As in Scintilla's CharClassify
+    using CharacterClasses = std::array<unsigned char, 256>;
+
+    // Classes of single byte characters for word boundaries
+    static void loadCharacterClasses(DocumentBackend& doc, CharacterClasses& characterClasses);
+
+private:
+    bool isWordAt(DocumentBackend& doc, const char* hit, Sci_Position pos, Sci_Position documentLength);
+
+    std::string findText;
+    int searchFlags = 0;
+    bool prepared = false;
+    bool usable = false;
+    bool foldsLetters = false;  // Case is ignored and the text has ASCII letters
+    bool askedDocument = false; // isWordAt() searched the document
+    int codePage = 0;
+    LiteralMatcher matcher;
+    CharacterClasses characterClasses{};
+};
+
+#endif // LITERAL_SEARCH_H
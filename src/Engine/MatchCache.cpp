@@ -0,0 +1,128 @@
+// This file is part of Notepad++ project
+// Copyright (C)2023 Thomas Knoefel
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "MatchCache.h"
+#include "MemoryUsage.h"
+
+#include <algorithm>
+
+const MatchCache::Entry* MatchCache::findEntry(const std::string& findTextUtf8, int searchFlags, uint64_t documentVersion, Sci_Position documentLength) const
+{
+    auto it = sets.find(Key{ findTextUtf8, searchFlags });
+    if (it == sets.end() || it->second.documentVersion != documentVersion || it->second.documentLength != documentLength) {
+        return nullptr;
+    }
+    return &it->second;
+}
+
+const std::vector<MatchInterval>* MatchCache::lookup(const std::string& findTextUtf8, int searchFlags, uint64_t documentVersion, Sci_Position documentLength) const
+{
+    const Entry* entry = findEntry(findTextUtf8, searchFlags, documentVersion, documentLength);
+    return (entry && !entry->oversized) ? &entry->matches : nullptr;
+}
+
+bool MatchCache::isOversized(const std::string& findTextUtf8, int searchFlags, uint64_t documentVersion, Sci_Position documentLength) const
+{
+    const Entry* entry = findEntry(findTextUtf8, searchFlags, documentVersion, documentLength);
+    return entry && entry->oversized;
+}
+
+const std::vector<MatchInterval>* MatchCache::store(const std::string& findTextUtf8, int searchFlags, uint64_t documentVersion, Sci_Position documentLength,
+    std::vector<MatchInterval>* matches)
+{
+    // Sets of older versions are useless, drop them before they add up
+    for (auto it = sets.begin(); it != sets.end();) {
+        it = (it->second.documentVersion != documentVersion) ? sets.erase(it) : std::next(it);
+    }
+    if (sets.size() >= MAX_SETS) {
+        sets.clear();
+    }
+
+    Entry& entry = sets[Key{ findTextUtf8, searchFlags }];
+    entry.documentVersion = documentVersion;
+    entry.documentLength = documentLength;
+    entry.oversized = (matches == nullptr);
+    entry.matches.clear();
+    if (matches) {
+        entry.matches.swap(*matches);
+        entry.matches.shrink_to_fit();
+        return &entry.matches;
+    }
+    return nullptr;
+}
+
+size_t MatchCache::memoryBytes() const
+{
+    size_t bytes = MemorySize::shallow(sets);
+    for (const auto& pair : sets) {
+        bytes += MemorySize::of(pair.first.findText) + MemorySize::shallow(pair.second.matches);
+    }
+    return bytes;
+}
+
+const MatchInterval* MatchCache::firstAtOrAfter(const std::vector<MatchInterval>& matches, Sci_Position pos)
+{
+    auto it = std::lower_bound(matches.begin(), matches.end(), pos, [](const MatchInterval& match, Sci_Position value) {
+        return match.start < value;
+        });
+    return (it != matches.end()) ? &*it : nullptr;
+}
+
+const MatchInterval* MatchCache::lastEndingBefore(const std::vector<MatchInterval>& matches, Sci_Position pos)
+{
+    // Matches do not overlap, so their ends are sorted as well
+    auto it = std::upper_bound(matches.begin(), matches.end(), pos, [](Sci_Position value, const MatchInterval& match) {
+        return value < match.end;
+        });
+    return (it != matches.begin()) ? &*std::prev(it) : nullptr;
+}
+
+bool MatchCache::isInsideMatch(const std::vector<MatchInterval>& matches, Sci_Position pos)
+{
+    auto it = std::lower_bound(matches.begin(), matches.end(), pos, [](const MatchInterval& match, Sci_Position value) {
+        return match.start < value;
+        });
+    return it != matches.begin() && std::prev(it)->end > pos;
+}
+
+bool MatchCache::canOverlap(const std::string& text, bool matchCase)
+{
+    auto fold = [matchCase](char ch) {
+        return (!matchCase && ch >= 'A' && ch <= 'Z') ? static_cast<char>(ch - 'A' + 'a') : ch;
+    };
+
+    if (!matchCase) {
+        for (char ch : text) {
+            if (static_cast<unsigned char>(ch) >= 0x80) {
+                return true;
+            }
+        }
+    }
+
+    // Longest proper border via the KMP failure function
+    std::vector<size_t> border(text.size() + 1, 0);
+    size_t k = 0;
+    for (size_t i = 1; i < text.size(); ++i) {
+        while (k > 0 && fold(text[i]) != fold(text[k])) {
+            k = border[k];
+        }
+        if (fold(text[i]) == fold(text[k])) {
+            ++k;
+        }
+        border[i + 1] = k;
+    }
+    return !text.empty() && border[text.size()] > 0;
+}
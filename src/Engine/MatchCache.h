@@ -0,0 +1,97 @@
+// This file is part of Notepad++ project
+// Copyright (C)2023 Thomas Knoefel
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef MATCH_CACHE_H
+#define MATCH_CACHE_H
+
+#include "DocumentBackend.h"
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+struct MatchInterval {
+    Sci_Position start;
+    Sci_Position end;
+};
+
+// Matches of a search over the whole document, as found by scanning forward from
+// the start: sorted by start, not overlapping. One set is kept per search text and
+// flags and is valid for one document version only.
+class MatchCache
+{
+public:
+    static constexpr size_t MAX_SETS = 64;                 // All sets are dropped when more are stored
+    static constexpr size_t MAX_MATCHES_PER_SET = 4000000; // 64 MB per set, larger sets are not cached
+
+    // Returns the cached set, or nullptr if there is none for this version and length
+    const std::vector<MatchInterval>* lookup(const std::string& findTextUtf8, int searchFlags, uint64_t documentVersion, Sci_Position documentLength) const;
+
+    // True if the set was found too large to cache for this version, searching directly is cheaper then
+    bool isOversized(const std::string& findTextUtf8, int searchFlags, uint64_t documentVersion, Sci_Position documentLength) const;
+
+    // Stores a complete set, or marks it oversized when matches is nullptr
+    const std::vector<MatchInterval>* store(const std::string& findTextUtf8, int searchFlags, uint64_t documentVersion, Sci_Position documentLength,
+        std::vector<MatchInterval>* matches);
+
+    void clear() noexcept {
+        sets.clear();
+    }
+
+    size_t setCount() const noexcept {
+        return sets.size();
+    }
+
+    size_t memoryBytes() const;
+
+    // First match starting at or after pos, nullptr if none
+    static const MatchInterval* firstAtOrAfter(const std::vector<MatchInterval>& matches, Sci_Position pos);
+
+    // Last match ending at or before pos, nullptr if none
+    static const MatchInterval* lastEndingBefore(const std::vector<MatchInterval>& matches, Sci_Position pos);
+
+    // True if pos lies inside a match, not at its start. A search started there can find
+    // an overlapping match the forward scan skipped.
+    static bool isInsideMatch(const std::vector<MatchInterval>& matches, Sci_Position pos);
+
+    // True if two occurrences of a literal text can overlap, i.e. it has a proper prefix
+    // that is also a suffix. Non-ASCII text is treated as overlapping when case is ignored.
+    static bool canOverlap(const std::string& text, bool matchCase);
+
+private:
+    struct Key {
+        std::string findText;
+        int searchFlags;
+
+        bool operator<(const Key& other) const {
+            return searchFlags != other.searchFlags ? searchFlags < other.searchFlags : findText < other.findText;
+        }
+    };
+
+    struct Entry {
+        uint64_t documentVersion = 0;
+        Sci_Position documentLength = 0;
+        bool oversized = false;
+        std::vector<MatchInterval> matches;
+    };
+
+    const Entry* findEntry(const std::string& findTextUtf8, int searchFlags, uint64_t documentVersion, Sci_Position documentLength) const;
+
+    std::map<Key, Entry> sets;
+};
+
+#endif // MATCH_CACHE_H
@@ -0,0 +1,87 @@
+// This file is part of Notepad++ project
+// Copyright (C)2023 Thomas Knoefel
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "MemoryUsage.h"
+
+#include <algorithm>
+#include <cstdio>
+
+size_t totalBytes(const MemoryReport& report)
+{
+    size_t total = 0;
+    for (const MemoryUsage& usage : report) {
+        total += usage.bytes;
+    }
+    return total;
+}
+
+std::string formatBytes(size_t bytes)
+{
+    char buffer[32];
+    if (bytes < 1024) {
+        std::snprintf(buffer, sizeof(buffer), "%zu B", bytes);
+    }
+    else if (bytes < 1024 * 1024) {
+        std::snprintf(buffer, sizeof(buffer), "%.1f KB", static_cast<double>(bytes) / 1024.0);
+    }
+    else {
+        std::snprintf(buffer, sizeof(buffer), "%.1f MB", static_cast<double>(bytes) / (1024.0 * 1024.0));
+    }
+    return buffer;
+}
+
+std::string formatMemoryReport(const MemoryReport& report)
+{
+    MemoryReport sorted = report;
+    std::stable_sort(sorted.begin(), sorted.end(), [](const MemoryUsage& a, const MemoryUsage& b) {
+        return a.bytes > b.bytes;
+        });
+
+    std::string result;
+    char line[160];
+    for (const MemoryUsage& usage : sorted) {
+        std::snprintf(line, sizeof(line), "%-28s %12s %12zu\n", usage.name.c_str(), formatBytes(usage.bytes).c_str(), usage.elements);
+        result += line;
+    }
+    std::snprintf(line, sizeof(line), "%-28s %12s\n", "total", formatBytes(totalBytes(report)).c_str());
+    result += line;
+    return result;
+}
+
+void LuaMemoryTracker::attach(lua_State* L)
+{
+    baseAllocator = lua_getallocf(L, &baseUserData);
+
+    // The state itself was allocated before the allocator could be replaced
+    current += static_cast<size_t>(lua_gc(L, LUA_GCCOUNT, 0)) * 1024 + static_cast<size_t>(lua_gc(L, LUA_GCCOUNTB, 0));
+    peak = std::max(peak, current);
+
+    lua_setallocf(L, &LuaMemoryTracker::allocate, this);
+}
+
+void* LuaMemoryTracker::allocate(void* ud, void* ptr, size_t osize, size_t nsize)
+{
+    LuaMemoryTracker* tracker = static_cast<LuaMemoryTracker*>(ud);
+    void* result = tracker->baseAllocator(tracker->baseUserData, ptr, osize, nsize);
+
+    // Without a block osize is a type tag, not a size
+    const size_t oldSize = ptr ? osize : 0;
+    if (nsize == 0 || result) {
+        tracker->current = tracker->current - std::min(tracker->current, oldSize) + nsize;
+        tracker->peak = std::max(tracker->peak, tracker->current);
+    }
+    return result;
+}
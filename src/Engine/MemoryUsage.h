@@ -0,0 +1,103 @@
+// This file is part of Notepad++ project
+// Copyright (C)2023 Thomas Knoefel
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef MEMORY_USAGE_H
+#define MEMORY_USAGE_H
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <lua.hpp>
+
+// Bytes held by one data structure. Container sizes are estimated from their
+// capacity and element size, allocator bookkeeping is not included.
+struct MemoryUsage {
+    std::string name;
+    size_t bytes = 0;
+    size_t elements = 0;
+};
+
+using MemoryReport = std::vector<MemoryUsage>;
+
+size_t totalBytes(const MemoryReport& report);
+
+// "812 B", "12.4 KB", "3.1 MB"
+std::string formatBytes(size_t bytes);
+
+// One structure per line, largest first, followed by the total
+std::string formatMemoryReport(const MemoryReport& report);
+
+// Size estimators for the containers the plugin uses
+namespace MemorySize {
+
+    // Heap part of a string, short strings live inside the object in all common implementations
+    template <typename CharT>
+    size_t of(const std::basic_string<CharT>& s) {
+        const size_t bytes = (s.capacity() + 1) * sizeof(CharT);
+        return bytes > 16 ? bytes : 0;
+    }
+
+    template <typename T>
+    size_t shallow(const std::vector<T>& v) {
+        return v.capacity() * sizeof(T);
+    }
+
+    // Red-black tree node: three pointers and the color next to the value
+    template <typename K, typename V>
+    size_t shallow(const std::map<K, V>& m) {
+        return m.size() * (sizeof(typename std::map<K, V>::value_type) + 4 * sizeof(void*));
+    }
+
+    template <typename K, typename V>
+    size_t shallow(const std::unordered_map<K, V>& m) {
+        return m.size() * (sizeof(typename std::unordered_map<K, V>::value_type) + 2 * sizeof(void*))
+            + m.bucket_count() * sizeof(void*);
+    }
+
+}
+
+// Counts the bytes a Lua state allocates by wrapping its allocator.
+// Lua states are short-lived in the engine, so the peak is the interesting number.
+class LuaMemoryTracker
+{
+public:
+    // Must be called right after the state is created, before any script runs
+    void attach(lua_State* L);
+
+    size_t currentBytes() const noexcept {
+        return current;
+    }
+
+    size_t peakBytes() const noexcept {
+        return peak;
+    }
+
+    void resetPeak() noexcept {
+        peak = current;
+    }
+
+private:
+    static void* allocate(void* ud, void* ptr, size_t osize, size_t nsize);
+
+    lua_Alloc baseAllocator = nullptr;
+    void* baseUserData = nullptr;
+    size_t current = 0;
+    size_t peak = 0;
+};
+
+#endif // MEMORY_USAGE_H
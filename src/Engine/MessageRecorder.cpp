@@ -0,0 +1,473 @@
+// This file is part of Notepad++ project
+// Copyright (C)2023 Thomas Knoefel
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "MessageRecorder.h"
+#include "MemoryUsage.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+
+    // How lParam (and the result) of a message has to be treated when recording and replaying
+    enum class MessageArgument {
+        Value,           // Plain integers
+        PointerResult,   // Plain integers, but the result is an address that cannot be compared
+        InputText,       // lParam is a NUL-terminated string read by Scintilla
+        InputTextLength, // lParam is a string of wParam bytes, -1 means NUL-terminated
+        TextRange,       // lParam is a Sci_TextRangeFull
+        OutputBuffer,    // lParam is a buffer Scintilla writes into
+        Unsupported      // Unknown layout, recorded for the histogram but not replayed
+    };
+
+    struct MessageInfo {
+        unsigned int message;
+        const char* name;
+        MessageArgument argument;
+    };
+
+#define MESSAGE_INFO(id, argument) { id, #id, MessageArgument::argument }
+
+    const MessageInfo messageTable[] = {
+        MESSAGE_INFO(SCI_GETLENGTH, Value),
+        MESSAGE_INFO(SCI_GETTEXTLENGTH, Value),
+        MESSAGE_INFO(SCI_GETCHARAT, Value),
+        MESSAGE_INFO(SCI_GETLINECOUNT, Value),
+        MESSAGE_INFO(SCI_LINEFROMPOSITION, Value),
+        MESSAGE_INFO(SCI_POSITIONFROMLINE, Value),
+        MESSAGE_INFO(SCI_GETLINEENDPOSITION, Value),
+        MESSAGE_INFO(SCI_LINELENGTH, Value),
+        MESSAGE_INFO(SCI_GETEOLMODE, Value),
+        MESSAGE_INFO(SCI_SETEOLMODE, Value),
+        MESSAGE_INFO(SCI_GETCODEPAGE, Value),
+        MESSAGE_INFO(SCI_GETLINEENDTYPESACTIVE, Value),
+        MESSAGE_INFO(SCI_POSITIONBEFORE, Value),
+        MESSAGE_INFO(SCI_POSITIONAFTER, Value),
+        MESSAGE_INFO(SCI_SETTARGETSTART, Value),
+        MESSAGE_INFO(SCI_SETTARGETEND, Value),
+        MESSAGE_INFO(SCI_SETTARGETRANGE, Value),
+        MESSAGE_INFO(SCI_GETTARGETSTART, Value),
+        MESSAGE_INFO(SCI_GETTARGETEND, Value),
+        MESSAGE_INFO(SCI_TARGETWHOLEDOCUMENT, Value),
+        MESSAGE_INFO(SCI_SETSEARCHFLAGS, Value),
+        MESSAGE_INFO(SCI_GETSEARCHFLAGS, Value),
+        MESSAGE_INFO(SCI_GETCURRENTPOS, Value),
+        MESSAGE_INFO(SCI_GETANCHOR, Value),
+        MESSAGE_INFO(SCI_SETCURRENTPOS, Value),
+        MESSAGE_INFO(SCI_SETANCHOR, Value),
+        MESSAGE_INFO(SCI_GOTOPOS, Value),
+        MESSAGE_INFO(SCI_SETEMPTYSELECTION, Value),
+        MESSAGE_INFO(SCI_SETSEL, Value),
+        MESSAGE_INFO(SCI_SETSELECTION, Value),
+        MESSAGE_INFO(SCI_ADDSELECTION, Value),
+        MESSAGE_INFO(SCI_CLEARSELECTIONS, Value),
+        MESSAGE_INFO(SCI_GETSELECTIONS, Value),
+        MESSAGE_INFO(SCI_GETMAINSELECTION, Value),
+        MESSAGE_INFO(SCI_GETSELECTIONNSTART, Value),
+        MESSAGE_INFO(SCI_GETSELECTIONNEND, Value),
+        MESSAGE_INFO(SCI_GETSELECTIONSTART, Value),
+        MESSAGE_INFO(SCI_GETSELECTIONEND, Value),
+        MESSAGE_INFO(SCI_SETSELECTIONSTART, Value),
+        MESSAGE_INFO(SCI_SETSELECTIONEND, Value),
+        MESSAGE_INFO(SCI_SETINDICATORCURRENT, Value),
+        MESSAGE_INFO(SCI_GETINDICATORCURRENT, Value),
+        MESSAGE_INFO(SCI_INDICATORFILLRANGE, Value),
+        MESSAGE_INFO(SCI_INDICATORCLEARRANGE, Value),
+        MESSAGE_INFO(SCI_INDICATORVALUEAT, Value),
+        MESSAGE_INFO(SCI_INDICATOREND, Value),
+        MESSAGE_INFO(SCI_INDICATORSTART, Value),
+        MESSAGE_INFO(SCI_INDICSETSTYLE, Value),
+        MESSAGE_INFO(SCI_INDICSETFORE, Value),
+        MESSAGE_INFO(SCI_INDICSETALPHA, Value),
+        MESSAGE_INFO(SCI_INDICSETUNDER, Value),
+        MESSAGE_INFO(SCI_GETMODEVENTMASK, Value),
+        MESSAGE_INFO(SCI_SETMODEVENTMASK, Value),
+        MESSAGE_INFO(SCI_BEGINUNDOACTION, Value),
+        MESSAGE_INFO(SCI_ENDUNDOACTION, Value),
+        MESSAGE_INFO(SCI_DELETERANGE, Value),
+        MESSAGE_INFO(SCI_CLEARALL, Value),
+        MESSAGE_INFO(SCI_GETREADONLY, Value),
+        MESSAGE_INFO(SCI_ENSUREVISIBLE, Value),
+        MESSAGE_INFO(SCI_ENSUREVISIBLEENFORCEPOLICY, Value),
+        MESSAGE_INFO(SCI_SETVISIBLEPOLICY, Value),
+        MESSAGE_INFO(SCI_SCROLLRANGE, Value),
+        MESSAGE_INFO(SCI_SCROLLCARET, Value),
+        MESSAGE_INFO(SCI_CHOOSECARETX, Value),
+        MESSAGE_INFO(SCI_STYLESETBACK, Value),
+        MESSAGE_INFO(SCI_STYLESETFORE, Value),
+        MESSAGE_INFO(SCI_STARTSTYLING, Value),
+        MESSAGE_INFO(SCI_SETSTYLING, Value),
+        MESSAGE_INFO(SCI_GETGAPPOSITION, Value),
+        MESSAGE_INFO(SCI_GETCHARACTERPOINTER, PointerResult),
+        MESSAGE_INFO(SCI_GETRANGEPOINTER, PointerResult),
+        MESSAGE_INFO(SCI_INSERTTEXT, InputText),
+        MESSAGE_INFO(SCI_SETTEXT, InputText),
+        MESSAGE_INFO(SCI_SEARCHINTARGET, InputTextLength),
+        MESSAGE_INFO(SCI_REPLACETARGET, InputTextLength),
+        MESSAGE_INFO(SCI_REPLACETARGETRE, InputTextLength),
+        MESSAGE_INFO(SCI_APPENDTEXT, InputTextLength),
+        MESSAGE_INFO(SCI_GETTEXTRANGEFULL, TextRange),
+        MESSAGE_INFO(SCI_GETLINE, OutputBuffer),
+        MESSAGE_INFO(SCI_GETTAG, OutputBuffer),
+        MESSAGE_INFO(SCI_GETSELTEXT, OutputBuffer),
+        MESSAGE_INFO(SCI_GETTEXT, OutputBuffer),
+        MESSAGE_INFO(SCI_GETWORDCHARS, OutputBuffer),
+        MESSAGE_INFO(SCI_GETWHITESPACECHARS, OutputBuffer),
+        MESSAGE_INFO(SCI_GETPUNCTUATIONCHARS, OutputBuffer),
+    };
+
+#undef MESSAGE_INFO
+
+    const MessageInfo* findMessageInfo(unsigned int iMessage)
+    {
+        for (const MessageInfo& info : messageTable) {
+            if (info.message == iMessage) {
+                return &info;
+            }
+        }
+        return nullptr;
+    }
+
+    MessageArgument argumentOf(unsigned int iMessage)
+    {
+        const MessageInfo* info = findMessageInfo(iMessage);
+        return info ? info->argument : MessageArgument::Unsupported;
+    }
+
+    int64_t elapsedNanoseconds(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    const char* const SESSION_HEADER = "MultiReplaceSession 1";
+
+}
+
+#pragma region MessageRecorder
+
+void MessageRecorder::start(DocumentBackend& document)
+{
+    recordedSession = RecordedSession();
+    messageHistogram.clear();
+    recordedBytes = 0;
+    recording = true;
+    snapshot(document);
+}
+
+void MessageRecorder::snapshot(DocumentBackend& document)
+{
+    RecordedMessage snapshotMessage;
+    snapshotMessage.wParam = static_cast<uptr_t>(document.send(SCI_GETCODEPAGE, 0, 0));
+    snapshotMessage.lParam = document.send(SCI_GETEOLMODE, 0, 0);
+
+    Sci_Position length = document.send(SCI_GETLENGTH, 0, 0);
+    if (!reserve(sizeof(RecordedMessage) + static_cast<size_t>(length))) {
+        return;
+    }
+    std::vector<char> buffer(static_cast<size_t>(length) + 1);
+    Sci_TextRangeFull tr{ { 0, length }, buffer.data() };
+    document.send(SCI_GETTEXTRANGEFULL, 0, reinterpret_cast<sptr_t>(&tr));
+    snapshotMessage.payload.assign(buffer.data(), static_cast<size_t>(length));
+
+    recordedSession.messages.push_back(std::move(snapshotMessage));
+}
+
+void MessageRecorder::record(unsigned int iMessage, uptr_t wParam, sptr_t lParam, sptr_t result, int64_t nanoseconds)
+{
+    MessageStats& stats = messageHistogram[iMessage];
+    stats.count++;
+    stats.totalNanoseconds += nanoseconds;
+
+    RecordedMessage recorded;
+    recorded.message = iMessage;
+    recorded.wParam = wParam;
+    recorded.lParam = lParam;
+    recorded.result = result;
+    recorded.nanoseconds = nanoseconds;
+
+    const char* text = reinterpret_cast<const char*>(lParam);
+    switch (argumentOf(iMessage)) {
+    case MessageArgument::InputText:
+        recorded.lParam = 0;
+        if (text) {
+            recorded.payload = text;
+        }
+        break;
+    case MessageArgument::InputTextLength:
+        recorded.lParam = 0;
+        if (text) {
+            const bool terminated = (static_cast<sptr_t>(wParam) == -1);
+            recorded.payload.assign(text, terminated ? std::strlen(text) : static_cast<size_t>(wParam));
+        }
+        break;
+    case MessageArgument::TextRange: {
+        recorded.lParam = 0;
+        const Sci_TextRangeFull* tr = reinterpret_cast<const Sci_TextRangeFull*>(lParam);
+        if (tr) {
+            recorded.payload.assign(reinterpret_cast<const char*>(&tr->chrg), sizeof(tr->chrg));
+        }
+        break;
+    }
+    case MessageArgument::OutputBuffer:
+        recorded.lParam = (lParam != 0) ? 1 : 0; // Only whether a buffer was passed matters
+        break;
+    case MessageArgument::PointerResult:
+        recorded.result = 0;
+        break;
+    default:
+        break;
+    }
+
+    if (reserve(sizeof(RecordedMessage) + recorded.payload.size())) {
+        recordedSession.messages.push_back(std::move(recorded));
+    }
+}
+
+bool MessageRecorder::reserve(size_t bytes)
+{
+    if (!recording) {
+        return false;
+    }
+    if (recordedBytes + bytes <= byteLimit) {
+        recordedBytes += bytes;
+        return true;
+    }
+
+    recording = false;
+    recordedSession.truncated = true;
+    if (onLimitReached) {
+        onLimitReached();
+    }
+    return false;
+}
+
+std::string MessageRecorder::formatHistogram(const std::map<unsigned int, MessageStats>& histogram, size_t maxRows)
+{
+    std::vector<std::pair<unsigned int, MessageStats>> rows(histogram.begin(), histogram.end());
+    std::sort(rows.begin(), rows.end(), [](const auto& a, const auto& b) {
+        return a.second.totalNanoseconds > b.second.totalNanoseconds;
+        });
+
+    size_t totalCount = 0;
+    int64_t totalNanoseconds = 0;
+    for (const auto& row : rows) {
+        totalCount += row.second.count;
+        totalNanoseconds += row.second.totalNanoseconds;
+    }
+
+    char line[160];
+    std::string report;
+    std::snprintf(line, sizeof(line), "%-34s %12s %12s %10s\n", "message", "count", "total ms", "avg us");
+    report += line;
+    for (size_t i = 0; i < rows.size() && i < maxRows; ++i) {
+        const MessageStats& stats = rows[i].second;
+        const char* name = messageName(rows[i].first);
+        char unknownName[32];
+        if (!name) {
+            std::snprintf(unknownName, sizeof(unknownName), "message %u", rows[i].first);
+            name = unknownName;
+        }
+        std::snprintf(line, sizeof(line), "%-34s %12zu %12.2f %10.3f\n", name, stats.count,
+            static_cast<double>(stats.totalNanoseconds) / 1e6,
+            stats.count ? static_cast<double>(stats.totalNanoseconds) / 1e3 / static_cast<double>(stats.count) : 0.0);
+        report += line;
+    }
+    if (rows.size() > maxRows) {
+        std::snprintf(line, sizeof(line), "... %zu more message types\n", rows.size() - maxRows);
+        report += line;
+    }
+    std::snprintf(line, sizeof(line), "%-34s %12zu %12.2f\n", "total", totalCount, static_cast<double>(totalNanoseconds) / 1e6);
+    report += line;
+    return report;
+}
+
+const char* MessageRecorder::messageName(unsigned int iMessage)
+{
+    const MessageInfo* info = findMessageInfo(iMessage);
+    return info ? info->name : nullptr;
+}
+
+size_t MessageRecorder::memoryBytes() const
+{
+    size_t bytes = recordedSession.messages.capacity() * sizeof(RecordedMessage);
+    for (const RecordedMessage& m : recordedSession.messages) {
+        bytes += MemorySize::of(m.payload);
+    }
+    return bytes + MemorySize::shallow(messageHistogram);
+}
+
+#pragma endregion
+
+
+#pragma region Session File
+
+// Text header followed by one record per message: a line with the numbers and the payload
+// length, then the raw payload bytes and a newline. Snapshots use message 0.
+bool MessageRecorder::save(std::ostream& out) const
+{
+    out << SESSION_HEADER << (recordedSession.truncated ? " truncated" : "") << "\n";
+    for (const RecordedMessage& m : recordedSession.messages) {
+        out << m.message << ' ' << static_cast<unsigned long long>(m.wParam) << ' ' << static_cast<long long>(m.lParam) << ' '
+            << static_cast<long long>(m.result) << ' ' << static_cast<long long>(m.nanoseconds) << ' ' << m.payload.size() << '\n';
+        out.write(m.payload.data(), static_cast<std::streamsize>(m.payload.size()));
+        out << '\n';
+    }
+    return out.good();
+}
+
+bool MessageRecorder::load(std::istream& in, RecordedSession& session)
+{
+    session = RecordedSession();
+
+    std::string header;
+    if (!std::getline(in, header) || header.compare(0, std::strlen(SESSION_HEADER), SESSION_HEADER) != 0) {
+        return false;
+    }
+    session.truncated = header.find("truncated") != std::string::npos;
+
+    RecordedMessage m;
+    unsigned long long wParam = 0;
+    long long lParam = 0;
+    long long result = 0;
+    long long nanoseconds = 0;
+    size_t payloadLength = 0;
+    while (in >> m.message >> wParam >> lParam >> result >> nanoseconds >> payloadLength) {
+        in.get(); // Newline after the numbers
+        m.wParam = static_cast<uptr_t>(wParam);
+        m.lParam = static_cast<sptr_t>(lParam);
+        m.result = static_cast<sptr_t>(result);
+        m.nanoseconds = nanoseconds;
+        m.payload.resize(payloadLength);
+        if (payloadLength > 0 && !in.read(&m.payload[0], static_cast<std::streamsize>(payloadLength))) {
+            return false;
+        }
+        in.get(); // Newline after the payload
+        session.messages.push_back(m);
+    }
+    return in.eof();
+}
+
+#pragma endregion
+
+
+#pragma region Replay
+
+ReplayResult MessageRecorder::replay(const RecordedSession& session, DocumentBackend& document)
+{
+    ReplayResult replayResult;
+    std::vector<char> buffer;
+
+    for (const RecordedMessage& m : session.messages) {
+        if (m.message == 0) {
+            // Snapshot: load the text the following messages were sent to
+            document.send(SCI_CLEARALL, 0, 0);
+            document.send(SCI_SETCODEPAGE, m.wParam, 0);
+            document.send(SCI_SETEOLMODE, static_cast<uptr_t>(m.lParam), 0);
+            document.send(SCI_APPENDTEXT, m.payload.size(), reinterpret_cast<sptr_t>(m.payload.data()));
+            document.send(SCI_SETEMPTYSELECTION, 0, 0);
+            continue;
+        }
+
+        const MessageArgument argument = argumentOf(m.message);
+        sptr_t lParam = m.lParam;
+        Sci_TextRangeFull tr{};
+        bool compareResult = true;
+
+        switch (argument) {
+        case MessageArgument::Value:
+            break;
+        case MessageArgument::PointerResult:
+            compareResult = false;
+            break;
+        case MessageArgument::InputText:
+        case MessageArgument::InputTextLength:
+            lParam = reinterpret_cast<sptr_t>(m.payload.c_str());
+            break;
+        case MessageArgument::TextRange: {
+            if (m.payload.size() != sizeof(tr.chrg)) {
+                replayResult.skipped++;
+                continue;
+            }
+            std::memcpy(&tr.chrg, m.payload.data(), sizeof(tr.chrg));
+            const Sci_Position length = document.send(SCI_GETLENGTH, 0, 0);
+            tr.chrg.cpMin = std::clamp<Sci_Position>(tr.chrg.cpMin, 0, length);
+            tr.chrg.cpMax = (tr.chrg.cpMax < 0) ? length : std::clamp<Sci_Position>(tr.chrg.cpMax, tr.chrg.cpMin, length);
+            buffer.resize(static_cast<size_t>(tr.chrg.cpMax - tr.chrg.cpMin) + 1);
+            tr.lpstrText = buffer.data();
+            lParam = reinterpret_cast<sptr_t>(&tr);
+            break;
+        }
+        case MessageArgument::OutputBuffer: {
+            if (m.lParam == 0) {
+                lParam = 0; // Size query
+                break;
+            }
+            // Ask the document itself how large the buffer has to be
+            sptr_t required;
+            if (m.message == SCI_GETLINE) {
+                required = document.send(SCI_LINELENGTH, m.wParam, 0);
+            }
+            else if (m.message == SCI_GETTEXT) {
+                required = static_cast<sptr_t>(m.wParam);
+            }
+            else {
+                required = document.send(m.message, m.wParam, 0);
+            }
+            buffer.resize(static_cast<size_t>(std::max<sptr_t>(required, 0)) + 1);
+            lParam = reinterpret_cast<sptr_t>(buffer.data());
+            break;
+        }
+        default:
+            replayResult.skipped++;
+            continue;
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        const sptr_t result = document.send(m.message, m.wParam, lParam);
+        const int64_t nanoseconds = elapsedNanoseconds(start);
+
+        replayResult.replayed++;
+        replayResult.nanoseconds += nanoseconds;
+        MessageStats& stats = replayResult.histogram[m.message];
+        stats.count++;
+        stats.totalNanoseconds += nanoseconds;
+        if (compareResult && result != m.result) {
+            replayResult.mismatches++;
+        }
+    }
+    return replayResult;
+}
+
+#pragma endregion
+
+
+#pragma region RecordingBackend
+
+sptr_t RecordingBackend::send(unsigned int iMessage, uptr_t wParam, sptr_t lParam)
+{
+    if (!recorder.isRecording()) {
+        return target.send(iMessage, wParam, lParam);
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    const sptr_t result = target.send(iMessage, wParam, lParam);
+    recorder.record(iMessage, wParam, lParam, result, elapsedNanoseconds(start));
+    return result;
+}
+
+#pragma endregion
@@ -0,0 +1,145 @@
+// This file is part of Notepad++ project
+// Copyright (C)2023 Thomas Knoefel
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef MESSAGE_RECORDER_H
+#define MESSAGE_RECORDER_H
+
+#include "DocumentBackend.h"
+
+#include <cstdint>
+#include <functional>
+#include <istream>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// One message of a recorded session. Pointer arguments are not stored as such,
+// the data they point to is kept in payload so the message can be sent again.
+struct RecordedMessage {
+    unsigned int message = 0; // 0 marks a document snapshot held in payload
+    uptr_t wParam = 0;
+    sptr_t lParam = 0;
+    sptr_t result = 0;
+    int64_t nanoseconds = 0;
+    std::string payload;
+};
+
+struct RecordedSession {
+    std::vector<RecordedMessage> messages;
+    bool truncated = false; // The byte limit stopped the recording
+};
+
+struct MessageStats {
+    size_t count = 0;
+    int64_t totalNanoseconds = 0;
+};
+
+struct ReplayResult {
+    size_t replayed = 0;
+    size_t skipped = 0;    // Messages whose arguments cannot be rebuilt
+    size_t mismatches = 0; // Results that differ from the recording
+    int64_t nanoseconds = 0;
+    std::map<unsigned int, MessageStats> histogram;
+};
+
+// Records the Scintilla messages the plugin sends, with arguments, results and
+// timing, and keeps a histogram per message ID. Nothing is recorded unless started.
+// Recording stops by itself once the messages and snapshots hold about byteLimit bytes.
+class MessageRecorder
+{
+public:
+    static constexpr size_t DEFAULT_BYTE_LIMIT = 128 * 1024 * 1024;
+
+    // Called once when the byte limit stops a recording, from within the message that
+    // crossed it. Should only take note and act later.
+    std::function<void()> onLimitReached;
+
+    void setByteLimit(size_t bytes) noexcept {
+        byteLimit = bytes;
+    }
+
+    // Starts a new session with a snapshot of the current document text
+    void start(DocumentBackend& document);
+    void stop() noexcept {
+        recording = false;
+    }
+
+    bool isRecording() const noexcept {
+        return recording;
+    }
+
+    // Adds a snapshot, e.g. after the user switched to another document
+    void snapshot(DocumentBackend& document);
+
+    void record(unsigned int iMessage, uptr_t wParam, sptr_t lParam, sptr_t result, int64_t nanoseconds);
+
+    const RecordedSession& session() const noexcept {
+        return recordedSession;
+    }
+
+    const std::map<unsigned int, MessageStats>& histogram() const noexcept {
+        return messageHistogram;
+    }
+
+    // Table sorted by total time, at most maxRows messages
+    std::string histogramReport(size_t maxRows = 25) const {
+        return formatHistogram(messageHistogram, maxRows);
+    }
+
+    static std::string formatHistogram(const std::map<unsigned int, MessageStats>& histogram, size_t maxRows);
+
+    bool save(std::ostream& out) const;
+    static bool load(std::istream& in, RecordedSession& session);
+
+    // Sends a recorded session to another document, typically a GapBufferDocument
+    static ReplayResult replay(const RecordedSession& session, DocumentBackend& document);
+
+    static const char* messageName(unsigned int iMessage);
+
+    // Estimated bytes held by the recorded messages and their payloads
+    size_t memoryBytes() const;
+
+private:
+    // False and recording stopped if bytes more would cross the limit
+    bool reserve(size_t bytes);
+
+    bool recording = false;
+    size_t byteLimit = DEFAULT_BYTE_LIMIT;
+    size_t recordedBytes = 0;
+    RecordedSession recordedSession;
+    std::map<unsigned int, MessageStats> messageHistogram;
+};
+
+// Backend decorator that passes every message to the recorder while it records.
+// When not recording the overhead is one branch per message.
+class RecordingBackend : public DocumentBackend
+{
+public:
+    RecordingBackend(DocumentBackend& target, MessageRecorder& recorder) : target(target), recorder(recorder) {}
+
+    sptr_t send(unsigned int iMessage, uptr_t wParam = 0, sptr_t lParam = 0) override;
+
+    void setRedraw(bool enable) override {
+        target.setRedraw(enable);
+    }
+
+private:
+    DocumentBackend& target;
+    MessageRecorder& recorder;
+};
+
+#endif // MESSAGE_RECORDER_H
@@ -0,0 +1,2662 @@
+// This file is part of Notepad++ project
+// Copyright (C)2023 Thomas Knoefel
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "MultiReplaceEngine.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#pragma region Replace
+
+bool MultiReplaceEngine::replaceOne(const ReplaceRule& rule, const SelectionInfo& selection, SearchResult& searchResult, Sci_Position& newPos)
+{
+    std::string findTextUtf8 = convertAndExtend(rule.findText, rule.extended);
+    int searchFlags = searchFlagsOf(rule.wholeWord, rule.matchCase, rule.regex, rule.fuzzyEdits);
+    searchResult = performSearchForward(findTextUtf8, searchFlags, true, selection.startPos);
+
+    if (searchResult.pos == selection.startPos && searchResult.length == selection.length) {
+        bool skipReplace = false;
+        std::string replaceTextUtf8 = convertAndExtend(rule.replaceText, rule.extended);
+        std::string localReplaceTextUtf8 = rule.replaceText;
+        if (rule.useVariables) {
+            LuaVariables vars;
+
+            const Sci_Position currentLineIndex = send(SCI_LINEFROMPOSITION, static_cast<uptr_t>(searchResult.pos), 0);
+            const Sci_Position previousLineStartPosition = (currentLineIndex == 0) ? 0 : send(SCI_POSITIONFROMLINE, static_cast<uptr_t>(currentLineIndex), 0);
+
+            if (options.scope == SearchScope::Column) {
+                const CellLocation cell = locateCell(searchResult.pos);
+                vars.COL = static_cast<Sci_Position>(cell.column);
+            }
+            vars.CNT = 1;
+            vars.LCNT = 1;
+            vars.APOS = searchResult.pos + 1;
+            vars.LINE = currentLineIndex + 1;
+            vars.LPOS = searchResult.pos - previousLineStartPosition + 1;
+            vars.MATCH = getMatchText(searchResult);
+
+            if (!resolveLuaSyntax(localReplaceTextUtf8, vars, skipReplace, rule.regex)) {
+                return false;  // Exit the function if error in syntax
+            }
+            ProfileScope convertScope(profiler, "convert");
+            replaceTextUtf8 = convertAndExtend(localReplaceTextUtf8, rule.extended);
+        }
+
+        if (!skipReplace) {
+            if (rule.regex) {
+                newPos = performRegexReplace(replaceTextUtf8, searchResult.pos, searchResult.length);
+                // Set the cursor to the end of the replaced text
+                send(SCI_SETEMPTYSELECTION, newPos, 0);
+            }
+            else {
+                newPos = performReplace(replaceTextUtf8, searchResult.pos, searchResult.length);
+            }
+            return true;  // A replacement was made
+        }
+        else {
+            newPos = searchResult.pos + searchResult.length;
+            // Clear selection
+            send(SCI_SETEMPTYSELECTION, newPos, 0);
+        }
+    }
+    return false;  // No replacement was made
+}
+
+void MultiReplaceEngine::replaceAll(const ReplaceRule& rule, int& findCount, int& replaceCount, BulkEditTransaction& transaction)
+{
+    ProfileScope profileScope(profiler, "replaceAll");
+
+    if (rule.findText.empty()) {
+        findCount = 0;
+        replaceCount = 0;
+        return;
+    }
+
+    bool isReplaceFirstEnabled = options.replaceFirst;
+    // Moving the caret would collapse the selection the search is scoped to
+    bool isSelectionScope = (options.scope == SearchScope::Selection);
+    int searchFlags = searchFlagsOf(rule.wholeWord, rule.matchCase, rule.regex, rule.fuzzyEdits);
+
+    std::string findTextUtf8;
+    std::string replaceTextUtf8;
+    {
+        ProfileScope convertScope(profiler, "convert");
+        findTextUtf8 = convertAndExtend(rule.findText, rule.extended);
+        replaceTextUtf8 = convertAndExtend(rule.replaceText, rule.extended);
+    }
+
+    // A warm match set shows without searching that there is nothing to replace
+    if (searchesWholeDocument(false)) {
+        const std::vector<MatchInterval>* cached = cachedMatches(findTextUtf8, searchFlags);
+        if (cached && cached->empty()) {
+            return;
+        }
+    }
+
+    Sci_Position previousLineIndex = -1;
+    Sci_Position lineFindCount = 0;
+
+    // Edits of a regex rule the watchdog may stop, undone if it does
+    struct AppliedEdit {
+        Sci_Position pos;
+        Sci_Position end;
+        std::string original;
+    };
+    const bool watched = rule.regex && regexWatchdog.isEnabled();
+    std::vector<AppliedEdit> applied;
+
+    SelectionScope::Snapshot selectionSnapshot(selectionScope, doc, isSelectionScope);
+    SearchResult searchResult = performSearchForward(findTextUtf8, searchFlags, false, 0);
+
+    while (searchResult.pos >= 0)
+    {
+        bool skipReplace = false;
+        findCount++;
+        std::string localReplaceTextUtf8 = rule.replaceText;
+        if (rule.useVariables) {
+            LuaVariables vars;
+
+            if (options.scope == SearchScope::Column) {
+                const CellLocation cell = locateCell(searchResult.pos);
+                vars.COL = static_cast<Sci_Position>(cell.column);
+            }
+
+            const Sci_Position currentLineIndex = send(SCI_LINEFROMPOSITION, static_cast<uptr_t>(searchResult.pos), 0);
+            const Sci_Position previousLineStartPosition = (currentLineIndex == 0) ? 0 : send(SCI_POSITIONFROMLINE, static_cast<uptr_t>(currentLineIndex), 0);
+
+            // Reset lineReplaceCount if the line has changed
+            if (currentLineIndex != previousLineIndex) {
+                lineFindCount = 0;
+                previousLineIndex = currentLineIndex;
+            }
+
+            lineFindCount++;
+
+            vars.CNT = findCount;
+            vars.LCNT = lineFindCount;
+            vars.APOS = searchResult.pos + 1;
+            vars.LINE = currentLineIndex + 1;
+            vars.LPOS = searchResult.pos - previousLineStartPosition + 1;
+            vars.MATCH = getMatchText(searchResult);
+
+            if (!resolveLuaSyntax(localReplaceTextUtf8, vars, skipReplace, rule.regex)) {
+                break;  // Exit the loop if error in syntax
+            }
+            ProfileScope convertScope(profiler, "convert");
+            replaceTextUtf8 = convertAndExtend(localReplaceTextUtf8, rule.extended);
+        }
+
+        Sci_Position newPos;
+        bool moveCaret = true;
+        if (!skipReplace) {
+            std::string original = watched ? getMatchText(searchResult) : std::string();
+            if (rule.regex) {
+                newPos = performRegexReplace(replaceTextUtf8, searchResult.pos, searchResult.length);
+            }
+            else {
+                newPos = performReplace(replaceTextUtf8, searchResult.pos, searchResult.length);
+                moveCaret = false;
+            }
+            replaceCount++;
+            if (isSelectionScope) {
+                selectionScope.applyReplacement(searchResult.pos, searchResult.length, newPos - searchResult.pos);
+            }
+            if (watched) {
+                applied.push_back({ searchResult.pos, newPos, std::move(original) });
+            }
+        }
+        else {
+            newPos = searchResult.pos + searchResult.length;
+        }
+
+        // Caret and selection are only updated once the transaction ends
+        if (moveCaret && !isSelectionScope) {
+            transaction.setCaret(newPos);
+        }
+
+        if (isReplaceFirstEnabled) {
+            break;  // Exit the loop after the first successful replacement
+        }
+
+        searchResult = performSearchForward(findTextUtf8, searchFlags, false, newPos);
+    }
+
+    // A rule stopped part way would leave the document half replaced, its edits are undone
+    // inside the same undo action
+    if (watched && regexWatchdog.isStopped(findTextUtf8, searchFlags)) {
+        for (auto edit = applied.rbegin(); edit != applied.rend(); ++edit) {
+            send(SCI_SETTARGETRANGE, edit->pos, edit->end);
+            send(SCI_REPLACETARGET, edit->original.size(), reinterpret_cast<sptr_t>(edit->original.data()));
+            if (isSelectionScope) {
+                selectionScope.applyReplacement(edit->pos, edit->end - edit->pos, static_cast<Sci_Position>(edit->original.size()));
+            }
+        }
+        if (!applied.empty() && !isSelectionScope) {
+            transaction.setCaret(applied.front().pos);
+        }
+        findCount = 0;
+        replaceCount = 0;
+    }
+}
+
+// Replace All of the list entries in order. Runs of literal entries that give the same result
+// in one pass are replaced together, the others one by one.
+void MultiReplaceEngine::replaceAllList(const std::vector<ReplaceRule>& rules, std::vector<RuleCount>& counts, BulkEditTransaction& transaction)
+{
+    counts.assign(rules.size(), RuleCount());
+    const bool fusable = options.scope == SearchScope::AllText && !options.replaceFirst && !options.foldCharacters;
+    int asciiDocument = -1; // Checked for the first rule that needs it, until a replacement may change it
+
+    size_t i = 0;
+    while (i < rules.size()) {
+        if (!rules[i].isEnabled) {
+            ++i;
+            continue;
+        }
+
+        FusedReplace fused;
+        std::vector<size_t> ruleIndexes;
+        std::vector<std::string> replaceTexts;
+        if (fusable) {
+            LiteralSearch::CharacterClasses classes{};
+            LiteralSearch::loadCharacterClasses(doc, classes);
+            const bool utf8 = send(SCI_GETCODEPAGE, 0, 0) == SC_CP_UTF8;
+            for (size_t j = i; j < rules.size(); ++j) {
+                if (!rules[j].isEnabled) {
+                    continue;
+                }
+                FusedRule rule;
+                bool foldsLetters = false;
+                if (!toFusedRule(rules[j], rule, foldsLetters)) {
+                    break;
+                }
+                // Without case matching Scintilla also folds some non-ASCII characters to
+                // ASCII letters, e.g. the Kelvin sign
+                if (foldsLetters && asciiDocument < 0) {
+                    const char* text = reinterpret_cast<const char*>(send(SCI_GETCHARACTERPOINTER, 0, 0));
+                    asciiDocument = (text && !LiteralMatcher::hasNonAscii(text, text + send(SCI_GETLENGTH, 0, 0))) ? 1 : 0;
+                }
+                if ((foldsLetters && asciiDocument == 0) || !fused.tryAdd(rule, classes, utf8)) {
+                    break;
+                }
+                ruleIndexes.push_back(j);
+                replaceTexts.push_back(convertAndExtend(rules[j].replaceText, rules[j].extended));
+            }
+        }
+
+        const size_t next = (ruleIndexes.size() < 2) ? i + 1 : ruleIndexes.back() + 1;
+        if (ruleIndexes.size() < 2) {
+            replaceAll(rules[i], counts[i].findCount, counts[i].replaceCount, transaction);
+        }
+        else {
+            replaceFused(fused, ruleIndexes, replaceTexts, counts);
+        }
+        for (; i < next; ++i) {
+            const std::string& replaceText = rules[i].replaceText;
+            const bool plainAscii = !rules[i].regex && !rules[i].extended && !rules[i].useVariables
+                && !LiteralMatcher::hasNonAscii(replaceText.data(), replaceText.data() + replaceText.size());
+            if (counts[i].replaceCount > 0 && !plainAscii) {
+                asciiDocument = -1;
+            }
+        }
+    }
+}
+
+bool MultiReplaceEngine::toFusedRule(const ReplaceRule& rule, FusedRule& fused, bool& foldsLetters)
+{
+    if (rule.regex || rule.fuzzyEdits > 0 || rule.useVariables) {
+        return false;
+    }
+    fused.findText = convertAndExtend(rule.findText, rule.extended);
+    fused.matchCase = rule.matchCase;
+    fused.wholeWord = rule.wholeWord;
+
+    // The same rules the native search takes
+    const int searchFlags = (rule.wholeWord * SCFIND_WHOLEWORD) | (rule.matchCase * SCFIND_MATCHCASE);
+    if (!literalSearch.prepare(doc, fused.findText, searchFlags)) {
+        return false;
+    }
+
+    foldsLetters = !rule.matchCase && std::any_of(fused.findText.begin(), fused.findText.end(), [](char ch) {
+        return (ch >= 'A' && ch <= 'Z') || (ch >= 'a' && ch <= 'z');
+        });
+    fused.replaceText = utf8ToCodepage(convertAndExtend(rule.replaceText, rule.extended), static_cast<int>(send(SCI_GETCODEPAGE, 0, 0)));
+    return true;
+}
+
+void MultiReplaceEngine::replaceFused(const FusedReplace& fused, const std::vector<size_t>& ruleIndexes, const std::vector<std::string>& replaceTexts,
+    std::vector<RuleCount>& counts)
+{
+    ProfileScope profileScope(profiler, "fusedReplace");
+
+    const Sci_Position length = send(SCI_GETLENGTH, 0, 0);
+    const char* text = reinterpret_cast<const char*>(send(SCI_GETCHARACTERPOINTER, 0, 0));
+    if (!text) {
+        return;
+    }
+    LiteralSearch::CharacterClasses classes{};
+    LiteralSearch::loadCharacterClasses(doc, classes);
+    const bool utf8 = send(SCI_GETCODEPAGE, 0, 0) == SC_CP_UTF8;
+
+    // Scintilla decides word boundaries at multi-byte characters
+    auto confirmWord = [this, &fused](size_t rule, Sci_Position pos) {
+        const std::string& findText = fused.rules()[rule].findText;
+        const int searchFlags = SCFIND_WHOLEWORD | (fused.rules()[rule].matchCase ? SCFIND_MATCHCASE : 0);
+        Sci_Position matchEnd = 0;
+        return searchInTarget(findText, searchFlags, pos, pos + static_cast<Sci_Position>(findText.size()), matchEnd) == pos;
+    };
+
+    std::vector<FusedMatch> matches;
+    fused.findMatches(text, length, classes, utf8, confirmWord, matches);
+
+    // Positions move by what the replacements before them added
+    Sci_Position shift = 0;
+    for (const FusedMatch& match : matches) {
+        const Sci_Position matchLength = static_cast<Sci_Position>(fused.rules()[match.rule].findText.size());
+        const Sci_Position pos = match.start + shift;
+        const Sci_Position newPos = performReplace(replaceTexts[match.rule], pos, matchLength);
+        shift += (newPos - pos) - matchLength;
+
+        RuleCount& count = counts[ruleIndexes[match.rule]];
+        ++count.findCount;
+        ++count.replaceCount;
+    }
+}
+
+// Live replace of typed text. The rules are applied in list order and only to matches
+// that overlap one of the ranges. Around a range the search reaches as far as a match of the
+// rule can be long, for regular expressions to the ends of its lines, so the cost follows the
+// size of the edit and not of the document. Text a replacement inserts joins its range, the
+// later rules see it as they would in Replace All.
+void MultiReplaceEngine::replaceInRanges(const std::vector<ReplaceRule>& rules, std::vector<SelectionRange>& ranges, std::vector<RuleCount>& counts)
+{
+    ProfileScope profileScope(profiler, "replaceInRanges");
+
+    counts.assign(rules.size(), RuleCount());
+
+    // The trigram index would be built for the whole document. Restored however the pass ends.
+    struct TrigramsOff {
+        explicit TrigramsOff(bool& option) : indexTrigrams(option), saved(option) {
+            indexTrigrams = false;
+        }
+        ~TrigramsOff() {
+            indexTrigrams = saved;
+        }
+        bool& indexTrigrams;
+        const bool saved;
+    } trigramsOff(options.indexTrigrams);
+
+    for (size_t i = 0; i < rules.size(); ++i) {
+        const ReplaceRule& rule = rules[i];
+        // Variables count over the whole document, a part of it cannot provide them
+        if (!rule.isEnabled || rule.useVariables || rule.findText.empty()) {
+            continue;
+        }
+
+        const int searchFlags = searchFlagsOf(rule.wholeWord, rule.matchCase, rule.regex, rule.fuzzyEdits);
+        std::string findTextUtf8;
+        std::string replaceTextUtf8;
+        {
+            ProfileScope convertScope(profiler, "convert");
+            findTextUtf8 = convertAndExtend(rule.findText, rule.extended);
+            replaceTextUtf8 = convertAndExtend(rule.replaceText, rule.extended);
+        }
+        const Sci_Position reach = matchReach(rule, findTextUtf8);
+
+        // Only moves forward, text this rule inserted is not searched again
+        Sci_Position from = 0;
+        size_t r = 0;
+        while (r < ranges.size()) {
+            const SelectionRange range = ranges[r];
+            Sci_Position windowStart = 0;
+            Sci_Position windowEnd = 0;
+            if (reach < 0) {
+                windowStart = send(SCI_POSITIONFROMLINE, send(SCI_LINEFROMPOSITION, range.start, 0), 0);
+                windowEnd = send(SCI_GETLINEENDPOSITION, send(SCI_LINEFROMPOSITION, range.end, 0), 0);
+            }
+            else {
+                windowStart = std::max<Sci_Position>(0, range.start - reach);
+                windowEnd = std::min<Sci_Position>(send(SCI_GETLENGTH, 0, 0), range.end + reach);
+            }
+            from = std::max(from, windowStart);
+
+            const SearchResult match = (from <= windowEnd) ? performSingleSearch(findTextUtf8, searchFlags, false, { from, windowEnd }) : SearchResult();
+            if (match.pos < 0 || match.pos >= range.end) {
+                ++r;
+                continue;
+            }
+
+            const Sci_Position matchEnd = match.pos + match.length;
+            const bool overlaps = (match.length > 0) ? matchEnd > range.start : match.pos >= range.start;
+            if (!overlaps) {
+                // A later match may still reach into the range
+                from = send(SCI_POSITIONAFTER, match.pos, 0);
+                continue;
+            }
+
+            const Sci_Position newPos = rule.regex ? performRegexReplace(replaceTextUtf8, match.pos, match.length)
+                : performReplace(replaceTextUtf8, match.pos, match.length);
+            counts[i].findCount++;
+            counts[i].replaceCount++;
+            followReplacement(ranges, match.pos, match.length, newPos);
+
+            from = newPos;
+            if (match.length == 0 && newPos == match.pos) {
+                const Sci_Position next = send(SCI_POSITIONAFTER, newPos, 0);
+                if (next <= newPos) {
+                    break; // Empty match at the end of the document
+                }
+                from = next;
+            }
+            r = static_cast<size_t>(std::partition_point(ranges.begin(), ranges.end(), [newPos](const SelectionRange& followed) {
+                return followed.end < newPos;
+                }) - ranges.begin());
+        }
+    }
+}
+
+// Longest text a match of the rule can span, -1 if the regular expression decides
+Sci_Position MultiReplaceEngine::matchReach(const ReplaceRule& rule, const std::string& findTextUtf8) const
+{
+    if (rule.regex) {
+        return -1;
+    }
+    // An edit of Fuzzy mode inserts at most one character of up to 4 bytes
+    Sci_Position reach = static_cast<Sci_Position>(findTextUtf8.size()) + 4 * rule.fuzzyEdits;
+    // Each folded character stands for up to 4 bytes of the document
+    if (options.foldCharacters) {
+        reach *= 4;
+    }
+    return reach;
+}
+
+// The length bytes at pos were replaced by text ending at newEnd. Ranges touching the replaced
+// text are joined with it, later ones move by the change in length. Ranges are sorted and
+// disjoint.
+void MultiReplaceEngine::followReplacement(std::vector<SelectionRange>& ranges, Sci_Position pos, Sci_Position length, Sci_Position newEnd)
+{
+    const Sci_Position end = pos + length;
+    const Sci_Position delta = newEnd - end;
+
+    std::vector<SelectionRange> followed;
+    followed.reserve(ranges.size() + 1);
+    size_t i = 0;
+    for (; i < ranges.size() && ranges[i].end < pos; ++i) {
+        followed.push_back(ranges[i]);
+    }
+    SelectionRange joined{ pos, newEnd };
+    for (; i < ranges.size() && ranges[i].start <= end; ++i) {
+        joined.start = std::min(joined.start, ranges[i].start);
+        joined.end = std::max(joined.end, ranges[i].end + delta);
+    }
+    followed.push_back(joined);
+    for (; i < ranges.size(); ++i) {
+        followed.push_back({ ranges[i].start + delta, ranges[i].end + delta });
+    }
+    ranges.swap(followed);
+}
+
+Sci_Position MultiReplaceEngine::performReplace(const std::string& replaceTextUtf8, Sci_Position pos, Sci_Position length)
+{
+    ProfileScope profileScope(profiler, "apply");
+
+    // Set the target range for the replacement
+    send(SCI_SETTARGETRANGE, pos, pos + length);
+
+    // Get the codepage of the document
+    int cp = static_cast<int>(send(SCI_GETCODEPAGE, 0, 0));
+
+    // Convert the string from UTF-8 to the codepage of the document
+    std::string replaceTextCp = utf8ToCodepage(replaceTextUtf8, cp);
+
+    // Perform the replacement
+    send(SCI_REPLACETARGET, replaceTextCp.size(), reinterpret_cast<sptr_t>(replaceTextCp.c_str()));
+    
+    // Get the end position after the replacement
+    Sci_Position newTargetEnd = static_cast<Sci_Position>(send(SCI_GETTARGETEND, 0, 0));
+
+    // Set the cursor to the end of the replaced text
+    //send(SCI_SETCURRENTPOS, newTargetEnd, 0);
+
+    // Clear selection
+    //send(SCI_SETSELECTIONSTART, newTargetEnd, 0);
+    //send(SCI_SETSELECTIONEND, newTargetEnd, 0);
+
+    return newTargetEnd;
+}
+
+Sci_Position MultiReplaceEngine::performRegexReplace(const std::string& replaceTextUtf8, Sci_Position pos, Sci_Position length)
+{
+    ProfileScope profileScope(profiler, "apply");
+
+    // Set the target range for the replacement
+    send(SCI_SETTARGETRANGE, pos, pos + length);
+
+    // Get the codepage of the document
+    int cp = static_cast<int>(send(SCI_GETCODEPAGE, 0, 0));
+
+    // Convert the string from UTF-8 to the codepage of the document
+    std::string replaceTextCp = utf8ToCodepage(replaceTextUtf8, cp);
+
+    // Perform the regex replacement
+    send(SCI_REPLACETARGETRE, static_cast<uptr_t>(-1), reinterpret_cast<sptr_t>(replaceTextCp.c_str()));
+
+    // Get the end position after the replacement
+    Sci_Position newTargetEnd = static_cast<Sci_Position>(send(SCI_GETTARGETEND, 0, 0));
+
+    return newTargetEnd;
+}
+
+SelectionInfo MultiReplaceEngine::getSelectionInfo() {
+    // Get selected text
+    Sci_Position selectionStart = send(SCI_GETSELECTIONSTART, 0, 0);
+    Sci_Position selectionEnd = send(SCI_GETSELECTIONEND, 0, 0);
+    std::vector<char> buffer(selectionEnd - selectionStart + 1);
+    send(SCI_GETSELTEXT, 0, reinterpret_cast<sptr_t>(&buffer[0]));
+    std::string selectedText(&buffer[0]);
+
+    // Calculate the length of the selected text
+    Sci_Position selectionLength = selectionEnd - selectionStart;
+
+    return SelectionInfo{ selectedText, selectionStart, selectionLength };
+}
+
+void MultiReplaceEngine::captureLuaGlobals(lua_State* L) {
+    lua_pushglobaltable(L);
+    lua_pushnil(L);
+    while (lua_next(L, -2) != 0) {
+        const char* key = lua_tostring(L, -2);
+        LuaVariable luaVar;
+        luaVar.name = key;
+
+        int type = lua_type(L, -1);
+        if (type == LUA_TNUMBER) {
+            luaVar.type = LuaVariableType::Number;
+            luaVar.numberValue = lua_tonumber(L, -1);
+        }
+        else if (type == LUA_TSTRING) {
+            luaVar.type = LuaVariableType::String;
+            luaVar.stringValue = lua_tostring(L, -1);
+        }
+        else if (type == LUA_TBOOLEAN) {
+            luaVar.type = LuaVariableType::Boolean;
+            luaVar.booleanValue = lua_toboolean(L, -1);
+        }
+        else {
+            // Skipping unknown types
+            lua_pop(L, 1);
+            continue;
+        }
+
+        globalLuaVariablesMap[key] = luaVar;
+        lua_pop(L, 1);
+    }
+
+    lua_pop(L, 1);
+}
+
+void MultiReplaceEngine::loadLuaGlobals(lua_State* L) {
+    for (const auto& pair : globalLuaVariablesMap) {
+        const LuaVariable& var = pair.second;
+
+        switch (var.type) {
+        case LuaVariableType::String:
+            lua_pushstring(L, var.stringValue.c_str());
+            break;
+        case LuaVariableType::Number:
+            lua_pushnumber(L, var.numberValue);
+            break;
+        case LuaVariableType::Boolean:
+            lua_pushboolean(L, var.booleanValue);
+            break;
+        default:
+            continue;  // Skip None or unsupported types
+        }
+
+        lua_setglobal(L, var.name.c_str());
+    }
+}
+
+bool MultiReplaceEngine::resolveLuaSyntax(std::string& inputString, const LuaVariables& vars, bool& skip, bool regex)
+{
+    ProfileScope profileScope(profiler, "lua");
+
+    lua_State* L = luaL_newstate();  // Create a new Lua environment
+    luaMemory.attach(L);
+    luaL_openlibs(L);  // Load standard libraries
+
+    loadLuaGlobals(L); // Load global Lua variables
+
+    // Set variables, as 64 bit Lua integers
+    lua_pushinteger(L, static_cast<lua_Integer>(vars.CNT));
+    lua_setglobal(L, "CNT");
+    lua_pushinteger(L, static_cast<lua_Integer>(vars.LCNT));
+    lua_setglobal(L, "LCNT");
+    lua_pushinteger(L, static_cast<lua_Integer>(vars.LINE));
+    lua_setglobal(L, "LINE");
+    lua_pushinteger(L, static_cast<lua_Integer>(vars.LPOS));
+    lua_setglobal(L, "LPOS");
+    lua_pushinteger(L, static_cast<lua_Integer>(vars.APOS));
+    lua_setglobal(L, "APOS");
+    lua_pushinteger(L, static_cast<lua_Integer>(vars.COL));
+    lua_setglobal(L, "COL");
+    lua_pushboolean(L, regex);
+    lua_setglobal(L, "REGEX");
+
+    setLuaVariable(L, "MATCH", vars.MATCH, regex);
+    // Get CAPs from Scintilla using SCI_GETTAG
+    std::vector<std::string> caps;  // Initialize an empty vector to store the captures
+
+    if (regex) {
+        sptr_t len = 0;
+        for (int i = 1; ; ++i) {
+            char buffer[1024] = { 0 };  // Buffer to hold the capture value
+            len = send(SCI_GETTAG, i, reinterpret_cast<sptr_t>(buffer));
+
+            if (len <= 0) {
+                // If len is zero or negative, break the loop
+                break;
+            }
+
+            if (len < static_cast<sptr_t>(sizeof(buffer))) {
+                // If the first character is 0x00, break the loop
+                if (buffer[0] == 0x00) {
+                    break;
+                }
+                buffer[len] = '\0';  // Null-terminate the string
+                std::string cap(buffer);  // Convert to std::string
+                caps.push_back(cap);  // Add the capture to the vector
+            }
+            else {
+                // Buffer overflow detected: This should be rare, but it's good to check
+                lua_close(L);
+                return false;
+            }
+        }
+    }
+
+    // Process the captures and set them as global variables
+    for (size_t i = 0; i < caps.size(); ++i) {
+        std::string cap = caps[i];
+        std::string globalVarName = "CAP" + std::to_string(i + 1);
+        setLuaVariable(L, globalVarName, cap, regex);
+    }
+
+    // Declare cond statement function
+    luaL_dostring(L,
+        "function cond(cond, trueVal, falseVal)\n"
+        "  local res = {result = '', skip = false}  -- Initialize result table with defaults\n"
+        "  if cond == nil then  -- Check if cond is nil\n"
+        "    error('cond cannot be nil')\n"
+        "    return res\n"
+        "  end\n"
+
+        "  if trueVal == nil then  -- Check if trueVal is nil\n"
+        "    error('trueVal cannot be nil')\n"
+        "    return res\n"
+        "  end\n"
+
+        "  if falseVal == nil then  -- Check if falseVal is missing\n"
+        "    res.skip = true  -- Set skip to true ONLY IF falseVal is not provided\n"
+        "  end\n"
+
+        "  if type(trueVal) == 'function' then\n"
+        "    trueVal = trueVal()\n"
+        "  end\n"
+
+        "  if type(falseVal) == 'function' then\n"
+        "    falseVal = falseVal()\n"
+        "  end\n"
+
+        "  if cond then\n"
+        "    if type(trueVal) == 'table' then\n"
+        "      res.result = trueVal.result\n"
+        "      res.skip = trueVal.skip\n"
+        "    else\n"
+        "      res.result = trueVal\n"
+        "      res.skip = false\n"
+        "    end\n"
+        "  else\n"
+        "    if not res.skip then\n"
+        "      if type(falseVal) == 'table' then\n"
+        "        res.result = falseVal.result\n"
+        "        res.skip = falseVal.skip\n"
+        "      else\n"
+        "        res.result = falseVal\n"
+        "      end\n"
+        "    end\n"
+        "  end\n"
+        "  resultTable = res\n"
+        "  return res  -- Return the table containing result and skip\n"
+        "end\n");
+
+
+    // Declare the set function
+    luaL_dostring(L,
+        "function set(strOrCalc)\n"
+        "  local res = {result = '', skip = false}  -- Initialize result table with defaults\n"
+        "  if strOrCalc == nil then\n"
+        "    error('cannot be nil')\n"
+        "    return\n"
+        "  end\n"
+        "  if type(strOrCalc) == 'string' then\n"
+        "    res.result = strOrCalc  -- Setting res.result\n"
+        "  elseif type(strOrCalc) == 'number' then\n"
+        "    res.result = tostring(strOrCalc)  -- Convert number to string and set to res.result\n"
+        "  else\n"
+        "    error('Expected string or number')\n"
+        "    return\n"
+        "  end\n"
+        "  resultTable = res\n"
+        "  return res  -- Return the table containing result and skip\n"
+        "end\n");
+
+    // Declare formatNumber function
+    luaL_dostring(L,
+        "function fmtN(num, maxDecimals, fixedDecimals)\n"
+        "  if num == nil then\n"
+        "    error('num cannot be nil')\n"
+        "    return\n"
+        "  elseif type(num) ~= 'number' then\n"
+        "    error('Invalid type for num. Expected a number')\n"
+        "    return\n"
+        "  end\n"
+        "  if maxDecimals == nil then\n"
+        "    error('maxDecimals cannot be nil')\n"
+        "    return\n"
+        "  elseif type(maxDecimals) ~= 'number' then\n"
+        "    error('Invalid type for maxDecimals. Expected a number')\n"
+        "    return\n"
+        "  end\n"
+        "  if fixedDecimals == nil then\n"
+        "    error('fixedDecimals cannot be nil')\n"
+        "    return\n"
+        "  elseif type(fixedDecimals) ~= 'boolean' then\n"
+        "    error('Invalid type for fixedDecimals. Expected a boolean')\n"
+        "    return\n"
+        "  end\n"
+        "  local multiplier = 10 ^ maxDecimals\n"
+        "  local rounded = math.floor(num * multiplier + 0.5) / multiplier\n"
+        "  local output = ''\n"
+        "  if fixedDecimals then\n"
+        "    output = string.format('%.' .. maxDecimals .. 'f', rounded)\n"
+        "  else\n"
+        "    local intPart, fracPart = math.modf(rounded)\n"
+        "    if fracPart == 0 then\n"
+        "      output = tostring(intPart)\n"
+        "    else\n"
+        "      output = tostring(rounded)\n"
+        "    end\n"
+        "  end\n"
+        "  return output\n"
+        "end");
+
+    // Declare the init function
+    luaL_dostring(L,
+        "function init(args)\n"
+        "  for name, value in pairs(args) do\n"
+        "    if _G[name] == nil then\n"
+        "      if type(name) ~= 'string' then\n"
+        "        error('Variable name must be a string')\n"
+        "      end\n"
+        "      if not string.match(name, '^[A-Za-z_][A-Za-z0-9_]*$') then\n"
+        "        error('Invalid variable name')\n"
+        "      end\n"
+        "      if value == nil then\n"
+        "        error('Value missing in Init')\n"
+        "      end\n"
+        "      -- Check if the value is a string and REGEX is true, then preprocess backslashes\n"
+        "      if type(value) == 'string' and REGEX then\n"
+        "        value = value:gsub('\\\\', '\\\\\\\\')\n"
+        "      end\n"
+        "      _G[name] = value\n"
+        "    end\n"
+        "  end\n"
+        "end\n");
+
+    // Show syntax error
+    if (luaL_dostring(L, inputString.c_str()) != LUA_OK) {
+        const char* cstr = lua_tostring(L, -1);
+        lua_pop(L, 1);
+        if (luaErrorHandler) {
+            luaErrorHandler(LuaErrorType::Syntax, cstr ? cstr : "");
+        }
+        lua_close(L);
+        return false;
+    }
+
+    // Retrieve the result from the table
+    lua_getglobal(L, "resultTable");
+    if (lua_istable(L, -1)) {
+        lua_getfield(L, -1, "result");
+        if (lua_isstring(L, -1) || lua_isnumber(L, -1)) {
+            inputString = lua_tostring(L, -1);  // Update inputString with the result
+        }
+        lua_pop(L, 1);  // Pop the 'result' field from the stack
+
+        // Retrieve the skip flag from the table
+        lua_getfield(L, -1, "skip");
+        if (lua_isboolean(L, -1)) {
+            skip = lua_toboolean(L, -1);
+        }
+        else {
+            skip = false;
+        }
+        lua_pop(L, 1);  // Pop the 'skip' field from the stack
+    }
+    else {
+        // Show Runtime error
+        if (luaErrorHandler) {
+            luaErrorHandler(LuaErrorType::Execution, inputString);
+        }
+        lua_close(L);
+        return false;
+    }
+    lua_pop(L, 1);  // Pop the 'result' table from the stack
+
+    // Read Lua global Variables
+    captureLuaGlobals(L);
+    std::string luaVariablesStr;
+    for (const auto& pair : globalLuaVariablesMap) {
+        const LuaVariable& var = pair.second;
+        luaVariablesStr += var.name + ": ";
+
+        switch (var.type) {
+        case LuaVariableType::String:
+            luaVariablesStr += "String, " + var.stringValue;
+            break;
+        case LuaVariableType::Number:
+            luaVariablesStr += "Number, " + std::to_string(var.numberValue);
+            break;
+        case LuaVariableType::Boolean:
+            luaVariablesStr += "Boolean, " + std::string(var.booleanValue ? "true" : "false");
+            break;
+        default:
+            luaVariablesStr += "None or Unsupported Type";
+            break;
+        }
+        luaVariablesStr += "\n";
+    }
+
+    //MessageBoxA(NULL, luaVariablesStr.c_str(), "Lua Variables", MB_OK);
+
+
+    lua_close(L);
+
+    return true;
+
+}
+
+void MultiReplaceEngine::setLuaVariable(lua_State* L, const std::string& varName, std::string value, bool regex) {
+    // Check if the input string is a number
+    bool isNumber = normalizeAndValidateNumber(value);
+    if (isNumber) {
+        double doubleVal = std::stod(value);
+        // Integral values in the range of a 64 bit Lua integer, checked before converting
+        if (std::floor(doubleVal) == doubleVal && std::fabs(doubleVal) < 9.2e18) {
+            lua_pushinteger(L, static_cast<lua_Integer>(doubleVal)); // Push as integer if value is integral
+        }
+        else {
+            lua_pushnumber(L, doubleVal); // Push as floating-point number otherwise
+        }
+    }
+    else {
+        std::string processedValue = value;
+        if (regex) {
+            // Set of characters that need to be escaped in a regex pattern
+            const std::unordered_set<char> regexSpecialChars = {
+                '\\', '^', '$', '.', '|', '?', '*', '+', '(', ')', '[', ']', '{', '}' };
+
+            processedValue.clear();
+            for (char c : value) {
+                if (regexSpecialChars.find(c) != regexSpecialChars.end()) {
+                    processedValue.append("\\"); // Escape special characters
+                }
+                processedValue.push_back(c);
+            }
+        }
+        lua_pushlstring(L, processedValue.data(), processedValue.size()); // Push the processed string to Lua, NULs included
+    }
+    lua_setglobal(L, varName.c_str()); // Set the global variable in Lua
+}
+
+#pragma endregion
+
+
+#pragma region Find
+
+SearchResult MultiReplaceEngine::performSingleSearch(const std::string& findTextUtf8, int searchFlags, bool selectMatch, SelectionRange range) {
+    ProfileScope profileScope(profiler, "search");
+
+    Sci_Position end = 0;
+    Sci_Position pos = searchInRange(findTextUtf8, searchFlags, range.start, range.end, end);
+    if (pos < 0) {
+        return SearchResult();
+    }
+    return makeSearchResult(pos, end - pos, selectMatch);
+}
+
+// Literal rules are searched in the document buffer, in list operations only in the blocks
+// the trigram index leaves, regular expressions with a required literal only on the lines
+// that contain it and under the watchdog's time budget. Backward searches and whatever the
+// native search cannot decide go through SCI_SEARCHINTARGET. Native and Fuzzy mode matches
+// leave the target where it was.
+Sci_Position MultiReplaceEngine::searchInRange(const std::string& findTextUtf8, int searchFlags, Sci_Position start, Sci_Position end, Sci_Position& matchEnd)
+{
+    Sci_Position pos = -1;
+    if (options.foldCharacters && foldedText.find(doc, findTextUtf8, searchFlags, start, end, pos, matchEnd)) {
+        return pos;
+    }
+    if (searchFlags & SEARCH_FUZZY) {
+        matchEnd = -1;
+        return fuzzySearch.prepare(doc, findTextUtf8, searchFlags) ? fuzzySearch.find(doc, start, end, matchEnd) : -1;
+    }
+    if (searchFlags & SCFIND_REGEXP) {
+        return regexWatchdog.isEnabled() ? searchWatched(findTextUtf8, searchFlags, start, end, matchEnd)
+            : searchRegex(findTextUtf8, searchFlags, start, end, matchEnd);
+    }
+    if (nativeLiteralSearch && start <= end && literalSearch.prepare(doc, findTextUtf8, searchFlags)) {
+        if (options.useList && options.indexTrigrams) {
+            return searchIndexed(findTextUtf8, searchFlags, start, end, matchEnd);
+        }
+        if (literalSearch.find(doc, start, end, pos)) {
+            matchEnd = (pos >= 0) ? pos + literalSearch.matchLength() : -1;
+            return pos;
+        }
+    }
+    return searchInTarget(findTextUtf8, searchFlags, start, end, matchEnd);
+}
+
+Sci_Position MultiReplaceEngine::searchRegex(const std::string& findTextUtf8, int searchFlags, Sci_Position start, Sci_Position end, Sci_Position& matchEnd)
+{
+    if (prefilterRegex && start <= end && regexPrefilter.prepare(doc, findTextUtf8, searchFlags)) {
+        Sci_Position pos = -1;
+        regexPrefilter.find(doc, start, end, pos, matchEnd);
+        return pos;
+    }
+    return searchInTarget(findTextUtf8, searchFlags, start, end, matchEnd);
+}
+
+// A forward search of a pattern that cannot match a line end finds the same first match
+// slice by slice, so a pattern that backtracks on every line is stopped after the slice it
+// ran over its budget in. One search of any other pattern cannot be cut short, it is timed
+// as a whole and stops the pattern for the searches after it.
+Sci_Position MultiReplaceEngine::searchWatched(const std::string& findTextUtf8, int searchFlags, Sci_Position start, Sci_Position end, Sci_Position& matchEnd)
+{
+    matchEnd = -1;
+    if (regexWatchdog.isStopped(findTextUtf8, searchFlags)) {
+        return -1;
+    }
+
+    const bool sliced = start <= end && regexWatchdog.isSingleLine(findTextUtf8);
+    Sci_Position from = start;
+    while (true) {
+        Sci_Position to = end;
+        Sci_Position line = -1;
+        if (sliced && end - from > RegexWatchdog::SLICE_BYTES) {
+            line = send(SCI_LINEFROMPOSITION, from + RegexWatchdog::SLICE_BYTES, 0);
+            to = std::min(end, static_cast<Sci_Position>(send(SCI_GETLINEENDPOSITION, line, 0)));
+        }
+
+        const RegexWatchdog::Clock::time_point sliceStart = RegexWatchdog::Clock::now();
+        const Sci_Position pos = searchRegex(findTextUtf8, searchFlags, from, to, matchEnd);
+        // A forward search that found a match only covered the text up to it
+        const Sci_Position searched = (pos >= 0 && from <= to) ? std::max(matchEnd, pos) - from : std::abs(to - from);
+        if (regexWatchdog.charge(findTextUtf8, searchFlags, RegexWatchdog::Clock::now() - sliceStart, searched)) {
+            matchEnd = -1;
+            return -1;
+        }
+        if (pos != -1 || to >= end) {
+            return pos;
+        }
+
+        const Sci_Position next = send(SCI_POSITIONFROMLINE, line + 1, 0);
+        if (next <= from || next >= end) {
+            return -1;
+        }
+        from = next;
+    }
+}
+
+// Forward search of a prepared literal rule. With many rules most of them never occur, the
+// index built for the first one lets the others skip the document or most of it.
+Sci_Position MultiReplaceEngine::searchIndexed(const std::string& findTextUtf8, int searchFlags, Sci_Position start, Sci_Position end, Sci_Position& matchEnd)
+{
+    if (!trigramIndex.isBuiltFor(doc)) {
+        ProfileScope profileScope(profiler, "trigramIndex");
+        trigramIndex.build(doc);
+    }
+
+    Sci_Position rangeStart = 0;
+    Sci_Position rangeEnd = 0;
+    while (trigramIndex.nextCandidates(doc, findTextUtf8, start, end, rangeStart, rangeEnd)) {
+        // A match starting in the range may end behind it
+        const Sci_Position searchEnd = std::min(end, rangeEnd + literalSearch.matchLength() - 1);
+        Sci_Position pos = -1;
+        if (literalSearch.find(doc, rangeStart, searchEnd, pos)) {
+            matchEnd = (pos >= 0) ? pos + literalSearch.matchLength() : -1;
+        }
+        else {
+            pos = searchInTarget(findTextUtf8, searchFlags, rangeStart, searchEnd, matchEnd);
+        }
+        if (pos >= 0) {
+            return pos;
+        }
+        start = rangeEnd;
+    }
+    matchEnd = -1;
+    return -1;
+}
+
+Sci_Position MultiReplaceEngine::searchInTarget(const std::string& findTextUtf8, int searchFlags, Sci_Position start, Sci_Position end, Sci_Position& matchEnd)
+{
+    send(SCI_SETTARGETRANGE, start, end);
+    send(SCI_SETSEARCHFLAGS, searchFlags, 0);
+    const Sci_Position pos = send(SCI_SEARCHINTARGET, findTextUtf8.length(), reinterpret_cast<sptr_t>(findTextUtf8.c_str()));
+    matchEnd = (pos >= 0) ? send(SCI_GETTARGETEND, 0, 0) : -1;
+    return pos;
+}
+
+SearchResult MultiReplaceEngine::makeSearchResult(Sci_Position pos, Sci_Position length, bool selectMatch) {
+    SearchResult result;
+    result.pos = pos;
+    result.length = length;
+
+    // If selectMatch is true, highlight the found text
+    if (selectMatch) {
+        displayResultCentered(result.pos, result.pos + result.length, true);
+    }
+
+    return result;
+}
+
+std::string MultiReplaceEngine::getMatchText(const SearchResult& result) {
+    if (result.pos < 0 || result.length <= 0) {
+        return std::string();
+    }
+
+    // The range pointer reads the document in place; the copy by length keeps NULs
+    const char* text = reinterpret_cast<const char*>(send(SCI_GETRANGEPOINTER, result.pos, result.length));
+    if (text) {
+        return std::string(text, static_cast<size_t>(result.length));
+    }
+
+    std::string buffer(static_cast<size_t>(result.length) + 1, '\0');
+    Sci_TextRangeFull tr{ { result.pos, result.pos + result.length }, &buffer[0] };
+    send(SCI_GETTEXTRANGEFULL, 0, reinterpret_cast<sptr_t>(&tr));
+    buffer.resize(static_cast<size_t>(result.length));
+    return buffer;
+}
+
+SearchResult MultiReplaceEngine::performSearchForward(const std::string& findTextUtf8, int searchFlags, bool selectMatch, Sci_Position start)
+{
+    SearchResult result;
+    SelectionRange targetRange;
+
+    // Check if the selection scope is active and selectMatch is false
+    if (!selectMatch && options.scope == SearchScope::Selection && selectionScope.isActive()) {
+        // The operation took a snapshot, the first candidate is found by binary search
+        for (size_t i = selectionScope.firstEndingAfter(start); i < selectionScope.size(); ++i) {
+            SelectionRange selection = selectionScope.range(i);
+            targetRange = (start > selection.start) ? SelectionRange{ start, selection.end } : selection;
+            result = performSingleSearch(findTextUtf8, searchFlags, selectMatch, targetRange);
+            if (result.pos >= 0) {
+                return result;
+            }
+        }
+    }
+    else if (!selectMatch && options.scope == SearchScope::Selection) {
+        Sci_Position selectionCount = send(SCI_GETSELECTIONS, 0, 0);
+        std::vector<SelectionRange> selections(selectionCount);
+
+        for (int i = 0; i < selectionCount; i++) {
+            selections[i].start = send(SCI_GETSELECTIONNSTART, i, 0);
+            selections[i].end = send(SCI_GETSELECTIONNEND, i, 0);
+        }
+
+        // Sort selections based on their start position
+        std::sort(selections.begin(), selections.end(), [](const SelectionRange& a, const SelectionRange& b) {
+            return a.start < b.start;
+            });
+
+        // Perform search within each selection
+        for (const auto& selection : selections) {
+            if (start >= selection.start && start < selection.end) {
+                // If the start position is within the current selection
+                targetRange = { start, selection.end };
+                result = performSingleSearch(findTextUtf8, searchFlags, selectMatch, targetRange);
+            }
+            else if (start < selection.start) {
+                // If the start position is lower than the current selection
+                targetRange = selection;
+                result = performSingleSearch(findTextUtf8, searchFlags, selectMatch, targetRange);
+            }
+
+            // Check if a match was found
+            if (result.pos >= 0) {
+                return result;
+            }
+        }
+    }
+    // Check if the column scope is active, selectMatch is false, and column delimiter data is set
+    else if (options.scope == SearchScope::Column && columnDelimiterData.isValid()) {
+        result = performColumnSearchForward(findTextUtf8, searchFlags, selectMatch, start);
+    }
+    else {
+        // A warm match set answers literal searches, unless the start lies inside a cached
+        // match where the search could find an overlapping one
+        const std::vector<MatchInterval>* matches = canUseMatchCache(findTextUtf8, searchFlags, false) ? cachedMatches(findTextUtf8, searchFlags) : nullptr;
+        if (matches && !MatchCache::isInsideMatch(*matches, start)) {
+            const MatchInterval* match = MatchCache::firstAtOrAfter(*matches, start);
+            return match ? makeSearchResult(match->start, match->end - match->start, selectMatch) : result;
+        }
+
+        // If neither selection nor column scope, perform search within the whole document
+        targetRange.start = start;
+        targetRange.end = send(SCI_GETLENGTH, 0, 0);
+        result = performSingleSearch(findTextUtf8, searchFlags, selectMatch, targetRange);
+    }
+
+    return result;
+}
+
+SearchResult MultiReplaceEngine::performColumnSearchForward(const std::string& findTextUtf8, int searchFlags, bool selectMatch, Sci_Position start)
+{
+    const CellLocation startCell = locateCell(start);
+    if (startCell.column == 0) {
+        return SearchResult();
+    }
+    const size_t lastLine = lineDelimiterPositions.size() - 1;
+
+    // Lookup table instead of a set search per cell
+    std::vector<bool> selectedColumns(static_cast<size_t>(*columnDelimiterData.columns.rbegin()) + 1, false);
+    for (int column : columnDelimiterData.columns) {
+        if (column > 0) {
+            selectedColumns[column] = true;
+        }
+    }
+    auto isSelected = [&selectedColumns](size_t column) {
+        return column < selectedColumns.size() && selectedColumns[column];
+    };
+
+    ProfileScope profileScope(profiler, "search");
+
+    if (!(searchFlags & (SCFIND_REGEXP | SEARCH_FUZZY)) && !findTextUtf8.empty()) {
+        // A literal match does not depend on where the target starts, so one search runs over
+        // all remaining lines and each hit is kept only if it fits into a selected cell
+        const Sci_Position limit = lineDelimiterPositions[lastLine].endPosition;
+        Sci_Position from = start;
+        while (from < limit) {
+            Sci_Position end = 0;
+            Sci_Position pos = searchInRange(findTextUtf8, searchFlags, from, limit, end);
+            if (pos < 0) {
+                break;
+            }
+
+            const CellLocation cell = locateCell(pos);
+            const bool selected = cell.contains(pos) && isSelected(cell.column);
+            if (selected && end <= cell.end) {
+                return makeSearchResult(pos, end - pos, selectMatch);
+            }
+
+            // No hit starting in an unselected cell can count
+            from = send(SCI_POSITIONAFTER, pos, 0);
+            if (cell.contains(pos) && !selected) {
+                from = std::max(from, cell.end);
+            }
+        }
+        return SearchResult();
+    }
+
+    // Regular expressions and Fuzzy mode see the cell boundaries, search each selected cell on its own
+    size_t startColumnIndex = startCell.column;
+    for (size_t line = startCell.line; line <= lastLine; ++line) {
+        const LineInfo& lineInfo = lineDelimiterPositions[line];
+        const size_t totalColumns = lineInfo.positions.size() + 1;
+
+        for (size_t column = startColumnIndex; column <= totalColumns; ++column) {
+            if (!isSelected(column)) {
+                continue;
+            }
+            Sci_Position startColumn = (column == 1) ? lineInfo.startPosition : lineInfo.positions[column - 2].position + columnDelimiterData.delimiterLength;
+            Sci_Position endColumn = (column == totalColumns) ? lineInfo.endPosition : lineInfo.positions[column - 1].position;
+
+            if (start >= startColumn && start <= endColumn) {
+                startColumn = start;
+            }
+            if (start > startColumn) {
+                continue;
+            }
+
+            Sci_Position end = 0;
+            Sci_Position pos = searchInRange(findTextUtf8, searchFlags, startColumn, endColumn, end);
+            if (pos >= 0) {
+                return makeSearchResult(pos, end - pos, selectMatch);
+            }
+        }
+        startColumnIndex = 1;
+    }
+    return SearchResult();
+}
+
+SearchResult MultiReplaceEngine::performSearchBackward(const std::string& findTextUtf8, int searchFlags, Sci_Position start)
+{
+    SearchResult result;
+    SelectionRange targetRange;
+
+    // Check if the column scope is active, and column delimiter data is set
+    if (options.scope == SearchScope::Column && columnDelimiterData.isValid()) {
+
+        // Identify Column to Start
+        const CellLocation startCell = locateCell(start);
+        Sci_Position startLine = static_cast<Sci_Position>(startCell.line);
+        size_t startColumnIndex = startCell.column;
+
+        // Iterate over each line in reverse
+        for (Sci_Position line = startLine; line >= 0; --line) {
+            if (line < static_cast<Sci_Position>(lineDelimiterPositions.size())) {
+                const auto& linePositions = lineDelimiterPositions[line].positions;
+                size_t totalColumns = linePositions.size() + 1;
+
+                // Handle search for specific columns from columnDelimiterData
+                for (size_t column = (line == startLine ? startColumnIndex : totalColumns); column >= 1; --column) {
+
+                    // Set start and end positions based on column index
+                    Sci_Position startColumn = 0;
+                    Sci_Position endColumn = 0;
+
+                    if (column == 1) {
+                        startColumn = lineDelimiterPositions[line].startPosition;
+                    }
+                    else {
+                        startColumn = linePositions[column - 2].position + columnDelimiterData.delimiterLength;
+                    }
+
+                    if (column == linePositions.size() + 1) {
+                        endColumn = lineDelimiterPositions[line].endPosition;
+                    }
+                    else {
+                        endColumn = linePositions[column - 1].position;
+                    }
+
+                    // Check if the current column is included in the specified columns
+                    if (columnDelimiterData.columns.find(static_cast<int>(column)) == columnDelimiterData.columns.end()) {
+                        // If it's not included, skip this iteration
+                        continue;
+                    }
+
+                    // Perform search within the column range
+                    if (start >= startColumn && start <= endColumn) {
+                        endColumn = start;
+                    }
+
+                    // Perform search within the column range
+                    if (start >= endColumn) {
+                        targetRange = { endColumn, startColumn };
+                        result = performSingleSearch(findTextUtf8, searchFlags, true, targetRange);
+
+                        // Check if a match was found
+                        if (result.pos >= 0) {
+                            return result;
+                        }
+                    }
+
+                }
+            }
+        }
+    }
+    else {
+        // A warm match set answers the search for the closest match ending before start
+        const std::vector<MatchInterval>* matches = canUseMatchCache(findTextUtf8, searchFlags, true) ? cachedMatches(findTextUtf8, searchFlags) : nullptr;
+        if (matches) {
+            const MatchInterval* match = MatchCache::lastEndingBefore(*matches, start);
+            return match ? makeSearchResult(match->start, match->end - match->start, true) : result;
+        }
+
+        // Setting up the range to search backward from 'start' to the beginning
+        SelectionRange searchRange;
+        searchRange.start = start;
+        searchRange.end = 0;
+        result = performSingleSearch(findTextUtf8, searchFlags, true, searchRange);
+    }
+
+    return result;
+}
+
+SearchResult MultiReplaceEngine::performListSearchBackward(const std::vector<ReplaceRule>& list, Sci_Position cursorPos, size_t& closestMatchIndex) {
+    SearchResult closestMatch;
+    closestMatch.pos = -1;
+    closestMatch.length = 0;
+
+    closestMatchIndex = std::numeric_limits<size_t>::max(); // Initialize with a value that represents "no index".
+
+    for (size_t i = 0; i < list.size(); ++i) {
+        if (list[i].isEnabled) {
+            int searchFlags = searchFlagsOf(list[i].wholeWord, list[i].matchCase, list[i].regex, list[i].fuzzyEdits);
+            std::string findTextUtf8 = convertAndExtend(list[i].findText, list[i].extended);
+
+            // Each press would search the document once per rule, the match set makes it a lookup
+            if (searchesWholeDocument(true) && canUseMatchCache(findTextUtf8, searchFlags, true)) {
+                collectMatches(findTextUtf8, searchFlags);
+            }
+            SearchResult result = performSearchBackward(findTextUtf8, searchFlags, cursorPos);
+
+            // If a match was found and it's closer to the cursor than the current closest match, update the closest match
+            if (result.pos >= 0 && (closestMatch.pos < 0 || (result.pos + result.length) >(closestMatch.pos + closestMatch.length))) {
+                closestMatch = result;
+                closestMatchIndex = i; // Update the index of the closest match
+            }
+        }
+    }
+
+    if (closestMatch.pos >= 0) { // Check if a match was found
+        displayResultCentered(closestMatch.pos, closestMatch.pos + closestMatch.length, false);
+    }
+
+    return closestMatch;
+}
+
+SearchResult MultiReplaceEngine::performListSearchForward(const std::vector<ReplaceRule>& list, Sci_Position cursorPos, size_t& closestMatchIndex) {
+    SearchResult closestMatch;
+    closestMatch.pos = -1;
+    closestMatch.length = 0;
+
+    closestMatchIndex = std::numeric_limits<size_t>::max(); // Initialisiert mit einem Wert, der "keinen Index" darstellt.
+
+    std::vector<RuleSearch> searches(list.size());
+    for (size_t i = 0; i < list.size(); i++) {
+        if (list[i].isEnabled) {
+            searches[i].searchFlags = searchFlagsOf(list[i].wholeWord, list[i].matchCase, list[i].regex, list[i].fuzzyEdits);
+            searches[i].findTextUtf8 = convertAndExtend(list[i].findText, list[i].extended);
+        }
+    }
+    const bool wholeDocument = searchesWholeDocument(false);
+    if (wholeDocument) {
+        scanRegexRules(searches);
+    }
+
+    for (size_t i = 0; i < list.size(); i++) {
+        if (list[i].isEnabled) {
+            const int searchFlags = searches[i].searchFlags;
+            const std::string& findTextUtf8 = searches[i].findTextUtf8;
+
+            // Each press would search the document once per rule, the match set makes it a lookup
+            if (wholeDocument && canUseMatchCache(findTextUtf8, searchFlags, false)) {
+                collectMatches(findTextUtf8, searchFlags);
+            }
+
+            // A regex search from the cursor finds the first match of the forward scan after
+            // it, unless the cursor is inside a match the scan made
+            const std::vector<MatchInterval>* scanned = wholeDocument ? scannedMatches(findTextUtf8, searchFlags) : nullptr;
+            SearchResult result;
+            if (scanned && !MatchCache::isInsideMatch(*scanned, cursorPos)) {
+                if (const MatchInterval* match = MatchCache::firstAtOrAfter(*scanned, cursorPos)) {
+                    result = makeSearchResult(match->start, match->end - match->start, false);
+                }
+            }
+            else {
+                result = performSearchForward(findTextUtf8, searchFlags, false, cursorPos);
+            }
+
+            // Wenn ein Treffer gefunden wurde, der näher am Cursor liegt als der aktuelle nächste Treffer, aktualisiere den nächstgelegenen Treffer
+            if (result.pos >= 0 && (closestMatch.pos < 0 || result.pos < closestMatch.pos)) {
+                closestMatch = result;
+                closestMatchIndex = i; // Aktualisiere den Index des nächstgelegenen Treffers
+            }
+        }
+    }
+
+    if (closestMatch.pos >= 0) { // Überprüfe, ob ein Treffer gefunden wurde
+        displayResultCentered(closestMatch.pos, closestMatch.pos + closestMatch.length, true);
+    }
+
+    return closestMatch;
+}
+
+void MultiReplaceEngine::displayResultCentered(size_t posStart, size_t posEnd, bool isDownwards)
+{
+    // Make sure target lines are unfolded
+    send(SCI_ENSUREVISIBLE, send(SCI_LINEFROMPOSITION, posStart, 0), 0);
+    send(SCI_ENSUREVISIBLE, send(SCI_LINEFROMPOSITION, posEnd, 0), 0);
+
+    // Jump-scroll to center, if current position is out of view
+    send(SCI_SETVISIBLEPOLICY, CARET_JUMPS | CARET_EVEN, 0);
+    send(SCI_ENSUREVISIBLEENFORCEPOLICY, send(SCI_LINEFROMPOSITION, isDownwards ? posEnd : posStart, 0), 0);
+
+    // When searching up, the beginning of the (possible multiline) result is important, when scrolling down the end
+    send(SCI_GOTOPOS, isDownwards ? posEnd : posStart, 0);
+    send(SCI_SETVISIBLEPOLICY, CARET_EVEN, 0);
+    send(SCI_ENSUREVISIBLEENFORCEPOLICY, send(SCI_LINEFROMPOSITION, isDownwards ? posEnd : posStart, 0), 0);
+
+    // Adjust so that we see the entire match; primarily horizontally
+    send(SCI_SCROLLRANGE, posStart, posEnd);
+
+    // Move cursor to end of result and select result
+    send(SCI_GOTOPOS, posEnd, 0);
+    send(SCI_SETANCHOR, posStart, 0);
+
+    // Update Scintilla's knowledge about what column the caret is in, so that if user
+    // does up/down arrow as first navigation after the search result is selected,
+    // the caret doesn't jump to an unexpected column
+    send(SCI_CHOOSECARETX, 0, 0);
+
+}
+
+// Finds all matches in the whole document the way Mark and Replace All scan it and keeps
+// them for the current document version. Returns nullptr if there are too many to keep.
+const std::vector<MatchInterval>* MultiReplaceEngine::collectMatches(const std::string& findTextUtf8, int searchFlags)
+{
+    if (findTextUtf8.empty()) {
+        return nullptr;
+    }
+
+    const Sci_Position length = send(SCI_GETLENGTH, 0, 0);
+    const int cacheFlags = matchCacheFlags(searchFlags);
+    if (const std::vector<MatchInterval>* cached = matchCache.lookup(findTextUtf8, cacheFlags, documentVersion, length)) {
+        return cached;
+    }
+    if (matchCache.isOversized(findTextUtf8, cacheFlags, documentVersion, length)) {
+        return nullptr;
+    }
+
+    // Taken over from the last scan of the list's regex rules
+    if (unionVersion == documentVersion && unionLength == length && isUnionCandidate(searchFlags)) {
+        const std::pair<std::string, int> key(findTextUtf8, searchFlags);
+        auto it = unionMatches.find(key);
+        if (it != unionMatches.end()) {
+            std::vector<MatchInterval> matches = std::move(it->second);
+            unionMatches.erase(it);
+            return matchCache.store(findTextUtf8, cacheFlags, documentVersion, length, &matches);
+        }
+        if (unionOversized.count(key) > 0) {
+            return matchCache.store(findTextUtf8, cacheFlags, documentVersion, length, nullptr);
+        }
+    }
+
+    ProfileScope profileScope(profiler, "collectMatches");
+
+    std::vector<MatchInterval> matches;
+    Sci_Position start = 0;
+    while (start <= length) {
+        Sci_Position end = 0;
+        Sci_Position pos = searchInRange(findTextUtf8, searchFlags, start, length, end);
+        if (pos < 0) {
+            break;
+        }
+        if (matches.size() >= MatchCache::MAX_MATCHES_PER_SET) {
+            return matchCache.store(findTextUtf8, cacheFlags, documentVersion, length, nullptr);
+        }
+
+        matches.push_back({ pos, end });
+
+        // An empty match would be found again, continue after the next character
+        if (end > pos) {
+            start = end;
+        }
+        else if (pos < length) {
+            start = send(SCI_POSITIONAFTER, pos, 0);
+        }
+        else {
+            break;
+        }
+    }
+    return matchCache.store(findTextUtf8, cacheFlags, documentVersion, length, &matches);
+}
+
+const std::vector<MatchInterval>* MultiReplaceEngine::cachedMatches(const std::string& findTextUtf8, int searchFlags) const
+{
+    const Sci_Position length = doc.send(SCI_GETLENGTH, 0, 0);
+    if (const std::vector<MatchInterval>* matches = matchCache.lookup(findTextUtf8, matchCacheFlags(searchFlags), documentVersion, length)) {
+        return matches;
+    }
+    return (unionLength == length) ? scannedMatches(findTextUtf8, searchFlags) : nullptr;
+}
+
+// Matches of a regex rule from the last scan of the list, nullptr if it was not part of it
+const std::vector<MatchInterval>* MultiReplaceEngine::scannedMatches(const std::string& findTextUtf8, int searchFlags) const
+{
+    if (unionVersion != documentVersion || !isUnionCandidate(searchFlags)) {
+        return nullptr;
+    }
+    if (const std::vector<MatchInterval>* matches = matchCache.lookup(findTextUtf8, matchCacheFlags(searchFlags), documentVersion, unionLength)) {
+        return matches; // Already moved over by collectMatches
+    }
+    auto it = unionMatches.find({ findTextUtf8, searchFlags });
+    return (it != unionMatches.end()) ? &it->second : nullptr;
+}
+
+// Finds the matches of all regex rules RegexUnion can search in one pass over the document,
+// so the list operations after it look them up instead of searching rule by rule. Rules
+// it cannot search and rules with too many matches are left to their own searches.
+void MultiReplaceEngine::scanRegexRules(const std::vector<RuleSearch>& searches)
+{
+    if (!unionRegex || !searchesWholeDocument(false)) {
+        return;
+    }
+
+    // The same rules are not scanned twice for one version of the document
+    const Sci_Position length = send(SCI_GETLENGTH, 0, 0);
+    std::vector<std::pair<std::string, int>> rules;
+    for (const RuleSearch& search : searches) {
+        if (!search.findTextUtf8.empty() && isUnionCandidate(search.searchFlags) && !regexWatchdog.isStopped(search.findTextUtf8, search.searchFlags)
+            && !cachedMatches(search.findTextUtf8, search.searchFlags)) {
+            rules.emplace_back(search.findTextUtf8, search.searchFlags);
+        }
+    }
+    if (rules.size() < 2 || (unionVersion == documentVersion && unionLength == length && std::all_of(rules.begin(), rules.end(), [this](const auto& rule) {
+        return unionMatches.count(rule) > 0 || unionOversized.count(rule) > 0;
+        }))) {
+        return;
+    }
+
+    ProfileScope profileScope(profiler, "scanRegexRules");
+
+    unionMatches.clear();
+    unionOversized.clear();
+    unionVersion = documentVersion;
+    unionLength = length;
+
+    const char* text = reinterpret_cast<const char*>(send(SCI_GETCHARACTERPOINTER, 0, 0));
+    if (!text) {
+        return;
+    }
+    RegexUnion::TextTraits traits = RegexUnion::traitsOf(text, length);
+    if (send(SCI_GETLINEENDTYPESACTIVE, 0, 0) != SC_LINE_END_TYPE_DEFAULT && !traits.ascii) {
+        return; // ^ and $ would also have to know the Unicode line ends
+    }
+    const int codePage = static_cast<int>(send(SCI_GETCODEPAGE, 0, 0));
+
+    regexUnion.clear();
+    std::vector<std::pair<std::string, int>> added;
+    for (const auto& rule : rules) {
+        if (std::find(added.begin(), added.end(), rule) == added.end()
+            && regexUnion.add(rule.first, (rule.second & SCFIND_MATCHCASE) != 0, codePage, traits)) {
+            added.push_back(rule);
+        }
+    }
+    if (added.size() < 2) {
+        regexUnion.clear();
+        return; // One rule is searched as fast on its own
+    }
+
+    std::vector<std::vector<MatchInterval>> matches;
+    std::vector<bool> oversized;
+    regexUnion.scan(text, length, MatchCache::MAX_MATCHES_PER_SET, matches, oversized);
+    for (size_t i = 0; i < added.size(); ++i) {
+        if (oversized[i]) {
+            unionOversized.insert(added[i]);
+        }
+        else {
+            unionMatches[added[i]] = std::move(matches[i]);
+        }
+    }
+}
+
+// Searching from an arbitrary position gives the same match as the forward scan only for
+// literal text, and backwards only if occurrences cannot overlap. Folded occurrences may
+// overlap where the find text does not.
+bool MultiReplaceEngine::canUseMatchCache(const std::string& findTextUtf8, int searchFlags, bool backward) const
+{
+    if (searchFlags & (SCFIND_REGEXP | SEARCH_FUZZY)) {
+        return false;
+    }
+    if (backward && options.foldCharacters) {
+        return false;
+    }
+    return !backward || !MatchCache::canOverlap(findTextUtf8, (searchFlags & SCFIND_MATCHCASE) != 0);
+}
+
+// True if performSearchForward searches the whole document instead of selections or columns
+bool MultiReplaceEngine::searchesWholeDocument(bool selectMatch) const
+{
+    if (!selectMatch && options.scope == SearchScope::Selection) {
+        return false;
+    }
+    return !(options.scope == SearchScope::Column && columnDelimiterData.isValid());
+}
+
+#pragma endregion
+
+
+#pragma region Mark
+
+int MultiReplaceEngine::markString(const std::string& findTextUtf8, int searchFlags) {
+    ProfileScope profileScope(profiler, "markString");
+
+    if (findTextUtf8.empty()) {
+        return 0;
+    }
+
+    int markCount = 0;  // Counter for marked matches
+    const std::vector<MatchInterval>* matches = searchesWholeDocument(false) ? collectMatches(findTextUtf8, searchFlags) : nullptr;
+    if (matches) {
+        for (const MatchInterval& match : *matches) {
+            highlightTextRange(match.start, match.end - match.start, findTextUtf8);
+            markCount++;
+        }
+    }
+    else {
+        SelectionScope::Snapshot selectionSnapshot(selectionScope, doc, options.scope == SearchScope::Selection);
+        SearchResult searchResult = performSearchForward(findTextUtf8, searchFlags, false, 0);
+        while (searchResult.pos >= 0) {
+            highlightTextRange(searchResult.pos, searchResult.length, findTextUtf8);
+            markCount++;
+            searchResult = performSearchForward(findTextUtf8, searchFlags, false, searchResult.pos + searchResult.length);
+        }
+    }
+
+    if (options.useList && markCount > 0) {
+        markedStringsCount++;
+    }
+
+    return markCount;
+}
+
+int MultiReplaceEngine::countString(const std::string& findTextUtf8, int searchFlags, int maxCount) {
+    ProfileScope profileScope(profiler, "countString");
+
+    if (findTextUtf8.empty()) {
+        return 0;
+    }
+
+    const bool wholeDocument = searchesWholeDocument(false);
+    if (wholeDocument) {
+        if (const std::vector<MatchInterval>* matches = cachedMatches(findTextUtf8, searchFlags)) {
+            return static_cast<int>(std::min(matches->size(), static_cast<size_t>(maxCount)));
+        }
+    }
+
+    // Same matches as markString, continuing after an empty match like collectMatches does
+    int count = 0;
+    const Sci_Position length = send(SCI_GETLENGTH, 0, 0);
+    SelectionScope::Snapshot selectionSnapshot(selectionScope, doc, options.scope == SearchScope::Selection);
+    SearchResult searchResult = performSearchForward(findTextUtf8, searchFlags, false, 0);
+    while (searchResult.pos >= 0) {
+        count++;
+        if (count >= maxCount || (cancellationCheck && cancellationCheck())) {
+            break;
+        }
+
+        Sci_Position next = searchResult.pos + searchResult.length;
+        if (searchResult.length == 0) {
+            if (searchResult.pos >= length) {
+                break;
+            }
+            next = send(SCI_POSITIONAFTER, searchResult.pos, 0);
+        }
+        searchResult = performSearchForward(findTextUtf8, searchFlags, false, next);
+    }
+    return count;
+}
+
+// countString in steps for a caller that must stay responsive: counts the matches from
+// 'from' on in about sliceBytes of the document and moves 'from' behind them, -1 once the
+// rule is done. In the whole document each step searches a window: for patterns that
+// cannot span lines it ends at a line end, for literal texts it overlaps the next window
+// by the longest text a match can be and only matches starting in the window count.
+// Other scopes and patterns go on from match to match.
+int MultiReplaceEngine::countStringSlice(const std::string& findTextUtf8, int searchFlags, Sci_Position& from, Sci_Position sliceBytes)
+{
+    ProfileScope profileScope(profiler, "countString");
+
+    const Sci_Position length = send(SCI_GETLENGTH, 0, 0);
+    if (findTextUtf8.empty() || from < 0 || from > length) {
+        from = -1;
+        return 0;
+    }
+
+    const bool wholeDocument = searchesWholeDocument(false);
+    if (wholeDocument && from == 0) {
+        if (const std::vector<MatchInterval>* matches = cachedMatches(findTextUtf8, searchFlags)) {
+            from = -1;
+            return static_cast<int>(std::min(matches->size(), static_cast<size_t>(std::numeric_limits<int>::max())));
+        }
+    }
+
+    const bool regex = (searchFlags & SCFIND_REGEXP) != 0;
+    const bool windowed = wholeDocument && (!regex || regexWatchdog.isSingleLine(findTextUtf8));
+    Sci_Position windowEnd = length;
+    Sci_Position searchEnd = length;
+    if (windowed && length - from > sliceBytes) {
+        if (regex) {
+            windowEnd = send(SCI_GETLINEENDPOSITION, send(SCI_LINEFROMPOSITION, from + sliceBytes, 0), 0);
+            searchEnd = windowEnd;
+        }
+        else {
+            // A character may fold to a longer one, four bytes are the longest in UTF-8, and a
+            // Fuzzy mode match may have up to its number of edits inserted
+            const Sci_Position overlap = 4 * static_cast<Sci_Position>(findTextUtf8.size() + fuzzyEditsOf(searchFlags));
+            windowEnd = from + sliceBytes;
+            searchEnd = std::min(length, windowEnd + overlap);
+        }
+    }
+
+    int count = 0;
+    SelectionScope::Snapshot selectionSnapshot(selectionScope, doc, options.scope == SearchScope::Selection);
+    while (true) {
+        const SearchResult searchResult = windowed ? performSingleSearch(findTextUtf8, searchFlags, false, { from, searchEnd })
+            : performSearchForward(findTextUtf8, searchFlags, false, from);
+        if (searchResult.pos < 0 || (windowed && searchResult.pos >= windowEnd && windowEnd < length)) {
+            break;
+        }
+        count++;
+
+        Sci_Position next = searchResult.pos + searchResult.length;
+        if (searchResult.length == 0) {
+            if (searchResult.pos >= length) {
+                from = -1;
+                return count;
+            }
+            next = send(SCI_POSITIONAFTER, searchResult.pos, 0);
+        }
+        from = next;
+        if (!windowed && count % 64 == 0) {
+            return count; // Long runs of matches are shared out between steps as well
+        }
+    }
+
+    if (!windowed || windowEnd >= length) {
+        from = -1;
+    }
+    else {
+        from = std::max(from, windowEnd);
+    }
+    return count;
+}
+
+void MultiReplaceEngine::highlightTextRange(Sci_Position pos, Sci_Position len, const std::string& findTextUtf8)
+{
+    ProfileScope profileScope(profiler, "highlight");
+
+    bool useListEnabled = options.useList;
+    long color = useListEnabled ? generateColorValue(findTextUtf8) : MARKER_COLOR;
+
+    // Check if the color already has an associated style
+    int indicatorStyle;
+    if (colorToStyleMap.find(color) == colorToStyleMap.end()) {
+        // If not, assign a new style and store it in the map
+        indicatorStyle = useListEnabled ? textStyles[(colorToStyleMap.size() % (textStyles.size() - 1)) + 1] : textStyles[0];
+        colorToStyleMap[color] = indicatorStyle;
+    }
+    else {
+        // If yes, use the existing style
+        indicatorStyle = colorToStyleMap[color];
+    }
+
+    // Set and apply highlighting style
+    send(SCI_SETINDICATORCURRENT, indicatorStyle, 0);
+    send(SCI_INDICSETSTYLE, indicatorStyle, INDIC_STRAIGHTBOX);
+
+    if (colorToStyleMap.size() < textStyles.size()) {
+        send(SCI_INDICSETFORE, indicatorStyle, color);
+    }
+
+    send(SCI_INDICSETALPHA, indicatorStyle, 100);
+    send(SCI_INDICATORFILLRANGE, pos, len);
+}
+
+long MultiReplaceEngine::generateColorValue(const std::string& str) {
+    // DJB2 hash
+    unsigned long hash = 5381;
+    for (char c : str) {
+        hash = ((hash << 5) + hash) + c;  // hash * 33 + c
+    }
+
+    // Create an RGB color using the hash
+    int r = (hash >> 16) & 0xFF;
+    int g = (hash >> 8) & 0xFF;
+    int b = hash & 0xFF;
+
+    // Convert RGB to long
+    long color = (r << 16) | (g << 8) | b;
+
+    return color;
+}
+
+#pragma endregion
+
+
+#pragma region CSV
+
+int MultiReplaceEngine::deleteColumns()
+{
+    ProfileScope profileScope(profiler, "deleteColumns");
+
+    if (!columnDelimiterData.isValid()) {
+        return 0;
+    }
+
+    int deletedFieldsCount = 0;
+    size_t lineCount = lineDelimiterPositions.size();
+
+    BulkEditTransaction transaction(doc);
+
+    // Loop from the last element down to the first
+    for (size_t i = lineCount; i-- > 0; ) {
+        const auto& lineInfo = lineDelimiterPositions[i];
+
+        // Process each column in reverse
+        for (auto it = columnDelimiterData.columns.rbegin(); it != columnDelimiterData.columns.rend(); ++it) {
+            size_t column = *it;
+
+            // Only process columns within the valid range
+            if (column <= lineInfo.positions.size() + 1) {
+
+                Sci_Position startPos, endPos;
+
+                if (column == 1) {
+                    startPos = lineInfo.startPosition;
+                }
+                else if (column - 2 < lineInfo.positions.size()) {
+                    startPos = lineInfo.positions[column - 2].position;
+                }
+                else {
+                    continue;
+                }
+
+                if (column - 1 < lineInfo.positions.size()) {
+                    // Delete leading Delimiter if first column will be droped
+                    if (column == 1) {
+                        endPos = lineInfo.positions[column - 1].position + columnDelimiterData.delimiterLength;
+                    }
+                    else {
+                        endPos = lineInfo.positions[column - 1].position;
+                    }
+                }
+                else {
+                    endPos = lineInfo.endPosition;
+                }
+
+                send(SCI_DELETERANGE, startPos, endPos - startPos);
+
+                deletedFieldsCount++;
+            }
+        }
+
+    }
+
+    return deletedFieldsCount;
+}
+
+std::string MultiReplaceEngine::copyColumns(int& copiedFieldsCount)
+{
+    ProfileScope profileScope(profiler, "copyColumns");
+
+    copiedFieldsCount = 0;
+    if (!columnDelimiterData.isValid()) {
+        return std::string();
+    }
+
+    std::string combinedText;
+    size_t lineCount = lineDelimiterPositions.size();
+
+    // Iterate through each line
+    for (size_t i = 0; i < lineCount; ++i) {
+        const auto& lineInfo = lineDelimiterPositions[i];
+
+        bool isFirstCopiedColumn = true;
+        std::string lineText;
+
+        // Process each column
+        for (size_t column : columnDelimiterData.columns) {
+            if (column <= lineInfo.positions.size() + 1) {
+                Sci_Position startPos, endPos;
+
+                if (column == 1) {
+                    startPos = lineInfo.startPosition;
+                    isFirstCopiedColumn = false;
+                }
+                else if (column - 2 < lineInfo.positions.size()) {
+                    startPos = lineInfo.positions[column - 2].position;
+                    // Drop first Delimiter if copied as first column
+                    if (isFirstCopiedColumn) {
+                        startPos += columnDelimiterData.delimiterLength;
+                        isFirstCopiedColumn = false;
+                    }
+                }
+                else {
+                    break;
+                }
+
+                if (column - 1 < lineInfo.positions.size()) {
+                    endPos = lineInfo.positions[column - 1].position;
+                }
+                else {
+                    endPos = lineInfo.endPosition;
+                }
+
+                // Buffer to hold the text
+                std::vector<char> buffer(static_cast<size_t>(endPos - startPos) + 1);
+
+                // Prepare TextRange structure for Scintilla
+                Sci_TextRangeFull tr;
+                tr.chrg.cpMin = startPos;
+                tr.chrg.cpMax = endPos;
+                tr.lpstrText = buffer.data();
+
+                // Extract text for the column
+                send(SCI_GETTEXTRANGEFULL, 0, reinterpret_cast<sptr_t>(&tr));
+                lineText += std::string(buffer.data());
+
+                copiedFieldsCount++;
+            }
+        }
+
+        combinedText += lineText;
+        // Add a newline except after the last line
+        if (i < lineCount - 1) {
+            combinedText += "\n";
+        }
+    }
+
+    return combinedText;
+}
+
+#pragma endregion
+
+
+#pragma region CSV Sort
+
+std::vector<CombinedColumns> MultiReplaceEngine::extractColumnData(size_t startLine, size_t lineCount) {
+    ProfileScope profileScope(profiler, "sort.extract");
+
+    std::vector<CombinedColumns> combinedData;
+    for (size_t i = startLine; i < lineCount; ++i) {
+        const auto& lineInfo = lineDelimiterPositions[i]; // Stelle sicher, dass lineDelimiterPositions definiert ist
+        CombinedColumns rowData;
+        rowData.columns.resize(columnDelimiterData.inputColumns.size()); // Stelle sicher, dass columnDelimiterData definiert ist
+
+        size_t columnIndex = 0;
+        for (size_t columnNumber : columnDelimiterData.inputColumns) {
+            Sci_Position startPos, endPos;
+
+            // Berechne Start- und Endpositionen für jede Spalte
+            if (columnNumber == 1) {
+                startPos = lineInfo.startPosition;
+            }
+            else if (columnNumber - 2 < lineInfo.positions.size()) {
+                startPos = lineInfo.positions[columnNumber - 2].position + columnDelimiterData.delimiterLength;
+            }
+            else {
+                continue;
+            }
+
+            if (columnNumber - 1 < lineInfo.positions.size()) {
+                endPos = lineInfo.positions[columnNumber - 1].position;
+            }
+            else {
+                endPos = lineInfo.endPosition;
+            }
+
+            // Puffer, um den Text zu halten
+            std::vector<char> buffer(static_cast<size_t>(endPos - startPos) + 1);
+            Sci_TextRangeFull tr;
+            tr.chrg.cpMin = startPos;
+            tr.chrg.cpMax = endPos;
+            tr.lpstrText = buffer.data();
+
+            // Extrahiere Text für die Spalte
+            send(SCI_GETTEXTRANGEFULL, 0, reinterpret_cast<sptr_t>(&tr));
+            rowData.columns[columnIndex++] = std::string(buffer.data());
+        }
+
+        combinedData.push_back(rowData);
+    }
+
+    return combinedData;
+}
+
+bool MultiReplaceEngine::sortRowsByColumn(SortDirection sortDirection, std::vector<size_t>& originalLineOrder) {
+    ProfileScope profileScope(profiler, "sortRowsByColumn");
+
+    // Validate column delimiter data
+    if (!columnDelimiterData.isValid()) {
+        return false;
+    }
+    size_t lineCount = lineDelimiterPositions.size();
+
+    // Check if there's nothing to sort or if the document has fewer lines than header lines
+    if (lineCount <= CSVheaderLinesCount) {
+        // Either nothing to sort or document consists only of header lines
+        return false;
+    }
+
+    BulkEditTransaction transaction(doc);
+
+    std::vector<CombinedColumns> combinedData;
+    combinedData.reserve(lineCount); // Reserve space for all lines, including headers
+
+    // Initialize tempOrder with indices for all lines, including header lines
+    std::vector<size_t> tempOrder(lineCount);
+    for (size_t i = 0; i < lineCount; ++i) {
+        tempOrder[i] = i; // Manually filling tempOrder with 0, 1, ..., lineCount-1
+    }
+
+    // Extract content of specified columns, starting after header lines
+    combinedData = extractColumnData(CSVheaderLinesCount, lineDelimiterPositions.size());
+
+    // Sort the tempOrder based on combinedData, excluding header lines during comparison
+    {
+        ProfileScope orderScope(profiler, "sort.order");
+        std::sort(tempOrder.begin() + CSVheaderLinesCount, tempOrder.end(), [&](const size_t a, const size_t b) {
+            size_t adjustedA = a - CSVheaderLinesCount;
+            size_t adjustedB = b - CSVheaderLinesCount;
+            // Implement the sorting logic here, only for lines beyond the header lines
+            return sortDirection == SortDirection::Ascending ? combinedData[adjustedA].columns[0] < combinedData[adjustedB].columns[0] : combinedData[adjustedA].columns[0] > combinedData[adjustedB].columns[0];
+            });
+    }
+
+    // Adjust originalLineOrder based on the opposite sorting results
+    if (!originalLineOrder.empty()) {
+        std::vector<size_t> newOrder(originalLineOrder.size());
+        for (size_t i = 0; i < tempOrder.size(); ++i) {
+            size_t positionInOriginal = tempOrder[i];
+            size_t valueForNewOrder = originalLineOrder[positionInOriginal];
+            newOrder[i] = valueForNewOrder;
+        }
+        originalLineOrder = std::move(newOrder);
+    }
+    else {
+        originalLineOrder = tempOrder;
+    }
+
+    // Use tempOrder to reorder lines in Scintilla, adjusting for header lines
+    reorderLinesInScintilla(tempOrder);
+    return true;
+}
+
+void MultiReplaceEngine::reorderLinesInScintilla(const std::vector<size_t>& sortedIndex) {
+    ProfileScope profileScope(profiler, "sort.reorder");
+
+    std::string lineBreak = getEOLStyle();
+
+    // Extract the text of each line based on the sorted index and include a line break after each
+    std::string combinedLines;
+    for (size_t i = 0; i < sortedIndex.size(); ++i) {
+        size_t idx = sortedIndex[i];
+        Sci_Position lineStart = send(SCI_POSITIONFROMLINE, idx, 0);
+        Sci_Position lineEnd = send(SCI_GETLINEENDPOSITION, idx, 0);
+        std::vector<char> buffer(static_cast<size_t>(lineEnd - lineStart) + 1); // Buffer size includes space for null terminator
+        Sci_TextRangeFull tr;
+        tr.chrg.cpMin = lineStart;
+        tr.chrg.cpMax = lineEnd;
+        tr.lpstrText = buffer.data();
+        send(SCI_GETTEXTRANGEFULL, 0, reinterpret_cast<sptr_t>(&tr));
+        combinedLines += std::string(buffer.data(), buffer.size() - 1); // Exclude null terminator from the string
+        if (i < sortedIndex.size() - 1) {
+            combinedLines += lineBreak; // Add line break after each line except the last
+        }
+    }
+
+    // Clear all content from Scintilla
+    send(SCI_CLEARALL, 0, 0);
+
+    // Re-insert the combined lines
+    send(SCI_APPENDTEXT, combinedLines.length(), reinterpret_cast<sptr_t>(combinedLines.c_str()));
+}
+
+void MultiReplaceEngine::restoreOriginalLineOrder(const std::vector<size_t>& originalOrder) {
+    ProfileScope profileScope(profiler, "sort.restore");
+
+    // Determine the total number of lines in the document
+    size_t totalLineCount = send(SCI_GETLINECOUNT, 0, 0);
+
+    // Ensure the size of the originalOrder vector matches the number of lines in the document
+    auto maxElementIt = std::max_element(originalOrder.begin(), originalOrder.end());
+    if (maxElementIt == originalOrder.end() || *maxElementIt != totalLineCount - 1) {
+        return;
+    }
+
+    // Create a vector for the new sorted content of the document
+    std::vector<std::string> sortedLines(totalLineCount);
+    std::string lineBreak = getEOLStyle();
+
+    // Iterate through each line in the document and fill sortedLines according to originalOrder
+    for (size_t i = 0; i < totalLineCount; ++i) {
+        size_t newPosition = originalOrder[i];
+        Sci_Position lineStart = send(SCI_POSITIONFROMLINE, i, 0);
+        Sci_Position lineEnd = send(SCI_GETLINEENDPOSITION, i, 0);
+        std::vector<char> buffer(static_cast<size_t>(lineEnd - lineStart) + 1);
+        Sci_TextRangeFull tr;
+        tr.chrg.cpMin = lineStart;
+        tr.chrg.cpMax = lineEnd;
+        tr.lpstrText = buffer.data();
+        send(SCI_GETTEXTRANGEFULL, 0, reinterpret_cast<sptr_t>(&tr));
+        sortedLines[newPosition] = std::string(buffer.data(), buffer.size() - 1); // Exclude null terminator
+    }
+
+    BulkEditTransaction transaction(doc);
+
+    // Clear the content of the editor
+    send(SCI_CLEARALL, 0, 0);
+
+    // Re-insert the lines in their original order
+    for (size_t i = 0; i < sortedLines.size(); ++i) {
+        //std::string message = "Inserting line at position: " + std::to_string(i) + "\nContent: " + sortedLines[i];
+        //MessageBoxA(NULL, message.c_str(), "Debug Insert Line", MB_OK);
+        send(SCI_APPENDTEXT, sortedLines[i].length(), reinterpret_cast<sptr_t>(sortedLines[i].c_str()));
+        // Add a line break after each line except the last one
+        if (i < sortedLines.size() - 1) {
+            send(SCI_APPENDTEXT, lineBreak.length(), reinterpret_cast<sptr_t>(lineBreak.c_str()));
+        }
+    }
+}
+
+#pragma endregion
+
+
+#pragma region Scope
+
+void MultiReplaceEngine::findAllDelimitersInDocument() {
+    ProfileScope profileScope(profiler, "findAllDelimiters");
+
+    // Clear list for new data
+    lineDelimiterPositions.clear();
+
+    // Get total line count in document
+    Sci_Position totalLines = send(SCI_GETLINECOUNT, 0, 0);
+
+    // Resize the list to fit total lines
+    lineDelimiterPositions.resize(totalLines);
+
+    // Find and store delimiter positions for each line
+    for (Sci_Position line = 0; line < totalLines; ++line) {
+
+        // Find delimiters in line
+        findDelimitersInLine(line);
+
+    }
+
+}
+
+void MultiReplaceEngine::findDelimitersInLine(Sci_Position line) {
+    // Initialize LineInfo for this line
+    LineInfo lineInfo;
+
+    // Get start and end positions of the line
+    lineInfo.startPosition = send(SCI_POSITIONFROMLINE, line, 0);
+    lineInfo.endPosition = send(SCI_GETLINEENDPOSITION, line, 0);
+
+    // The line including its line end is read window by window, a minified file can be one
+    // line of hundreds of megabytes
+    const Sci_Position lineEnd = lineInfo.startPosition + send(SCI_LINELENGTH, line, 0);
+    const std::string& delimiter = columnDelimiterData.extendedDelimiter;
+    const Sci_Position delimiterLength = static_cast<Sci_Position>(columnDelimiterData.delimiterLength);
+    const char* window = nullptr;
+    Sci_Position windowStart = lineInfo.startPosition;
+    Sci_Position windowEnd = lineInfo.startPosition;
+
+    // Define structure to store delimiter position
+    DelimiterPosition delimiterPos = { 0 };
+
+    bool inQuotes = false;
+    Sci_Position pos = lineInfo.startPosition;
+
+    bool hasQuoteChar = !columnDelimiterData.quoteChar.empty();
+    char currentQuoteChar = hasQuoteChar ? columnDelimiterData.quoteChar[0] : 0;
+
+    while (pos < lineEnd) {
+        // A delimiter starting at pos has to lie in the window
+        if (pos + std::max<Sci_Position>(delimiterLength, 1) > windowEnd && windowEnd < lineEnd) {
+            windowStart = pos;
+            windowEnd = std::min(lineEnd, pos + LINE_WINDOW_BYTES);
+            window = reinterpret_cast<const char*>(send(SCI_GETRANGEPOINTER, windowStart, windowEnd - windowStart));
+            if (!window) {
+                break;
+            }
+        }
+        const char* p = window + (pos - windowStart);
+
+        // If there's a defined quote character and it matches, toggle inQuotes
+        if (hasQuoteChar && *p == currentQuoteChar) {
+            inQuotes = !inQuotes;
+            ++pos;
+            continue;
+        }
+
+        if (!inQuotes && delimiterLength > 0 && static_cast<size_t>(delimiterLength) == delimiter.size() && pos + delimiterLength <= windowEnd
+            && std::memcmp(p, delimiter.data(), delimiter.size()) == 0) {
+            delimiterPos.position = pos;
+            lineInfo.positions.push_back(delimiterPos);
+            pos += delimiterLength;  // Skip delimiter for next iteration
+            continue;
+        }
+        ++pos;
+    }
+
+    // Convert size of lineDelimiterPositions to signed integer
+    Sci_Position listSize = static_cast<Sci_Position>(lineDelimiterPositions.size());
+
+    // Update lineDelimiterPositions with the LineInfo for this line
+    if (line < listSize) {
+        lineDelimiterPositions[line] = lineInfo;
+    }
+    else {
+        // If the line index is greater than the current size of the list,
+        // append new elements to the list
+        lineDelimiterPositions.resize(line + 1);
+        lineDelimiterPositions[line] = lineInfo;
+    }
+}
+
+CellLocation MultiReplaceEngine::locateCell(Sci_Position position) const {
+    CellLocation cell;
+    const size_t lineCount = lineDelimiterPositions.size();
+    if (options.scope != SearchScope::Column ||
+        columnDelimiterData.columns.empty() || columnDelimiterData.extendedDelimiter.empty() ||
+        lineCount == 0) {
+        return cell;
+    }
+
+    // Callers mostly move forward or stay on the same line, so gallop from the last line
+    // found in either direction and finish with a binary search
+    auto startsAfter = [&](size_t line) { return lineDelimiterPositions[line].startPosition > position; };
+    size_t low = std::min(lastLocatedLine, lineCount - 1);
+    size_t high = lineCount;
+    if (startsAfter(low)) {
+        high = low;
+        low = 0;
+        for (size_t step = 1; step <= high; step *= 2) {
+            if (!startsAfter(high - step)) {
+                low = high - step;
+                break;
+            }
+            high -= step;
+        }
+    }
+    else {
+        for (size_t step = 1; low + step < lineCount; step *= 2) {
+            if (startsAfter(low + step)) {
+                high = low + step;
+                break;
+            }
+            low += step;
+        }
+    }
+    auto lineIt = std::upper_bound(lineDelimiterPositions.begin() + low, lineDelimiterPositions.begin() + high, position,
+        [](Sci_Position value, const LineInfo& lineInfo) { return value < lineInfo.startPosition; });
+    if (lineIt == lineDelimiterPositions.begin()) {
+        return cell;
+    }
+    cell.line = static_cast<size_t>(std::prev(lineIt) - lineDelimiterPositions.begin());
+    lastLocatedLine = cell.line;
+
+    // The first delimiter at or after the position closes its cell
+    const LineInfo& lineInfo = lineDelimiterPositions[cell.line];
+    const auto& linePositions = lineInfo.positions;
+    auto delimiterIt = std::lower_bound(linePositions.begin(), linePositions.end(), position,
+        [](const DelimiterPosition& delimiter, Sci_Position value) { return delimiter.position < value; });
+    const size_t index = static_cast<size_t>(delimiterIt - linePositions.begin());
+
+    cell.column = index + 1;
+    cell.start = (index == 0) ? lineInfo.startPosition : linePositions[index - 1].position + columnDelimiterData.delimiterLength;
+    cell.end = (index == linePositions.size()) ? lineInfo.endPosition : linePositions[index].position;
+    return cell;
+}
+
+void MultiReplaceEngine::updateDelimitersInDocument(size_t lineNumber, ChangeType changeType) {
+
+    if (lineNumber > lineDelimiterPositions.size()) {
+        return; // invalid line number
+    }
+
+    LineInfo lineInfo;
+    switch (changeType) {
+    case ChangeType::Insert:
+        // Insert an empty line at the specified index
+        if (lineNumber > 0) { // not the first line
+            lineInfo.startPosition = lineDelimiterPositions[lineNumber - 1].endPosition + eolLength;
+            lineInfo.endPosition = lineInfo.startPosition;
+        }
+        else {
+            lineInfo.startPosition = 0;
+            lineInfo.endPosition = 0;
+        }
+        lineDelimiterPositions.insert(lineDelimiterPositions.begin() + lineNumber, lineInfo);
+        break;
+
+    case ChangeType::Delete:
+        // Delete the specified line
+        if (lineNumber < lineDelimiterPositions.size()) {
+            // Calculate the length of the deleted line (including EOL)
+            Sci_Position deletedLineLength = lineDelimiterPositions[lineNumber].endPosition
+                - lineDelimiterPositions[lineNumber].startPosition
+                + eolLength;
+
+            lineDelimiterPositions.erase(lineDelimiterPositions.begin() + lineNumber);
+
+            // Update positions for subsequent lines
+            for (size_t i = lineNumber; i < lineDelimiterPositions.size(); ++i) {
+                lineDelimiterPositions[i].startPosition -= deletedLineLength;
+                lineDelimiterPositions[i].endPosition -= deletedLineLength;
+                for (auto& delim : lineDelimiterPositions[i].positions) {
+                    delim.position -= deletedLineLength;
+                }
+            }
+        }
+        break;
+
+    case ChangeType::Modify:
+        // Modify the content of the specified line
+        if (lineNumber < lineDelimiterPositions.size()) {
+            // Re-analyze the line to find delimiters
+            findDelimitersInLine(lineNumber);
+
+            // Only adjust following lines if not at the last line
+            if (lineNumber < lineDelimiterPositions.size() - 1) {
+                // Calculate the difference to the next line start position (considering EOL)
+                Sci_Position positionDifference = lineDelimiterPositions[lineNumber + 1].startPosition - lineDelimiterPositions[lineNumber].endPosition - eolLength;
+
+                // Update positions for subsequent lines
+                for (size_t i = lineNumber + 1; i < lineDelimiterPositions.size(); ++i) {
+                    if (positionDifference > 0) { // The distance is too large, need to reduce
+                        lineDelimiterPositions[i].startPosition -= positionDifference;
+                        lineDelimiterPositions[i].endPosition -= positionDifference;
+                        for (auto& delim : lineDelimiterPositions[i].positions) {
+                            delim.position -= positionDifference;
+                        }
+                    }
+                    else if (positionDifference < 0) { // The distance is too small, need to increase
+                        lineDelimiterPositions[i].startPosition += abs(positionDifference);
+                        lineDelimiterPositions[i].endPosition += abs(positionDifference);
+                        for (auto& delim : lineDelimiterPositions[i].positions) {
+                            delim.position += abs(positionDifference);
+                        }
+                    }
+                }
+            }
+        }
+        break;
+
+    default:
+        break;
+    }
+
+}
+
+#pragma endregion
+
+
+#pragma region Utilities
+
+int MultiReplaceEngine::convertExtendedToString(const std::string& query, std::string& result)
+{
+    auto readBase = [](const char* str, int* value, int base, int size) -> bool
+    {
+        int i = 0, temp = 0;
+        *value = 0;
+        char max = '0' + static_cast<char>(base) - 1;
+        char current;
+        while (i < size)
+        {
+            current = str[i];
+            if (current >= 'A')
+            {
+                current &= 0xdf;
+                current -= ('A' - '0' - 10);
+            }
+            else if (current > '9')
+                return false;
+
+            if (current >= '0' && current <= max)
+            {
+                temp *= base;
+                temp += (current - '0');
+            }
+            else
+            {
+                return false;
+            }
+            ++i;
+        }
+        *value = temp;
+        return true;
+    };
+
+    int i = 0, j = 0;
+    int charLeft = static_cast<int>(query.length());
+    char current;
+    result.clear();
+    result.resize(query.length()); // Preallocate memory for optimal performance
+
+    while (i < static_cast<int>(query.length()))
+    {
+        current = query[i];
+        --charLeft;
+        if (current == '\\' && charLeft)
+        {
+            ++i;
+            --charLeft;
+            current = query[i];
+            switch (current)
+            {
+            case 'r':
+                result[j] = '\r';
+                break;
+            case 'n':
+                result[j] = '\n';
+                break;
+            case '0':
+                result[j] = '\0';
+                break;
+            case 't':
+                result[j] = '\t';
+                break;
+            case '\\':
+                result[j] = '\\';
+                break;
+            case 'b':
+            case 'd':
+            case 'o':
+            case 'x':
+            case 'u':
+            {
+                int size = 0, base = 0;
+                if (current == 'b')
+                {
+                    size = 8, base = 2;
+                }
+                else if (current == 'o')
+                {
+                    size = 3, base = 8;
+                }
+                else if (current == 'd')
+                {
+                    size = 3, base = 10;
+                }
+                else if (current == 'x')
+                {
+                    size = 2, base = 16;
+                }
+                else if (current == 'u')
+                {
+                    size = 4, base = 16;
+                }
+
+                if (charLeft >= size)
+                {
+                    int res = 0;
+                    if (readBase(query.c_str() + (i + 1), &res, base, size))
+                    {
+                        result[j] = static_cast<char>(res);
+                        i += size;
+                        break;
+                    }
+                }
+                // not enough chars to make parameter, use default method as fallback
+            }
+            [[fallthrough]];
+            default:
+                // unknown sequence, treat as regular text
+                result[j] = '\\';
+                ++j;
+                result[j] = current;
+                break;
+            }
+        }
+        else
+        {
+            result[j] = query[i];
+        }
+        ++i;
+        ++j;
+    }
+
+    // Nullterminate the result-String
+    result.resize(j);
+
+    // Return length of result-Strings
+    return j;
+}
+
+std::string MultiReplaceEngine::convertAndExtend(const std::string& input, bool extended)
+{
+    std::string output = input;
+
+    if (extended)
+    {
+        std::string outputExtended;
+        convertExtendedToString(output, outputExtended);
+        output = outputExtended;
+    }
+
+    return output;
+}
+
+Sci_Position MultiReplaceEngine::getEOLLength() {
+    Sci_Position eolMode = send(SCI_GETEOLMODE, 0, 0);
+    switch (eolMode) {
+    case SC_EOL_CRLF:
+        return 2;
+    case SC_EOL_CR:
+    case SC_EOL_LF:
+        return 1;
+    default:
+        return 2; // Default to CRLF
+    }
+}
+
+std::string MultiReplaceEngine::getEOLStyle() {
+    Sci_Position eolMode = send(SCI_GETEOLMODE, 0, 0);
+    switch (eolMode) {
+    case SC_EOL_CRLF:
+        return "\r\n";
+    case SC_EOL_CR:
+        return "\r";
+    case SC_EOL_LF:
+        return "\n";
+    default:
+        return "\n";  // Defaulting to LF
+    }
+}
+
+std::string MultiReplaceEngine::utf8ToCodepage(const std::string& utf8Str, int codepage) const {
+    if (!codepageConverter) {
+        return utf8Str;
+    }
+    return codepageConverter(utf8Str, codepage);
+}
+
+sptr_t MultiReplaceEngine::send(unsigned int iMessage, uptr_t wParam, sptr_t lParam) {
+    switch (iMessage) {
+    case SCI_REPLACETARGET:
+    case SCI_REPLACETARGETRE:
+    case SCI_INSERTTEXT:
+    case SCI_DELETERANGE:
+    case SCI_SETTEXT:
+    case SCI_APPENDTEXT:
+    case SCI_CLEARALL:
+    case SCI_REPLACESEL:
+    case SCI_UNDO:
+    case SCI_REDO: {
+        ++documentVersion;
+        // Without SCN_MODIFIED from the host the folded text and the index are stale
+        const uint64_t editsBefore = reportedEdits;
+        const sptr_t result = doc.send(iMessage, wParam, lParam);
+        if (reportedEdits == editsBefore) {
+            foldedText.reset();
+            trigramIndex.reset();
+        }
+        return result;
+    }
+    default:
+        break;
+    }
+    return doc.send(iMessage, wParam, lParam);
+}
+
+BulkEditTransaction::BulkEditTransaction(DocumentBackend& document, int modEventMask)
+    : doc(document)
+{
+    previousModEventMask = doc.send(SCI_GETMODEVENTMASK, 0, 0);
+    doc.send(SCI_SETMODEVENTMASK, static_cast<uptr_t>(modEventMask), 0);
+    doc.setRedraw(false);
+    doc.send(SCI_BEGINUNDOACTION, 0, 0);
+}
+
+BulkEditTransaction::~BulkEditTransaction() {
+    doc.send(SCI_ENDUNDOACTION, 0, 0);
+
+    // Apply the last requested caret position instead of every intermediate one
+    if (deferredCaretPos >= 0) {
+        doc.send(SCI_SETEMPTYSELECTION, static_cast<uptr_t>(deferredCaretPos), 0);
+    }
+
+    doc.send(SCI_SETMODEVENTMASK, static_cast<uptr_t>(previousModEventMask), 0);
+    doc.setRedraw(true);
+}
+
+bool MultiReplaceEngine::normalizeAndValidateNumber(std::string& str) {
+    if (str == "." || str == ",") {
+        return false;
+    }
+
+    int dotCount = 0;
+    std::string tempStr = str; // Temporary string to hold potentially modified string
+    for (char& c : tempStr) {
+        if (c == '.') {
+            dotCount++;
+        }
+        else if (c == ',') {
+            dotCount++;
+            c = '.';  // Potentially replace comma with dot in tempStr
+        }
+        else if (!isdigit(c)) {
+            return false;  // Contains non-numeric characters
+        }
+
+        if (dotCount > 1) {
+            return false;  // Contains more than one separator
+        }
+    }
+
+    str = tempStr;
+    return true;  // String is a valid number
+}
+
+#pragma endregion
+
+
+#pragma region Memory
+
+MemoryReport MultiReplaceEngine::memoryUsage() const
+{
+    MemoryReport report;
+
+    MemoryUsage delimiters{ "lineDelimiterPositions", MemorySize::shallow(lineDelimiterPositions), lineDelimiterPositions.size() };
+    for (const LineInfo& lineInfo : lineDelimiterPositions) {
+        delimiters.bytes += MemorySize::shallow(lineInfo.positions);
+    }
+    report.push_back(delimiters);
+
+    MemoryUsage luaVariables{ "globalLuaVariablesMap", MemorySize::shallow(globalLuaVariablesMap), globalLuaVariablesMap.size() };
+    for (const auto& pair : globalLuaVariablesMap) {
+        luaVariables.bytes += MemorySize::of(pair.first) + MemorySize::of(pair.second.name) + MemorySize::of(pair.second.stringValue);
+    }
+    report.push_back(luaVariables);
+
+    report.push_back({ "colorToStyleMap", MemorySize::shallow(colorToStyleMap), colorToStyleMap.size() });
+    report.push_back({ "matchCache", matchCache.memoryBytes(), matchCache.setCount() });
+    report.push_back({ "trigramIndex", trigramIndex.memoryBytes(), 0 });
+    MemoryUsage scanned{ "regexUnion", regexUnion.memoryBytes(), unionMatches.size() };
+    for (const auto& pair : unionMatches) {
+        scanned.bytes += MemorySize::of(pair.first.first) + MemorySize::shallow(pair.second);
+    }
+    report.push_back(scanned);
+    report.push_back({ "profiler", profiler.memoryBytes(), 0 });
+    report.push_back({ "Lua heap (peak)", luaMemory.peakBytes(), 0 });
+    return report;
+}
+
+void MultiReplaceEngine::releaseCaches()
+{
+    profiler.releaseTrace();
+    luaMemory.resetPeak();
+    matchCache.clear();
+    trigramIndex.reset();
+    regexUnion.clear();
+    unionMatches.clear();
+    unionOversized.clear();
+    unionLength = -1;
+}
+
+#pragma endregion
@@ -0,0 +1,383 @@
+// This file is part of Notepad++ project
+// Copyright (C)2023 Thomas Knoefel
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef MULTI_REPLACE_ENGINE_H
+#define MULTI_REPLACE_ENGINE_H
+
+#include "DocumentBackend.h"
+#include "FoldedText.h"
+#include "FusedReplace.h"
+#include "FuzzySearch.h"
+#include "LiteralSearch.h"
+#include "MatchCache.h"
+#include "RegexPrefilter.h"
+#include "RegexUnion.h"
+#include "RegexWatchdog.h"
+#include "MemoryUsage.h"
+#include "OperationProfiler.h"
+#include "SelectionScope.h"
+#include "TrigramIndex.h"
+
+#include <string>
+#include <vector>
+#include <map>
+#include <functional>
+#include <limits>
+#include <unordered_map>
+#include <set>
+#include <lua.hpp>
+
+enum class SortDirection {
+    Unsorted,
+    Ascending,
+    Descending
+};
+
+enum class ChangeType { Insert, Delete, Modify };
+
+enum class SearchScope { AllText, Selection, Column };
+
+enum class LuaErrorType { Syntax, Execution };
+
+// One Find/Replace entry as the engine sees it. Texts are in the document encoding
+// and not yet extended, the host converts them from its own representation.
+struct ReplaceRule
+{
+    bool isEnabled = true;
+    std::string findText;
+    std::string replaceText;
+    bool wholeWord = false;
+    bool matchCase = false;
+    bool useVariables = false;
+    bool extended = false;
+    bool regex = false;
+    int fuzzyEdits = 0; // Fuzzy mode with at most this many edits if above 0
+};
+
+// Options that the panel reads from its controls before each operation
+struct EngineOptions
+{
+    SearchScope scope = SearchScope::AllText;
+    bool replaceFirst = false;
+    bool useList = false;
+    bool foldCharacters = false; // Accent- and width-insensitive search of literal rules
+    bool indexTrigrams = true;   // List operations skip document blocks a literal rule cannot match in
+};
+
+// Find text and flags of a list entry as markString and countString take them
+struct RuleSearch {
+    std::string findTextUtf8;
+    int searchFlags = 0;
+};
+
+struct RuleCount {
+    int findCount = 0;
+    int replaceCount = 0;
+};
+
+struct SearchResult {
+    Sci_Position pos = -1;
+    Sci_Position length = 0;
+};
+
+struct SelectionInfo {
+    std::string text;
+    Sci_Position startPos;
+    Sci_Position length;
+};
+
+struct ColumnDelimiterData {
+    std::vector<int> inputColumns; // original order of the columns
+    std::set<int> columns;
+    std::string extendedDelimiter;
+    std::string quoteChar;
+    size_t delimiterLength = 0;
+    bool delimiterChanged = false;
+    bool quoteCharChanged = false;
+    bool columnChanged = false;
+
+    bool isValid() const {
+        bool isQuoteCharValid = quoteChar.empty() ||
+            (quoteChar.length() == 1 && (quoteChar[0] == '"' || quoteChar[0] == '\''));
+        return !columns.empty() && !extendedDelimiter.empty() && isQuoteCharValid;
+    }
+};
+
+struct DelimiterPosition {
+    Sci_Position position;
+};
+
+struct CombinedColumns {
+    std::vector<std::string> columns;
+};
+
+struct LineInfo {
+    std::vector<DelimiterPosition> positions;
+    Sci_Position startPosition = 0;
+    Sci_Position endPosition = 0;
+};
+
+// Cell of the delimiter index a position belongs to. A position on a delimiter belongs to the
+// cell it closes, one on the line break to the last cell of the line.
+struct CellLocation {
+    size_t line = 0;          // Index into lineDelimiterPositions
+    size_t column = 0;        // 1-based, 0 if column scope is not set up
+    Sci_Position start = 0;
+    Sci_Position end = 0;
+
+    // False for positions inside a multi-character delimiter or on the line break
+    bool contains(Sci_Position position) const {
+        return column > 0 && position >= start && position <= end;
+    }
+};
+
+// Lua Engine
+// Positions, lines, counts and columns are 64 bit like Sci_Position, documents can exceed 2 GB
+struct LuaVariables {
+    Sci_Position CNT = 0;
+    Sci_Position LINE = 0;
+    Sci_Position LPOS = 0;
+    Sci_Position LCNT = 0;
+    Sci_Position APOS = 0;
+    Sci_Position COL = 1;
+    std::string MATCH;
+};
+
+enum class LuaVariableType {
+    String,
+    Number,
+    Boolean,
+    None
+};
+
+struct LuaVariable {
+    std::string name;
+    LuaVariableType type;
+    std::string stringValue;
+    double numberValue;
+    bool booleanValue;
+
+    LuaVariable() : name(""), type(LuaVariableType::None), numberValue(0.0), booleanValue(false) {}
+};
+
+using LuaVariablesMap = std::map<std::string, LuaVariable>;
+
+// Scoped session for mass edits. While it is alive all edits form one undo action,
+// the view does not repaint and only insert/delete notifications are delivered.
+// Caret changes are applied once when it ends.
+class BulkEditTransaction {
+public:
+    explicit BulkEditTransaction(DocumentBackend& document, int modEventMask = SC_MOD_INSERTTEXT | SC_MOD_DELETETEXT);
+    ~BulkEditTransaction();
+
+    BulkEditTransaction(const BulkEditTransaction&) = delete;
+    BulkEditTransaction& operator=(const BulkEditTransaction&) = delete;
+
+    inline void setCaret(Sci_Position pos) {
+        deferredCaretPos = pos;
+    }
+
+private:
+    DocumentBackend& doc;
+    sptr_t previousModEventMask = SC_MODEVENTMASKALL;
+    Sci_Position deferredCaretPos = -1;
+};
+
+// Search, replace, mark, column and Lua logic of the plugin. It only talks to the
+// document through a DocumentBackend and never touches any UI, so the same code
+// runs inside Notepad++ and in the headless benchmarks.
+class MultiReplaceEngine
+{
+public:
+    explicit MultiReplaceEngine(DocumentBackend& document) : doc(document) {
+        literalSearch.cancellationCheck = &cancellationCheck;
+        fuzzySearch.cancellationCheck = &cancellationCheck;
+        foldedText.setCancellationCheck(&cancellationCheck);
+    }
+
+    MultiReplaceEngine(const MultiReplaceEngine&) = delete;
+    MultiReplaceEngine& operator=(const MultiReplaceEngine&) = delete;
+
+    static constexpr long MARKER_COLOR = 0x007F00; // Color for non-list Marker
+    static constexpr Sci_Position LINE_WINDOW_BYTES = 64 * 1024; // Per-line routines read and style long lines in windows of this size
+
+    EngineOptions options;
+
+    // Host hooks
+    std::function<std::string(const std::string&, int)> codepageConverter; // UTF-8 to document codepage, identity if unset
+    std::function<void(LuaErrorType, const std::string&)> luaErrorHandler; // Receives the Lua message or the failing script
+    std::function<bool()> cancellationCheck; // Polled by countString after each match and by the literal, fuzzy and folded scanners every 64 KB; never cancels if unset
+
+    // Style-related variables
+    std::vector<int> textStyles = { 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 30, 32, 33, 34, 35, 36, 37, 38, 39, 40, 41, 42, 43 };
+    std::unordered_map<long, int> colorToStyleMap;
+    size_t markedStringsCount = 0;
+
+    // Column-related variables
+    ColumnDelimiterData columnDelimiterData;
+    std::vector<LineInfo> lineDelimiterPositions;
+    Sci_Position eolLength = -1; // Stores the length of the EOL character sequence
+    size_t CSVheaderLinesCount = 1; // Number of header lines not included in CSV sorting
+
+    LuaVariablesMap globalLuaVariablesMap; // stores Lua Global Variables
+
+    OperationProfiler profiler; // Per-phase timing, disabled unless the host enables it
+    LuaMemoryTracker luaMemory; // Heap of the Lua states created by resolveLuaSyntax
+    MatchCache matchCache; // Whole-document match sets of the current document version
+    bool nativeLiteralSearch = true; // Literal rules are searched in the document buffer, not through SCI_SEARCHINTARGET
+    bool prefilterRegex = true;      // Regex rules only search lines that contain their required literal
+    RegexWatchdog regexWatchdog;     // Time budget of each regex rule, the host starts it per operation
+    bool unionRegex = false;         // Regex rules of a list are scanned together where RegexUnion can, off unless the host enables it
+
+    // Invalidates cached matches. The host calls it when the document changes, edits made by
+    // the engine itself are counted in send().
+    void notifyDocumentModified() {
+        ++documentVersion;
+        resetSearches();
+        foldedText.reset();
+        trigramIndex.reset();
+    }
+
+    // The same for SCN_MODIFIED, which also carries the edit over to the folded text and
+    // the trigram index. The prepared searches only depend on the code page and the word
+    // characters, not on the text, so they are kept: Replace All reports one edit per match.
+    void notifyTextModified(int modificationType, Sci_Position position, Sci_Position length, const char* text) {
+        ++documentVersion;
+        ++reportedEdits;
+        foldedText.update(doc, modificationType, position, length, text);
+        trigramIndex.update(modificationType, position, length);
+    }
+
+    // The host calls it before each operation, the word characters may have changed with the
+    // language of the document
+    void notifyPropertiesChanged() noexcept {
+        resetSearches();
+    }
+
+    uint64_t getDocumentVersion() const noexcept {
+        return documentVersion;
+    }
+
+    //Replace
+    void replaceAll(const ReplaceRule& rule, int& findCount, int& replaceCount, BulkEditTransaction& transaction);
+    void replaceAllList(const std::vector<ReplaceRule>& rules, std::vector<RuleCount>& counts, BulkEditTransaction& transaction);
+    void replaceInRanges(const std::vector<ReplaceRule>& rules, std::vector<SelectionRange>& ranges, std::vector<RuleCount>& counts);
+    static void followReplacement(std::vector<SelectionRange>& ranges, Sci_Position pos, Sci_Position length, Sci_Position newEnd);
+    bool replaceOne(const ReplaceRule& rule, const SelectionInfo& selection, SearchResult& searchResult, Sci_Position& newPos);
+    Sci_Position performReplace(const std::string& replaceTextUtf8, Sci_Position pos, Sci_Position length);
+    Sci_Position performRegexReplace(const std::string& replaceTextUtf8, Sci_Position pos, Sci_Position length);
+    SelectionInfo getSelectionInfo();
+    bool resolveLuaSyntax(std::string& inputString, const LuaVariables& vars, bool& skip, bool regex);
+
+    //Find
+    SearchResult performSingleSearch(const std::string& findTextUtf8, int searchFlags, bool selectMatch, SelectionRange range);
+    std::string getMatchText(const SearchResult& result); // Read on demand, search results only carry the range
+    SearchResult performSearchForward(const std::string& findTextUtf8, int searchFlags, bool selectMatch, Sci_Position start);
+    SearchResult performColumnSearchForward(const std::string& findTextUtf8, int searchFlags, bool selectMatch, Sci_Position start);
+    SearchResult performSearchBackward(const std::string& findTextUtf8, int searchFlags, Sci_Position start);
+    SearchResult performListSearchForward(const std::vector<ReplaceRule>& list, Sci_Position cursorPos, size_t& closestMatchIndex);
+    SearchResult performListSearchBackward(const std::vector<ReplaceRule>& list, Sci_Position cursorPos, size_t& closestMatchIndex);
+    void displayResultCentered(size_t posStart, size_t posEnd, bool isDownwards);
+    const std::vector<MatchInterval>* collectMatches(const std::string& findTextUtf8, int searchFlags);
+    void scanRegexRules(const std::vector<RuleSearch>& searches);
+    bool searchesWholeDocument(bool selectMatch) const;
+
+    //Mark
+    int markString(const std::string& findTextUtf8, int searchFlags);
+    int countString(const std::string& findTextUtf8, int searchFlags, int maxCount = std::numeric_limits<int>::max());
+    int countStringSlice(const std::string& findTextUtf8, int searchFlags, Sci_Position& from, Sci_Position sliceBytes);
+    void highlightTextRange(Sci_Position pos, Sci_Position len, const std::string& findTextUtf8);
+    long generateColorValue(const std::string& str);
+
+    //CSV
+    int deleteColumns();
+    std::string copyColumns(int& copiedFieldsCount);
+
+    //CSV Sort
+    std::vector<CombinedColumns> extractColumnData(size_t startLine, size_t lineCount);
+    bool sortRowsByColumn(SortDirection sortDirection, std::vector<size_t>& originalLineOrder);
+    void reorderLinesInScintilla(const std::vector<size_t>& sortedIndex);
+    void restoreOriginalLineOrder(const std::vector<size_t>& originalOrder);
+
+    //Scope
+    void findAllDelimitersInDocument();
+    void findDelimitersInLine(Sci_Position line);
+    CellLocation locateCell(Sci_Position position) const;
+    void updateDelimitersInDocument(size_t lineNumber, ChangeType changeType);
+
+    //Utilities
+    static int convertExtendedToString(const std::string& query, std::string& result);
+    static std::string convertAndExtend(const std::string& input, bool extended);
+    static bool normalizeAndValidateNumber(std::string& str);
+    Sci_Position getEOLLength();
+    std::string getEOLStyle();
+    std::string utf8ToCodepage(const std::string& utf8Str, int codepage) const;
+    sptr_t send(unsigned int iMessage, uptr_t wParam = 0, sptr_t lParam = 0);
+
+    //Memory
+    MemoryReport memoryUsage() const;
+    void releaseCaches();
+
+private:
+    DocumentBackend& doc;
+    uint64_t documentVersion = 0;
+    SelectionScope selectionScope; // Selections of the running Replace All or Mark
+    mutable size_t lastLocatedLine = 0; // Where locateCell starts looking
+    LiteralSearch literalSearch; // The rule last searched natively
+    RegexPrefilter regexPrefilter; // The regex rule last searched
+    FuzzySearch fuzzySearch; // The Fuzzy mode rule last searched
+    FoldedText foldedText; // Folded copy of the document while options.foldCharacters is set
+    TrigramIndex trigramIndex; // Built by the first list search while options.indexTrigrams is set
+    RegexUnion regexUnion; // Regex rules of the list last scanned together
+    std::map<std::pair<std::string, int>, std::vector<MatchInterval>> unionMatches; // Their matches, one set per rule
+    std::set<std::pair<std::string, int>> unionOversized; // Rules with too many matches to keep
+    uint64_t unionVersion = 0;
+    Sci_Position unionLength = -1;
+    uint64_t reportedEdits = 0; // Calls of notifyTextModified
+
+    void resetSearches() noexcept {
+        literalSearch.reset();
+        regexPrefilter.reset();
+        fuzzySearch.reset();
+    }
+
+    bool toFusedRule(const ReplaceRule& rule, FusedRule& fused, bool& foldsLetters);
+    void replaceFused(const FusedReplace& fused, const std::vector<size_t>& ruleIndexes, const std::vector<std::string>& replaceTexts,
+        std::vector<RuleCount>& counts);
+    Sci_Position matchReach(const ReplaceRule& rule, const std::string& findTextUtf8) const;
+    Sci_Position searchInRange(const std::string& findTextUtf8, int searchFlags, Sci_Position start, Sci_Position end, Sci_Position& matchEnd);
+    Sci_Position searchIndexed(const std::string& findTextUtf8, int searchFlags, Sci_Position start, Sci_Position end, Sci_Position& matchEnd);
+    Sci_Position searchRegex(const std::string& findTextUtf8, int searchFlags, Sci_Position start, Sci_Position end, Sci_Position& matchEnd);
+    Sci_Position searchWatched(const std::string& findTextUtf8, int searchFlags, Sci_Position start, Sci_Position end, Sci_Position& matchEnd);
+    Sci_Position searchInTarget(const std::string& findTextUtf8, int searchFlags, Sci_Position start, Sci_Position end, Sci_Position& matchEnd);
+    SearchResult makeSearchResult(Sci_Position pos, Sci_Position length, bool selectMatch);
+    const std::vector<MatchInterval>* cachedMatches(const std::string& findTextUtf8, int searchFlags) const;
+    const std::vector<MatchInterval>* scannedMatches(const std::string& findTextUtf8, int searchFlags) const;
+    bool isUnionCandidate(int searchFlags) const noexcept {
+        return (searchFlags & SCFIND_REGEXP) && !(searchFlags & (SCFIND_WHOLEWORD | SEARCH_FUZZY));
+    }
+    bool canUseMatchCache(const std::string& findTextUtf8, int searchFlags, bool backward) const;
+    int matchCacheFlags(int searchFlags) const noexcept {
+        return searchFlags | (options.foldCharacters ? SEARCH_FOLDED : 0);
+    }
+
+    //Lua
+    void captureLuaGlobals(lua_State* L);
+    void loadLuaGlobals(lua_State* L);
+    void setLuaVariable(lua_State* L, const std::string& varName, std::string value, bool regex);
+};
+
+#endif // MULTI_REPLACE_ENGINE_H
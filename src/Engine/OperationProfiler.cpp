@@ -0,0 +1,176 @@
+// This file is part of Notepad++ project
+// Copyright (C)2023 Thomas Knoefel
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "OperationProfiler.h"
+
+#include <cstdio>
+#include <fstream>
+
+namespace {
+
+    int64_t toNanoseconds(OperationProfiler::Clock::duration duration)
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+    }
+
+    std::string formatMilliseconds(int64_t nanoseconds)
+    {
+        char buffer[32];
+        if (nanoseconds < 10000000) {
+            std::snprintf(buffer, sizeof(buffer), "%.2f ms", static_cast<double>(nanoseconds) / 1000000.0);
+        }
+        else {
+            std::snprintf(buffer, sizeof(buffer), "%lld ms", static_cast<long long>(nanoseconds / 1000000));
+        }
+        return buffer;
+    }
+
+    // Trace timestamps are microseconds, fractions keep sub-microsecond phases visible
+    std::string formatMicroseconds(int64_t nanoseconds)
+    {
+        char buffer[32];
+        std::snprintf(buffer, sizeof(buffer), "%.3f", static_cast<double>(nanoseconds) / 1000.0);
+        return buffer;
+    }
+
+    std::string escapeJson(const std::string& text)
+    {
+        std::string result;
+        for (char ch : text) {
+            switch (ch) {
+            case '"': result += "\\\""; break;
+            case '\\': result += "\\\\"; break;
+            case '\n': result += "\\n"; break;
+            case '\r': result += "\\r"; break;
+            case '\t': result += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(ch) < 0x20) {
+                    char buffer[8];
+                    std::snprintf(buffer, sizeof(buffer), "\\u%04x", ch);
+                    result += buffer;
+                }
+                else {
+                    result += ch;
+                }
+            }
+        }
+        return result;
+    }
+
+}
+
+void OperationProfiler::beginOperation(const std::string& name)
+{
+    operation = name;
+    operationActive = true;
+    operationStart = Clock::now();
+    operationNanoseconds = 0;
+    phaseStats.clear();
+    traceEvents.clear();
+    droppedTraceEvents = 0;
+    scopeDepth = 0;
+}
+
+void OperationProfiler::endOperation()
+{
+    operationNanoseconds = toNanoseconds(Clock::now() - operationStart);
+    operationActive = false;
+}
+
+void OperationProfiler::addSample(const char* phase, Clock::time_point start, Clock::time_point end, int depth)
+{
+    const int64_t duration = toNanoseconds(end - start);
+
+    // Only a handful of phases exist, a linear scan beats hashing here
+    PhaseStats* stats = nullptr;
+    for (PhaseStats& entry : phaseStats) {
+        if (entry.name == phase) {
+            stats = &entry;
+            break;
+        }
+    }
+    if (!stats) {
+        phaseStats.push_back({ phase, 0, 0 });
+        stats = &phaseStats.back();
+    }
+    stats->totalNanoseconds += duration;
+    stats->count++;
+
+    if (traceEnabled) {
+        if (traceEvents.size() < MAX_TRACE_EVENTS) {
+            traceEvents.push_back({ phase, toNanoseconds(start - operationStart), duration, depth });
+        }
+        else {
+            droppedTraceEvents++;
+        }
+    }
+}
+
+void OperationProfiler::releaseTrace()
+{
+    if (!operationActive) {
+        std::vector<TraceEvent>().swap(traceEvents);
+    }
+}
+
+std::string OperationProfiler::summary() const
+{
+    std::string result = operation.empty() ? std::string("Operation") : operation;
+    result += " " + formatMilliseconds(operationNanoseconds);
+    if (phaseStats.empty()) {
+        return result;
+    }
+
+    result += ":";
+    bool first = true;
+    for (const PhaseStats& stats : phaseStats) {
+        result += first ? " " : ", ";
+        first = false;
+        result += stats.name;
+        result += " " + formatMilliseconds(stats.totalNanoseconds);
+        if (stats.count > 1) {
+            result += " (" + std::to_string(stats.count) + "x)";
+        }
+    }
+    return result;
+}
+
+bool OperationProfiler::writeChromeTrace(std::ostream& out) const
+{
+    const std::string operationName = escapeJson(operation.empty() ? std::string("Operation") : operation);
+    out << "{\"traceEvents\":[\n";
+    out << "{\"name\":\"" << operationName << "\",\"cat\":\"operation\",\"ph\":\"X\",\"ts\":0,\"dur\":"
+        << formatMicroseconds(operationNanoseconds) << ",\"pid\":1,\"tid\":1}";
+
+    for (const TraceEvent& event : traceEvents) {
+        out << ",\n{\"name\":\"" << escapeJson(event.name) << "\",\"cat\":\"phase\",\"ph\":\"X\",\"ts\":"
+            << formatMicroseconds(event.startNanoseconds) << ",\"dur\":" << formatMicroseconds(event.durationNanoseconds)
+            << ",\"pid\":1,\"tid\":1,\"args\":{\"depth\":" << event.depth << "}}";
+    }
+
+    out << "\n],\"displayTimeUnit\":\"ms\",\"otherData\":{\"operation\":\"" << operationName
+        << "\",\"droppedEvents\":" << droppedTraceEvents << "}}\n";
+    return out.good();
+}
+
+bool OperationProfiler::writeChromeTrace(const std::string& filePath) const
+{
+    std::ofstream outFile(filePath, std::ios::binary);
+    if (!outFile.is_open()) {
+        return false;
+    }
+    return writeChromeTrace(outFile);
+}
@@ -0,0 +1,141 @@
+// This file is part of Notepad++ project
+// Copyright (C)2023 Thomas Knoefel
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef OPERATION_PROFILER_H
+#define OPERATION_PROFILER_H
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Collects wall time and call counts per phase of a user operation such as
+// Replace All. Phase names must be string literals, they are compared by address.
+// While disabled a ProfileScope costs one branch.
+class OperationProfiler
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct PhaseStats {
+        const char* name = nullptr;
+        int64_t totalNanoseconds = 0;
+        size_t count = 0;
+    };
+
+    struct TraceEvent {
+        const char* name;
+        int64_t startNanoseconds; // Relative to the start of the operation
+        int64_t durationNanoseconds;
+        int depth;
+    };
+
+    static constexpr size_t MAX_TRACE_EVENTS = 1000000; // Bounds memory when tracing long operations
+
+    void setEnabled(bool enable) noexcept {
+        enabled = enable;
+    }
+
+    bool isEnabled() const noexcept {
+        return enabled;
+    }
+
+    // Trace events are only kept when tracing is on, the per-phase totals are always kept
+    void setTraceEnabled(bool enable) noexcept {
+        traceEnabled = enable;
+    }
+
+    void beginOperation(const std::string& name);
+    void endOperation();
+
+    bool isOperationActive() const noexcept {
+        return operationActive;
+    }
+
+    void addSample(const char* phase, Clock::time_point start, Clock::time_point end, int depth);
+
+    const std::string& operationName() const noexcept {
+        return operation;
+    }
+
+    int64_t operationDurationNanoseconds() const noexcept {
+        return operationNanoseconds;
+    }
+
+    const std::vector<PhaseStats>& phases() const noexcept {
+        return phaseStats;
+    }
+
+    // One line such as "Replace All 812 ms: search 400 ms (12000x), lua 300 ms (12000x)"
+    std::string summary() const;
+
+    // Writes the last operation as Chrome trace-event JSON (chrome://tracing, Perfetto)
+    bool writeChromeTrace(std::ostream& out) const;
+    bool writeChromeTrace(const std::string& filePath) const;
+
+    // Bytes held by the phase table and the trace buffer
+    size_t memoryBytes() const noexcept {
+        return phaseStats.capacity() * sizeof(PhaseStats) + traceEvents.capacity() * sizeof(TraceEvent);
+    }
+
+    // Frees the trace buffer of the last operation, the summary stays available
+    void releaseTrace();
+
+    int scopeDepth = 0; // Maintained by ProfileScope
+
+private:
+    bool enabled = false;
+    bool traceEnabled = false;
+    bool operationActive = false;
+    std::string operation;
+    Clock::time_point operationStart;
+    int64_t operationNanoseconds = 0;
+    std::vector<PhaseStats> phaseStats;
+    std::vector<TraceEvent> traceEvents;
+    size_t droppedTraceEvents = 0;
+};
+
+// Measures the enclosing block as one sample of the given phase
+class ProfileScope
+{
+public:
+    ProfileScope(OperationProfiler& profiler, const char* phase) noexcept
+        : profiler(profiler.isEnabled() ? &profiler : nullptr), phase(phase) {
+        if (this->profiler) {
+            depth = this->profiler->scopeDepth++;
+            start = OperationProfiler::Clock::now();
+        }
+    }
+
+    ~ProfileScope() {
+        if (profiler) {
+            profiler->addSample(phase, start, OperationProfiler::Clock::now(), depth);
+            profiler->scopeDepth--;
+        }
+    }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    OperationProfiler* profiler;
+    const char* phase;
+    OperationProfiler::Clock::time_point start;
+    int depth = 0;
+};
+
+#endif // OPERATION_PROFILER_H
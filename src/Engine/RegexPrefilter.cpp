@@ -0,0 +1,368 @@
+// This file is part of Notepad++ project
+// Copyright (C)2023 Thomas Knoefel
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "RegexPrefilter.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+namespace {
+
+    constexpr size_t NOT_FOUND = std::string::npos;
+
+    inline bool isAsciiAlnum(char ch) {
+        return (ch >= '0' && ch <= '9') || (ch >= 'A' && ch <= 'Z') || (ch >= 'a' && ch <= 'z');
+    }
+
+    // Index after the ']' of the class starting at i
+    size_t skipClass(const std::string& pattern, size_t i) {
+        size_t j = i + 1;
+        if (j < pattern.size() && pattern[j] == '^') {
+            ++j;
+        }
+        if (j < pattern.size() && pattern[j] == ']') {
+            ++j; // A leading ']' is a member
+        }
+        while (j < pattern.size()) {
+            if (pattern[j] == '\\') {
+                j += 2;
+            }
+            else if (pattern[j] == ']') {
+                return j + 1;
+            }
+            else {
+                ++j;
+            }
+        }
+        return NOT_FOUND;
+    }
+
+    // Index after the ')' closing the group starting at i
+    size_t skipGroup(const std::string& pattern, size_t i) {
+        size_t depth = 0;
+        size_t j = i;
+        while (j < pattern.size()) {
+            const char ch = pattern[j];
+            if (ch == '\\') {
+                j += 2;
+            }
+            else if (ch == '[') {
+                j = skipClass(pattern, j);
+                if (j == NOT_FOUND) {
+                    return NOT_FOUND;
+                }
+            }
+            else {
+                ++j;
+                if (ch == '(') {
+                    ++depth;
+                }
+                else if (ch == ')' && --depth == 0) {
+                    return j;
+                }
+            }
+        }
+        return NOT_FOUND;
+    }
+
+    // Checks the whole pattern for syntax that changes how the rest is read, returns false
+    // for it. singleLine is set if no match can contain a line end: '.' does not match one,
+    // the engine never sets SCFIND_REGEXP_DOTMATCHESNL, every escape that might is refused.
+    bool scanPattern(const std::string& pattern, bool& singleLine) {
+        singleLine = true;
+        const size_t n = pattern.size();
+        size_t i = 0;
+        while (i < n) {
+            const char ch = pattern[i];
+            if (static_cast<unsigned char>(ch) < 0x20) {
+                singleLine = false;
+                ++i;
+            }
+            else if (ch == '\\') {
+                if (i + 1 >= n || pattern[i + 1] == 'Q' || pattern[i + 1] == 'E') {
+                    return false;
+                }
+                // \s, \n, \R, \x0A, \p{...} and the like can match a line end, \z and \' only
+                // match at the end of the text and not at the end of a line
+                if ((isAsciiAlnum(pattern[i + 1]) && !std::strchr("dwSbBht123456789", pattern[i + 1])) ||
+                    pattern[i + 1] == '`' || pattern[i + 1] == '\'') {
+                    singleLine = false;
+                }
+                i += 2;
+            }
+            else if (ch == '[') {
+                const size_t next = skipClass(pattern, i);
+                if (next == NOT_FOUND) {
+                    return false;
+                }
+                if (i + 1 < n && pattern[i + 1] == '^') {
+                    singleLine = false; // Negated classes contain the line ends
+                }
+                for (size_t j = i + 1; j + 1 < next; ++j) {
+                    const char member = pattern[j];
+                    if (member == '\\' && (pattern[j + 1] == 'Q' || pattern[j + 1] == 'E')) {
+                        return false;
+                    }
+                    if (static_cast<unsigned char>(member) < 0x20 || (member == '[' && pattern[j + 1] == ':') ||
+                        (member == '\\' && isAsciiAlnum(pattern[j + 1]) && pattern[j + 1] != 'd' && pattern[j + 1] != 'w')) {
+                        singleLine = false;
+                    }
+                    if (member == '\\') {
+                        ++j;
+                    }
+                }
+                i = next;
+            }
+            else if (ch == '(' && i + 1 < n && pattern[i + 1] == '?') {
+                // Inline modifiers like (?i) and (?x) and comments
+                if (i + 2 >= n || !std::strchr(":=!<>", pattern[i + 2])) {
+                    return false;
+                }
+                i += 2;
+            }
+            else {
+                ++i;
+            }
+        }
+        return true;
+    }
+
+    size_t saturatingAdd(size_t a, size_t b) {
+        return (a > RegexPrefilter::UNBOUNDED - b) ? RegexPrefilter::UNBOUNDED : a + b;
+    }
+
+    size_t saturatingMultiply(size_t a, size_t b) {
+        return (a != 0 && b > RegexPrefilter::UNBOUNDED / a) ? RegexPrefilter::UNBOUNDED : a * b;
+    }
+
+}
+
+RegexPrefilter::RequiredLiteral RegexPrefilter::requiredLiteral(const std::string& pattern)
+{
+    RequiredLiteral result;
+    bool singleLine = false;
+    if (!scanPattern(pattern, singleLine)) {
+        return result;
+    }
+
+    // Only the top level is looked at, every group, class and escape ends a literal run.
+    // A run also ends at a quantifier, and loses its last atom if that atom is optional.
+    // offset is the most bytes the atoms before the current one can match.
+    constexpr size_t MAX_CHARACTER_BYTES = 4;
+    std::string run;
+    size_t runOffset = 0;
+    size_t offset = 0;
+    auto endRun = [&]() {
+        if (run.size() > result.text.size()) {
+            result.text = run;
+            result.maxOffset = runOffset;
+        }
+        run.clear();
+    };
+
+    const size_t n = pattern.size();
+    size_t i = 0;
+    while (i < n) {
+        const char ch = pattern[i];
+        std::string atom;        // The text the atom matches, empty if it is no literal
+        size_t atomBytes = 0;    // Most bytes one repetition of the atom can match
+
+        switch (ch) {
+        case '|':
+            return RequiredLiteral(); // Alternatives need not share a literal
+        case ')':
+        case ']':
+        case '}':
+        case '*':
+        case '+':
+        case '?':
+        case '{':
+            return RequiredLiteral();
+        case '[':
+            i = skipClass(pattern, i);
+            atomBytes = MAX_CHARACTER_BYTES;
+            break;
+        case '(':
+            i = skipGroup(pattern, i);
+            atomBytes = UNBOUNDED;
+            break;
+        case '\\': {
+            const char escaped = pattern[i + 1];
+            if (std::strchr("bBAzZG", escaped)) {
+                atomBytes = 0; // Assertions
+            }
+            else if (std::strchr("dDwWsShHvVtnrfea<>`'", escaped)) {
+                atomBytes = MAX_CHARACTER_BYTES; // One character, or an assertion in Boost
+            }
+            else if (escaped >= '1' && escaped <= '9' && !std::isdigit(static_cast<unsigned char>(pattern[i + 2]))) {
+                atomBytes = UNBOUNDED; // Back reference
+            }
+            else if (static_cast<unsigned char>(escaped) < 0x80 && !isAsciiAlnum(escaped)) {
+                atom.assign(1, escaped); // Escaped punctuation stands for itself
+                atomBytes = 1;
+            }
+            else {
+                return RequiredLiteral(); // Escapes with arguments like \x41 or \cA
+            }
+            i += 2;
+            break;
+        }
+        case '.':
+            atomBytes = MAX_CHARACTER_BYTES;
+            ++i;
+            break;
+        case '^':
+        case '$':
+            ++i;
+            break;
+        default:
+            if (static_cast<unsigned char>(ch) >= 0x80) {
+                // A quantifier applies to the whole character, whatever the code page is
+                const size_t start = i;
+                while (i < n && static_cast<unsigned char>(pattern[i]) >= 0x80) {
+                    ++i;
+                }
+                atom = pattern.substr(start, i - start);
+            }
+            else {
+                atom.assign(1, ch);
+                ++i;
+            }
+            atomBytes = atom.size();
+            break;
+        }
+        if (i == NOT_FOUND) {
+            return RequiredLiteral();
+        }
+
+        bool quantified = false;
+        bool optional = false;
+        size_t maxRepeat = 1;
+        if (i < n && (pattern[i] == '*' || pattern[i] == '?' || pattern[i] == '+')) {
+            quantified = true;
+            optional = pattern[i] != '+';
+            maxRepeat = (pattern[i] == '?') ? 1 : UNBOUNDED;
+            ++i;
+        }
+        else if (i < n && pattern[i] == '{') {
+            const size_t close = pattern.find('}', i);
+            if (close == NOT_FOUND || !std::isdigit(static_cast<unsigned char>(pattern[i + 1])) ||
+                pattern.find_first_not_of("0123456789,", i + 1) != close) {
+                return RequiredLiteral();
+            }
+            const size_t comma = pattern.find(',', i);
+            const std::string minText = pattern.substr(i + 1, std::min(comma, close) - i - 1);
+            const std::string maxText = (comma < close) ? pattern.substr(comma + 1, close - comma - 1) : minText;
+            quantified = true;
+            optional = minText.find_first_not_of('0') == std::string::npos;
+            maxRepeat = (maxText.empty() || maxText.size() > 9) ? UNBOUNDED : std::stoul(maxText);
+            i = close + 1;
+        }
+        if (quantified && i < n && (pattern[i] == '?' || pattern[i] == '+')) {
+            ++i; // Lazy or possessive
+        }
+
+        if (atom.empty() || optional) {
+            endRun();
+        }
+        else {
+            if (run.empty()) {
+                runOffset = offset;
+            }
+            run += atom;
+            if (quantified) {
+                endRun(); // A repeated atom is followed by more of itself
+            }
+        }
+        offset = saturatingAdd(offset, saturatingMultiply(atomBytes, maxRepeat));
+    }
+    endRun();
+    result.singleLine = singleLine;
+    return result;
+}
+
+bool RegexPrefilter::prepare(DocumentBackend& doc, const std::string& findTextUtf8, int flags)
+{
+    if (prepared && flags == searchFlags && findTextUtf8 == pattern) {
+        return usable;
+    }
+    prepared = true;
+    usable = false;
+    pattern = findTextUtf8;
+    searchFlags = flags;
+
+    // With Unicode line ends a line can end in characters the pattern might match
+    if (!(flags & SCFIND_REGEXP) || doc.send(SCI_GETLINEENDTYPESACTIVE, 0, 0) != SC_LINE_END_TYPE_DEFAULT) {
+        return false;
+    }
+    required = requiredLiteral(pattern);
+    if (required.text.empty() || (!required.singleLine && required.maxOffset == UNBOUNDED)) {
+        return false;
+    }
+    usable = literalSearch.prepare(doc, required.text, flags & SCFIND_MATCHCASE);
+    return usable;
+}
+
+void RegexPrefilter::find(DocumentBackend& doc, Sci_Position start, Sci_Position end, Sci_Position& pos, Sci_Position& matchEnd)
+{
+    Sci_Position from = start;
+    while (from < end) {
+        Sci_Position candidate = -1;
+        if (!literalSearch.find(doc, from, end, candidate)) {
+            searchTarget(doc, from, end, pos, matchEnd); // The literal search cannot decide, search the rest
+            return;
+        }
+        if (candidate < 0) {
+            break;
+        }
+
+        if (!required.singleLine) {
+            // No match starts more than maxOffset before the first literal, search from there
+            Sci_Position searchStart = from;
+            if (candidate - from > static_cast<Sci_Position>(required.maxOffset)) {
+                searchStart = std::max(from, static_cast<Sci_Position>(doc.send(SCI_POSITIONBEFORE, candidate - required.maxOffset, 0)));
+            }
+            searchTarget(doc, searchStart, end, pos, matchEnd);
+            return;
+        }
+
+        // The first match is on this line, if there is one on it
+        const Sci_Position line = doc.send(SCI_LINEFROMPOSITION, candidate, 0);
+        const Sci_Position lineStart = std::max(from, static_cast<Sci_Position>(doc.send(SCI_POSITIONFROMLINE, line, 0)));
+        const Sci_Position lineEnd = std::min(end, static_cast<Sci_Position>(doc.send(SCI_GETLINEENDPOSITION, line, 0)));
+        searchTarget(doc, lineStart, lineEnd, pos, matchEnd);
+        if (pos >= 0) {
+            return;
+        }
+
+        const Sci_Position nextLine = doc.send(SCI_POSITIONFROMLINE, line + 1, 0);
+        if (nextLine <= candidate) {
+            break;
+        }
+        from = nextLine;
+    }
+    pos = -1;
+    matchEnd = -1;
+}
+
+void RegexPrefilter::searchTarget(DocumentBackend& doc, Sci_Position start, Sci_Position end, Sci_Position& pos, Sci_Position& matchEnd) const
+{
+    doc.send(SCI_SETTARGETRANGE, start, end);
+    doc.send(SCI_SETSEARCHFLAGS, searchFlags, 0);
+    pos = doc.send(SCI_SEARCHINTARGET, pattern.length(), reinterpret_cast<sptr_t>(pattern.c_str()));
+    matchEnd = (pos >= 0) ? doc.send(SCI_GETTARGETEND, 0, 0) : -1;
+}
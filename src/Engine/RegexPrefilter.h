@@ -0,0 +1,67 @@
+// This file is part of Notepad++ project
+// Copyright (C)2023 Thomas Knoefel
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef REGEX_PREFILTER_H
+#define REGEX_PREFILTER_H
+
+#include "DocumentBackend.h"
+#include "LiteralSearch.h"
+
+#include <string>
+
+// Narrows regex searches down with a literal every match has to contain, which is found
+// natively. For patterns that cannot match a line end, the regex only runs on the lines
+// that contain the literal. Otherwise the regex search starts where the first match
+// containing the literal can start at the earliest.
+class RegexPrefilter
+{
+public:
+    static constexpr size_t UNBOUNDED = static_cast<size_t>(-1);
+
+    struct RequiredLiteral {
+        std::string text;              // Empty if there is none
+        size_t maxOffset = UNBOUNDED;  // Most bytes a match can have before the literal
+        bool singleLine = false;       // No match can contain a line end
+    };
+
+    // The longest literal every match contains. Empty if there is none or if the pattern
+    // uses syntax this parser does not know.
+    static RequiredLiteral requiredLiteral(const std::string& pattern);
+
+    // False if the rule is no regular expression or has no usable literal
+    bool prepare(DocumentBackend& doc, const std::string& findTextUtf8, int searchFlags);
+
+    // Forward search in [start, end) of a prepared rule, like SCI_SEARCHINTARGET.
+    // Leaves the target on the match; pos and matchEnd are -1 if there is none.
+    void find(DocumentBackend& doc, Sci_Position start, Sci_Position end, Sci_Position& pos, Sci_Position& matchEnd);
+
+    void reset() noexcept {
+        prepared = false;
+        literalSearch.reset();
+    }
+
+private:
+    void searchTarget(DocumentBackend& doc, Sci_Position start, Sci_Position end, Sci_Position& pos, Sci_Position& matchEnd) const;
+
+    std::string pattern;
+    int searchFlags = 0;
+    bool prepared = false;
+    bool usable = false;
+    RequiredLiteral required;
+    LiteralSearch literalSearch; // Searches the required literal
+};
+
+#endif // REGEX_PREFILTER_H
@@ -0,0 +1,925 @@
+// This file is part of Notepad++ project
+// Copyright (C)2023 Thomas Knoefel
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "RegexUnion.h"
+
+#include <algorithm>
+#include <cctype>
+
+namespace {
+
+    inline bool isWordByte(unsigned char ch) noexcept {
+        return (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || (ch >= '0' && ch <= '9') || ch == '_';
+    }
+
+    inline bool isHexDigit(char ch) noexcept {
+        return (ch >= '0' && ch <= '9') || (ch >= 'a' && ch <= 'f') || (ch >= 'A' && ch <= 'F');
+    }
+
+    inline int hexValue(char ch) noexcept {
+        return (ch <= '9') ? ch - '0' : (ch | 0x20) - 'a' + 10;
+    }
+
+    enum AssertionKind { LineStart, LineEnd, WordBoundary, NotWordBoundary };
+
+    // Syntax tree of a pattern
+    struct Node {
+        enum Kind { Set, Concat, Alternation, Repeat, Assertion } kind = Concat;
+        std::bitset<256> bytes;   // Set
+        AssertionKind assertion = LineStart;
+        std::vector<Node> children;
+        int min = 0;              // Repeat
+        int max = 0;              // Repeat, -1 for no limit
+        bool greedy = true;       // Repeat
+    };
+
+    bool isNullable(const Node& node) {
+        switch (node.kind) {
+        case Node::Set:
+            return false;
+        case Node::Assertion:
+            return true;
+        case Node::Concat:
+            return std::all_of(node.children.begin(), node.children.end(), isNullable);
+        case Node::Alternation:
+            return std::any_of(node.children.begin(), node.children.end(), isNullable);
+        case Node::Repeat:
+            return node.min == 0 || isNullable(node.children.front());
+        }
+        return true;
+    }
+
+    // True if a repeated part can match the empty text, backtracking engines treat such
+    // iterations differently from a Pike VM
+    bool repeatsNullable(const Node& node) {
+        if (node.kind == Node::Repeat && isNullable(node.children.front())) {
+            return true;
+        }
+        return std::any_of(node.children.begin(), node.children.end(), repeatsNullable);
+    }
+
+    // Recursive descent over the supported subset; parse() returns false for anything else
+    class Parser {
+    public:
+        static constexpr int MAX_DEPTH = 100;
+
+        Parser(const std::string& pattern, bool matchCase, bool utf8)
+            : pattern(pattern), matchCase(matchCase), utf8(utf8) {}
+
+        bool parse(Node& root) {
+            return parseAlternation(root, 0) && pos == pattern.size();
+        }
+
+        bool needsAscii = false;       // Classes, '.', \b or case folding decide about non-ASCII characters
+        bool needsNoFormFeed = false;  // '.', ^ and $ treat a form feed as a line end in one engine only
+        bool needsNoCr = false;        // ^ and $ around CR LF differ between the engines
+
+    private:
+        char peek() const {
+            return pos < pattern.size() ? pattern[pos] : '\0';
+        }
+
+        bool atEnd() const {
+            return pos >= pattern.size();
+        }
+
+        bool parseAlternation(Node& node, int depth) {
+            if (depth > MAX_DEPTH) {
+                return false;
+            }
+            node.kind = Node::Alternation;
+            while (true) {
+                Node branch;
+                if (!parseConcat(branch, depth)) {
+                    return false;
+                }
+                node.children.push_back(std::move(branch));
+                if (atEnd() || peek() != '|') {
+                    break;
+                }
+                ++pos;
+            }
+            if (node.children.size() == 1) {
+                Node single = std::move(node.children.front());
+                node = std::move(single);
+            }
+            return true;
+        }
+
+        bool parseConcat(Node& node, int depth) {
+            node.kind = Node::Concat;
+            while (!atEnd() && peek() != '|' && peek() != ')') {
+                Node atom;
+                if (!parseAtom(atom, depth) || !parseQuantifier(atom)) {
+                    return false;
+                }
+                node.children.push_back(std::move(atom));
+            }
+            return true;
+        }
+
+        bool parseQuantifier(Node& atom) {
+            int min = 0;
+            int max = 0;
+            const char ch = peek();
+            if (ch == '*') {
+                max = -1;
+                ++pos;
+            }
+            else if (ch == '+') {
+                min = 1;
+                max = -1;
+                ++pos;
+            }
+            else if (ch == '?') {
+                max = 1;
+                ++pos;
+            }
+            else if (ch == '{') {
+                if (!parseCount(min, max)) {
+                    return false;
+                }
+            }
+            else {
+                return true;
+            }
+            if (atom.kind == Node::Assertion) {
+                return false;
+            }
+
+            bool greedy = true;
+            if (peek() == '?') {
+                greedy = false;
+                ++pos;
+            }
+            // Possessive quantifiers and stacked ones are left to Scintilla
+            if (peek() == '+' || peek() == '*' || peek() == '?' || peek() == '{') {
+                return false;
+            }
+            // So are lazy bounded ones, Boost skips start positions before some of them
+            if (!greedy && max >= 0 && max != min) {
+                return false;
+            }
+
+            Node repeat;
+            repeat.kind = Node::Repeat;
+            repeat.min = min;
+            repeat.max = max;
+            repeat.greedy = greedy;
+            repeat.children.push_back(std::move(atom));
+            atom = std::move(repeat);
+            return true;
+        }
+
+        bool parseNumber(int& value) {
+            const size_t start = pos;
+            value = 0;
+            while (!atEnd() && peek() >= '0' && peek() <= '9') {
+                value = value * 10 + (peek() - '0');
+                if (value > RegexUnion::MAX_REPEAT) {
+                    return false;
+                }
+                ++pos;
+            }
+            return pos > start;
+        }
+
+        bool parseCount(int& min, int& max) {
+            ++pos;
+            if (!parseNumber(min)) {
+                return false;
+            }
+            max = min;
+            if (peek() == ',') {
+                ++pos;
+                if (peek() == '}') {
+                    max = -1;
+                }
+                else if (!parseNumber(max) || max < min) {
+                    return false;
+                }
+            }
+            if (peek() != '}') {
+                return false;
+            }
+            ++pos;
+            return true;
+        }
+
+        void addByte(std::bitset<256>& bytes, unsigned char ch) {
+            bytes.set(ch);
+            if (!matchCase && ((ch | 0x20) >= 'a' && (ch | 0x20) <= 'z')) {
+                bytes.set(ch ^ 0x20);
+                needsAscii = true;
+            }
+        }
+
+        // \d, \w and \s, set to the bytes of the class
+        bool classEscape(char ch, std::bitset<256>& bytes) {
+            switch (ch | 0x20) {
+            case 'd':
+                for (int c = '0'; c <= '9'; ++c) bytes.set(c);
+                break;
+            case 'w':
+                for (int c = 0; c < 128; ++c) if (isWordByte(static_cast<unsigned char>(c))) bytes.set(c);
+                break;
+            case 's':
+                for (char c : { ' ', '\t', '\n', '\v', '\f', '\r' }) bytes.set(static_cast<unsigned char>(c));
+                break;
+            default:
+                return false;
+            }
+            needsAscii = true;
+            if (ch >= 'A' && ch <= 'Z') {
+                bytes.flip();
+            }
+            return true;
+        }
+
+        // A single character escape such as \t, \x41 or \. as its byte
+        bool characterEscape(unsigned char& value) {
+            const char ch = peek();
+            switch (ch) {
+            case 't': value = '\t'; break;
+            case 'n': value = '\n'; break;
+            case 'r': value = '\r'; break;
+            case 'f': value = '\f'; break;
+            case 'x':
+                if (pos + 2 >= pattern.size() || !isHexDigit(pattern[pos + 1]) || !isHexDigit(pattern[pos + 2])) {
+                    return false;
+                }
+                value = static_cast<unsigned char>(hexValue(pattern[pos + 1]) * 16 + hexValue(pattern[pos + 2]));
+                if (value >= 0x80) {
+                    return false;
+                }
+                pos += 2;
+                break;
+            default:
+                // Escaped punctuation stands for itself, letters and digits have meanings
+                if (static_cast<unsigned char>(ch) >= 0x80 || std::isalnum(static_cast<unsigned char>(ch)) || ch < 0x20) {
+                    return false;
+                }
+                value = static_cast<unsigned char>(ch);
+                break;
+            }
+            ++pos;
+            return true;
+        }
+
+        bool parseAtom(Node& node, int depth) {
+            const unsigned char ch = static_cast<unsigned char>(peek());
+            node.kind = Node::Set;
+            switch (ch) {
+            case '(':
+                ++pos;
+                if (peek() == '?') {
+                    if (pos + 1 >= pattern.size() || pattern[pos + 1] != ':') {
+                        return false; // Lookarounds, modifiers, atomic groups
+                    }
+                    pos += 2;
+                }
+                if (!parseAlternation(node, depth + 1) || peek() != ')') {
+                    return false;
+                }
+                ++pos;
+                return true;
+            case '[':
+                return parseClass(node);
+            case '.':
+                ++pos;
+                node.bytes.set();
+                node.bytes.reset('\n');
+                node.bytes.reset('\r');
+                needsAscii = true;
+                needsNoFormFeed = true;
+                return true;
+            case '^':
+            case '$':
+                ++pos;
+                node.kind = Node::Assertion;
+                node.assertion = (ch == '^') ? LineStart : LineEnd;
+                needsNoCr = true;
+                needsNoFormFeed = true;
+                return true;
+            case '\\':
+                ++pos;
+                if (atEnd()) {
+                    return false;
+                }
+                if (peek() == 'b' || peek() == 'B') {
+                    node.kind = Node::Assertion;
+                    node.assertion = (peek() == 'b') ? WordBoundary : NotWordBoundary;
+                    needsAscii = true;
+                    ++pos;
+                    return true;
+                }
+                if (classEscape(peek(), node.bytes)) {
+                    ++pos;
+                    return true;
+                }
+                {
+                    unsigned char value = 0;
+                    if (!characterEscape(value)) {
+                        return false;
+                    }
+                    addByte(node.bytes, value);
+                }
+                return true;
+            case ')':
+            case ']':
+            case '{':
+            case '}':
+            case '*':
+            case '+':
+            case '?':
+                return false;
+            default:
+                break;
+            }
+
+            if (ch < 0x80) {
+                addByte(node.bytes, ch);
+                ++pos;
+                return true;
+            }
+
+            // A multi-byte character is matched byte by byte and repeated as a whole
+            if (!utf8 || !matchCase) {
+                return false;
+            }
+            const size_t length = (ch >= 0xF0) ? 4 : (ch >= 0xE0) ? 3 : (ch >= 0xC0) ? 2 : 0;
+            if (length == 0 || pos + length > pattern.size()) {
+                return false;
+            }
+            node.kind = Node::Concat;
+            for (size_t k = 0; k < length; ++k) {
+                const unsigned char byte = static_cast<unsigned char>(pattern[pos + k]);
+                if (k > 0 && (byte & 0xC0) != 0x80) {
+                    return false;
+                }
+                Node part;
+                part.kind = Node::Set;
+                part.bytes.set(byte);
+                node.children.push_back(std::move(part));
+            }
+            pos += length;
+            return true;
+        }
+
+        bool parseClass(Node& node) {
+            ++pos;
+            bool negated = false;
+            if (peek() == '^') {
+                negated = true;
+                ++pos;
+            }
+            // A leading ']' is a member in one engine and ends an empty class in the other
+            if (peek() == ']') {
+                return false;
+            }
+            while (!atEnd() && peek() != ']') {
+                unsigned char first = 0;
+                if (peek() == '[') {
+                    return false; // POSIX classes and the like
+                }
+                if (peek() == '\\') {
+                    ++pos;
+                    if (atEnd()) {
+                        return false;
+                    }
+                    const char escaped = peek();
+                    if (escaped == 'd' || escaped == 'w' || escaped == 's') {
+                        classEscape(escaped, node.bytes);
+                        ++pos;
+                        continue;
+                    }
+                    if (escaped == 'b' || !characterEscape(first)) {
+                        return false;
+                    }
+                }
+                else {
+                    first = static_cast<unsigned char>(peek());
+                    if (first >= 0x80) {
+                        return false;
+                    }
+                    ++pos;
+                }
+
+                unsigned char last = first;
+                if (peek() == '-' && pos + 1 < pattern.size() && pattern[pos + 1] != ']') {
+                    ++pos;
+                    if (peek() == '\\') {
+                        ++pos;
+                        if (atEnd() || !characterEscape(last)) {
+                            return false;
+                        }
+                    }
+                    else {
+                        last = static_cast<unsigned char>(peek());
+                        if (last >= 0x80 || last == '[') {
+                            return false;
+                        }
+                        ++pos;
+                    }
+                    if (last < first) {
+                        return false;
+                    }
+                }
+                for (int c = first; c <= last; ++c) {
+                    addByte(node.bytes, static_cast<unsigned char>(c));
+                }
+            }
+            if (atEnd()) {
+                return false;
+            }
+            ++pos;
+            if (negated) {
+                node.bytes.flip();
+                needsAscii = true;
+            }
+            return node.bytes.any();
+        }
+
+        const std::string& pattern;
+        bool matchCase;
+        bool utf8;
+        size_t pos = 0;
+    };
+
+}
+
+RegexUnion::TextTraits RegexUnion::traitsOf(const char* text, Sci_Position length)
+{
+    TextTraits traits;
+    const char* end = text + length;
+    for (const char* p = text; p < end; ++p) {
+        const unsigned char ch = static_cast<unsigned char>(*p);
+        if (ch >= 0x80) {
+            traits.ascii = false;
+        }
+        else if (ch == '\r') {
+            traits.hasCr = true;
+        }
+        else if (ch == '\f') {
+            traits.hasFormFeed = true;
+        }
+    }
+    return traits;
+}
+
+void RegexUnion::clear()
+{
+    program.clear();
+    byteSets.clear();
+    ruleStarts.clear();
+    firstBytes.clear();
+}
+
+// Appends the instructions of one rule. The instruction after a node is the one emitted
+// next, so only splits and jumps need their targets patched.
+class RegexUnion::Compiler
+{
+public:
+    Compiler(RegexUnion& target, int32_t rule)
+        : target(target), rule(rule), first(target.program.size()) {}
+
+    bool emit(const Node& node) {
+        if (target.program.size() - first > MAX_RULE_INSTRUCTIONS) {
+            return false;
+        }
+        switch (node.kind) {
+        case Node::Set:
+            target.byteSets.push_back(node.bytes);
+            append(Op::Byte, here() + 1, static_cast<int32_t>(target.byteSets.size() - 1));
+            return true;
+        case Node::Assertion:
+            append(assertionOp(node.assertion), here() + 1, -1);
+            return true;
+        case Node::Concat:
+            for (const Node& child : node.children) {
+                if (!emit(child)) {
+                    return false;
+                }
+            }
+            return true;
+        case Node::Alternation:
+            return emitAlternation(node);
+        case Node::Repeat:
+            return emitRepeat(node);
+        }
+        return false;
+    }
+
+    void finish() {
+        append(Op::Match, -1, -1);
+    }
+
+private:
+    static Op assertionOp(AssertionKind kind) {
+        switch (kind) {
+        case LineStart: return Op::LineStart;
+        case LineEnd: return Op::LineEnd;
+        case WordBoundary: return Op::WordBoundary;
+        default: return Op::NotWordBoundary;
+        }
+    }
+
+    int32_t here() const {
+        return static_cast<int32_t>(target.program.size());
+    }
+
+    int32_t append(Op op, int32_t next, int32_t other) {
+        target.program.push_back({ op, next, other, rule });
+        return here() - 1;
+    }
+
+    // Each branch but the last is tried first through a split, all jump to the end
+    bool emitAlternation(const Node& node) {
+        std::vector<int32_t> jumps;
+        for (size_t i = 0; i < node.children.size(); ++i) {
+            const bool last = i + 1 == node.children.size();
+            const int32_t split = last ? -1 : append(Op::Split, here() + 1, -1);
+            if (!emit(node.children[i])) {
+                return false;
+            }
+            if (!last) {
+                jumps.push_back(append(Op::Jump, -1, -1));
+                target.program[split].other = here();
+            }
+        }
+        for (int32_t jump : jumps) {
+            target.program[jump].next = here();
+        }
+        return true;
+    }
+
+    // The required copies, then a loop or nested optional copies. A greedy split prefers
+    // another iteration, a lazy one leaving.
+    bool emitRepeat(const Node& node) {
+        const Node& child = node.children.front();
+        for (int i = 0; i < node.min; ++i) {
+            if (!emit(child)) {
+                return false;
+            }
+        }
+
+        auto setBranches = [&](int32_t split, int32_t body, int32_t exit) {
+            target.program[split].next = node.greedy ? body : exit;
+            target.program[split].other = node.greedy ? exit : body;
+        };
+        if (node.max < 0) {
+            const int32_t loop = append(Op::Split, -1, -1);
+            if (!emit(child)) {
+                return false;
+            }
+            append(Op::Jump, loop, -1);
+            setBranches(loop, loop + 1, here());
+            return true;
+        }
+
+        std::vector<int32_t> splits;
+        for (int i = node.min; i < node.max; ++i) {
+            splits.push_back(append(Op::Split, -1, -1));
+            if (!emit(child)) {
+                return false;
+            }
+        }
+        for (int32_t split : splits) {
+            setBranches(split, split + 1, here());
+        }
+        return true;
+    }
+
+    RegexUnion& target;
+    int32_t rule;
+    size_t first;
+};
+
+bool RegexUnion::add(const std::string& pattern, bool matchCase, int codePage, const TextTraits& traits)
+{
+    // In DBCS documents trail bytes can look like ASCII characters
+    const bool utf8 = codePage == SC_CP_UTF8;
+    if (codePage != 0 && !utf8 && !traits.ascii) {
+        return false;
+    }
+
+    Parser parser(pattern, matchCase, utf8);
+    Node root;
+    if (pattern.empty() || !parser.parse(root) || isNullable(root) || repeatsNullable(root)) {
+        return false;
+    }
+    if ((parser.needsAscii && !traits.ascii) || (parser.needsNoCr && traits.hasCr) || (parser.needsNoFormFeed && traits.hasFormFeed)) {
+        return false;
+    }
+
+    const size_t programSize = program.size();
+    const size_t setCount = byteSets.size();
+    Compiler compiler(*this, static_cast<int32_t>(ruleStarts.size()));
+    if (!compiler.emit(root)) {
+        program.resize(programSize);
+        byteSets.resize(setCount);
+        return false;
+    }
+    compiler.finish();
+    ruleStarts.push_back(static_cast<int32_t>(programSize));
+
+    // Every match consumes a byte first, the assertions before it are assumed to hold
+    std::bitset<256> bytes;
+    std::vector<bool> seen(program.size() - programSize, false);
+    std::vector<int32_t> pending{ static_cast<int32_t>(programSize) };
+    while (!pending.empty()) {
+        const int32_t pc = pending.back();
+        pending.pop_back();
+        if (seen[pc - programSize]) {
+            continue;
+        }
+        seen[pc - programSize] = true;
+        const Instruction& instruction = program[pc];
+        if (instruction.op == Op::Byte) {
+            bytes |= byteSets[instruction.other];
+        }
+        else if (instruction.op == Op::Split) {
+            pending.push_back(instruction.next);
+            pending.push_back(instruction.other);
+        }
+        else if (instruction.op != Op::Match) {
+            pending.push_back(instruction.next);
+        }
+    }
+    firstBytes.push_back(bytes);
+    return true;
+}
+
+// Pike VM over all rules at once. Threads are kept in priority order per rule; a thread
+// that reaches the end of its rule records a candidate and drops the rule's threads of
+// lower priority. A rule without threads left reports its candidate and searches on from
+// its end, catching up alone if the scan has moved past it.
+class RegexUnion::Scanner
+{
+public:
+    Scanner(const RegexUnion& target, const char* text, Sci_Position length, size_t maxMatches,
+        std::vector<std::vector<MatchInterval>>& matches, std::vector<bool>& oversized)
+        : target(target), text(reinterpret_cast<const unsigned char*>(text)), length(length), maxMatches(maxMatches),
+        matches(matches), oversized(oversized), visited(target.program.size(), 0), rules(target.ruleStarts.size()) {
+        for (size_t rule = 0; rule < target.firstBytes.size(); ++rule) {
+            for (int byte = 0; byte < 256; ++byte) {
+                if (target.firstBytes[rule][byte]) {
+                    seedRules[byte].push_back(static_cast<int32_t>(rule));
+                }
+            }
+        }
+    }
+
+    void run() {
+        std::vector<Thread> current;
+        std::vector<Thread> next;
+        uint32_t currentId = ++lastListId;
+        for (Sci_Position pos = 0; pos < length; ++pos) {
+            if (current.empty()) {
+                while (pos < length && seedRules[text[pos]].empty()) {
+                    ++pos;
+                }
+                if (pos == length) {
+                    break;
+                }
+            }
+            for (int32_t rule : seedRules[text[pos]]) {
+                if (canStart(rule, pos)) {
+                    addThread(current, currentId, target.ruleStarts[rule], pos, pos);
+                }
+            }
+
+            next.clear();
+            const uint32_t nextId = ++lastListId;
+            step(current, next, nextId, pos);
+            finishRules(pos + 1, next, nextId);
+            current.swap(next);
+            currentId = nextId;
+        }
+
+        // No thread gets past the end of the text
+        std::vector<Thread> rest;
+        for (size_t i = 0; i < pendingRules.size(); ++i) {
+            const int32_t rule = pendingRules[i];
+            while (rules[rule].pending) {
+                report(rule);
+                if (rules[rule].restart < length) {
+                    rest.clear();
+                    runRule(rule, rules[rule].restart, length, rest, ++lastListId);
+                }
+            }
+        }
+    }
+
+private:
+    struct Thread {
+        int32_t pc;
+        Sci_Position start;
+    };
+
+    struct RuleState {
+        Sci_Position candidateStart = -1;
+        Sci_Position candidateEnd = -1;
+        Sci_Position restart = 0;  // Where the rule's next search starts
+        uint32_t cutList = 0;      // List in which the rule found its candidate
+        uint32_t countList = 0;    // List threadCount refers to
+        size_t threadCount = 0;
+        bool pending = false;      // Has a candidate
+    };
+
+    bool canStart(int32_t rule, Sci_Position pos) const {
+        return !rules[rule].pending && pos >= rules[rule].restart && !oversized[rule];
+    }
+
+    size_t threadCount(int32_t rule, uint32_t listId) const {
+        return rules[rule].countList == listId ? rules[rule].threadCount : 0;
+    }
+
+    bool holds(Op op, Sci_Position pos) const {
+        switch (op) {
+        case Op::LineStart:
+            return pos == 0 || text[pos - 1] == '\n';
+        case Op::LineEnd:
+            return pos == length || text[pos] == '\n';
+        default: {
+            // Boost wants a character on both sides of \B, so it fails at the ends of the text
+            if (op == Op::NotWordBoundary && (pos == 0 || pos == length)) {
+                return false;
+            }
+            const bool wordBefore = pos > 0 && isWordByte(text[pos - 1]);
+            const bool wordAfter = pos < length && isWordByte(text[pos]);
+            return (wordBefore != wordAfter) == (op == Op::WordBoundary);
+        }
+        }
+    }
+
+    // Adds the thread and everything it reaches without consuming a byte, in priority order
+    void addThread(std::vector<Thread>& list, uint32_t listId, int32_t pc, Sci_Position pos, Sci_Position start) {
+        const int32_t rule = target.program[pc].rule;
+        RuleState& state = rules[rule];
+        if (state.cutList == listId) {
+            return;
+        }
+        stack.clear();
+        stack.push_back(pc);
+        while (!stack.empty()) {
+            const int32_t current = stack.back();
+            stack.pop_back();
+            if (visited[current] == listId) {
+                continue;
+            }
+            visited[current] = listId;
+
+            const Instruction& instruction = target.program[current];
+            switch (instruction.op) {
+            case Op::Byte:
+                list.push_back({ current, start });
+                if (state.countList != listId) {
+                    state.countList = listId;
+                    state.threadCount = 0;
+                }
+                ++state.threadCount;
+                break;
+            case Op::Jump:
+                stack.push_back(instruction.next);
+                break;
+            case Op::Split:
+                stack.push_back(instruction.other);
+                stack.push_back(instruction.next);
+                break;
+            case Op::Match:
+                state.candidateStart = start;
+                state.candidateEnd = pos;
+                state.cutList = listId;
+                if (!state.pending) {
+                    state.pending = true;
+                    pendingRules.push_back(rule);
+                }
+                stack.clear();
+                break;
+            default:
+                if (holds(instruction.op, pos)) {
+                    stack.push_back(instruction.next);
+                }
+                break;
+            }
+        }
+    }
+
+    void step(const std::vector<Thread>& current, std::vector<Thread>& next, uint32_t nextId, Sci_Position pos) {
+        const unsigned char byte = text[pos];
+        for (const Thread& thread : current) {
+            const Instruction& instruction = target.program[thread.pc];
+            if (target.byteSets[instruction.other][byte]) {
+                addThread(next, nextId, instruction.next, pos + 1, thread.start);
+            }
+        }
+    }
+
+    void report(int32_t rule) {
+        RuleState& state = rules[rule];
+        state.pending = false;
+        state.restart = state.candidateEnd;
+        state.cutList = 0; // The next search may start in the list the candidate was found in
+        if (oversized[rule]) {
+            return;
+        }
+        if (matches[rule].size() >= maxMatches) {
+            oversized[rule] = true;
+            std::vector<MatchInterval>().swap(matches[rule]);
+            return;
+        }
+        matches[rule].push_back({ state.candidateStart, state.candidateEnd });
+    }
+
+    // Reports the rules whose threads all ended, those that restart behind pos catch up
+    void finishRules(Sci_Position pos, std::vector<Thread>& next, uint32_t nextId) {
+        const size_t count = pendingRules.size();
+        for (size_t i = 0; i < count; ++i) {
+            const int32_t rule = pendingRules[i];
+            if (!rules[rule].pending || threadCount(rule, nextId) > 0) {
+                continue;
+            }
+            report(rule);
+            if (rules[rule].restart < pos) {
+                runRule(rule, rules[rule].restart, pos, next, nextId);
+            }
+        }
+        pendingRules.erase(std::remove_if(pendingRules.begin(), pendingRules.end(), [this](int32_t rule) {
+            return !rules[rule].pending;
+            }), pendingRules.end());
+    }
+
+    // Scans [from, to) for one rule and hands its threads at to over to out
+    void runRule(int32_t rule, Sci_Position from, Sci_Position to, std::vector<Thread>& out, uint32_t outId) {
+        RuleState& state = rules[rule];
+        std::vector<Thread> current;
+        std::vector<Thread> next;
+        uint32_t currentId = ++lastListId;
+        Sci_Position pos = from;
+        while (pos < to) {
+            if (canStart(rule, pos) && target.firstBytes[rule][text[pos]]) {
+                addThread(current, currentId, target.ruleStarts[rule], pos, pos);
+            }
+            next.clear();
+            const uint32_t nextId = ++lastListId;
+            step(current, next, nextId, pos);
+            ++pos;
+            if (state.pending && threadCount(rule, nextId) == 0) {
+                report(rule);
+                if (state.restart < pos) {
+                    pos = state.restart;
+                    next.clear();
+                }
+            }
+            current.swap(next);
+            currentId = nextId;
+        }
+
+        for (const Thread& thread : current) {
+            out.push_back(thread);
+            visited[thread.pc] = outId;
+        }
+        state.countList = outId;
+        state.threadCount = current.size();
+    }
+
+    const RegexUnion& target;
+    const unsigned char* text;
+    Sci_Position length;
+    size_t maxMatches;
+    std::vector<std::vector<MatchInterval>>& matches;
+    std::vector<bool>& oversized;
+
+    std::vector<uint32_t> visited; // Per instruction, the list it was last added to
+    uint32_t lastListId = 0;
+    std::vector<RuleState> rules;
+    std::vector<int32_t> pendingRules;
+    std::vector<int32_t> seedRules[256];
+    std::vector<int32_t> stack;
+};
+
+void RegexUnion::scan(const char* text, Sci_Position length, size_t maxMatches,
+    std::vector<std::vector<MatchInterval>>& matches, std::vector<bool>& oversized) const
+{
+    matches.assign(ruleStarts.size(), std::vector<MatchInterval>());
+    oversized.assign(ruleStarts.size(), false);
+    if (ruleStarts.empty() || length <= 0) {
+        return;
+    }
+    Scanner scanner(*this, text, length, maxMatches, matches, oversized);
+    scanner.run();
+}
@@ -0,0 +1,92 @@
+// This file is part of Notepad++ project
+// Copyright (C)2023 Thomas Knoefel
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef REGEX_UNION_H
+#define REGEX_UNION_H
+
+#include "DocumentBackend.h"
+#include "MatchCache.h"
+
+#include <bitset>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Searches many regex rules in one pass over the text. The rules are compiled into one
+// program for a Pike VM, each instruction tagged with its rule; every rule keeps its own
+// threads, so one scan yields the matches each rule finds when the document is scanned
+// for it alone: leftmost, the first alternative and greedy choices preferred like in a
+// backtracking engine, continuing at the end of the previous match. Rules start threads
+// only at bytes that can begin one of their matches.
+//
+// Only a subset of the syntax is compiled: literals, classes, '.', groups, alternation,
+// greedy and lazy quantifiers, ^, $, \b, \B, \d, \w, \s and their negations. Patterns with
+// other syntax, that can match the empty text, or whose meaning depends on the encoding or
+// on line end conventions in a text like this one are left to individual searches.
+class RegexUnion
+{
+public:
+    static constexpr size_t MAX_RULE_INSTRUCTIONS = 2000; // Bounds counted repetitions
+    static constexpr int MAX_REPEAT = 100;
+
+    struct TextTraits {
+        bool ascii = true;
+        bool hasCr = false;
+        bool hasFormFeed = false;
+    };
+
+    static TextTraits traitsOf(const char* text, Sci_Position length);
+
+    void clear();
+
+    // Adds the rule if the union can search it exactly in a text with these traits.
+    // codePage is the document's: 0 for single-byte, SC_CP_UTF8 or a DBCS one.
+    bool add(const std::string& pattern, bool matchCase, int codePage, const TextTraits& traits);
+
+    size_t ruleCount() const noexcept {
+        return ruleStarts.size();
+    }
+
+    // Matches of each rule in the order the rules were added. A rule with more than
+    // maxMatches matches is marked oversized and its list left empty.
+    void scan(const char* text, Sci_Position length, size_t maxMatches,
+        std::vector<std::vector<MatchInterval>>& matches, std::vector<bool>& oversized) const;
+
+    size_t memoryBytes() const noexcept {
+        return program.capacity() * sizeof(Instruction) + byteSets.capacity() * sizeof(std::bitset<256>)
+            + ruleStarts.capacity() * sizeof(int32_t) + firstBytes.capacity() * sizeof(std::bitset<256>);
+    }
+
+private:
+    enum class Op : uint8_t { Byte, Split, Jump, Match, LineStart, LineEnd, WordBoundary, NotWordBoundary };
+
+    struct Instruction {
+        Op op;
+        int32_t next;  // Byte, Jump, assertions; the preferred branch of Split
+        int32_t other; // Split: the other branch. Byte: index in byteSets
+        int32_t rule;
+    };
+
+    class Compiler;
+    class Scanner;
+
+    std::vector<Instruction> program;
+    std::vector<std::bitset<256>> byteSets;
+    std::vector<int32_t> ruleStarts;
+    std::vector<std::bitset<256>> firstBytes; // Bytes a match of the rule can start with
+};
+
+#endif // REGEX_UNION_H
@@ -0,0 +1,55 @@
+// This file is part of Notepad++ project
+// Copyright (C)2023 Thomas Knoefel
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "RegexWatchdog.h"
+#include "RegexPrefilter.h"
+
+#include <algorithm>
+
+void RegexWatchdog::beginOperation(int budgetMilliseconds)
+{
+    budget = std::chrono::milliseconds(budgetMilliseconds > 0 ? budgetMilliseconds : 0);
+    stoppedPatterns.clear();
+    stopped.clear();
+}
+
+bool RegexWatchdog::isStopped(const std::string& pattern, int searchFlags) const
+{
+    return stoppedPatterns.count({ pattern, searchFlags }) != 0;
+}
+
+bool RegexWatchdog::isSingleLine(const std::string& pattern)
+{
+    if (pattern != singleLinePattern) {
+        singleLinePattern = pattern;
+        singleLine = RegexPrefilter::requiredLiteral(pattern).singleLine;
+    }
+    return singleLine;
+}
+
+bool RegexWatchdog::charge(const std::string& pattern, int searchFlags, Clock::duration elapsed, Sci_Position bytes)
+{
+    if (isStopped(pattern, searchFlags)) {
+        return true;
+    }
+    const Sci_Position slices = std::max<Sci_Position>(1, (bytes + SLICE_BYTES - 1) / SLICE_BYTES);
+    if (elapsed <= budget * slices) {
+        return false;
+    }
+    stoppedPatterns.insert({ pattern, searchFlags });
+    stopped.push_back({ pattern, searchFlags, std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count() });
+    return true;
+}
@@ -0,0 +1,84 @@
+// This file is part of Notepad++ project
+// Copyright (C)2023 Thomas Knoefel
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef REGEX_WATCHDOG_H
+#define REGEX_WATCHDOG_H
+
+#include "DocumentBackend.h"
+
+#include <chrono>
+#include <cstdint>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Limits the time one regular expression search may take during a user operation.
+// SCI_SEARCHINTARGET cannot be interrupted, so the engine searches patterns that cannot
+// match a line end in slices of whole lines and times every slice, other patterns every
+// search. A search may take the budget once for each SLICE_BYTES of text it covered, so
+// the limit catches a runaway backtrack and not the total work of a large document. A
+// pattern over it is stopped: its searches find nothing until the next operation begins.
+class RegexWatchdog
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr Sci_Position SLICE_BYTES = 256 * 1024; // About a millisecond of a simple regex
+    static constexpr int DEFAULT_BUDGET_MS = 500;
+
+    struct Timeout {
+        std::string pattern;
+        int searchFlags;
+        int64_t milliseconds; // Of the search that ran over
+    };
+
+    // Forgets the patterns stopped in the previous operation. A budget of 0 switches the
+    // watchdog off.
+    void beginOperation(int budgetMilliseconds);
+
+    bool isEnabled() const noexcept {
+        return budget.count() > 0;
+    }
+
+    bool isStopped(const std::string& pattern, int searchFlags) const;
+
+    // True if no match of the pattern can contain a line end
+    bool isSingleLine(const std::string& pattern);
+
+    // Checks the time of one search or slice over the given number of bytes, true if the
+    // pattern is stopped
+    bool charge(const std::string& pattern, int searchFlags, Clock::duration elapsed, Sci_Position bytes);
+
+    // The patterns stopped during the current operation, in order
+    const std::vector<Timeout>& timeouts() const noexcept {
+        return stopped;
+    }
+
+    int budgetMilliseconds() const noexcept {
+        return static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(budget).count());
+    }
+
+private:
+    Clock::duration budget = Clock::duration::zero();
+    std::set<std::pair<std::string, int>> stoppedPatterns;
+    std::vector<Timeout> stopped;
+
+    std::string singleLinePattern; // The pattern isSingleLine was last asked about
+    bool singleLine = false;
+};
+
+#endif // REGEX_WATCHDOG_H
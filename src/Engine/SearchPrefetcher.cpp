@@ -0,0 +1,528 @@
+// This file is part of Notepad++ project
+// Copyright (C)2023 Thomas Knoefel
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "SearchPrefetcher.h"
+#include "GapBufferDocument.h"
+
+#include <algorithm>
+
+namespace {
+
+    bool sameRules(const std::vector<CountRule>& a, const std::vector<CountRule>& b)
+    {
+        return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](const CountRule& x, const CountRule& y) {
+            return x.index == y.index && x.searchFlags == y.searchFlags && x.findTextUtf8 == y.findTextUtf8;
+            });
+    }
+
+    std::vector<MatchInterval>::iterator firstStartingAt(std::vector<MatchInterval>& matches, Sci_Position pos)
+    {
+        return std::lower_bound(matches.begin(), matches.end(), pos, [](const MatchInterval& match, Sci_Position value) {
+            return match.start < value;
+            });
+    }
+
+}
+
+SearchPrefetcher::~SearchPrefetcher()
+{
+    join();
+}
+
+void SearchPrefetcher::start(CountSnapshot snapshot, std::vector<CountRule> sessionRules, Sci_Position from, uint64_t documentVersion)
+{
+    stop();
+    if (snapshot.isSample()) {
+        return;
+    }
+
+    // Nothing is shared with the worker before it starts
+    session = std::make_unique<Session>();
+    session->rules = std::move(sessionRules);
+    session->states.assign(session->rules.size(), RuleState());
+    for (size_t i = 0; i < session->rules.size(); ++i) {
+        RuleState& state = session->states[i];
+        state.from = from;
+        state.gaps.push_back({ from, -1 });
+        state.guard = static_cast<Sci_Position>(session->rules[i].findTextUtf8.size()) + 1;
+    }
+    session->version = documentVersion;
+    session->documentLength = snapshot.documentLength;
+    session->cursor = from;
+    session->active = true;
+    session->thread = std::thread(&SearchPrefetcher::run, std::ref(*session), std::move(snapshot));
+}
+
+void SearchPrefetcher::prepare(std::vector<CountRule> sessionRules, Sci_Position from, uint64_t documentVersion)
+{
+    if (copy.text && copy.version == documentVersion && sameRules(copy.rules, sessionRules)) {
+        return;
+    }
+    stop();
+    copy.text = std::make_shared<std::string>();
+    copy.rules = std::move(sessionRules);
+    copy.from = from;
+    copy.version = documentVersion;
+}
+
+bool SearchPrefetcher::copySlice(DocumentBackend& doc, const MultiReplaceEngine& engine)
+{
+    if (!copy.text) {
+        return false;
+    }
+    if (copy.version != engine.getDocumentVersion()) {
+        copy = PendingCopy(); // Changed by something the copy did not see
+        return false;
+    }
+
+    const Sci_Position length = doc.send(SCI_GETLENGTH, 0, 0);
+    const Sci_Position copied = static_cast<Sci_Position>(copy.text->size());
+    const Sci_Position end = std::min(length, copied + COPY_SLICE_BYTES);
+    if (end > copied) {
+        if (copied == 0) {
+            copy.text->reserve(static_cast<size_t>(length) + 1);
+        }
+        copy.text->resize(static_cast<size_t>(end) + 1);
+        Sci_TextRangeFull tr{ { copied, end }, &(*copy.text)[static_cast<size_t>(copied)] };
+        doc.send(SCI_GETTEXTRANGEFULL, 0, reinterpret_cast<sptr_t>(&tr));
+        copy.text->resize(static_cast<size_t>(end));
+    }
+    if (end < length) {
+        return true;
+    }
+
+    PendingCopy done = std::move(copy);
+    copy = PendingCopy();
+    start(CountSnapshot::capture(doc, engine, std::move(done.text)), std::move(done.rules), done.from, done.version);
+    return false;
+}
+
+void SearchPrefetcher::updateCopy(PendingCopy& pending, Sci_Position pos, Sci_Position deletedLength, const std::string& insertedText)
+{
+    const Sci_Position copied = static_cast<Sci_Position>(pending.text->size());
+    const Sci_Position insertedLength = static_cast<Sci_Position>(insertedText.size());
+    const Sci_Position editEnd = pos + deletedLength;
+    if (editEnd <= copied) {
+        pending.text->replace(static_cast<size_t>(pos), static_cast<size_t>(deletedLength), insertedText);
+    }
+    else if (pos < copied) {
+        pending.text->resize(static_cast<size_t>(pos)); // Copied again from the edit on
+    }
+    if (pos < pending.from) {
+        pending.from = (editEnd < pending.from) ? pending.from + insertedLength - deletedLength : pos + insertedLength;
+    }
+}
+
+void SearchPrefetcher::stop()
+{
+    copy = PendingCopy();
+    if (session) {
+        {
+            std::lock_guard<std::mutex> lock(session->mutex);
+            session->stopping = true;
+            session->active = false;
+        }
+        session->wakeUp.notify_one();
+        retired.push_back(std::move(session));
+    }
+    reap();
+}
+
+void SearchPrefetcher::join()
+{
+    stop();
+    for (const std::unique_ptr<Session>& retiredSession : retired) {
+        retiredSession->thread.join();
+    }
+    retired.clear();
+}
+
+void SearchPrefetcher::reap()
+{
+    retired.erase(std::remove_if(retired.begin(), retired.end(), [](const std::unique_ptr<Session>& retiredSession) {
+        if (!retiredSession->finished) {
+            return false;
+        }
+        retiredSession->thread.join(); // Only the return is left to run
+        return true;
+        }), retired.end());
+}
+
+bool SearchPrefetcher::follows(const std::vector<CountRule>& sessionRules, uint64_t documentVersion) const
+{
+    if (!session) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(session->mutex);
+    return session->active && session->version == documentVersion && sameRules(session->rules, sessionRules);
+}
+
+size_t SearchPrefetcher::memoryBytes() const
+{
+    // Retired sessions hold their copy until their thread ends
+    size_t bytes = copy.text ? copy.text->capacity() : 0;
+    auto add = [&bytes](const Session& counted) {
+        std::lock_guard<std::mutex> lock(counted.mutex);
+        bytes += counted.copyBytes;
+    };
+    if (session) {
+        add(*session);
+    }
+    for (const std::unique_ptr<Session>& retiredSession : retired) {
+        add(*retiredSession);
+    }
+    return bytes;
+}
+
+bool SearchPrefetcher::isIdle() const
+{
+    if (!session) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(session->mutex);
+    return session->active && session->idle;
+}
+
+bool SearchPrefetcher::canPrefetch(const CountRule& rule, const EngineOptions& options)
+{
+    return options.scope == SearchScope::AllText && !options.foldCharacters && !rule.findTextUtf8.empty()
+        && !(rule.searchFlags & (SCFIND_REGEXP | SEARCH_FUZZY));
+}
+
+SearchPrefetcher::Lookup SearchPrefetcher::next(Sci_Position pos, uint64_t documentVersion, PrefetchedMatch& match, const RangeSearch& search, size_t onlyRule)
+{
+    if (!session) {
+        return Lookup::Unknown;
+    }
+    std::lock_guard<std::mutex> lock(session->mutex);
+    if (!session->active || session->version != documentVersion) {
+        return Lookup::Unknown;
+    }
+    std::vector<RuleState>& states = session->states;
+
+    // Each rule either has its next match or tells up to where it has none
+    constexpr Sci_Position unbounded = std::numeric_limits<Sci_Position>::max();
+    Sci_Position searchedUpTo = unbounded;
+    bool found = false;
+    for (size_t i = 0; i < states.size(); ++i) {
+        if (onlyRule < states.size() && i != onlyRule) {
+            continue;
+        }
+        RuleState& state = states[i];
+
+        // A step right after a replacement would wait for the worker otherwise
+        while (search && !state.gaps.empty() && state.gaps.front().end >= 0) {
+            const Sci_Position end = session->searchEnd(state);
+            session->resolveGap(state, search(session->rules[i], state.gaps.front().start, end), end);
+            ++session->revision;
+        }
+
+        const Sci_Position firstGap = state.gaps.empty() ? unbounded : state.gaps.front().start;
+        if (pos < state.from || firstGap <= pos || MatchCache::isInsideMatch(state.known, pos)) {
+            return Lookup::Unknown;
+        }
+        const MatchInterval* known = MatchCache::firstAtOrAfter(state.known, pos);
+        if (known && known->start < firstGap) {
+            if (!found || known->start < match.start) {
+                match = { known->start, known->end, i };
+                found = true;
+            }
+        }
+        else {
+            searchedUpTo = std::min(searchedUpTo, firstGap);
+        }
+    }
+
+    if (found && match.start >= searchedUpTo) {
+        found = false;
+    }
+    if (found) {
+        session->trim(pos);
+        session->cursor = pos;
+        session->wakeUp.notify_one();
+        return Lookup::Found;
+    }
+    return (searchedUpTo == unbounded) ? Lookup::NotFound : Lookup::Unknown;
+}
+
+void SearchPrefetcher::applyEdit(Sci_Position pos, Sci_Position deletedLength, const std::string& insertedText, uint64_t previousVersion, uint64_t documentVersion)
+{
+    if (copy.text) {
+        if (copy.version != previousVersion) {
+            copy = PendingCopy();
+        }
+        else {
+            updateCopy(copy, pos, deletedLength, insertedText);
+            copy.version = documentVersion;
+        }
+    }
+
+    if (!session) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(session->mutex);
+    if (!session->active) {
+        return;
+    }
+    if (session->version != previousVersion) {
+        session->active = false; // Changed by something the session did not see
+        return;
+    }
+
+    const Sci_Position insertedLength = static_cast<Sci_Position>(insertedText.size());
+    const Sci_Position delta = insertedLength - deletedLength;
+    const Sci_Position editEnd = pos + deletedLength;
+
+    for (RuleState& state : session->states) {
+        if (pos < state.from) {
+            state.from = (editEnd < state.from) ? state.from + delta : pos + insertedLength;
+        }
+
+        // Matches touching the edit can change, including those ending right before it
+        // or starting right after it, where the word boundary changes
+        auto first = std::lower_bound(state.known.begin(), state.known.end(), pos, [](const MatchInterval& match, Sci_Position value) {
+            return match.end < value;
+            });
+        auto last = std::upper_bound(first, state.known.end(), editEnd, [](Sci_Position value, const MatchInterval& match) {
+            return value < match.start;
+            });
+        const Sci_Position keptEnd = (first != state.known.begin()) ? std::prev(first)->end : state.from;
+        for (auto it = state.known.erase(first, last); it != state.known.end(); ++it) {
+            it->start += delta;
+            it->end += delta;
+        }
+
+        // New matches can start a match length before the edit and overlap known ones up
+        // to a match length after it. Gaps starting in the edit become part of its gap.
+        Gap changed{ std::max({ state.from, keptEnd, pos - state.guard }), pos + insertedLength + state.guard };
+        std::vector<Gap> gaps;
+        gaps.reserve(state.gaps.size() + 1);
+        for (const Gap& gap : state.gaps) {
+            if (gap.start > editEnd) {
+                gaps.push_back({ gap.start + delta, (gap.end < 0) ? -1 : gap.end + delta });
+            }
+            else if (gap.start >= changed.start) {
+                changed.end = (gap.end < 0 || changed.end < 0) ? -1 : std::max(changed.end, gap.end + delta);
+            }
+            else {
+                gaps.push_back({ gap.start, (gap.end < 0 || gap.end <= editEnd) ? gap.end : gap.end + delta });
+            }
+        }
+        gaps.insert(std::upper_bound(gaps.begin(), gaps.end(), changed.start, [](Sci_Position value, const Gap& gap) {
+            return value < gap.start;
+            }), changed);
+        mergeGaps(gaps);
+        state.gaps.swap(gaps);
+    }
+
+    session->pendingEdits.push_back({ pos, deletedLength, insertedText });
+    ++session->revision;
+    session->version = documentVersion;
+    session->documentLength += delta;
+    session->wakeUp.notify_one();
+}
+
+void SearchPrefetcher::mergeGaps(std::vector<Gap>& gaps)
+{
+    // A gap inside the changed text of the one before it is searched with it, and nothing
+    // behind the end of the scan is known anyway
+    size_t kept = 0;
+    for (size_t i = 1; i < gaps.size(); ++i) {
+        Gap& previous = gaps[kept];
+        if (previous.end < 0 || gaps[i].start <= previous.end) {
+            if (previous.end >= 0) {
+                previous.end = (gaps[i].end < 0) ? -1 : std::max(previous.end, gaps[i].end);
+            }
+        }
+        else {
+            gaps[++kept] = gaps[i];
+        }
+    }
+    gaps.resize(gaps.empty() ? 0 : kept + 1);
+}
+
+void SearchPrefetcher::Session::trim(Sci_Position pos)
+{
+    // The scan from the end of a match is the scan from its start, steps do not go back
+    for (RuleState& state : states) {
+        const Sci_Position limit = state.gaps.empty() ? pos : std::min(pos, state.gaps.front().start);
+        auto first = state.known.begin();
+        auto last = first;
+        while (last != state.known.end() && last->end <= limit) {
+            ++last;
+        }
+        if (last != first) {
+            state.from = std::prev(last)->end;
+            state.known.erase(first, last);
+        }
+    }
+}
+
+Sci_Position SearchPrefetcher::Session::searchEnd(const RuleState& state) const
+{
+    // Matches starting in the changed text have to fit in, with the character after them
+    const Gap& gap = state.gaps.front();
+    const Sci_Position end = (gap.end < 0) ? gap.start + std::max(SCAN_BYTES, 2 * state.guard) : gap.end + state.guard;
+    return std::min(end, documentLength);
+}
+
+bool SearchPrefetcher::Session::nextGap(size_t& rule) const
+{
+    // Changed text first, steps cannot pass it
+    for (size_t i = 0; i < states.size(); ++i) {
+        if (!states[i].gaps.empty() && states[i].gaps.front().end >= 0) {
+            rule = i;
+            return true;
+        }
+    }
+
+    // Then the rule that got least far, while it has too few matches ahead of the caret
+    bool found = false;
+    for (size_t i = 0; i < states.size(); ++i) {
+        const RuleState& state = states[i];
+        if (state.gaps.empty() || (found && state.gaps.front().start >= states[rule].gaps.front().start)) {
+            continue;
+        }
+        const MatchInterval* ahead = MatchCache::firstAtOrAfter(state.known, cursor);
+        const size_t aheadCount = ahead ? static_cast<size_t>(state.known.data() + state.known.size() - ahead) : 0;
+        if (aheadCount < LOOKAHEAD) {
+            rule = i;
+            found = true;
+        }
+    }
+    return found;
+}
+
+void SearchPrefetcher::Session::resolveGap(RuleState& state, const SearchResult& result, Sci_Position searchedTo)
+{
+    Gap& gap = state.gaps.front();
+    const bool changed = gap.end >= 0;
+    auto knownFrom = firstStartingAt(state.known, gap.start);
+
+    if (result.pos < 0 || (changed && result.pos >= gap.end)) {
+        if (changed) {
+            // Nothing new in the changed text, behind it the scan finds what it found before
+            state.gaps.erase(state.gaps.begin());
+        }
+        else if (searchedTo >= documentLength) {
+            state.known.erase(knownFrom, state.known.end());
+            state.gaps.clear();
+        }
+        else {
+            // No match fits into the slice, one could still start in its last match length
+            gap.start = std::max(gap.start, searchedTo - state.guard + 1);
+        }
+        return;
+    }
+
+    const MatchInterval match{ result.pos, result.pos + result.length };
+    if (knownFrom != state.known.end() && knownFrom->start == match.start && knownFrom->end == match.end) {
+        // The scan meets a match it made before, from there on it continues as it did
+        state.gaps.erase(state.gaps.begin());
+        return;
+    }
+
+    // Known matches the new one overlaps are gone, and matches they hid can appear
+    auto knownTo = firstStartingAt(state.known, match.end);
+    for (auto it = knownFrom; it != knownTo; ++it) {
+        if (changed) {
+            gap.end = std::max(gap.end, it->end);
+        }
+    }
+    state.known.insert(state.known.erase(knownFrom, knownTo), match);
+    gap.start = match.end;
+    if (changed && gap.start >= gap.end) {
+        state.gaps.erase(state.gaps.begin());
+    }
+    else {
+        mergeGaps(state.gaps);
+    }
+}
+
+void SearchPrefetcher::run(Session& session, CountSnapshot snapshot)
+{
+    scan(session, std::move(snapshot));
+    session.finished = true;
+}
+
+void SearchPrefetcher::scan(Session& session, CountSnapshot snapshot)
+{
+    const bool asciiText = std::none_of(snapshot.text->begin(), snapshot.text->end(), [](char ch) {
+        return static_cast<unsigned char>(ch) >= 0x80;
+        });
+    for (const CountRule& rule : session.rules) {
+        if (!BackgroundCounter::searchesLikeScintilla(rule, snapshot, asciiText)) {
+            std::lock_guard<std::mutex> lock(session.mutex);
+            session.active = false;
+            return;
+        }
+    }
+
+    GapBufferDocument doc(snapshot.text);
+    snapshot.applyTo(doc);
+    const size_t textBytes = snapshot.text->size();
+    snapshot.text.reset();
+
+    MultiReplaceEngine engine(doc);
+    engine.options = snapshot.options;
+
+    std::unique_lock<std::mutex> lock(session.mutex);
+    session.copyBytes = textBytes;
+    while (!session.stopping && session.active) {
+        if (!session.pendingEdits.empty()) {
+            std::vector<Edit> edits;
+            edits.swap(session.pendingEdits);
+            lock.unlock();
+            // Replayed like the host reports them, so the caches of the engine follow
+            for (const Edit& edit : edits) {
+                if (edit.deletedLength > 0) {
+                    doc.send(SCI_DELETERANGE, static_cast<uptr_t>(edit.pos), edit.deletedLength);
+                    engine.notifyTextModified(SC_MOD_DELETETEXT, edit.pos, edit.deletedLength, nullptr);
+                }
+                if (!edit.insertedText.empty()) {
+                    const Sci_Position length = static_cast<Sci_Position>(edit.insertedText.size());
+                    doc.send(SCI_SETTARGETRANGE, static_cast<uptr_t>(edit.pos), edit.pos);
+                    doc.send(SCI_REPLACETARGET, static_cast<uptr_t>(length), reinterpret_cast<sptr_t>(edit.insertedText.data()));
+                    engine.notifyTextModified(SC_MOD_INSERTTEXT, edit.pos, length, edit.insertedText.data());
+                }
+            }
+            lock.lock();
+            continue;
+        }
+
+        size_t rule = 0;
+        if (!session.nextGap(rule)) {
+            session.idle = true;
+            session.wakeUp.wait(lock);
+            session.idle = false;
+            continue;
+        }
+
+        const CountRule searched = session.rules[rule];
+        const Sci_Position start = session.states[rule].gaps.front().start;
+        const Sci_Position end = session.searchEnd(session.states[rule]);
+        const uint64_t revisionBefore = session.revision;
+        lock.unlock();
+        const SearchResult result = engine.performSingleSearch(searched.findTextUtf8, searched.searchFlags, false, { start, end });
+        lock.lock();
+
+        // An edit or a step that searched for itself meanwhile changed the gaps
+        if (session.revision == revisionBefore && !session.stopping) {
+            session.resolveGap(session.states[rule], result, end);
+        }
+    }
+    session.copyBytes = 0;
+}
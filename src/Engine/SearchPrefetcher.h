@@ -0,0 +1,181 @@
+// This file is part of Notepad++ project
+// Copyright (C)2023 Thomas Knoefel
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef SEARCH_PREFETCHER_H
+#define SEARCH_PREFETCHER_H
+
+#include "BackgroundCounter.h"
+#include "MatchCache.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct PrefetchedMatch {
+    Sci_Position start = -1;
+    Sci_Position end = -1;
+    size_t rule = 0; // Position in the rules of the session
+};
+
+// Look-ahead for stepping through a document with Find Next and Replace. A worker thread
+// searches a copy of the document for the next matches of each rule, in the order a forward
+// scan from the caret finds them. Replacements of the host are replayed on the copy and
+// move the matches found so far by the change in length; only the surroundings of the edit
+// are searched again. Each step is then a lookup, however far the next match is.
+// The host copies the document in slices with copySlice, so no step waits for a whole copy.
+// A stopped session is retired and its thread ends on its own; only join() waits for it.
+class SearchPrefetcher
+{
+public:
+    static constexpr size_t LOOKAHEAD = 64;                          // Matches per rule kept ahead of the last step
+    static constexpr Sci_Position SCAN_BYTES = 16 * 1024 * 1024;     // The worker searches for new matches in slices of this size
+    static constexpr Sci_Position COPY_SLICE_BYTES = 8 * 1024 * 1024; // The host copies the document in slices of this size
+
+    // Searches the rule in [start, end) of the caller's document
+    using RangeSearch = std::function<SearchResult(const CountRule& rule, Sci_Position start, Sci_Position end)>;
+
+    enum class Lookup {
+        Found,
+        NotFound, // No match up to the end of the document
+        Unknown   // Not searched yet, the host has to search itself
+    };
+
+    SearchPrefetcher() = default;
+    SearchPrefetcher(const SearchPrefetcher&) = delete;
+    SearchPrefetcher& operator=(const SearchPrefetcher&) = delete;
+    ~SearchPrefetcher();
+
+    // Stops the running session and starts one at position from. The snapshot has to hold
+    // the whole document of the given version.
+    void start(CountSnapshot snapshot, std::vector<CountRule> sessionRules, Sci_Position from, uint64_t documentVersion);
+
+    // Stops the running session and starts copying the document for one at position from,
+    // unless a copy for these rules and this version is already under way
+    void prepare(std::vector<CountRule> sessionRules, Sci_Position from, uint64_t documentVersion);
+
+    // Copies the next slice of the document and starts the session once the copy is whole.
+    // False when nothing is left to copy, also when the document changed other than by
+    // applyEdit. Called on the thread owning the document.
+    bool copySlice(DocumentBackend& doc, const MultiReplaceEngine& engine);
+
+    bool isCopying() const noexcept {
+        return copy.text != nullptr;
+    }
+
+    // Ends the copy and retires the session without waiting for its thread
+    void stop();
+
+    // Stops and waits for the threads of all sessions
+    void join();
+
+    // True if a session for these rules is in step with the document
+    bool follows(const std::vector<CountRule>& sessionRules, uint64_t documentVersion) const;
+
+    // The match a search from pos finds, the first rule wins on equal starts. With onlyRule
+    // set, the match of that rule of the session. The text around replacements the worker
+    // has not searched yet is searched with 'search', which has to be fast.
+    Lookup next(Sci_Position pos, uint64_t documentVersion, PrefetchedMatch& match, const RangeSearch& search = nullptr,
+        size_t onlyRule = std::numeric_limits<size_t>::max());
+
+    // Replays a replacement the host made between the two document versions, on the session
+    // or on the part copied so far. Any other change of the document ends both.
+    void applyEdit(Sci_Position pos, Sci_Position deletedLength, const std::string& insertedText, uint64_t previousVersion, uint64_t documentVersion);
+
+    // Literal rules on the whole document, where matches only depend on the text around them
+    static bool canPrefetch(const CountRule& rule, const EngineOptions& options);
+
+    // Size of the document copies, while the host or the worker holds one
+    size_t memoryBytes() const;
+
+    // True while the worker has found enough ahead and waits for the next step
+    bool isIdle() const;
+
+private:
+    // Where the scan has to continue. Up to end the text changed, from there on the scan finds
+    // the known matches again. A gap without end is as far as the scan got.
+    struct Gap {
+        Sci_Position start = 0;
+        Sci_Position end = -1;
+    };
+
+    // The matches of one rule in the order of a forward scan from 'from'
+    struct RuleState {
+        std::vector<MatchInterval> known;
+        std::vector<Gap> gaps;  // Sorted, at most the last one without end
+        Sci_Position from = 0;
+        Sci_Position guard = 0; // Longest match plus the character deciding a word boundary
+    };
+
+    struct Edit {
+        Sci_Position pos = 0;
+        Sci_Position deletedLength = 0;
+        std::string insertedText;
+    };
+
+    // State shared by the host and the worker of one session
+    struct Session {
+        mutable std::mutex mutex;
+        std::condition_variable wakeUp;
+        std::vector<CountRule> rules;
+        std::vector<RuleState> states;
+        std::vector<Edit> pendingEdits;  // Not yet replayed on the copy
+        uint64_t revision = 0;           // Changes of the gaps the worker did not make
+        uint64_t version = 0;            // Document version the positions refer to
+        Sci_Position documentLength = 0;
+        Sci_Position cursor = 0;         // Position of the last step
+        size_t copyBytes = 0;
+        bool active = false;
+        bool stopping = false;
+        bool idle = false;
+        std::atomic<bool> finished{ false }; // Set last, the thread touches nothing of the session after it
+        std::thread thread;
+
+        bool nextGap(size_t& rule) const;
+        Sci_Position searchEnd(const RuleState& state) const;
+        void resolveGap(RuleState& state, const SearchResult& result, Sci_Position searchedTo);
+        void trim(Sci_Position pos);
+    };
+
+    // The document copied so far for the next session, only touched by the host
+    struct PendingCopy {
+        std::shared_ptr<std::string> text; // Null while no copy is under way
+        std::vector<CountRule> rules;
+        Sci_Position from = 0;
+        uint64_t version = 0;
+    };
+
+    // Marks the session finished once the scan returned and its copy is gone
+    static void run(Session& session, CountSnapshot snapshot);
+    static void scan(Session& session, CountSnapshot snapshot);
+    static void mergeGaps(std::vector<Gap>& gaps);
+    static void updateCopy(PendingCopy& pending, Sci_Position pos, Sci_Position deletedLength, const std::string& insertedText);
+
+    // Joins the retired sessions that ended
+    void reap();
+
+    PendingCopy copy;
+    std::unique_ptr<Session> session; // Current session, null before the first start
+    std::vector<std::unique_ptr<Session>> retired;
+};
+
+#endif // SEARCH_PREFETCHER_H
@@ -0,0 +1,163 @@
+// This file is part of Notepad++ project
+// Copyright (C)2023 Thomas Knoefel
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "SelectionScope.h"
+
+#include <algorithm>
+
+namespace {
+
+    // Scintilla's SelectionPosition::MoveForInsertDelete without virtual space
+    Sci_Position moveForDelete(Sci_Position position, Sci_Position startChange, Sci_Position length)
+    {
+        if (position > startChange) {
+            return (position > startChange + length) ? position - length : startChange;
+        }
+        return position;
+    }
+
+    Sci_Position moveForInsert(Sci_Position position, Sci_Position startChange, Sci_Position length, bool moveForEqual)
+    {
+        if (position > startChange || (position == startChange && moveForEqual)) {
+            return position + length;
+        }
+        return position;
+    }
+
+}
+
+void SelectionScope::capture(DocumentBackend& doc)
+{
+    const Sci_Position selectionCount = doc.send(SCI_GETSELECTIONS, 0, 0);
+    ranges.resize(static_cast<size_t>(selectionCount));
+    for (Sci_Position i = 0; i < selectionCount; i++) {
+        ranges[i].start = doc.send(SCI_GETSELECTIONNSTART, i, 0);
+        ranges[i].end = doc.send(SCI_GETSELECTIONNEND, i, 0);
+    }
+
+    // Sort selections based on their start position
+    std::sort(ranges.begin(), ranges.end(), [](const SelectionRange& a, const SelectionRange& b) {
+        return a.start < b.start;
+        });
+
+    sortedEnds = std::is_sorted(ranges.begin(), ranges.end(), [](const SelectionRange& a, const SelectionRange& b) {
+        return a.end < b.end;
+        });
+    shiftedFrom = 0;
+    offset = 0;
+    active = true;
+}
+
+void SelectionScope::reset() noexcept
+{
+    ranges.clear();
+    shiftedFrom = 0;
+    offset = 0;
+    active = false;
+}
+
+size_t SelectionScope::firstEndingAfter(Sci_Position pos) const
+{
+    if (!sortedEnds) {
+        for (size_t i = 0; i < ranges.size(); ++i) {
+            if (range(i).end > pos) {
+                return i;
+            }
+        }
+        return ranges.size();
+    }
+
+    size_t low = 0;
+    size_t high = ranges.size();
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (range(mid).end > pos) {
+            high = mid;
+        }
+        else {
+            low = mid + 1;
+        }
+    }
+    return low;
+}
+
+size_t SelectionScope::firstStartingAfter(Sci_Position pos) const
+{
+    size_t low = 0;
+    size_t high = ranges.size();
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (range(mid).start > pos) {
+            high = mid;
+        }
+        else {
+            low = mid + 1;
+        }
+    }
+    return low;
+}
+
+void SelectionScope::settleUpTo(size_t index)
+{
+    for (; shiftedFrom < index; ++shiftedFrom) {
+        ranges[shiftedFrom].start += offset;
+        ranges[shiftedFrom].end += offset;
+    }
+}
+
+void SelectionScope::applyReplacement(Sci_Position pos, Sci_Position oldLength, Sci_Position newLength)
+{
+    const Sci_Position delta = newLength - oldLength;
+
+    // Ranges starting after the replaced text only shift, from this index on
+    size_t firstShifted = firstStartingAfter(pos + oldLength);
+
+    // Ranges touching the replaced text are moved exactly, as Scintilla deletes and then inserts
+    settleUpTo(firstShifted);
+    for (size_t i = firstEndingAfter(pos - 1); i < firstShifted; ++i) {
+        SelectionRange& r = ranges[i];
+        r.start = moveForDelete(r.start, pos, oldLength);
+        r.end = moveForDelete(r.end, pos, oldLength);
+
+        // Text inserted at the start of a selection moves it, text inserted at its end stays outside
+        const bool empty = (r.start == r.end);
+        r.start = moveForInsert(r.start, pos, newLength, !empty);
+        r.end = moveForInsert(r.end, pos, newLength, false);
+    }
+
+    // Replacing before an earlier one, only when used out of order
+    for (size_t i = firstShifted; i < shiftedFrom; ++i) {
+        ranges[i].start += delta;
+        ranges[i].end += delta;
+    }
+    offset += delta;
+}
+
+SelectionScope::Snapshot::Snapshot(SelectionScope& scope, DocumentBackend& doc, bool enable)
+    : scope(scope)
+{
+    if (enable && !scope.isActive()) {
+        scope.capture(doc);
+        owner = true;
+    }
+}
+
+SelectionScope::Snapshot::~Snapshot()
+{
+    if (owner) {
+        scope.reset();
+    }
+}
@@ -0,0 +1,83 @@
+// This file is part of Notepad++ project
+// Copyright (C)2023 Thomas Knoefel
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef SELECTION_SCOPE_H
+#define SELECTION_SCOPE_H
+
+#include "DocumentBackend.h"
+
+#include <vector>
+
+struct SelectionRange {
+    Sci_Position start = 0;
+    Sci_Position end = 0;
+};
+
+// The selections of a Selection-scope operation, read once and sorted by start.
+// Replacements move the ranges the same way Scintilla moves its selections, so
+// the snapshot stays equal to what SCI_GETSELECTIONNSTART/END would return.
+class SelectionScope
+{
+public:
+    void capture(DocumentBackend& doc);
+    void reset() noexcept;
+
+    bool isActive() const noexcept {
+        return active;
+    }
+
+    size_t size() const noexcept {
+        return ranges.size();
+    }
+
+    SelectionRange range(size_t index) const {
+        return index < shiftedFrom ? ranges[index] : SelectionRange{ ranges[index].start + offset, ranges[index].end + offset };
+    }
+
+    // Index of the first range ending after pos, size() if there is none
+    size_t firstEndingAfter(Sci_Position pos) const;
+
+    // Text at pos of oldLength bytes was replaced by newLength bytes
+    void applyReplacement(Sci_Position pos, Sci_Position oldLength, Sci_Position newLength);
+
+    // Captures the selections for the lifetime of an operation, unless a snapshot is already active
+    class Snapshot {
+    public:
+        Snapshot(SelectionScope& scope, DocumentBackend& doc, bool enable);
+        ~Snapshot();
+
+        Snapshot(const Snapshot&) = delete;
+        Snapshot& operator=(const Snapshot&) = delete;
+
+    private:
+        SelectionScope& scope;
+        bool owner = false;
+    };
+
+private:
+    size_t firstStartingAfter(Sci_Position pos) const;
+    void settleUpTo(size_t index);
+
+    std::vector<SelectionRange> ranges;
+    // Replacements before a range shift all later ranges alike, the shift is added lazily:
+    // ranges from shiftedFrom on are stored without offset
+    size_t shiftedFrom = 0;
+    Sci_Position offset = 0;
+    bool sortedEnds = true; // False if ranges overlap, lookups are linear then
+    bool active = false;
+};
+
+#endif // SELECTION_SCOPE_H
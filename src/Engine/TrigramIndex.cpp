@@ -0,0 +1,257 @@
+// This file is part of Notepad++ project
+// Copyright (C)2023 Thomas Knoefel
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "TrigramIndex.h"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace {
+
+    constexpr int HASH_BITS = 14;
+    static_assert(TrigramIndex::FILTER_BITS == size_t{ 1 } << HASH_BITS, "One bit per hash value");
+
+    inline uint32_t lowerAscii(unsigned char ch) noexcept {
+        return (ch >= 'A' && ch <= 'Z') ? ch | 0x20u : ch;
+    }
+
+    // Fibonacci hashing of the 24 bit trigram
+    inline size_t trigramHash(uint32_t trigram) noexcept {
+        return static_cast<size_t>((trigram * 0x9E3779B1u) >> (32 - HASH_BITS));
+    }
+
+}
+
+bool TrigramIndex::build(DocumentBackend& doc)
+{
+    reset();
+    document = doc.send(SCI_GETDOCPOINTER, 0, 0);
+    const Sci_Position length = doc.send(SCI_GETLENGTH, 0, 0);
+    Sci_Position start = 0;
+    do {
+        Block block;
+        block.start = start;
+        block.length = std::min(BLOCK_SIZE, length - start);
+        blocks.push_back(block);
+        start += BLOCK_SIZE;
+    } while (start < length);
+
+    built = true;
+    stale = true;
+    if (!refresh(doc)) {
+        reset();
+        return false;
+    }
+    return true;
+}
+
+bool TrigramIndex::isBuiltFor(DocumentBackend& doc) const
+{
+    if (!built || blocks.empty() || doc.send(SCI_GETDOCPOINTER, 0, 0) != document) {
+        return false;
+    }
+    return blocks.back().start + blocks.back().length == doc.send(SCI_GETLENGTH, 0, 0);
+}
+
+void TrigramIndex::reset()
+{
+    blocks.clear();
+    anyBlock.reset();
+    built = false;
+    document = 0;
+    stale = false;
+    queryText.clear();
+    queryHashes.clear();
+}
+
+void TrigramIndex::indexBlock(DocumentBackend& doc, Block& block, Sci_Position documentLength, bool& readable)
+{
+    block.trigrams.reset();
+    block.dirty = false;
+
+    // Trigrams starting in the last two bytes reach into the next block
+    const Sci_Position available = std::min(block.length + 2, documentLength - block.start);
+    if (block.length == 0 || available < 3) {
+        return;
+    }
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(doc.send(SCI_GETRANGEPOINTER, block.start, available));
+    if (!p) {
+        readable = false;
+        return;
+    }
+    const Sci_Position last = std::min(available, block.length + 2);
+    uint32_t trigram = (lowerAscii(p[0]) << 8) | lowerAscii(p[1]);
+    for (Sci_Position i = 2; i < last; ++i) {
+        trigram = ((trigram << 8) | lowerAscii(p[i])) & 0xFFFFFF;
+        block.trigrams.set(trigramHash(trigram));
+    }
+}
+
+bool TrigramIndex::refresh(DocumentBackend& doc)
+{
+    if (!stale) {
+        return true;
+    }
+
+    // Blocks that grew are split, so a match still spans at most two of them
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        if (blocks[i].length > 2 * BLOCK_SIZE) {
+            Block rest;
+            rest.start = blocks[i].start + BLOCK_SIZE;
+            rest.length = blocks[i].length - BLOCK_SIZE;
+            blocks[i].length = BLOCK_SIZE;
+            blocks[i].dirty = true;
+            blocks.insert(blocks.begin() + static_cast<ptrdiff_t>(i) + 1, rest);
+        }
+    }
+
+    const Sci_Position documentLength = doc.send(SCI_GETLENGTH, 0, 0);
+    bool readable = true;
+    anyBlock.reset();
+    for (Block& block : blocks) {
+        if (block.dirty) {
+            indexBlock(doc, block, documentLength, readable);
+        }
+        anyBlock |= block.trigrams;
+    }
+    stale = false;
+    return readable;
+}
+
+size_t TrigramIndex::blockAt(Sci_Position pos) const
+{
+    auto it = std::upper_bound(blocks.begin(), blocks.end(), pos, [](Sci_Position value, const Block& block) {
+        return value < block.start;
+        });
+    return (it == blocks.begin()) ? 0 : static_cast<size_t>(it - blocks.begin()) - 1;
+}
+
+void TrigramIndex::update(int modificationType, Sci_Position position, Sci_Position length)
+{
+    if (!built || length <= 0) {
+        return;
+    }
+
+    const size_t first = blockAt(position);
+    if (modificationType & SC_MOD_INSERTTEXT) {
+        blocks[first].length += length;
+        blocks[first].dirty = true;
+    }
+    else if (modificationType & SC_MOD_DELETETEXT) {
+        const Sci_Position end = position + length;
+        for (size_t i = first; i < blocks.size() && blocks[i].start < end; ++i) {
+            const Sci_Position overlap = std::min(end, blocks[i].start + blocks[i].length) - std::max(position, blocks[i].start);
+            if (overlap > 0) {
+                blocks[i].length -= overlap;
+                blocks[i].dirty = true;
+            }
+        }
+    }
+    else {
+        return;
+    }
+
+    // The block before reads two bytes of the edited one
+    if (first > 0) {
+        blocks[first - 1].dirty = true;
+    }
+    for (size_t i = first + 1; i < blocks.size(); ++i) {
+        blocks[i].start = blocks[i - 1].start + blocks[i - 1].length;
+    }
+    if (blocks.size() > 1) {
+        blocks.erase(std::remove_if(blocks.begin() + static_cast<ptrdiff_t>(first), blocks.end(), [](const Block& block) {
+            return block.length == 0;
+            }), blocks.end());
+        if (blocks.empty()) {
+            blocks.emplace_back();
+        }
+    }
+    stale = true;
+}
+
+void TrigramIndex::prepareQuery(const std::string& findTextUtf8)
+{
+    queryText = findTextUtf8;
+    queryHashes.clear();
+    if (queryText.size() < 3) {
+        return;
+    }
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(queryText.data());
+    uint32_t trigram = (lowerAscii(p[0]) << 8) | lowerAscii(p[1]);
+    for (size_t i = 2; i < queryText.size(); ++i) {
+        trigram = ((trigram << 8) | lowerAscii(p[i])) & 0xFFFFFF;
+        queryHashes.push_back(trigramHash(trigram));
+    }
+    std::sort(queryHashes.begin(), queryHashes.end());
+    queryHashes.erase(std::unique(queryHashes.begin(), queryHashes.end()), queryHashes.end());
+}
+
+bool TrigramIndex::nextCandidates(DocumentBackend& doc, const std::string& findTextUtf8, Sci_Position from, Sci_Position to,
+    Sci_Position& rangeStart, Sci_Position& rangeEnd)
+{
+    rangeStart = from;
+    rangeEnd = to;
+    if (from >= to) {
+        return false;
+    }
+
+    // Blocks edited while one rule is being replaced are candidates until the next rule
+    if (findTextUtf8 != queryText) {
+        prepareQuery(findTextUtf8);
+        if (!refresh(doc)) {
+            reset();
+        }
+    }
+    if (!built || queryHashes.empty()) {
+        return true;
+    }
+    if (!stale && std::any_of(queryHashes.begin(), queryHashes.end(), [this](size_t hash) { return !anyBlock[hash]; })) {
+        return false;
+    }
+
+    auto canStartIn = [this](size_t i) {
+        if (blocks[i].dirty || (i + 1 < blocks.size() && blocks[i + 1].dirty)) {
+            return true;
+        }
+        const std::bitset<FILTER_BITS>* next = (i + 1 < blocks.size()) ? &blocks[i + 1].trigrams : nullptr;
+        return std::all_of(queryHashes.begin(), queryHashes.end(), [&](size_t hash) {
+            return blocks[i].trigrams[hash] || (next && (*next)[hash]);
+            });
+    };
+
+    size_t i = blockAt(from);
+    while (i < blocks.size() && blocks[i].start < to && !canStartIn(i)) {
+        ++i;
+    }
+    if (i == blocks.size() || blocks[i].start >= to) {
+        return false;
+    }
+    rangeStart = std::max(from, blocks[i].start);
+
+    // Frequent texts are found again right away, checking all the following blocks for
+    // each match would cost more than searching them
+    const size_t last = std::min(blocks.size(), i + MAX_RANGE_BLOCKS);
+    while (i < last && blocks[i].start < to && canStartIn(i)) {
+        ++i;
+    }
+    rangeEnd = std::min(to, blocks[i - 1].start + blocks[i - 1].length);
+    return rangeStart < rangeEnd;
+}
+
+size_t TrigramIndex::memoryBytes() const
+{
+    return blocks.capacity() * sizeof(Block) + queryText.capacity() + queryHashes.capacity() * sizeof(size_t);
+}
@@ -0,0 +1,86 @@
+// This file is part of Notepad++ project
+// Copyright (C)2023 Thomas Knoefel
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef TRIGRAM_INDEX_H
+#define TRIGRAM_INDEX_H
+
+#include "DocumentBackend.h"
+
+#include <bitset>
+#include <string>
+#include <vector>
+
+// Which blocks of the document can contain a literal text. Each block of about BLOCK_SIZE
+// bytes keeps a hashed set of the byte trigrams starting in it, ASCII letters in lower case.
+// A match starting in a block has all its trigrams in that block or the next one, so other
+// blocks are skipped; a text none of whose trigrams occur cannot match at all. Texts shorter
+// than a trigram are never filtered. Edits mark the blocks they touch as candidates for
+// every text; they are indexed again when another text is queried.
+class TrigramIndex
+{
+public:
+    static constexpr Sci_Position BLOCK_SIZE = 16384;
+    static constexpr size_t FILTER_BITS = 16384; // About 20% of the bits are set for prose
+    static constexpr size_t MAX_RANGE_BLOCKS = 16; // Candidate ranges returned at once
+
+    bool isBuilt() const noexcept {
+        return built;
+    }
+
+    // Built for the document doc shows now. Another buffer, or a length the edits seen by
+    // update() do not explain, needs a new build.
+    bool isBuiltFor(DocumentBackend& doc) const;
+
+    // Indexes the whole document, false if its text cannot be read
+    bool build(DocumentBackend& doc);
+
+    // Called for SCN_MODIFIED after text was inserted or deleted
+    void update(int modificationType, Sci_Position position, Sci_Position length);
+
+    // The next range of possible match starts in [from, to): rangeStart is where the first
+    // block that can hold a match begins, rangeEnd where the last of the following such
+    // blocks ends. False if no match can start in [from, to).
+    bool nextCandidates(DocumentBackend& doc, const std::string& findTextUtf8, Sci_Position from, Sci_Position to,
+        Sci_Position& rangeStart, Sci_Position& rangeEnd);
+
+    void reset();
+
+    size_t memoryBytes() const;
+
+private:
+    struct Block {
+        Sci_Position start = 0;
+        Sci_Position length = 0;
+        bool dirty = true;
+        std::bitset<FILTER_BITS> trigrams;
+    };
+
+    void indexBlock(DocumentBackend& doc, Block& block, Sci_Position documentLength, bool& readable);
+    bool refresh(DocumentBackend& doc);
+    size_t blockAt(Sci_Position pos) const;
+    void prepareQuery(const std::string& findTextUtf8);
+
+    std::vector<Block> blocks;
+    std::bitset<FILTER_BITS> anyBlock; // Union of all blocks
+    bool built = false;
+    bool stale = false; // Some blocks are dirty or too large, anyBlock is outdated
+    sptr_t document = 0; // SCI_GETDOCPOINTER of the indexed document
+
+    std::string queryText;           // The text last queried
+    std::vector<size_t> queryHashes; // Its trigram hashes, sorted
+};
+
+#endif // TRIGRAM_INDEX_H
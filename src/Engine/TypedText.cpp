@@ -0,0 +1,98 @@
+// This file is part of Notepad++ project
+// Copyright (C)2023 Thomas Knoefel
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "TypedText.h"
+
+#include <algorithm>
+
+void TypedText::inserted(Sci_Position pos, Sci_Position length)
+{
+    lastInsert = { pos, pos + length };
+
+    std::vector<SelectionRange> moved;
+    moved.reserve(ranges.size() + 1);
+    for (const SelectionRange& range : ranges) {
+        if (range.end <= pos) {
+            moved.push_back(range);
+        }
+        else if (range.start >= pos) {
+            moved.push_back({ range.start + length, range.end + length });
+        }
+        else {
+            // Text that was not typed stays out of the range
+            moved.push_back({ range.start, pos });
+            moved.push_back({ pos + length, range.end + length });
+        }
+    }
+    ranges.swap(moved);
+}
+
+void TypedText::deleted(Sci_Position pos, Sci_Position length)
+{
+    lastInsert = { -1, -1 };
+
+    // Deleted text shrinks the ranges, it adds none
+    std::vector<SelectionRange> shrunk;
+    shrunk.reserve(ranges.size());
+    for (const SelectionRange& range : ranges) {
+        if (range.end <= pos) {
+            shrunk.push_back(range);
+        }
+        else if (range.start >= pos + length) {
+            shrunk.push_back({ range.start - length, range.end - length });
+        }
+        else if (range.start < pos || range.end > pos + length) {
+            shrunk.push_back({ std::min(range.start, pos), std::max(pos, range.end - length) });
+        }
+    }
+    ranges.swap(shrunk);
+}
+
+bool TypedText::charAdded(Sci_Position caret)
+{
+    const SelectionRange typed = lastInsert;
+    lastInsert = { -1, -1 };
+    if (typed.start < 0 || typed.end != caret) {
+        return false;
+    }
+
+    // Joined with the ranges it touches
+    auto first = std::lower_bound(ranges.begin(), ranges.end(), typed.start, [](const SelectionRange& range, Sci_Position pos) {
+        return range.end < pos;
+        });
+    auto last = first;
+    SelectionRange joined = typed;
+    for (; last != ranges.end() && last->start <= typed.end; ++last) {
+        joined.start = std::min(joined.start, last->start);
+        joined.end = std::max(joined.end, last->end);
+    }
+    ranges.insert(ranges.erase(first, last), joined);
+    return true;
+}
+
+void TypedText::clear() noexcept
+{
+    ranges.clear();
+    lastInsert = { -1, -1 };
+}
+
+std::vector<SelectionRange> TypedText::take()
+{
+    std::vector<SelectionRange> taken;
+    taken.swap(ranges);
+    lastInsert = { -1, -1 };
+    return taken;
+}
@@ -0,0 +1,51 @@
+// This file is part of Notepad++ project
+// Copyright (C)2023 Thomas Knoefel
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef TYPED_TEXT_H
+#define TYPED_TEXT_H
+
+#include "SelectionScope.h"
+
+#include <vector>
+
+// The text typed since the last pass of live replace. SCN_MODIFIED reports the inserts of
+// Find/Replace of Notepad++, macros, auto-completion and other plugins as user edits too, so
+// an insert only counts as typed when SCN_CHARADDED follows it with the caret at its end.
+// Other inserts move the ranges, one inside a range splits it.
+class TypedText
+{
+public:
+    void inserted(Sci_Position pos, Sci_Position length);
+    void deleted(Sci_Position pos, Sci_Position length);
+
+    // SCN_CHARADDED: the last insert was typed if it ends at the caret. True if it was added.
+    bool charAdded(Sci_Position caret);
+
+    void clear() noexcept;
+
+    bool empty() const noexcept {
+        return ranges.empty();
+    }
+
+    // The ranges, sorted and disjoint, tracking starts over
+    std::vector<SelectionRange> take();
+
+private:
+    std::vector<SelectionRange> ranges;
+    SelectionRange lastInsert{ -1, -1 }; // Waits for SCN_CHARADDED
+};
+
+#endif // TYPED_TEXT_H
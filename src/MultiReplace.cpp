@@ -102,12 +102,17 @@ extern "C" __declspec(dllexport) void beNotified(SCNotification * notifyCode)
         if (notifyCode->modificationType & SC_MOD_INSERTTEXT ||
             notifyCode->modificationType & SC_MOD_DELETETEXT)
         {
-            MultiReplace::onTextChanged();
+            MultiReplace::onTextChanged(notifyCode);
             MultiReplace::processTextChange(notifyCode);
             MultiReplace::processLog();
         }
     }
     break;
+    case SCN_CHARADDED:
+    {
+        MultiReplace::onCharAdded(notifyCode);
+    }
+    break;
 
     case NPPN_BUFFERACTIVATED:
     {
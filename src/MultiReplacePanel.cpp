@@ -24,6 +24,7 @@
 
 #include <algorithm>
 #include <bitset>
+#include <chrono>
 #include <codecvt>
 #include <Commctrl.h>
 #include <fstream>
@@ -52,6 +53,7 @@
 
 HWND MultiReplace::s_hScintilla = nullptr;
 HWND MultiReplace::s_hDlg = nullptr;
+bool MultiReplace::wasTextSelected = false;
 bool MultiReplace::isWindowOpen = false;
 bool MultiReplace::isLoggingEnabled = true;
 bool MultiReplace::textModified = true;
@@ -116,10 +118,12 @@ void MultiReplace::positionAndResizeControls(int windowWidth, int windowHeight)
     ctrlMap[IDC_REPLACE_FIRST_CHECKBOX] = { 20, 189, 198, 25, WC_BUTTON, getLangStrLPCWSTR(L"panel_replace_first_match_only"), BS_AUTOCHECKBOX | WS_TABSTOP, NULL };
     ctrlMap[IDC_WRAP_AROUND_CHECKBOX] = { 20, 220, 198, 25, WC_BUTTON, getLangStrLPCWSTR(L"panel_wrap_around"), BS_AUTOCHECKBOX | WS_TABSTOP, NULL };
 
-    ctrlMap[IDC_SEARCH_MODE_GROUP] = { 225, 99, 200, 130, WC_BUTTON,  getLangStrLPCWSTR(L"panel_search_mode"), BS_GROUPBOX, NULL };
+    ctrlMap[IDC_SEARCH_MODE_GROUP] = { 225, 99, 200, 163, WC_BUTTON,  getLangStrLPCWSTR(L"panel_search_mode"), BS_GROUPBOX, NULL };
     ctrlMap[IDC_NORMAL_RADIO] = { 235, 126, 180, 25, WC_BUTTON, getLangStrLPCWSTR(L"panel_normal"), BS_AUTORADIOBUTTON | WS_GROUP | WS_TABSTOP, NULL };
     ctrlMap[IDC_EXTENDED_RADIO] = { 235, 157, 180, 25, WC_BUTTON, getLangStrLPCWSTR(L"panel_extended"), BS_AUTORADIOBUTTON | WS_TABSTOP, NULL };
     ctrlMap[IDC_REGEX_RADIO] = { 235, 188, 180, 25, WC_BUTTON, getLangStrLPCWSTR(L"panel_regular_expression"), BS_AUTORADIOBUTTON | WS_TABSTOP, NULL };
+    ctrlMap[IDC_FUZZY_RADIO] = { 235, 219, 120, 25, WC_BUTTON, getLangStrLPCWSTR(L"panel_fuzzy"), BS_AUTORADIOBUTTON | WS_TABSTOP, NULL };
+    ctrlMap[IDC_FUZZY_EDITS_EDIT] = { 360, 221, 30, 20, WC_EDIT, NULL, ES_LEFT | ES_NUMBER | WS_BORDER | WS_TABSTOP, getLangStrLPCWSTR(L"tooltip_fuzzy_edits") };
 
     ctrlMap[IDC_SCOPE_GROUP] = { 440, 99, 247, 163, WC_BUTTON, getLangStrLPCWSTR(L"panel_scope"), BS_GROUPBOX, NULL };
     ctrlMap[IDC_ALL_TEXT_RADIO] = { 450, 126, 230, 25, WC_BUTTON, getLangStrLPCWSTR(L"panel_all_text"), BS_AUTORADIOBUTTON | WS_GROUP | WS_TABSTOP, NULL };
@@ -219,6 +223,8 @@ void MultiReplace::initializeCtrlMap()
     Sci_Position end = ::SendMessage(MultiReplace::getScintillaHandle(), SCI_GETSELECTIONEND, 0, 0);
     bool isTextSelected = (start != end);
     ::EnableWindow(::GetDlgItem(_hSelf, IDC_SELECTION_RADIO), isTextSelected);
+    wasTextSelected = isTextSelected;
+    shownCaretPosition = -1;
 
     isWindowOpen = true;
 }
@@ -285,9 +291,9 @@ bool MultiReplace::createAndShowWindows() {
 void MultiReplace::initializePluginStyle()
 {
     // Initialize for non-list marker
-    long standardMarkerColor = MARKER_COLOR;
-    int standardMarkerStyle = textStyles[0];
-    colorToStyleMap[standardMarkerColor] = standardMarkerStyle;
+    long standardMarkerColor = MultiReplaceEngine::MARKER_COLOR;
+    int standardMarkerStyle = engine.textStyles[0];
+    engine.colorToStyleMap[standardMarkerColor] = standardMarkerStyle;
 
     ::SendMessage(_hScintilla, SCI_SETINDICATORCURRENT, standardMarkerStyle, 0);
     ::SendMessage(_hScintilla, SCI_INDICSETSTYLE, standardMarkerStyle, INDIC_STRAIGHTBOX);
@@ -295,6 +301,27 @@ void MultiReplace::initializePluginStyle()
     ::SendMessage(_hScintilla, SCI_INDICSETALPHA, standardMarkerStyle, 100);
 }
 
+void MultiReplace::initializeEngine() {
+    engine.codepageConverter = [this](const std::string& utf8Str, int codepage) {
+        return utf8ToCodepage(utf8Str, codepage);
+    };
+
+    engine.luaErrorHandler = [this](LuaErrorType errorType, const std::string& detail) {
+        if (!isLuaErrorDialogEnabled) {
+            return;
+        }
+        if (errorType == LuaErrorType::Syntax) {
+            std::wstring error_message = utf8ToWString(detail.c_str());
+            MessageBoxW(NULL, error_message.c_str(), getLangStr(L"msgbox_title_use_variables_syntax_error").c_str(), MB_OK);
+        }
+        else {
+            std::wstring errorMsg = getLangStr(L"msgbox_use_variables_execution_error", { utf8ToWString(detail.c_str()) });
+            std::wstring errorTitle = getLangStr(L"msgbox_title_use_variables_execution_error");
+            MessageBoxW(NULL, errorMsg.c_str(), errorTitle.c_str(), MB_OK);
+        }
+    };
+}
+
 void MultiReplace::initializeListView() {
     _replaceListView = GetDlgItem(_hSelf, IDC_REPLACE_LIST);
     originalListViewProc = (WNDPROC)SetWindowLongPtr(_replaceListView, GWLP_WNDPROC, (LONG_PTR)ListViewSubclassProc);
@@ -492,8 +519,8 @@ void MultiReplace::createListViewColumns(HWND listView) {
     // Calculate the remaining width for the first two columns
     int adjustedWidth = windowWidth - 282;
 
-    // Calculate the total width of columns 5 to 10 (Options and Delete Button)
-    int columns5to10Width = 30 * 7;
+    // Calculate the total width of columns 5 to 11 (Options and Delete Button)
+    int columns5to10Width = 30 * 8;
 
     // Calculate the remaining width after subtracting the widths of the specified columns
     int remainingWidth = adjustedWidth - findCountColumnWidth - replaceCountColumnWidth - columns5to10Width;
@@ -548,11 +575,16 @@ void MultiReplace::createListViewColumns(HWND listView) {
         ListView_InsertColumn(listView, 6 + i, &lvc);
     }
 
-    // Column for Delete Button
+    // Column for the edits of Fuzzy mode
     lvc.iSubItem = 11;
+    lvc.pszText = getLangStrLPWSTR(L"header_fuzzy");
+    ListView_InsertColumn(listView, 11, &lvc);
+
+    // Column for Delete Button
+    lvc.iSubItem = 12;
     lvc.pszText = L"";
     lvc.cx = 30;
-    ListView_InsertColumn(listView, 11, &lvc);
+    ListView_InsertColumn(listView, 12, &lvc);
 
     //Adding Tooltips
     HWND hwndHeader = ListView_GetHeader(listView);
@@ -563,6 +595,7 @@ void MultiReplace::createListViewColumns(HWND listView) {
     AddHeaderTooltip(hwndTT, hwndHeader, 8, getLangStrLPWSTR(L"tooltip_header_use_variables"));
     AddHeaderTooltip(hwndTT, hwndHeader, 9, getLangStrLPWSTR(L"tooltip_header_extended"));
     AddHeaderTooltip(hwndTT, hwndHeader, 10, getLangStrLPWSTR(L"tooltip_header_regex"));
+    AddHeaderTooltip(hwndTT, hwndHeader, 11, getLangStrLPWSTR(L"tooltip_header_fuzzy"));
 
 }
 
@@ -607,7 +640,7 @@ void MultiReplace::insertReplaceListItem(const ReplaceItemData& itemData)
 }
 
 int MultiReplace::calcDynamicColWidth(const CountColWidths& widths) {
-    int columns5to10Width = 210; // Simplified calculation (30 * 7).
+    int columns5to10Width = 240; // Simplified calculation (30 * 8).
 
     // Directly calculate the width available for each dynamic column.
     int totalRemainingWidth = widths.listViewWidth - widths.margin - columns5to10Width - widths.findCountWidth - widths.replaceCountWidth;
@@ -661,9 +694,15 @@ void MultiReplace::handleCopyBack(NMITEMACTIVATE* pnmia) {
     SendMessageW(GetDlgItem(_hSelf, IDC_WHOLE_WORD_CHECKBOX), BM_SETCHECK, itemData.wholeWord ? BST_CHECKED : BST_UNCHECKED, 0);
     SendMessageW(GetDlgItem(_hSelf, IDC_MATCH_CASE_CHECKBOX), BM_SETCHECK, itemData.matchCase ? BST_CHECKED : BST_UNCHECKED, 0);
     SendMessageW(GetDlgItem(_hSelf, IDC_USE_VARIABLES_CHECKBOX), BM_SETCHECK, itemData.useVariables ? BST_CHECKED : BST_UNCHECKED, 0);
-    SendMessageW(GetDlgItem(_hSelf, IDC_NORMAL_RADIO), BM_SETCHECK, (!itemData.regex && !itemData.extended) ? BST_CHECKED : BST_UNCHECKED, 0);
-    SendMessageW(GetDlgItem(_hSelf, IDC_EXTENDED_RADIO), BM_SETCHECK, itemData.extended ? BST_CHECKED : BST_UNCHECKED, 0);
-    SendMessageW(GetDlgItem(_hSelf, IDC_REGEX_RADIO), BM_SETCHECK, itemData.regex ? BST_CHECKED : BST_UNCHECKED, 0);
+    bool fuzzy = itemData.fuzzyEdits > 0;
+    SendMessageW(GetDlgItem(_hSelf, IDC_NORMAL_RADIO), BM_SETCHECK, (!itemData.regex && !itemData.extended && !fuzzy) ? BST_CHECKED : BST_UNCHECKED, 0);
+    SendMessageW(GetDlgItem(_hSelf, IDC_EXTENDED_RADIO), BM_SETCHECK, (itemData.extended && !fuzzy) ? BST_CHECKED : BST_UNCHECKED, 0);
+    SendMessageW(GetDlgItem(_hSelf, IDC_REGEX_RADIO), BM_SETCHECK, (itemData.regex && !fuzzy) ? BST_CHECKED : BST_UNCHECKED, 0);
+    SendMessageW(GetDlgItem(_hSelf, IDC_FUZZY_RADIO), BM_SETCHECK, fuzzy ? BST_CHECKED : BST_UNCHECKED, 0);
+    if (fuzzy) {
+        SetDlgItemInt(_hSelf, IDC_FUZZY_EDITS_EDIT, static_cast<UINT>(itemData.fuzzyEdits), FALSE);
+    }
+    EnableWindow(GetDlgItem(_hSelf, IDC_WHOLE_WORD_CHECKBOX), !itemData.regex && !fuzzy);
 }
 
 void MultiReplace::shiftListItem(HWND listView, const Direction& direction) {
@@ -871,6 +910,11 @@ void MultiReplace::handleCopyToListButton() {
     itemData.useVariables = (IsDlgButtonChecked(_hSelf, IDC_USE_VARIABLES_CHECKBOX) == BST_CHECKED);
     itemData.extended = (IsDlgButtonChecked(_hSelf, IDC_EXTENDED_RADIO) == BST_CHECKED);
     itemData.regex = (IsDlgButtonChecked(_hSelf, IDC_REGEX_RADIO) == BST_CHECKED);
+    itemData.fuzzyEdits = getFuzzyEditsFromDialog();
+
+    if (!checkFuzzyFindText(itemData.findText, itemData.fuzzyEdits)) {
+        return;
+    }
 
     insertReplaceListItem(itemData);
 
@@ -1100,6 +1144,9 @@ LRESULT CALLBACK MultiReplace::EditControlSubclassProc(HWND hwnd, UINT msg, WPAR
             else if (pThis->_editingColumn == 5) { // Assuming column 5 is for replaceText
                 item.replaceText = newText;
             }
+            else if (pThis->_editingColumn == 11) { // Edits of Fuzzy mode, empty or 0 switches it off
+                item.fuzzyEdits = std::clamp(_wtoi(newText), 0, MAX_FUZZY_EDITS);
+            }
 
             // Reflect this change in the ListView
             ListView_SetItemText(pThis->_replaceListView, pThis->_editingItemIndex, pThis->_editingColumn, newText);
@@ -1157,6 +1204,12 @@ void MultiReplace::createContextMenu(HWND hwnd, POINT ptScreen, MenuState state)
     if (hMenu) {
         AppendMenu(hMenu, MF_STRING | (state.clickedOnItem ? MF_ENABLED : MF_GRAYED), IDM_COPY_DATA_TO_FIELDS, getLangStr(L"ctxmenu_transfer_to_input_fields").c_str());        
         AppendMenu(hMenu, MF_STRING | (state.listNotEmpty ? MF_ENABLED : MF_GRAYED), IDM_SEARCH_IN_LIST, getLangStr(L"ctxmenu_search_in_list").c_str());
+        if (isCounting()) {
+            AppendMenu(hMenu, MF_STRING, IDM_COUNT_MATCHES, getLangStr(L"ctxmenu_cancel_count").c_str());
+        }
+        else {
+            AppendMenu(hMenu, MF_STRING | (state.listNotEmpty ? MF_ENABLED : MF_GRAYED), IDM_COUNT_MATCHES, getLangStr(L"ctxmenu_count_matches").c_str());
+        }
         AppendMenu(hMenu, MF_SEPARATOR, 0, NULL);
         AppendMenu(hMenu, MF_STRING | (state.hasSelection ? MF_ENABLED : MF_GRAYED), IDM_CUT_LINES_TO_CLIPBOARD, getLangStr(L"ctxmenu_cut").c_str());
         AppendMenu(hMenu, MF_STRING | (state.hasSelection ? MF_ENABLED : MF_GRAYED), IDM_COPY_LINES_TO_CLIPBOARD, getLangStr(L"ctxmenu_copy").c_str());
@@ -1199,7 +1252,7 @@ MenuState MultiReplace::checkMenuConditions(HWND listView, POINT ptScreen) {
     }
 
     // Enable editing if the clicked column is one of the editable columns and an item was actually clicked
-    if (state.clickedOnItem && ((clickedColumn == 3) || (clickedColumn >= 4 && clickedColumn <= 10))) {
+    if (state.clickedOnItem && ((clickedColumn == 3) || (clickedColumn >= 4 && clickedColumn <= 11))) {
         state.canEdit = true;
     }
 
@@ -1286,7 +1339,7 @@ void MultiReplace::performItemAction(POINT pt, ItemAction action) {
         if ((clickedColumn == 3) || (clickedColumn >= 6 && clickedColumn <= 10)) {
             toggleBooleanAt(hitTestResult, clickedColumn);
         }
-        else if (clickedColumn == 4 || clickedColumn == 5) {
+        else if (clickedColumn == 4 || clickedColumn == 5 || clickedColumn == 11) {
             editTextAt(hitTestResult, clickedColumn);
         }
         break;
@@ -1328,7 +1381,8 @@ void MultiReplace::copySelectedItemsToClipboard(HWND listView) {
                     std::to_wstring(item.matchCase) + L"," +
                     std::to_wstring(item.useVariables) + L"," +
                     std::to_wstring(item.extended) + L"," +
-                    std::to_wstring(item.regex) + L"\n";
+                    std::to_wstring(item.regex) + L"," +
+                    std::to_wstring(item.fuzzyEdits) + L"\n";
                 csvData += line;
             }
         }
@@ -1477,7 +1531,7 @@ void MultiReplace::pasteItemsIntoList() {
         columns.push_back(unescapeCsvValue(currentValue)); // Add the last value
 
         // Check for proper column count and non-empty findText before adding to the list
-        if (columns.size() != 8 || columns[1].empty()) continue;
+        if ((columns.size() != 8 && columns.size() != 9) || columns[1].empty()) continue;
 
         ReplaceItemData item;
         try {
@@ -1489,6 +1543,9 @@ void MultiReplace::pasteItemsIntoList() {
             item.useVariables = std::stoi(columns[5]) != 0;
             item.extended = std::stoi(columns[6]) != 0;
             item.regex = std::stoi(columns[7]) != 0;
+            if (columns.size() == 9) {
+                item.fuzzyEdits = std::clamp(std::stoi(columns[8]), 0, MAX_FUZZY_EDITS);
+            }
         }
         catch (const std::exception&) {
             continue; // Silently ignore lines with conversion errors
@@ -1592,6 +1649,12 @@ int MultiReplace::searchInListData(int startIdx, const std::wstring& findText, c
 
 INT_PTR CALLBACK MultiReplace::run_dlgProc(UINT message, WPARAM wParam, LPARAM lParam)
 {
+    // Text changes made while the panel handles a message are its own, live replace leaves them alone
+    struct MessageDepth {
+        int& depth;
+        explicit MessageDepth(int& value) : depth(value) { ++depth; }
+        ~MessageDepth() { --depth; }
+    } messageDepth(panelMessageDepth);
 
     switch (message)
     {
@@ -1600,6 +1663,7 @@ INT_PTR CALLBACK MultiReplace::run_dlgProc(UINT message, WPARAM wParam, LPARAM l
         loadLanguage();
         initializeWindowSize();
         pointerToScintilla();
+        initializeEngine();
         initializePluginStyle();
         initializeCtrlMap();
         initializeListView();
@@ -1636,8 +1700,67 @@ INT_PTR CALLBACK MultiReplace::run_dlgProc(UINT message, WPARAM wParam, LPARAM l
     }
     break;
 
+    case WM_COUNT_PROGRESS:
+    {
+        processCountProgress();
+        return TRUE;
+    }
+
+    case WM_LIVE_COUNT:
+    {
+        showLiveCount();
+        return TRUE;
+    }
+
+    case WM_SESSION_LIMIT:
+    {
+        // Saves the session and unchecks the menu item, as stopping it from the menu does
+        if (sessionLimitReached) {
+            recordSession();
+        }
+        return TRUE;
+    }
+
+    case WM_TIMER:
+    {
+        if (wParam == LIVE_COUNT_TIMER_ID) {
+            startLiveCount();
+            return TRUE;
+        }
+        if (wParam == CARET_STATUS_TIMER_ID) {
+            KillTimer(_hSelf, CARET_STATUS_TIMER_ID);
+            caretStatusPending = false;
+            showCaretPosition();
+            return TRUE;
+        }
+        if (wParam == LIVE_REPLACE_TIMER_ID) {
+            applyLiveReplace();
+            return TRUE;
+        }
+        if (wParam == DEFERRED_COUNT_TIMER_ID) {
+            continueDeferredCount();
+            return TRUE;
+        }
+        if (wParam == PREFETCH_COPY_TIMER_ID) {
+            // One slice of the look-ahead copy per tick, so typing stays responsive
+            if (!searchPrefetcher.copySlice(sciBackend, engine)) {
+                KillTimer(_hSelf, PREFETCH_COPY_TIMER_ID);
+            }
+            return TRUE;
+        }
+    }
+    break;
+
     case WM_DESTROY:
     {
+        KillTimer(_hSelf, LIVE_COUNT_TIMER_ID);
+        KillTimer(_hSelf, CARET_STATUS_TIMER_ID);
+        KillTimer(_hSelf, LIVE_REPLACE_TIMER_ID);
+        KillTimer(_hSelf, DEFERRED_COUNT_TIMER_ID);
+        KillTimer(_hSelf, PREFETCH_COPY_TIMER_ID);
+        liveCounter.join();
+        backgroundCounter.join();
+        searchPrefetcher.join();
         if (_replaceListView && originalListViewProc) {
             SetWindowLongPtr(_replaceListView, GWLP_WNDPROC, (LONG_PTR)originalListViewProc);
         }
@@ -1708,7 +1831,7 @@ INT_PTR CALLBACK MultiReplace::run_dlgProc(UINT message, WPARAM wParam, LPARAM l
             case NM_CLICK:
             {
                 NMITEMACTIVATE* pnmia = reinterpret_cast<NMITEMACTIVATE*>(lParam);
-                if (pnmia->iSubItem == 11) { // Delete button column
+                if (pnmia->iSubItem == 12) { // Delete button column
                     handleDeletion(pnmia);
                 }
                 if (pnmia->iSubItem == 3) { // Select button column
@@ -1788,6 +1911,13 @@ INT_PTR CALLBACK MultiReplace::run_dlgProc(UINT message, WPARAM wParam, LPARAM l
                     }
                     break;
                 case 11:
+                    if (itemData.fuzzyEdits > 0) {
+                        // The buffer of the list view takes the text, it holds at least a few characters
+                        plvdi->item.mask |= LVIF_TEXT;
+                        wcsncpy_s(plvdi->item.pszText, plvdi->item.cchTextMax, std::to_wstring(itemData.fuzzyEdits).c_str(), _TRUNCATE);
+                    }
+                    break;
+                case 12:
                     plvdi->item.mask |= LVIF_TEXT;
                     plvdi->item.pszText = L"\u2716";
                     break;
@@ -2001,6 +2131,24 @@ INT_PTR CALLBACK MultiReplace::run_dlgProc(UINT message, WPARAM wParam, LPARAM l
         }
         break;
 
+        case IDC_FIND_EDIT:
+        {
+            // The text of a history entry is set after CBN_SELCHANGE, the timer reads it later
+            if (HIWORD(wParam) == CBN_EDITCHANGE || HIWORD(wParam) == CBN_SELCHANGE) {
+                scheduleLiveCount();
+            }
+        }
+        break;
+
+        case IDC_MATCH_CASE_CHECKBOX:
+        case IDC_WHOLE_WORD_CHECKBOX:
+        {
+            if (HIWORD(wParam) == BN_CLICKED) {
+                scheduleLiveCount();
+            }
+        }
+        break;
+
         case IDC_2_BUTTONS_MODE:
         {
             // Check if the Find checkbox has been clicked
@@ -2012,9 +2160,11 @@ INT_PTR CALLBACK MultiReplace::run_dlgProc(UINT message, WPARAM wParam, LPARAM l
         break;
 
         case IDC_REGEX_RADIO:
+        case IDC_FUZZY_RADIO:
         {
-            // Check if the Regular expression radio button is checked
-            bool regexChecked = (IsDlgButtonChecked(_hSelf, IDC_REGEX_RADIO) == BST_CHECKED);
+            // Whole word does not apply to regular expressions and fuzzy matches
+            bool regexChecked = (IsDlgButtonChecked(_hSelf, IDC_REGEX_RADIO) == BST_CHECKED)
+                || (IsDlgButtonChecked(_hSelf, IDC_FUZZY_RADIO) == BST_CHECKED);
 
             // Enable or disable the Whole word checkbox accordingly
             EnableWindow(GetDlgItem(_hSelf, IDC_WHOLE_WORD_CHECKBOX), !regexChecked);
@@ -2024,6 +2174,7 @@ INT_PTR CALLBACK MultiReplace::run_dlgProc(UINT message, WPARAM wParam, LPARAM l
             {
                 CheckDlgButton(_hSelf, IDC_WHOLE_WORD_CHECKBOX, BST_UNCHECKED);
             }
+            scheduleLiveCount();
         }
         break;
 
@@ -2031,6 +2182,15 @@ INT_PTR CALLBACK MultiReplace::run_dlgProc(UINT message, WPARAM wParam, LPARAM l
         case IDC_EXTENDED_RADIO:
         {
             EnableWindow(GetDlgItem(_hSelf, IDC_WHOLE_WORD_CHECKBOX), TRUE);
+            scheduleLiveCount();
+        }
+        break;
+
+        case IDC_FUZZY_EDITS_EDIT:
+        {
+            if (HIWORD(wParam) == EN_CHANGE && IsDlgButtonChecked(_hSelf, IDC_FUZZY_RADIO) == BST_CHECKED) {
+                scheduleLiveCount();
+            }
         }
         break;
 
@@ -2039,6 +2199,7 @@ INT_PTR CALLBACK MultiReplace::run_dlgProc(UINT message, WPARAM wParam, LPARAM l
             setElementsState(columnRadioDependentElements, false);
             setElementsState(selectionRadioDisabledButtons, true);
             handleClearDelimiterState();
+            scheduleLiveCount();
         }
         break;
 
@@ -2047,6 +2208,7 @@ INT_PTR CALLBACK MultiReplace::run_dlgProc(UINT message, WPARAM wParam, LPARAM l
             setElementsState(columnRadioDependentElements, false);
             setElementsState(selectionRadioDisabledButtons, false);
             handleClearDelimiterState();
+            scheduleLiveCount();
         }
         break;
 
@@ -2058,13 +2220,14 @@ INT_PTR CALLBACK MultiReplace::run_dlgProc(UINT message, WPARAM wParam, LPARAM l
             CheckRadioButton(_hSelf, IDC_ALL_TEXT_RADIO, IDC_COLUMN_MODE_RADIO, IDC_COLUMN_MODE_RADIO);        
             setElementsState(columnRadioDependentElements, true);
             setElementsState(selectionRadioDisabledButtons, true);
+            clearLiveCount();
         }
         break;
 
         case IDC_COLUMN_SORT_ASC_BUTTON:
         {
             handleDelimiterPositions(DelimiterOperation::LoadAll);
-            if (columnDelimiterData.isValid()) {
+            if (engine.columnDelimiterData.isValid()) {
                 handleSortStateAndSort(SortDirection::Ascending);
                 UpdateSortButtonSymbols();
             }            
@@ -2074,7 +2237,7 @@ INT_PTR CALLBACK MultiReplace::run_dlgProc(UINT message, WPARAM wParam, LPARAM l
         case IDC_COLUMN_SORT_DESC_BUTTON:
         {
             handleDelimiterPositions(DelimiterOperation::LoadAll);
-            if (columnDelimiterData.isValid()) {
+            if (engine.columnDelimiterData.isValid()) {
                 handleSortStateAndSort(SortDirection::Descending);
                 UpdateSortButtonSymbols();
             }
@@ -2085,7 +2248,7 @@ INT_PTR CALLBACK MultiReplace::run_dlgProc(UINT message, WPARAM wParam, LPARAM l
         {
             if (confirmColumnDeletion()) {
                 handleDelimiterPositions(DelimiterOperation::LoadAll);
-                if (columnDelimiterData.isValid()) {
+                if (engine.columnDelimiterData.isValid()) {
                     handleDeleteColumns();
                 }
             }
@@ -2095,7 +2258,7 @@ INT_PTR CALLBACK MultiReplace::run_dlgProc(UINT message, WPARAM wParam, LPARAM l
         case IDC_COLUMN_COPY_BUTTON:
         {
             handleDelimiterPositions(DelimiterOperation::LoadAll);
-            if (columnDelimiterData.isValid()) {
+            if (engine.columnDelimiterData.isValid()) {
                 handleCopyColumnsToClipboard();
             }
         }
@@ -2105,7 +2268,7 @@ INT_PTR CALLBACK MultiReplace::run_dlgProc(UINT message, WPARAM wParam, LPARAM l
         {
             if (!isColumnHighlighted) {
                 handleDelimiterPositions(DelimiterOperation::LoadAll);
-                if (columnDelimiterData.isValid()) {
+                if (engine.columnDelimiterData.isValid()) {
                     handleHighlightColumnsInDocument();
                 }
             }
@@ -2330,6 +2493,12 @@ INT_PTR CALLBACK MultiReplace::run_dlgProc(UINT message, WPARAM wParam, LPARAM l
         }
         break;
 
+        case IDM_COUNT_MATCHES:
+        {
+            handleCountMatches();
+        }
+        break;
+
         case IDM_COPY_DATA_TO_FIELDS:
         {
             NMITEMACTIVATE nmia = {};
@@ -2411,8 +2580,11 @@ void MultiReplace::handleReplaceAllButton() {
         return;
     }
 
+    beginEngineOperation();
+    beginOperationProfile("Replace All");
+
     // Clear all stored Lua Global Variables
-    globalLuaVariablesMap.clear();
+    engine.globalLuaVariablesMap.clear();
 
     int totalReplaceCount = 0;
     // Check if the "In List" option is enabled
@@ -2425,25 +2597,27 @@ void MultiReplace::handleReplaceAllButton() {
             showStatusMessage(getLangStr(L"status_add_values_instructions"), RGB(255, 0, 0));
             return;
         }
-        ::SendMessage(_hScintilla, SCI_BEGINUNDOACTION, 0, 0);
-        for (size_t i = 0; i < replaceListData.size(); ++i)
-        {
-            if (replaceListData[i].isEnabled)
-            {
-                int findCount = 0;
-                int replaceCount = 0;
-                replaceAll(replaceListData[i], findCount, replaceCount);
-
-                // Update counts in list item
-                if (findCount > 0) {
-                    updateCountColumns(i, findCount, replaceCount);
-                }
+        std::vector<ReplaceRule> rules;
+        rules.reserve(replaceListData.size());
+        for (const ReplaceItemData& itemData : replaceListData) {
+            rules.push_back(toReplaceRule(itemData));
+        }
 
-                // Accumulate total replacements
-                totalReplaceCount += replaceCount;
+        std::vector<RuleCount> counts;
+        {
+            BulkEditTransaction transaction(recordingBackend);
+            engine.replaceAllList(rules, counts, transaction);
+        }
+        for (size_t i = 0; i < counts.size(); ++i)
+        {
+            // Update counts in list item
+            if (counts[i].findCount > 0) {
+                updateCountColumns(i, counts[i].findCount, counts[i].replaceCount);
             }
+
+            // Accumulate total replacements
+            totalReplaceCount += counts[i].replaceCount;
         }
-        ::SendMessage(_hScintilla, SCI_ENDUNDOACTION, 0, 0);
     }
     else
     {
@@ -2455,18 +2629,175 @@ void MultiReplace::handleReplaceAllButton() {
         itemData.useVariables = (IsDlgButtonChecked(_hSelf, IDC_USE_VARIABLES_CHECKBOX) == BST_CHECKED);
         itemData.regex = (IsDlgButtonChecked(_hSelf, IDC_REGEX_RADIO) == BST_CHECKED);
         itemData.extended = (IsDlgButtonChecked(_hSelf, IDC_EXTENDED_RADIO) == BST_CHECKED);
+        itemData.fuzzyEdits = getFuzzyEditsFromDialog();
 
-        ::SendMessage(_hScintilla, SCI_BEGINUNDOACTION, 0, 0);
-        int findCount = 0;
-        replaceAll(itemData, findCount, totalReplaceCount);
-        ::SendMessage(_hScintilla, SCI_ENDUNDOACTION, 0, 0);
+        if (!checkFuzzyFindText(itemData.findText, itemData.fuzzyEdits)) {
+            return;
+        }
+
+        {
+            BulkEditTransaction transaction(recordingBackend);
+            int findCount = 0;
+            engine.replaceAll(toReplaceRule(itemData), findCount, totalReplaceCount, transaction);
+        }
 
         // Add the entered text to the combo box history
         addStringToComboBoxHistory(GetDlgItem(_hSelf, IDC_FIND_EDIT), itemData.findText);
         addStringToComboBoxHistory(GetDlgItem(_hSelf, IDC_REPLACE_EDIT), itemData.replaceText);
     }
-    // Display status message
-    showStatusMessage(getLangStr(L"status_occurrences_replaced", { std::to_wstring(totalReplaceCount) }), RGB(0, 128, 0));
+    // Display status message, entries the watchdog stopped had their replacements undone
+    std::wstring message = getLangStr(L"status_occurrences_replaced", { std::to_wstring(totalReplaceCount) });
+    if (!engine.regexWatchdog.timeouts().empty()) {
+        message += L" " + getLangStr(L"status_regex_replacements_undone");
+    }
+    showStatusMessage(appendOperationStatus(message), RGB(0, 128, 0));
+}
+
+void MultiReplace::updateEngineOptions() {
+    if (IsDlgButtonChecked(_hSelf, IDC_SELECTION_RADIO) == BST_CHECKED) {
+        engine.options.scope = SearchScope::Selection;
+    }
+    else if (IsDlgButtonChecked(_hSelf, IDC_COLUMN_MODE_RADIO) == BST_CHECKED) {
+        engine.options.scope = SearchScope::Column;
+    }
+    else {
+        engine.options.scope = SearchScope::AllText;
+    }
+    engine.options.replaceFirst = (IsDlgButtonChecked(_hSelf, IDC_REPLACE_FIRST_CHECKBOX) == BST_CHECKED);
+    engine.options.useList = (IsDlgButtonChecked(_hSelf, IDC_USE_LIST_CHECKBOX) == BST_CHECKED);
+    engine.options.foldCharacters = foldCharacters;
+    engine.options.indexTrigrams = indexTrigrams;
+    engine.unionRegex = unionRegex;
+}
+
+// Called once by each user operation, regex rules stopped in the last one run again. Status
+// updates and timers only take the options, they must not reset an operation under way.
+void MultiReplace::beginEngineOperation() {
+    updateEngineOptions();
+    engine.notifyPropertiesChanged();
+    engine.regexWatchdog.beginOperation(regexBudgetMs);
+}
+
+ReplaceRule MultiReplace::toReplaceRule(const ReplaceItemData& itemData) const {
+    ReplaceRule rule;
+    rule.isEnabled = itemData.isEnabled;
+    rule.findText = wstringToString(itemData.findText);
+    rule.replaceText = wstringToString(itemData.replaceText);
+    rule.wholeWord = itemData.wholeWord;
+    rule.matchCase = itemData.matchCase;
+    rule.useVariables = itemData.useVariables;
+    rule.extended = itemData.extended;
+    rule.regex = itemData.regex && itemData.fuzzyEdits == 0; // Fuzzy mode takes precedence in loaded lists
+    rule.fuzzyEdits = itemData.fuzzyEdits;
+    return rule;
+}
+
+int MultiReplace::getFuzzyEditsFromDialog() {
+    if (IsDlgButtonChecked(_hSelf, IDC_FUZZY_RADIO) != BST_CHECKED) {
+        return 0;
+    }
+    BOOL translated = FALSE;
+    UINT edits = GetDlgItemInt(_hSelf, IDC_FUZZY_EDITS_EDIT, &translated, FALSE);
+    return translated ? std::clamp(static_cast<int>(edits), 1, MAX_FUZZY_EDITS) : 1;
+}
+
+bool MultiReplace::checkFuzzyFindText(const std::wstring& findText, int fuzzyEdits) {
+    // The fuzzy matcher keeps one bit per character of the find text
+    size_t characters = std::count_if(findText.begin(), findText.end(), [](wchar_t ch) { return ch < 0xDC00 || ch > 0xDFFF; });
+    if (fuzzyEdits > 0 && characters > FuzzyMatcher::MAX_PATTERN_LENGTH) {
+        showStatusMessage(getLangStr(L"status_fuzzy_text_too_long", { std::to_wstring(FuzzyMatcher::MAX_PATTERN_LENGTH) }), RGB(255, 0, 0));
+        return false;
+    }
+    return true;
+}
+
+std::vector<ReplaceRule> MultiReplace::getReplaceRules() const {
+    std::vector<ReplaceRule> rules;
+    rules.reserve(replaceListData.size());
+    for (const auto& itemData : replaceListData) {
+        rules.push_back(toReplaceRule(itemData));
+    }
+    return rules;
+}
+
+// Ranges of the text the user typed since the last pass of live replace. Inserts wait for
+// SCN_CHARADDED, see trackTypedCharacter.
+void MultiReplace::trackLiveReplace(const SCNotification* notifyCode) {
+    if (!liveReplaceEnabled) {
+        return;
+    }
+
+    // Changes of the panel's own operations, undo and redo are left as they are, pending
+    // ranges would not follow them
+    if (panelMessageDepth > 0 || !(notifyCode->modificationType & SC_PERFORMED_USER)) {
+        if (!typedText.empty()) {
+            clearLiveReplace();
+        }
+        return;
+    }
+
+    if (notifyCode->modificationType & SC_MOD_INSERTTEXT) {
+        typedText.inserted(notifyCode->position, notifyCode->length);
+    }
+    else {
+        typedText.deleted(notifyCode->position, notifyCode->length);
+        // Deleting while typing postpones the pass as well
+        if (!typedText.empty()) {
+            SetTimer(_hSelf, LIVE_REPLACE_TIMER_ID, liveReplaceDelayMs, NULL);
+        }
+    }
+}
+
+// The last insert was typed if it ends at the caret. Characters a macro records or plays
+// back are left alone.
+void MultiReplace::trackTypedCharacter() {
+    if (!liveReplaceEnabled || panelMessageDepth > 0) {
+        return;
+    }
+    const MacroStatus macroStatus = static_cast<MacroStatus>(::SendMessage(nppData._nppHandle, NPPM_GETCURRENTMACROSTATUS, 0, 0));
+    if (macroStatus == MacroStatus::RecordInProgress || macroStatus == MacroStatus::PlayingBack) {
+        return;
+    }
+
+    // Typing on postpones the pass
+    if (typedText.charAdded(::SendMessage(_hScintilla, SCI_GETCURRENTPOS, 0, 0))) {
+        SetTimer(_hSelf, LIVE_REPLACE_TIMER_ID, liveReplaceDelayMs, NULL);
+    }
+}
+
+// One undo step per pass, the edits of the pass itself are not tracked again
+void MultiReplace::applyLiveReplace() {
+    KillTimer(_hSelf, LIVE_REPLACE_TIMER_ID);
+
+    std::vector<SelectionRange> ranges = typedText.take();
+    if (!liveReplaceEnabled || ranges.empty() || replaceListData.empty()) {
+        return;
+    }
+
+    beginEngineOperation();
+    std::vector<RuleCount> counts;
+    {
+        BulkEditTransaction transaction(recordingBackend);
+        engine.replaceInRanges(getReplaceRules(), ranges, counts);
+    }
+
+    int totalReplaceCount = 0;
+    for (size_t i = 0; i < counts.size(); ++i) {
+        if (counts[i].findCount > 0) {
+            updateCountColumns(i, counts[i].findCount, counts[i].replaceCount);
+        }
+        totalReplaceCount += counts[i].replaceCount;
+    }
+    if (totalReplaceCount > 0) {
+        showStatusMessage(getLangStr(L"status_live_replaced", { std::to_wstring(totalReplaceCount) }), RGB(0, 128, 0));
+    }
+}
+
+void MultiReplace::clearLiveReplace() {
+    if (_hSelf) {
+        KillTimer(_hSelf, LIVE_REPLACE_TIMER_ID);
+    }
+    typedText.clear();
 }
 
 void MultiReplace::handleReplaceButton() {
@@ -2478,13 +2809,14 @@ void MultiReplace::handleReplaceButton() {
         return;
     }
 
+    beginEngineOperation();
+
     bool useListEnabled = (IsDlgButtonChecked(_hSelf, IDC_USE_LIST_CHECKBOX) == BST_CHECKED);
     bool wrapAroundEnabled = (IsDlgButtonChecked(_hSelf, IDC_WRAP_AROUND_CHECKBOX) == BST_CHECKED);
 
     SearchResult searchResult;
     searchResult.pos = -1;
     searchResult.length = 0;
-    searchResult.foundText = "";
 
     Sci_Position newPos = ::SendMessage(_hScintilla, SCI_GETCURRENTPOS, 0, 0);
     size_t matchIndex = std::numeric_limits<size_t>::max();
@@ -2495,20 +2827,30 @@ void MultiReplace::handleReplaceButton() {
             return;
         }
 
-        SelectionInfo selection = getSelectionInfo();
+        SelectionInfo selection = engine.getSelectionInfo();
+        std::vector<ReplaceRule> rules = getReplaceRules();
+        std::vector<CountRule> prefetched = prefetchRules();
 
         int replacements = 0;  // Counter for replacements
-        for (size_t i = 0; i < replaceListData.size(); ++i) {
-            if (replaceListData[i].isEnabled && replaceOne(replaceListData[i], selection, searchResult, newPos)) {
+        for (size_t i = 0; i < rules.size(); ++i) {
+            // The look-ahead spares the search of rules without a match at the selection
+            if (!rules[i].isEnabled || !mayReplaceAt(prefetched, i, selection)) {
+                continue;
+            }
+            const uint64_t previousVersion = engine.getDocumentVersion();
+            if (engine.replaceOne(rules[i], selection, searchResult, newPos)) {
                 replacements++;
                 updateCountColumns(i, -1, 1);
+                prefetchReplacement(searchResult, newPos, previousVersion);
             }
         }
 
-        searchResult = performListSearchForward(replaceListData, newPos, matchIndex);
+        if (!findPrefetched(prefetched, newPos, searchResult, matchIndex)) {
+            searchResult = engine.performListSearchForward(rules, newPos, matchIndex);
+        }
 
-        if (searchResult.pos < 0 && wrapAroundEnabled) {
-            searchResult = performListSearchForward(replaceListData, 0, matchIndex);
+        if (searchResult.pos < 0 && wrapAroundEnabled && !findPrefetched(prefetched, 0, searchResult, matchIndex)) {
+            searchResult = engine.performListSearchForward(rules, 0, matchIndex);
         }
 
         // Build and show message based on results
@@ -2536,22 +2878,36 @@ void MultiReplace::handleReplaceButton() {
         replaceItem.useVariables = (IsDlgButtonChecked(_hSelf, IDC_USE_VARIABLES_CHECKBOX) == BST_CHECKED);
         replaceItem.regex = (IsDlgButtonChecked(_hSelf, IDC_REGEX_RADIO) == BST_CHECKED);
         replaceItem.extended = (IsDlgButtonChecked(_hSelf, IDC_EXTENDED_RADIO) == BST_CHECKED);
+        replaceItem.fuzzyEdits = getFuzzyEditsFromDialog();
+
+        if (!checkFuzzyFindText(replaceItem.findText, replaceItem.fuzzyEdits)) {
+            return;
+        }
 
         std::string findTextUtf8 = convertAndExtend(replaceItem.findText, replaceItem.extended);
-        int searchFlags = (replaceItem.wholeWord * SCFIND_WHOLEWORD) | (replaceItem.matchCase * SCFIND_MATCHCASE) | (replaceItem.regex * SCFIND_REGEXP);
+        int searchFlags = searchFlagsOf(replaceItem.wholeWord, replaceItem.matchCase, replaceItem.regex, replaceItem.fuzzyEdits);
 
-        SelectionInfo selection = getSelectionInfo();
-        bool wasReplaced = replaceOne(replaceItem, selection, searchResult, newPos);
+        SelectionInfo selection = engine.getSelectionInfo();
+        const uint64_t previousVersion = engine.getDocumentVersion();
+        bool wasReplaced = engine.replaceOne(toReplaceRule(replaceItem), selection, searchResult, newPos);
+        if (wasReplaced) {
+            prefetchReplacement(searchResult, newPos, previousVersion);
+        }
 
         // Add the entered text to the combo box history
         addStringToComboBoxHistory(GetDlgItem(_hSelf, IDC_FIND_EDIT), replaceItem.findText);
         addStringToComboBoxHistory(GetDlgItem(_hSelf, IDC_REPLACE_EDIT), replaceItem.replaceText);
 
+        std::vector<CountRule> prefetched = prefetchRules(findTextUtf8, searchFlags);
         if (searchResult.pos < 0 && wrapAroundEnabled) {
-            searchResult = performSearchForward(findTextUtf8, searchFlags, true, 0);
+            if (!findPrefetched(prefetched, 0, searchResult, matchIndex)) {
+                searchResult = engine.performSearchForward(findTextUtf8, searchFlags, true, 0);
+            }
         }
         else if (searchResult.pos >= 0) {
-            searchResult = performSearchForward(findTextUtf8, searchFlags, true, newPos);
+            if (!findPrefetched(prefetched, newPos, searchResult, matchIndex)) {
+                searchResult = engine.performSearchForward(findTextUtf8, searchFlags, true, newPos);
+            }
         }
 
         if (wasReplaced) {
@@ -2571,640 +2927,178 @@ void MultiReplace::handleReplaceButton() {
 
 }
 
-bool MultiReplace::replaceOne(const ReplaceItemData& itemData, const SelectionInfo& selection, SearchResult& searchResult, Sci_Position& newPos)
-{
-    std::string findTextUtf8 = convertAndExtend(itemData.findText, itemData.extended);
-    int searchFlags = (itemData.wholeWord * SCFIND_WHOLEWORD) | (itemData.matchCase * SCFIND_MATCHCASE) | (itemData.regex * SCFIND_REGEXP);
-    searchResult = performSearchForward(findTextUtf8, searchFlags, true, selection.startPos);
-
-    if (searchResult.pos == selection.startPos && searchResult.length == selection.length) {
-        bool skipReplace = false;
-        std::string replaceTextUtf8 = convertAndExtend(itemData.replaceText, itemData.extended);
-        std::string localReplaceTextUtf8 = wstringToString(itemData.replaceText);
-        if (itemData.useVariables) {
-            LuaVariables vars;
-
-            int currentLineIndex = static_cast<int>(send(SCI_LINEFROMPOSITION, static_cast<uptr_t>(searchResult.pos), 0));
-            int previousLineStartPosition = (currentLineIndex == 0) ? 0 : static_cast<int>(send(SCI_POSITIONFROMLINE, static_cast<uptr_t>(currentLineIndex), 0));
-
-            if (IsDlgButtonChecked(_hSelf, IDC_COLUMN_MODE_RADIO) == BST_CHECKED) {
-                ColumnInfo columnInfo = getColumnInfo(searchResult.pos);
-                vars.COL = static_cast<int>(columnInfo.startColumnIndex);
-            }
-            vars.CNT = 1;
-            vars.LCNT = 1;
-            vars.APOS = static_cast<int>(searchResult.pos) + 1;
-            vars.LINE = currentLineIndex + 1;
-            vars.LPOS = static_cast<int>(searchResult.pos) - previousLineStartPosition + 1;
-            vars.MATCH = searchResult.foundText;
-
-            if (!resolveLuaSyntax(localReplaceTextUtf8, vars, skipReplace, itemData.regex)) {
-                return false;  // Exit the function if error in syntax
-            }
-            replaceTextUtf8 = convertAndExtend(localReplaceTextUtf8, itemData.extended);
-        }
-
-        if (!skipReplace) {
-            if (itemData.regex) {
-                newPos = performRegexReplace(replaceTextUtf8, searchResult.pos, searchResult.length);
-            }
-            else {
-                newPos = performReplace(replaceTextUtf8, searchResult.pos, searchResult.length);
-            }
-            return true;  // A replacement was made
-        }
-        else {
-            newPos = searchResult.pos + searchResult.length;
-            // Clear selection
-            send(SCI_SETSELECTIONSTART, newPos, 0);
-            send(SCI_SETSELECTIONEND, newPos, 0);
-        }
-    }
-    return false;  // No replacement was made
-}
+#pragma endregion
 
-void MultiReplace::replaceAll(const ReplaceItemData& itemData, int& findCount, int& replaceCount)
-{
-    if (itemData.findText.empty()) {
-        findCount = 0;
-        replaceCount = 0;
-        return;
-    }
 
-    bool isReplaceFirstEnabled = (IsDlgButtonChecked(_hSelf, IDC_REPLACE_FIRST_CHECKBOX) == BST_CHECKED);
-    int searchFlags = (itemData.wholeWord * SCFIND_WHOLEWORD) | (itemData.matchCase * SCFIND_MATCHCASE) | (itemData.regex * SCFIND_REGEXP);
+#pragma region Find
 
-    std::string findTextUtf8 = convertAndExtend(itemData.findText, itemData.extended);
-    std::string replaceTextUtf8 = convertAndExtend(itemData.replaceText, itemData.extended);
+void MultiReplace::handleFindNextButton() {
+    beginEngineOperation();
 
-    int previousLineIndex = -1;
-    int lineFindCount = 0;
+    size_t matchIndex = std::numeric_limits<size_t>::max();
 
-    SearchResult searchResult = performSearchForward(findTextUtf8, searchFlags, false, 0);
+    bool useListEnabled = (IsDlgButtonChecked(_hSelf, IDC_USE_LIST_CHECKBOX) == BST_CHECKED);
+    bool wrapAroundEnabled = (IsDlgButtonChecked(_hSelf, IDC_WRAP_AROUND_CHECKBOX) == BST_CHECKED);
 
-    while (searchResult.pos >= 0)
-    {
-        bool skipReplace = false;
-        findCount++;
-        std::string localReplaceTextUtf8 = wstringToString(itemData.replaceText);
-        if (itemData.useVariables) {
-            LuaVariables vars;
-
-            if (IsDlgButtonChecked(_hSelf, IDC_COLUMN_MODE_RADIO) == BST_CHECKED) {
-                ColumnInfo columnInfo = getColumnInfo(searchResult.pos);
-                vars.COL = static_cast<int>(columnInfo.startColumnIndex);
-            }
+    LRESULT searchPos = ::SendMessage(_hScintilla, SCI_GETCURRENTPOS, 0, 0);
 
-            int currentLineIndex = static_cast<int>(send(SCI_LINEFROMPOSITION, static_cast<uptr_t>(searchResult.pos), 0));
-            int previousLineStartPosition = (currentLineIndex == 0) ? 0 : static_cast<int>(send(SCI_POSITIONFROMLINE, static_cast<uptr_t>(currentLineIndex), 0));
+    if (useListEnabled) {
+        if (replaceListData.empty()) {
+            showStatusMessage(getLangStr(L"status_add_values_or_find_directly"), RGB(255, 0, 0));
+            return;
+        }
 
-            // Reset lineReplaceCount if the line has changed
-            if (currentLineIndex != previousLineIndex) {
-                lineFindCount = 0;
-                previousLineIndex = currentLineIndex;
+        std::vector<ReplaceRule> rules = getReplaceRules();
+        std::vector<CountRule> prefetched = prefetchRules();
+        SearchResult result;
+        if (!findPrefetched(prefetched, searchPos, result, matchIndex)) {
+            result = engine.performListSearchForward(rules, searchPos, matchIndex);
+        }
+        if (result.pos < 0 && wrapAroundEnabled) {
+            if (!findPrefetched(prefetched, 0, result, matchIndex)) {
+                result = engine.performListSearchForward(rules, 0, matchIndex);
             }
-
-            lineFindCount++;
-
-            vars.CNT = findCount;
-            vars.LCNT = lineFindCount;
-            vars.APOS = static_cast<int>(searchResult.pos) + 1;
-            vars.LINE = currentLineIndex + 1;
-            vars.LPOS = static_cast<int>(searchResult.pos) - previousLineStartPosition + 1;
-            vars.MATCH = searchResult.foundText;
-
-            if (!resolveLuaSyntax(localReplaceTextUtf8, vars, skipReplace, itemData.regex)) {
-                break;  // Exit the loop if error in syntax
+            if (result.pos >= 0) {
+                updateCountColumns(matchIndex, 1);
+                showStatusMessage(getLangStr(L"status_wrapped"), RGB(0, 128, 0));
+                return;
             }
-            replaceTextUtf8 = convertAndExtend(localReplaceTextUtf8, itemData.extended);
         }
 
-        Sci_Position newPos;
-        if (!skipReplace) {
-            if (itemData.regex) {
-                newPos = performRegexReplace(replaceTextUtf8, searchResult.pos, searchResult.length);
+        if (result.pos >= 0) {
+            showStatusMessage(L"", RGB(0, 128, 0));
+            updateCountColumns(matchIndex, 1);
+        }
+        else {
+            showNoMatchStatus(getLangStr(L"status_no_matches_found"));
+        }
+    }
+    else {
+        std::wstring findText = getTextFromDialogItem(_hSelf, IDC_FIND_EDIT);
+        bool wholeWord = (IsDlgButtonChecked(_hSelf, IDC_WHOLE_WORD_CHECKBOX) == BST_CHECKED);
+        bool matchCase = (IsDlgButtonChecked(_hSelf, IDC_MATCH_CASE_CHECKBOX) == BST_CHECKED);
+        bool regex = (IsDlgButtonChecked(_hSelf, IDC_REGEX_RADIO) == BST_CHECKED);
+        bool extended = (IsDlgButtonChecked(_hSelf, IDC_EXTENDED_RADIO) == BST_CHECKED);
+        int fuzzyEdits = getFuzzyEditsFromDialog();
+        if (!checkFuzzyFindText(findText, fuzzyEdits)) {
+            return;
+        }
+        int searchFlags = searchFlagsOf(wholeWord, matchCase, regex, fuzzyEdits);
+
+        std::string findTextUtf8 = convertAndExtend(findText, extended);
+        std::vector<CountRule> prefetched = prefetchRules(findTextUtf8, searchFlags);
+        SearchResult result;
+        if (!findPrefetched(prefetched, searchPos, result, matchIndex)) {
+            result = engine.performSearchForward(findTextUtf8, searchFlags, true, searchPos);
+        }
+        if (result.pos < 0 && wrapAroundEnabled) {
+            if (!findPrefetched(prefetched, 0, result, matchIndex)) {
+                result = engine.performSearchForward(findTextUtf8, searchFlags, true, 0);
             }
-            else {
-                newPos = performReplace(replaceTextUtf8, searchResult.pos, searchResult.length);
+            if (result.pos >= 0) {
+                showStatusMessage(getLangStr(L"status_wrapped"), RGB(0, 128, 0));
+                return;
             }
-            replaceCount++;
+        }
+
+        if (result.pos >= 0) {
+            showStatusMessage(L"", RGB(0, 128, 0));
         }
         else {
-            newPos = searchResult.pos + searchResult.length;
-            // Clear selection
-            send(SCI_SETSELECTIONSTART, newPos, 0);
-            send(SCI_SETSELECTIONEND, newPos, 0);
+            showNoMatchStatus(getLangStr(L"status_no_matches_found_for", { findText }));
         }
+        addStringToComboBoxHistory(GetDlgItem(_hSelf, IDC_FIND_EDIT), findText);
+    }
+}
 
-        if (isReplaceFirstEnabled) {
-            break;  // Exit the loop after the first successful replacement
+std::vector<CountRule> MultiReplace::prefetchRules() {
+    std::vector<CountRule> rules;
+    for (size_t i = 0; i < replaceListData.size(); ++i) {
+        if (replaceListData[i].isEnabled) {
+            rules.push_back(makeCountRule(i));
+            if (!SearchPrefetcher::canPrefetch(rules.back(), engine.options)) {
+                return {};
+            }
         }
-
-        searchResult = performSearchForward(findTextUtf8, searchFlags, false, newPos);
     }
+    return rules;
+}
 
+std::vector<CountRule> MultiReplace::prefetchRules(const std::string& findTextUtf8, int searchFlags) const {
+    CountRule rule;
+    rule.findTextUtf8 = findTextUtf8;
+    rule.searchFlags = searchFlags;
+    if (!SearchPrefetcher::canPrefetch(rule, engine.options)) {
+        return {};
+    }
+    return { rule };
 }
 
-Sci_Position MultiReplace::performReplace(const std::string& replaceTextUtf8, Sci_Position pos, Sci_Position length)
-{
-    // Set the target range for the replacement
-    send(SCI_SETTARGETRANGE, pos, pos + length);
+bool MultiReplace::findPrefetched(const std::vector<CountRule>& rules, Sci_Position pos, SearchResult& result, size_t& matchIndex) {
+    if (rules.empty()) {
+        return false;
+    }
 
-    // Get the codepage of the document
-    int cp = static_cast<int>(send(SCI_GETCODEPAGE, 0, 0));
+    const uint64_t version = engine.getDocumentVersion();
+    if (!searchPrefetcher.follows(rules, version)) {
+        // This step still searches itself, the session serves the steps after the copy
+        if (::SendMessage(_hScintilla, SCI_GETLENGTH, 0, 0) >= PREFETCH_MIN_LENGTH) {
+            searchPrefetcher.prepare(rules, pos, version);
+            SetTimer(_hSelf, PREFETCH_COPY_TIMER_ID, USER_TIMER_MINIMUM, NULL);
+        }
+        return false;
+    }
 
-    // Convert the string from UTF-8 to the codepage of the document
-    std::string replaceTextCp = utf8ToCodepage(replaceTextUtf8, cp);
+    PrefetchedMatch match;
+    switch (searchPrefetcher.next(pos, version, match, prefetchSearch())) {
+    case SearchPrefetcher::Lookup::Found:
+        engine.displayResultCentered(match.start, match.end, true);
+        result.pos = match.start;
+        result.length = match.end - match.start;
+        matchIndex = rules[match.rule].index;
+        return true;
+    case SearchPrefetcher::Lookup::NotFound:
+        result = SearchResult();
+        matchIndex = std::numeric_limits<size_t>::max();
+        return true;
+    default:
+        return false;
+    }
+}
 
-    // Perform the replacement
-    send(SCI_REPLACETARGET, replaceTextCp.size(), reinterpret_cast<sptr_t>(replaceTextCp.c_str()));
-    
-    // Get the end position after the replacement
-    Sci_Position newTargetEnd = static_cast<Sci_Position>(send(SCI_GETTARGETEND, 0, 0));
+bool MultiReplace::mayReplaceAt(const std::vector<CountRule>& rules, size_t index, const SelectionInfo& selection) {
+    auto rule = std::find_if(rules.begin(), rules.end(), [index](const CountRule& candidate) { return candidate.index == index; });
+    if (rule == rules.end() || !searchPrefetcher.follows(rules, engine.getDocumentVersion())) {
+        return true;
+    }
 
-    // Set the cursor to the end of the replaced text
-    //send(SCI_SETCURRENTPOS, newTargetEnd, 0);
+    PrefetchedMatch match;
+    switch (searchPrefetcher.next(selection.startPos, engine.getDocumentVersion(), match, prefetchSearch(), static_cast<size_t>(rule - rules.begin()))) {
+    case SearchPrefetcher::Lookup::Found:
+        return match.start == selection.startPos && match.end - match.start == selection.length;
+    case SearchPrefetcher::Lookup::NotFound:
+        return false;
+    default:
+        return true;
+    }
+}
 
-    // Clear selection
-    //send(SCI_SETSELECTIONSTART, newTargetEnd, 0);
-    //send(SCI_SETSELECTIONEND, newTargetEnd, 0);
+SearchPrefetcher::RangeSearch MultiReplace::prefetchSearch() {
+    // Only asked for the text around a replacement
+    return [this](const CountRule& rule, Sci_Position start, Sci_Position end) {
+        return engine.performSingleSearch(rule.findTextUtf8, rule.searchFlags, false, { start, end });
+    };
+}
 
-    return newTargetEnd;
+void MultiReplace::prefetchReplacement(const SearchResult& replaced, Sci_Position newPos, uint64_t previousVersion) {
+    SearchResult inserted;
+    inserted.pos = replaced.pos;
+    inserted.length = newPos - replaced.pos;
+    searchPrefetcher.applyEdit(replaced.pos, replaced.length, engine.getMatchText(inserted), previousVersion, engine.getDocumentVersion());
 }
 
-Sci_Position MultiReplace::performRegexReplace(const std::string& replaceTextUtf8, Sci_Position pos, Sci_Position length)
-{
-    // Set the target range for the replacement
-    send(SCI_SETTARGETRANGE, pos, pos + length);
-
-    // Get the codepage of the document
-    int cp = static_cast<int>(send(SCI_GETCODEPAGE, 0, 0));
-
-    // Convert the string from UTF-8 to the codepage of the document
-    std::string replaceTextCp = utf8ToCodepage(replaceTextUtf8, cp);
-
-    // Perform the regex replacement
-    send(SCI_REPLACETARGETRE, static_cast<WPARAM>(-1), reinterpret_cast<sptr_t>(replaceTextCp.c_str()));
-
-    // Get the end position after the replacement
-    Sci_Position newTargetEnd = static_cast<Sci_Position>(send(SCI_GETTARGETEND, 0, 0));
-
-    // Set the cursor to the end of the replaced text
-    send(SCI_SETCURRENTPOS, newTargetEnd, 0);
-
-    // Clear selection
-    send(SCI_SETSELECTIONSTART, newTargetEnd, 0);
-    send(SCI_SETSELECTIONEND, newTargetEnd, 0);
-
-    return newTargetEnd;
-}
-
-SelectionInfo MultiReplace::getSelectionInfo() {
-    // Get selected text
-    Sci_Position selectionStart = ::SendMessage(_hScintilla, SCI_GETSELECTIONSTART, 0, 0);
-    Sci_Position selectionEnd = ::SendMessage(_hScintilla, SCI_GETSELECTIONEND, 0, 0);
-    std::vector<char> buffer(selectionEnd - selectionStart + 1);
-    ::SendMessage(_hScintilla, SCI_GETSELTEXT, 0, reinterpret_cast<LPARAM>(&buffer[0]));
-    std::string selectedText(&buffer[0]);
-
-    // Calculate the length of the selected text
-    Sci_Position selectionLength = selectionEnd - selectionStart;
-
-    return SelectionInfo{ selectedText, selectionStart, selectionLength };
-}
-
-void MultiReplace::captureLuaGlobals(lua_State* L) {
-    lua_pushglobaltable(L);
-    lua_pushnil(L);
-    while (lua_next(L, -2) != 0) {
-        const char* key = lua_tostring(L, -2);
-        LuaVariable luaVar;
-        luaVar.name = key;
-
-        int type = lua_type(L, -1);
-        if (type == LUA_TNUMBER) {
-            luaVar.type = LuaVariableType::Number;
-            luaVar.numberValue = lua_tonumber(L, -1);
-        }
-        else if (type == LUA_TSTRING) {
-            luaVar.type = LuaVariableType::String;
-            luaVar.stringValue = lua_tostring(L, -1);
-        }
-        else if (type == LUA_TBOOLEAN) {
-            luaVar.type = LuaVariableType::Boolean;
-            luaVar.booleanValue = lua_toboolean(L, -1);
-        }
-        else {
-            // Skipping unknown types
-            lua_pop(L, 1);
-            continue;
-        }
-
-        globalLuaVariablesMap[key] = luaVar;
-        lua_pop(L, 1);
-    }
-
-    lua_pop(L, 1);
-}
-
-void MultiReplace::loadLuaGlobals(lua_State* L) {
-    for (const auto& pair : globalLuaVariablesMap) {
-        const LuaVariable& var = pair.second;
-
-        switch (var.type) {
-        case LuaVariableType::String:
-            lua_pushstring(L, var.stringValue.c_str());
-            break;
-        case LuaVariableType::Number:
-            lua_pushnumber(L, var.numberValue);
-            break;
-        case LuaVariableType::Boolean:
-            lua_pushboolean(L, var.booleanValue);
-            break;
-        default:
-            continue;  // Skip None or unsupported types
-        }
-
-        lua_setglobal(L, var.name.c_str());
-    }
-}
-
-bool MultiReplace::resolveLuaSyntax(std::string& inputString, const LuaVariables& vars, bool& skip, bool regex)
-{
-    lua_State* L = luaL_newstate();  // Create a new Lua environment
-    luaL_openlibs(L);  // Load standard libraries
-
-    loadLuaGlobals(L); // Load global Lua variables
-
-    // Set variables
-    lua_pushnumber(L, vars.CNT);
-    lua_setglobal(L, "CNT");
-    lua_pushnumber(L, vars.LCNT);
-    lua_setglobal(L, "LCNT");
-    lua_pushnumber(L, vars.LINE);
-    lua_setglobal(L, "LINE");
-    lua_pushnumber(L, vars.LPOS);
-    lua_setglobal(L, "LPOS");
-    lua_pushnumber(L, vars.APOS);
-    lua_setglobal(L, "APOS");
-    lua_pushnumber(L, vars.COL);
-    lua_setglobal(L, "COL");
-    lua_pushboolean(L, regex);
-    lua_setglobal(L, "REGEX");
-
-    // Convert numbers to integers
-    luaL_dostring(L, "CNT = math.tointeger(CNT)");
-    luaL_dostring(L, "LCNT = math.tointeger(LCNT)");
-    luaL_dostring(L, "LINE = math.tointeger(LINE)");
-    luaL_dostring(L, "LPOS = math.tointeger(LPOS)");
-    luaL_dostring(L, "APOS = math.tointeger(APOS)");
-    luaL_dostring(L, "COL = math.tointeger(COL)");
-
-    setLuaVariable(L, "MATCH", vars.MATCH, regex);
-    // Get CAPs from Scintilla using SCI_GETTAG
-    std::vector<std::string> caps;  // Initialize an empty vector to store the captures
-
-    if (regex) {
-        sptr_t len = 0;
-        for (int i = 1; ; ++i) {
-            char buffer[1024] = { 0 };  // Buffer to hold the capture value
-            len = send(SCI_GETTAG, i, reinterpret_cast<sptr_t>(buffer), true);
-
-            if (len <= 0) {
-                // If len is zero or negative, break the loop
-                break;
-            }
-
-            if (len < sizeof(buffer)) {
-                // If the first character is 0x00, break the loop
-                if (buffer[0] == 0x00) {
-                    break;
-                }
-                buffer[len] = '\0';  // Null-terminate the string
-                std::string cap(buffer);  // Convert to std::string
-                caps.push_back(cap);  // Add the capture to the vector
-            }
-            else {
-                // Buffer overflow detected: This should be rare, but it's good to check
-                lua_close(L);
-                return false;
-            }
-        }
-    }
-
-    // Process the captures and set them as global variables
-    for (size_t i = 0; i < caps.size(); ++i) {
-        std::string cap = caps[i];
-        std::string globalVarName = "CAP" + std::to_string(i + 1);
-        setLuaVariable(L, globalVarName, cap, regex);
-    }
-
-    // Declare cond statement function
-    luaL_dostring(L,
-        "function cond(cond, trueVal, falseVal)\n"
-        "  local res = {result = '', skip = false}  -- Initialize result table with defaults\n"
-        "  if cond == nil then  -- Check if cond is nil\n"
-        "    error('cond cannot be nil')\n"
-        "    return res\n"
-        "  end\n"
-
-        "  if trueVal == nil then  -- Check if trueVal is nil\n"
-        "    error('trueVal cannot be nil')\n"
-        "    return res\n"
-        "  end\n"
-
-        "  if falseVal == nil then  -- Check if falseVal is missing\n"
-        "    res.skip = true  -- Set skip to true ONLY IF falseVal is not provided\n"
-        "  end\n"
-
-        "  if type(trueVal) == 'function' then\n"
-        "    trueVal = trueVal()\n"
-        "  end\n"
-
-        "  if type(falseVal) == 'function' then\n"
-        "    falseVal = falseVal()\n"
-        "  end\n"
-
-        "  if cond then\n"
-        "    if type(trueVal) == 'table' then\n"
-        "      res.result = trueVal.result\n"
-        "      res.skip = trueVal.skip\n"
-        "    else\n"
-        "      res.result = trueVal\n"
-        "      res.skip = false\n"
-        "    end\n"
-        "  else\n"
-        "    if not res.skip then\n"
-        "      if type(falseVal) == 'table' then\n"
-        "        res.result = falseVal.result\n"
-        "        res.skip = falseVal.skip\n"
-        "      else\n"
-        "        res.result = falseVal\n"
-        "      end\n"
-        "    end\n"
-        "  end\n"
-        "  resultTable = res\n"
-        "  return res  -- Return the table containing result and skip\n"
-        "end\n");
-
-
-    // Declare the set function
-    luaL_dostring(L,
-        "function set(strOrCalc)\n"
-        "  local res = {result = '', skip = false}  -- Initialize result table with defaults\n"
-        "  if strOrCalc == nil then\n"
-        "    error('cannot be nil')\n"
-        "    return\n"
-        "  end\n"
-        "  if type(strOrCalc) == 'string' then\n"
-        "    res.result = strOrCalc  -- Setting res.result\n"
-        "  elseif type(strOrCalc) == 'number' then\n"
-        "    res.result = tostring(strOrCalc)  -- Convert number to string and set to res.result\n"
-        "  else\n"
-        "    error('Expected string or number')\n"
-        "    return\n"
-        "  end\n"
-        "  resultTable = res\n"
-        "  return res  -- Return the table containing result and skip\n"
-        "end\n");
-
-    // Declare formatNumber function
-    luaL_dostring(L,
-        "function fmtN(num, maxDecimals, fixedDecimals)\n"
-        "  if num == nil then\n"
-        "    error('num cannot be nil')\n"
-        "    return\n"
-        "  elseif type(num) ~= 'number' then\n"
-        "    error('Invalid type for num. Expected a number')\n"
-        "    return\n"
-        "  end\n"
-        "  if maxDecimals == nil then\n"
-        "    error('maxDecimals cannot be nil')\n"
-        "    return\n"
-        "  elseif type(maxDecimals) ~= 'number' then\n"
-        "    error('Invalid type for maxDecimals. Expected a number')\n"
-        "    return\n"
-        "  end\n"
-        "  if fixedDecimals == nil then\n"
-        "    error('fixedDecimals cannot be nil')\n"
-        "    return\n"
-        "  elseif type(fixedDecimals) ~= 'boolean' then\n"
-        "    error('Invalid type for fixedDecimals. Expected a boolean')\n"
-        "    return\n"
-        "  end\n"
-        "  local multiplier = 10 ^ maxDecimals\n"
-        "  local rounded = math.floor(num * multiplier + 0.5) / multiplier\n"
-        "  local output = ''\n"
-        "  if fixedDecimals then\n"
-        "    output = string.format('%.' .. maxDecimals .. 'f', rounded)\n"
-        "  else\n"
-        "    local intPart, fracPart = math.modf(rounded)\n"
-        "    if fracPart == 0 then\n"
-        "      output = tostring(intPart)\n"
-        "    else\n"
-        "      output = tostring(rounded)\n"
-        "    end\n"
-        "  end\n"
-        "  return output\n"
-        "end");
-
-    // Declare the init function
-    luaL_dostring(L,
-        "function init(args)\n"
-        "  for name, value in pairs(args) do\n"
-        "    if _G[name] == nil then\n"
-        "      if type(name) ~= 'string' then\n"
-        "        error('Variable name must be a string')\n"
-        "      end\n"
-        "      if not string.match(name, '^[A-Za-z_][A-Za-z0-9_]*$') then\n"
-        "        error('Invalid variable name')\n"
-        "      end\n"
-        "      if value == nil then\n"
-        "        error('Value missing in Init')\n"
-        "      end\n"
-        "      -- Check if the value is a string and REGEX is true, then preprocess backslashes\n"
-        "      if type(value) == 'string' and REGEX then\n"
-        "        value = value:gsub('\\\\', '\\\\\\\\')\n"
-        "      end\n"
-        "      _G[name] = value\n"
-        "    end\n"
-        "  end\n"
-        "end\n");
-
-    // Show syntax error
-    if (luaL_dostring(L, inputString.c_str()) != LUA_OK) {
-        const char* cstr = lua_tostring(L, -1);
-        lua_pop(L, 1);
-        if (isLuaErrorDialogEnabled) {
-            std::wstring error_message = utf8ToWString(cstr);
-            MessageBoxW(NULL, error_message.c_str(), getLangStr(L"msgbox_title_use_variables_syntax_error").c_str(), MB_OK);
-        }
-        lua_close(L);
-        return false;
-    }
-
-    // Retrieve the result from the table
-    lua_getglobal(L, "resultTable");
-    if (lua_istable(L, -1)) {
-        lua_getfield(L, -1, "result");
-        if (lua_isstring(L, -1) || lua_isnumber(L, -1)) {
-            inputString = lua_tostring(L, -1);  // Update inputString with the result
-        }
-        lua_pop(L, 1);  // Pop the 'result' field from the stack
-
-        // Retrieve the skip flag from the table
-        lua_getfield(L, -1, "skip");
-        if (lua_isboolean(L, -1)) {
-            skip = lua_toboolean(L, -1);
-        }
-        else {
-            skip = false;
-        }
-        lua_pop(L, 1);  // Pop the 'skip' field from the stack
-    }
-    else {
-        // Show Runtime error
-        if (isLuaErrorDialogEnabled) {
-            std::wstring errorMsg = getLangStr(L"msgbox_use_variables_execution_error", { utf8ToWString(inputString.c_str()) });
-            std::wstring errorTitle = getLangStr(L"msgbox_title_use_variables_execution_error");
-            MessageBoxW(NULL, errorMsg.c_str(), errorTitle.c_str(), MB_OK);
-        }
-        lua_close(L);
-        return false;
-    }
-    lua_pop(L, 1);  // Pop the 'result' table from the stack
-
-    // Read Lua global Variables
-    captureLuaGlobals(L);
-    std::string luaVariablesStr;
-    for (const auto& pair : globalLuaVariablesMap) {
-        const LuaVariable& var = pair.second;
-        luaVariablesStr += var.name + ": ";
-
-        switch (var.type) {
-        case LuaVariableType::String:
-            luaVariablesStr += "String, " + var.stringValue;
-            break;
-        case LuaVariableType::Number:
-            luaVariablesStr += "Number, " + std::to_string(var.numberValue);
-            break;
-        case LuaVariableType::Boolean:
-            luaVariablesStr += "Boolean, " + std::string(var.booleanValue ? "true" : "false");
-            break;
-        default:
-            luaVariablesStr += "None or Unsupported Type";
-            break;
-        }
-        luaVariablesStr += "\n";
-    }
-
-    //MessageBoxA(NULL, luaVariablesStr.c_str(), "Lua Variables", MB_OK);
-
-
-    lua_close(L);
-
-    return true;
-
-}
-
-void MultiReplace::setLuaVariable(lua_State* L, const std::string& varName, std::string value, bool regex) {
-    // Check if the input string is a number
-    bool isNumber = normalizeAndValidateNumber(value);
-    if (isNumber) {
-        double doubleVal = std::stod(value);
-        int intVal = static_cast<int>(doubleVal);
-        if (doubleVal == static_cast<double>(intVal)) {
-            lua_pushinteger(L, intVal); // Push as integer if value is integral
-        }
-        else {
-            lua_pushnumber(L, doubleVal); // Push as floating-point number otherwise
-        }
-    }
-    else {
-        std::string processedValue = value;
-        if (regex) {
-            // Set of characters that need to be escaped in a regex pattern
-            const std::unordered_set<char> regexSpecialChars = {
-                '\\', '^', '$', '.', '|', '?', '*', '+', '(', ')', '[', ']', '{', '}' };
-
-            processedValue.clear();
-            for (char c : value) {
-                if (regexSpecialChars.find(c) != regexSpecialChars.end()) {
-                    processedValue.append("\\"); // Escape special characters
-                }
-                processedValue.push_back(c);
-            }
-        }
-        lua_pushstring(L, processedValue.c_str()); // Push the processed string to Lua
-    }
-    lua_setglobal(L, varName.c_str()); // Set the global variable in Lua
-}
-#pragma endregion
-
-
-#pragma region Find
-
-void MultiReplace::handleFindNextButton() {
-    size_t matchIndex = std::numeric_limits<size_t>::max();
-
-    bool useListEnabled = (IsDlgButtonChecked(_hSelf, IDC_USE_LIST_CHECKBOX) == BST_CHECKED);
-    bool wrapAroundEnabled = (IsDlgButtonChecked(_hSelf, IDC_WRAP_AROUND_CHECKBOX) == BST_CHECKED);
-
-    LRESULT searchPos = ::SendMessage(_hScintilla, SCI_GETCURRENTPOS, 0, 0);
-
-    if (useListEnabled) {
-        if (replaceListData.empty()) {
-            showStatusMessage(getLangStr(L"status_add_values_or_find_directly"), RGB(255, 0, 0));
-            return;
-        }
-
-        SearchResult result = performListSearchForward(replaceListData, searchPos, matchIndex);
-        if (result.pos < 0 && wrapAroundEnabled) {
-            result = performListSearchForward(replaceListData, 0, matchIndex);
-            if (result.pos >= 0) {
-                updateCountColumns(matchIndex, 1);
-                showStatusMessage(getLangStr(L"status_wrapped"), RGB(0, 128, 0));
-                return;
-            }
-        }
-
-        if (result.pos >= 0) {
-            showStatusMessage(L"", RGB(0, 128, 0));
-            updateCountColumns(matchIndex, 1);
-        }
-        else {
-            showStatusMessage(getLangStr(L"status_no_matches_found"), RGB(255, 0, 0));
-        }
-    }
-    else {
-        std::wstring findText = getTextFromDialogItem(_hSelf, IDC_FIND_EDIT);
-        bool wholeWord = (IsDlgButtonChecked(_hSelf, IDC_WHOLE_WORD_CHECKBOX) == BST_CHECKED);
-        bool matchCase = (IsDlgButtonChecked(_hSelf, IDC_MATCH_CASE_CHECKBOX) == BST_CHECKED);
-        bool regex = (IsDlgButtonChecked(_hSelf, IDC_REGEX_RADIO) == BST_CHECKED);
-        bool extended = (IsDlgButtonChecked(_hSelf, IDC_EXTENDED_RADIO) == BST_CHECKED);
-        int searchFlags = (wholeWord * SCFIND_WHOLEWORD) | (matchCase * SCFIND_MATCHCASE) | (regex * SCFIND_REGEXP);
-
-        std::string findTextUtf8 = convertAndExtend(findText, extended);
-        SearchResult result = performSearchForward(findTextUtf8, searchFlags, true, searchPos);
-        if (result.pos < 0 && wrapAroundEnabled) {
-            result = performSearchForward(findTextUtf8, searchFlags, true, 0);
-            if (result.pos >= 0) {
-                showStatusMessage(getLangStr(L"status_wrapped"), RGB(0, 128, 0));
-                return;
-            }
-        }
-
-        if (result.pos >= 0) {
-            showStatusMessage(L"", RGB(0, 128, 0));
-        }
-        else {
-            showStatusMessage(getLangStr(L"status_no_matches_found_for", { findText }), RGB(255, 0, 0));
-        }
-        addStringToComboBoxHistory(GetDlgItem(_hSelf, IDC_FIND_EDIT), findText);
-    }
-}
-
-void MultiReplace::handleFindPrevButton() {
+void MultiReplace::handleFindPrevButton() {
+    beginEngineOperation();
 
     size_t matchIndex = std::numeric_limits<size_t>::max();
 
@@ -3221,7 +3115,8 @@ void MultiReplace::handleFindPrevButton() {
             return;
         }
 
-        SearchResult result = performListSearchBackward(replaceListData, searchPos, matchIndex);
+        std::vector<ReplaceRule> rules = getReplaceRules();
+        SearchResult result = engine.performListSearchBackward(rules, searchPos, matchIndex);
 
         if (result.pos >= 0) {
             updateCountColumns(matchIndex, 1);
@@ -3229,7 +3124,7 @@ void MultiReplace::handleFindPrevButton() {
         }
         else if (wrapAroundEnabled)
         {
-            result = performListSearchBackward(replaceListData, ::SendMessage(_hScintilla, SCI_GETLENGTH, 0, 0), matchIndex);
+            result = engine.performListSearchBackward(rules, ::SendMessage(_hScintilla, SCI_GETLENGTH, 0, 0), matchIndex);
             if (result.pos >= 0) {
                 updateCountColumns(matchIndex, 1);
                 showStatusMessage(getLangStr(L"status_wrapped_position", { addLineAndColumnMessage(result.pos) }), RGB(0, 128, 0));
@@ -3240,7 +3135,7 @@ void MultiReplace::handleFindPrevButton() {
         }
         else
         {
-            showStatusMessage(getLangStr(L"status_no_matches_found"), RGB(255, 0, 0));
+            showNoMatchStatus(getLangStr(L"status_no_matches_found"));
         }
 
     }
@@ -3251,18 +3146,22 @@ void MultiReplace::handleFindPrevButton() {
         bool matchCase = (IsDlgButtonChecked(_hSelf, IDC_MATCH_CASE_CHECKBOX) == BST_CHECKED);
         bool regex = (IsDlgButtonChecked(_hSelf, IDC_REGEX_RADIO) == BST_CHECKED);
         bool extended = (IsDlgButtonChecked(_hSelf, IDC_EXTENDED_RADIO) == BST_CHECKED);
-        int searchFlags = (wholeWord * SCFIND_WHOLEWORD) | (matchCase * SCFIND_MATCHCASE) | (regex * SCFIND_REGEXP);
+        int fuzzyEdits = getFuzzyEditsFromDialog();
+        if (!checkFuzzyFindText(findText, fuzzyEdits)) {
+            return;
+        }
+        int searchFlags = searchFlagsOf(wholeWord, matchCase, regex, fuzzyEdits);
 
         std::string findTextUtf8 = convertAndExtend(findText, extended);
 
-        SearchResult result = performSearchBackward(findTextUtf8, searchFlags, searchPos);
+        SearchResult result = engine.performSearchBackward(findTextUtf8, searchFlags, searchPos);
 
         if (result.pos >= 0) {
             showStatusMessage(L"" + addLineAndColumnMessage(result.pos), RGB(0, 128, 0));
         }
         else if (wrapAroundEnabled)
         {
-            result = performSearchBackward(findTextUtf8, searchFlags, ::SendMessage(_hScintilla, SCI_GETLENGTH, 0, 0));
+            result = engine.performSearchBackward(findTextUtf8, searchFlags, ::SendMessage(_hScintilla, SCI_GETLENGTH, 0, 0));
             if (result.pos >= 0) {
                 showStatusMessage(getLangStr(L"status_wrapped_find", { findText, addLineAndColumnMessage(result.pos) }), RGB(0, 128, 0));
             }
@@ -3272,457 +3171,356 @@ void MultiReplace::handleFindPrevButton() {
         }
         else
         {
-            showStatusMessage(getLangStr(L"status_no_matches_found_for", { findText }), RGB(255, 0, 0));
+            showNoMatchStatus(getLangStr(L"status_no_matches_found_for", { findText }));
         }
 
         addStringToComboBoxHistory(GetDlgItem(_hSelf, IDC_FIND_EDIT), findText);
     }
 }
 
-SearchResult MultiReplace::performSingleSearch(const std::string& findTextUtf8, int searchFlags, bool selectMatch, SelectionRange range) {
-
-    send(SCI_SETTARGETSTART, range.start, 0);
-    send(SCI_SETTARGETEND, range.end, 0);
-    send(SCI_SETSEARCHFLAGS, searchFlags, 0);
-
-    LRESULT pos = send(SCI_SEARCHINTARGET, findTextUtf8.length(), reinterpret_cast<sptr_t>(findTextUtf8.c_str()));
-
-    SearchResult result;
-    result.pos = pos;
-
-    if (pos >= 0) {
-        // If a match is found, set additional result data
-        result.length = send(SCI_GETTARGETEND, 0, 0) - pos;
+#pragma endregion
 
-        // Consider the worst case for UTF-8, where one character could be up to 4 bytes.
-        char buffer[MAX_TEXT_LENGTH * 4 + 1] = { 0 };  // Assuming UTF-8 encoding in Scintilla
-        Sci_TextRangeFull tr;
-        tr.chrg.cpMin = static_cast<int>(result.pos);
-        tr.chrg.cpMax = static_cast<int>(result.pos + result.length);
 
-        if (tr.chrg.cpMax - tr.chrg.cpMin > sizeof(buffer) - 1) {
-            // Safety check to avoid overflow.
-            tr.chrg.cpMax = tr.chrg.cpMin + sizeof(buffer) - 1;
-        }
+#pragma region Mark
 
-        tr.lpstrText = buffer;
-        send(SCI_GETTEXTRANGEFULL, 0, reinterpret_cast<LPARAM>(&tr));
+void MultiReplace::handleMarkMatchesButton() {
+    beginEngineOperation();
+    beginOperationProfile("Mark Matches");
 
-        result.foundText = std::string(buffer);        
+    int totalMatchCount = 0;
+    bool useListEnabled = (IsDlgButtonChecked(_hSelf, IDC_USE_LIST_CHECKBOX) == BST_CHECKED);
+    engine.markedStringsCount = 0;
 
-        // If selectMatch is true, highlight the found text
-        if (selectMatch) {
-            displayResultCentered(result.pos, result.pos + result.length, true);
+    if (useListEnabled) {
+        if (replaceListData.empty()) {
+            showStatusMessage(getLangStr(L"status_add_values_or_mark_directly"), RGB(255, 0, 0));
+            return;
         }
-    }
-
-    return result;
-}
 
-SearchResult MultiReplace::performSearchForward(const std::string& findTextUtf8, int searchFlags, bool selectMatch, LRESULT start)
-{
-    SearchResult result;
-    SelectionRange targetRange;
-
-    // Check if IDC_SELECTION_RADIO is enabled and selectMatch is false
-    if (!selectMatch && IsDlgButtonChecked(_hSelf, IDC_SELECTION_RADIO) == BST_CHECKED) {
-        LRESULT selectionCount = ::SendMessage(_hScintilla, SCI_GETSELECTIONS, 0, 0);
-        std::vector<SelectionRange> selections(selectionCount);
-
-        for (int i = 0; i < selectionCount; i++) {
-            selections[i].start = ::SendMessage(_hScintilla, SCI_GETSELECTIONNSTART, i, 0);
-            selections[i].end = ::SendMessage(_hScintilla, SCI_GETSELECTIONNEND, i, 0);
-        }
-
-        // Sort selections based on their start position
-        std::sort(selections.begin(), selections.end(), [](const SelectionRange& a, const SelectionRange& b) {
-            return a.start < b.start;
-            });
-
-        // Perform search within each selection
-        for (const auto& selection : selections) {
-            if (start >= selection.start && start < selection.end) {
-                // If the start position is within the current selection
-                targetRange = { start, selection.end };
-                result = performSingleSearch(findTextUtf8, searchFlags, selectMatch, targetRange);
-            }
-            else if (start < selection.start) {
-                // If the start position is lower than the current selection
-                targetRange = selection;
-                result = performSingleSearch(findTextUtf8, searchFlags, selectMatch, targetRange);
-            }
-
-            // Check if a match was found
-            if (result.pos >= 0) {
-                return result;
+        std::vector<RuleSearch> searches(replaceListData.size());
+        for (size_t i = 0; i < replaceListData.size(); ++i) {
+            if (replaceListData[i].isEnabled) {
+                searches[i].findTextUtf8 = convertAndExtend(replaceListData[i].findText, replaceListData[i].extended);
+                searches[i].searchFlags = searchFlagsOf(replaceListData[i].wholeWord, replaceListData[i].matchCase, replaceListData[i].regex, replaceListData[i].fuzzyEdits);
             }
         }
-    }
-    // Check if IDC_COLUMN_MODE_RADIO is enabled, selectMatch is false, and column delimiter data is set
-    else if (IsDlgButtonChecked(_hSelf, IDC_COLUMN_MODE_RADIO) == BST_CHECKED && columnDelimiterData.isValid()) {
-
-        // Identify Column to Start
-        ColumnInfo columnInfo = getColumnInfo(start);
-        LRESULT totalLines = columnInfo.totalLines;
-        LRESULT startLine = columnInfo.startLine;
-        SIZE_T startColumnIndex = columnInfo.startColumnIndex;
-
-        // Iterate over each line
-        for (LRESULT line = startLine; line < totalLines; ++line) {
-            if (line < static_cast<LRESULT>(lineDelimiterPositions.size())) {
-                const auto& linePositions = lineDelimiterPositions[line].positions;
-                SIZE_T totalColumns = linePositions.size() + 1;
-
-                // Handle search for specific columns from columnDelimiterData
-                for (SIZE_T column = startColumnIndex; column <= totalColumns; ++column) {
-
-                    LRESULT startColumn = 0;
-                    LRESULT endColumn = 0;
-
-                    // Set start and end positions based on column index
-                    if (column == 1) {
-                        startColumn = lineDelimiterPositions[line].startPosition;
-                    }
-                    else {
-                        startColumn = linePositions[column - 2].position + columnDelimiterData.delimiterLength;
-                    }
-
-                    if (column == linePositions.size() + 1) {
-                        endColumn = lineDelimiterPositions[line].endPosition;
-                    }
-                    else {
-                        endColumn = linePositions[column - 1].position;
-                    }
-
-                    // Check if the current column is included in the specified columns
-                    if (columnDelimiterData.columns.find(static_cast<int>(column)) == columnDelimiterData.columns.end()) {
-                        // If it's not included, skip this iteration
-                        continue;
-                    }
+        engine.scanRegexRules(searches);
 
-                    // If start position is within the column range, adjust startColumn
-                    if (start >= startColumn && start <= endColumn) {
-                        startColumn = start;
-                    }
-
-                    // Perform search within the column range
-                    if (start <= startColumn) {
-                        targetRange = { startColumn, endColumn };
-                        result = performSingleSearch(findTextUtf8, searchFlags, selectMatch, targetRange);
+        for (size_t i = 0; i < replaceListData.size(); ++i) {
+            if (replaceListData[i].isEnabled) {
+                int matchCount = engine.markString(searches[i].findTextUtf8, searches[i].searchFlags);
+                totalMatchCount += matchCount;
 
-                        // Check if a match was found
-                        if (result.pos >= 0) {
-                            return result;
-                        }
-                    }
+                if (matchCount > 0) {
+                    updateCountColumns(i, matchCount);
                 }
-                // Reset startColumnIndex for the next lines
-                startColumnIndex = 1;
             }
         }
     }
     else {
-        // If neither IDC_SELECTION_RADIO nor IDC_COLUMN_MODE_RADIO, perform search within the whole document
-        targetRange.start = start;
-        targetRange.end = send(SCI_GETLENGTH, 0, 0);
-        result = performSingleSearch(findTextUtf8, searchFlags, selectMatch, targetRange);
-    }
-
-    return result;
-}
-
-SearchResult MultiReplace::performSearchBackward(const std::string& findTextUtf8, int searchFlags, LRESULT start)
-{
-    SearchResult result;
-    SelectionRange targetRange;
-
-    // Check if IDC_COLUMN_MODE_RADIO is enabled, and column delimiter data is set
-    if (IsDlgButtonChecked(_hSelf, IDC_COLUMN_MODE_RADIO) == BST_CHECKED && columnDelimiterData.isValid()) {
-
-        // Identify Column to Start
-        ColumnInfo columnInfo = getColumnInfo(start);
-        LRESULT startLine = columnInfo.startLine;
-        SIZE_T startColumnIndex = columnInfo.startColumnIndex;
-
-        // Iterate over each line in reverse
-        for (LRESULT line = startLine; line >= 0; --line) {
-            if (line < static_cast<LRESULT>(lineDelimiterPositions.size())) {
-                const auto& linePositions = lineDelimiterPositions[line].positions;
-                SIZE_T totalColumns = linePositions.size() + 1;
-
-                // Handle search for specific columns from columnDelimiterData
-                for (SIZE_T column = (line == startLine ? startColumnIndex : totalColumns); column >= 1; --column) {
-
-                    // Set start and end positions based on column index
-                    LRESULT startColumn = 0;
-                    LRESULT endColumn = 0;
-
-                    if (column == 1) {
-                        startColumn = lineDelimiterPositions[line].startPosition;
-                    }
-                    else {
-                        startColumn = linePositions[column - 2].position + columnDelimiterData.delimiterLength;
-                    }
-
-                    if (column == linePositions.size() + 1) {
-                        endColumn = lineDelimiterPositions[line].endPosition;
-                    }
-                    else {
-                        endColumn = linePositions[column - 1].position;
-                    }
-
-                    // Check if the current column is included in the specified columns
-                    if (columnDelimiterData.columns.find(static_cast<int>(column)) == columnDelimiterData.columns.end()) {
-                        // If it's not included, skip this iteration
-                        continue;
-                    }
-
-                    // Perform search within the column range
-                    if (start >= startColumn && start <= endColumn) {
-                        endColumn = start;
-                    }
+        std::wstring findText = getTextFromDialogItem(_hSelf, IDC_FIND_EDIT);
+        bool wholeWord = (IsDlgButtonChecked(_hSelf, IDC_WHOLE_WORD_CHECKBOX) == BST_CHECKED);
+        bool matchCase = (IsDlgButtonChecked(_hSelf, IDC_MATCH_CASE_CHECKBOX) == BST_CHECKED);
+        bool regex = (IsDlgButtonChecked(_hSelf, IDC_REGEX_RADIO) == BST_CHECKED);
+        bool extended = (IsDlgButtonChecked(_hSelf, IDC_EXTENDED_RADIO) == BST_CHECKED);
 
-                    // Perform search within the column range
-                    if (start >= endColumn) {
-                        targetRange = { endColumn, startColumn };
-                        result = performSingleSearch(findTextUtf8, searchFlags, true, targetRange);
+        int fuzzyEdits = getFuzzyEditsFromDialog();
+        if (!checkFuzzyFindText(findText, fuzzyEdits)) {
+            return;
+        }
 
-                        // Check if a match was found
-                        if (result.pos >= 0) {
-                            return result;
-                        }
-                    }
+        std::string findTextUtf8 = convertAndExtend(findText, extended);
+        int searchFlags = searchFlagsOf(wholeWord, matchCase, regex, fuzzyEdits);
+        totalMatchCount = engine.markString(findTextUtf8, searchFlags);
 
-                }
-            }
-        }
-    }
-    else {
-        // Setting up the range to search backward from 'start' to the beginning
-        SelectionRange searchRange;
-        searchRange.start = start;
-        searchRange.end = 0;
-        result = performSingleSearch(findTextUtf8, searchFlags, true, searchRange);
+        addStringToComboBoxHistory(GetDlgItem(_hSelf, IDC_FIND_EDIT), findText);
     }
-
-    return result;
+    showStatusMessage(appendOperationStatus(getLangStr(L"status_occurrences_marked", { std::to_wstring(totalMatchCount) })), RGB(0, 0, 128));
 }
 
-SearchResult MultiReplace::performListSearchBackward(const std::vector<ReplaceItemData>& list, LRESULT cursorPos, size_t& closestMatchIndex) {
-    SearchResult closestMatch;
-    closestMatch.pos = -1;
-    closestMatch.length = 0;
-    closestMatch.foundText = "";
-
-    closestMatchIndex = std::numeric_limits<size_t>::max(); // Initialize with a value that represents "no index".
-
-    for (size_t i = 0; i < list.size(); ++i) {
-        if (list[i].isEnabled) {
-            int searchFlags = (list[i].wholeWord * SCFIND_WHOLEWORD) |
-                (list[i].matchCase * SCFIND_MATCHCASE) |
-                (list[i].regex * SCFIND_REGEXP);
-            std::string findTextUtf8 = convertAndExtend(list[i].findText, list[i].extended);
-            SearchResult result = performSearchBackward(findTextUtf8, searchFlags, cursorPos);
-
-            // If a match was found and it's closer to the cursor than the current closest match, update the closest match
-            if (result.pos >= 0 && (closestMatch.pos < 0 || (result.pos + result.length) >(closestMatch.pos + closestMatch.length))) {
-                closestMatch = result;
-                closestMatchIndex = i; // Update the index of the closest match
-            }
-        }
+void MultiReplace::handleCountMatches() {
+    // A second click on the menu entry cancels
+    if (isCounting()) {
+        cancelCount();
+        showStatusMessage(getLangStr(L"status_count_cancelled"), RGB(255, 0, 0));
+        return;
     }
 
-    if (closestMatch.pos >= 0) { // Check if a match was found
-        displayResultCentered(closestMatch.pos, closestMatch.pos + closestMatch.length, false);
-    }
+    beginEngineOperation();
+    handleDelimiterPositions(DelimiterOperation::LoadAll);
+    resetCountColumns();
 
-    return closestMatch;
+    countRules.clear();
+    deferredCountRules.clear();
+    for (size_t i = 0; i < replaceListData.size(); ++i) {
+        if (replaceListData[i].isEnabled) {
+            countRules.push_back(makeCountRule(i));
+        }
+    }
+    countedRules = 0;
+    countedMatches = 0;
+    countDocumentVersion = engine.getDocumentVersion();
+    countOptions = engine.options;
+
+    // Counting happens on a copy, the document and its marks stay untouched
+    backgroundCounter.start(CountSnapshot::capture(sciBackend, engine), countRules,
+        [this](uint64_t job, const CountResult& result) {
+            queueCountProgress({ job, result.index, result.count, false, false });
+        },
+        [this](uint64_t job, bool cancelled) {
+            queueCountProgress({ job, 0, 0, true, cancelled });
+        });
+    showStatusMessage(getLangStr(L"status_counting", { L"0", std::to_wstring(countRules.size()) }), RGB(0, 128, 0));
 }
 
-SearchResult MultiReplace::performListSearchForward(const std::vector<ReplaceItemData>& list, LRESULT cursorPos, size_t& closestMatchIndex) {
-    SearchResult closestMatch;
-    closestMatch.pos = -1;
-    closestMatch.length = 0;
-    closestMatch.foundText = "";
+CountRule MultiReplace::makeCountRule(size_t index) {
+    const ReplaceItemData& item = replaceListData[index];
+    CountRule rule;
+    rule.index = index;
+    rule.findTextUtf8 = convertAndExtend(item.findText, item.extended);
+    rule.searchFlags = searchFlagsOf(item.wholeWord, item.matchCase, item.regex, item.fuzzyEdits);
+    return rule;
+}
 
-    closestMatchIndex = std::numeric_limits<size_t>::max(); // Initialisiert mit einem Wert, der "keinen Index" darstellt.
+void MultiReplace::queueCountProgress(const CountProgress& progress) {
+    // Runs on the worker thread
+    std::lock_guard<std::mutex> lock(countProgressMutex);
+    countProgressQueue.push_back(progress);
+    PostMessage(_hSelf, WM_COUNT_PROGRESS, 0, 0);
+}
 
-    for (size_t i = 0; i < list.size(); i++) {
-        if (list[i].isEnabled) {
-            int searchFlags = (list[i].wholeWord * SCFIND_WHOLEWORD) | (list[i].matchCase * SCFIND_MATCHCASE) | (list[i].regex * SCFIND_REGEXP);
-            std::string findTextUtf8 = convertAndExtend(list[i].findText, list[i].extended);
-            SearchResult result = performSearchForward(findTextUtf8, searchFlags, false, cursorPos);
+void MultiReplace::processCountProgress() {
+    std::vector<CountProgress> progressList;
+    {
+        std::lock_guard<std::mutex> lock(countProgressMutex);
+        progressList.swap(countProgressQueue);
+    }
 
-            // Wenn ein Treffer gefunden wurde, der näher am Cursor liegt als der aktuelle nächste Treffer, aktualisiere den nächstgelegenen Treffer
-            if (result.pos >= 0 && (closestMatch.pos < 0 || result.pos < closestMatch.pos)) {
-                closestMatch = result;
-                closestMatchIndex = i; // Aktualisiere den Index des nächstgelegenen Treffers
+    for (const CountProgress& progress : progressList) {
+        // Leftovers of a cancelled job
+        if (progress.job != backgroundCounter.currentJob()) {
+            continue;
+        }
+        if (progress.finished) {
+            if (!progress.cancelled) {
+                finishCount();
             }
+            continue;
+        }
+        if (countedRules >= countRules.size()) {
+            continue;
         }
-    }
 
-    if (closestMatch.pos >= 0) { // Überprüfe, ob ein Treffer gefunden wurde
-        displayResultCentered(closestMatch.pos, closestMatch.pos + closestMatch.length, true);
+        // Results arrive in rule order. Rows edited in the meantime are left empty.
+        const CountRule& rule = countRules[countedRules++];
+        if (rule.index >= replaceListData.size()) {
+            continue;
+        }
+        const CountRule current = makeCountRule(rule.index);
+        if (current.findTextUtf8 != rule.findTextUtf8 || current.searchFlags != rule.searchFlags) {
+            continue;
+        }
+        if (progress.count == BackgroundCounter::DEFERRED) {
+            deferredCountRules.push_back(rule);
+            continue;
+        }
+        countedMatches += progress.count;
+        updateCountColumns(rule.index, progress.count);
     }
 
-    return closestMatch;
+    if (backgroundCounter.isRunning()) {
+        showStatusMessage(getLangStr(L"status_counting", { std::to_wstring(countedRules), std::to_wstring(countRules.size()) }), RGB(0, 128, 0));
+    }
 }
 
-void MultiReplace::displayResultCentered(size_t posStart, size_t posEnd, bool isDownwards)
-{
-    // Make sure target lines are unfolded
-    ::SendMessage(_hScintilla, SCI_ENSUREVISIBLE, ::SendMessage(_hScintilla, SCI_LINEFROMPOSITION, posStart, 0), 0);
-    ::SendMessage(_hScintilla, SCI_ENSUREVISIBLE, ::SendMessage(_hScintilla, SCI_LINEFROMPOSITION, posEnd, 0), 0);
-
-    // Jump-scroll to center, if current position is out of view
-    ::SendMessage(_hScintilla, SCI_SETVISIBLEPOLICY, CARET_JUMPS | CARET_EVEN, 0);
-    ::SendMessage(_hScintilla, SCI_ENSUREVISIBLEENFORCEPOLICY, ::SendMessage(_hScintilla, SCI_LINEFROMPOSITION, isDownwards ? posEnd : posStart, 0), 0);
-
-    // When searching up, the beginning of the (possible multiline) result is important, when scrolling down the end
-    ::SendMessage(_hScintilla, SCI_GOTOPOS, isDownwards ? posEnd : posStart, 0);
-    ::SendMessage(_hScintilla, SCI_SETVISIBLEPOLICY, CARET_EVEN, 0);
-    ::SendMessage(_hScintilla, SCI_ENSUREVISIBLEENFORCEPOLICY, ::SendMessage(_hScintilla, SCI_LINEFROMPOSITION, isDownwards ? posEnd : posStart, 0), 0);
-
-    // Adjust so that we see the entire match; primarily horizontally
-    ::SendMessage(_hScintilla, SCI_SCROLLRANGE, posStart, posEnd);
-
-    // Move cursor to end of result and select result
-    ::SendMessage(_hScintilla, SCI_GOTOPOS, posEnd, 0);
-    ::SendMessage(_hScintilla, SCI_SETANCHOR, posStart, 0);
-
-    // Update Scintilla's knowledge about what column the caret is in, so that if user
-    // does up/down arrow as first navigation after the search result is selected,
-    // the caret doesn't jump to an unexpected column
-    ::SendMessage(_hScintilla, SCI_CHOOSECARETX, 0, 0);
+void MultiReplace::finishCount() {
+    // Rules the copy cannot search like Scintilla are counted in the editor, as long as
+    // the document still matches the copy. Timer steps keep the editor responsive.
+    if (!deferredCountRules.empty() && engine.getDocumentVersion() == countDocumentVersion) {
+        deferredCountActive = true;
+        deferredCountedRules = 0;
+        deferredCountFrom = 0;
+        deferredCount = 0;
+        deferredStoppedRules.clear();
+        SetTimer(_hSelf, DEFERRED_COUNT_TIMER_ID, USER_TIMER_MINIMUM, NULL);
+        return;
+    }
+    deferredCountRules.clear();
 
+    showStatusMessage(getLangStr(L"status_occurrences_counted", { std::to_wstring(countedMatches) }), RGB(0, 128, 0));
 }
 
-#pragma endregion
-
-
-#pragma region Mark
-
-void MultiReplace::handleMarkMatchesButton() {
-    int totalMatchCount = 0;
-    bool useListEnabled = (IsDlgButtonChecked(_hSelf, IDC_USE_LIST_CHECKBOX) == BST_CHECKED);
-    markedStringsCount = 0;
+void MultiReplace::continueDeferredCount() {
+    // The counts so far belong to the text the count started with
+    if (engine.getDocumentVersion() != countDocumentVersion) {
+        cancelCount();
+        showStatusMessage(getLangStr(L"status_count_cancelled"), RGB(255, 0, 0));
+        return;
+    }
 
-    if (useListEnabled) {
-        if (replaceListData.empty()) {
-            showStatusMessage(getLangStr(L"status_add_values_or_mark_directly"), RGB(255, 0, 0));
-            return;
+    // Other operations in between may have set other options and begun watchdog operations
+    // of their own, each step begins its own one
+    const EngineOptions options = engine.options;
+    engine.options = countOptions;
+    engine.regexWatchdog.beginOperation(regexBudgetMs);
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(DEFERRED_COUNT_STEP_MS);
+    while (deferredCountedRules < deferredCountRules.size() && std::chrono::steady_clock::now() < deadline) {
+        const CountRule& rule = deferredCountRules[deferredCountedRules];
+        deferredCount += engine.countStringSlice(rule.findTextUtf8, rule.searchFlags, deferredCountFrom, DEFERRED_COUNT_SLICE_BYTES);
+        const bool stopped = engine.regexWatchdog.isStopped(rule.findTextUtf8, rule.searchFlags);
+        if (deferredCountFrom >= 0 && !stopped) {
+            continue;
         }
 
-        for (size_t i = 0; i < replaceListData.size(); ++i) {
-            if (replaceListData[i].isEnabled) {
-                std::string findTextUtf8 = convertAndExtend(replaceListData[i].findText, replaceListData[i].extended);
-                int searchFlags = (replaceListData[i].wholeWord * SCFIND_WHOLEWORD)
-                    | (replaceListData[i].matchCase * SCFIND_MATCHCASE)
-                    | (replaceListData[i].regex * SCFIND_REGEXP);
-                int matchCount = markString(findTextUtf8, searchFlags);
-                totalMatchCount += matchCount;
-
-                if (matchCount > 0) {
-                    updateCountColumns(i, matchCount);
-                }
+        // The count of a stopped rule is short, its row is left empty and the status names
+        // it. Rows edited in the meantime are left empty too.
+        if (stopped) {
+            deferredStoppedRules.push_back(rule.index);
+        }
+        else if (rule.index < replaceListData.size()) {
+            const CountRule current = makeCountRule(rule.index);
+            if (current.findTextUtf8 == rule.findTextUtf8 && current.searchFlags == rule.searchFlags) {
+                countedMatches += deferredCount;
+                updateCountColumns(rule.index, deferredCount);
             }
         }
+        ++deferredCountedRules;
+        deferredCountFrom = 0;
+        deferredCount = 0;
     }
-    else {
-        std::wstring findText = getTextFromDialogItem(_hSelf, IDC_FIND_EDIT);
-        bool wholeWord = (IsDlgButtonChecked(_hSelf, IDC_WHOLE_WORD_CHECKBOX) == BST_CHECKED);
-        bool matchCase = (IsDlgButtonChecked(_hSelf, IDC_MATCH_CASE_CHECKBOX) == BST_CHECKED);
-        bool regex = (IsDlgButtonChecked(_hSelf, IDC_REGEX_RADIO) == BST_CHECKED);
-        bool extended = (IsDlgButtonChecked(_hSelf, IDC_EXTENDED_RADIO) == BST_CHECKED);
-
-        std::string findTextUtf8 = convertAndExtend(findText, extended);
-        int searchFlags = (wholeWord * SCFIND_WHOLEWORD)
-            | (matchCase * SCFIND_MATCHCASE)
-            | (regex * SCFIND_REGEXP);
-        totalMatchCount = markString(findTextUtf8, searchFlags);
+    engine.options = options;
 
-        addStringToComboBoxHistory(GetDlgItem(_hSelf, IDC_FIND_EDIT), findText);
+    if (deferredCountedRules < deferredCountRules.size()) {
+        const size_t done = countRules.size() - (deferredCountRules.size() - deferredCountedRules);
+        showStatusMessage(getLangStr(L"status_counting", { std::to_wstring(done), std::to_wstring(countRules.size()) }), RGB(0, 128, 0));
+        return;
     }
-    showStatusMessage(getLangStr(L"status_occurrences_marked", { std::to_wstring(totalMatchCount) }), RGB(0, 0, 128));
-}
 
-int MultiReplace::markString(const std::string& findTextUtf8, int searchFlags) {
-    if (findTextUtf8.empty()) {
-        return 0;
-    }
+    KillTimer(_hSelf, DEFERRED_COUNT_TIMER_ID);
+    deferredCountActive = false;
+    deferredCountRules.clear();
 
-    int markCount = 0;  // Counter for marked matches
-    SearchResult searchResult = performSearchForward(findTextUtf8, searchFlags, false, 0);
-    while (searchResult.pos >= 0) {
-        highlightTextRange(searchResult.pos, searchResult.length, findTextUtf8);
-        markCount++;
-        searchResult = performSearchForward(findTextUtf8, searchFlags, false, searchResult.pos + searchResult.length);
+    std::wstring message = getLangStr(L"status_occurrences_counted", { std::to_wstring(countedMatches) });
+    if (!deferredStoppedRules.empty()) {
+        std::wstring entries;
+        for (size_t index : deferredStoppedRules) {
+            entries += (entries.empty() ? L"" : L", ") + std::to_wstring(index + 1);
+        }
+        message += L" | " + getLangStr(L"status_regex_stopped_entries", { std::to_wstring(regexBudgetMs), entries });
     }
+    showStatusMessage(message, RGB(0, 128, 0));
+}
 
-    if (IsDlgButtonChecked(_hSelf, IDC_USE_LIST_CHECKBOX) == BST_CHECKED && markCount > 0) {
-        markedStringsCount++;
+void MultiReplace::cancelCount() {
+    backgroundCounter.cancel();
+    KillTimer(_hSelf, DEFERRED_COUNT_TIMER_ID);
+    deferredCountActive = false;
+    deferredCountRules.clear();
+}
+
+void MultiReplace::scheduleLiveCount() {
+    if (!liveCountEnabled) {
+        return;
     }
 
-    return markCount;
+    // Every change restarts the pause, a count still running for the old text is dropped
+    liveCountJob = 0;
+    liveCounter.requestCancel();
+    SetTimer(_hSelf, LIVE_COUNT_TIMER_ID, liveCountDelayMs, NULL);
 }
 
-void MultiReplace::highlightTextRange(LRESULT pos, LRESULT len, const std::string& findTextUtf8)
-{
-    bool useListEnabled = (IsDlgButtonChecked(_hSelf, IDC_USE_LIST_CHECKBOX) == BST_CHECKED);
-    long color = useListEnabled ? generateColorValue(findTextUtf8) : MARKER_COLOR;
+void MultiReplace::startLiveCount() {
+    KillTimer(_hSelf, LIVE_COUNT_TIMER_ID);
+    updateEngineOptions();
 
-    // Check if the color already has an associated style
-    int indicatorStyle;
-    if (colorToStyleMap.find(color) == colorToStyleMap.end()) {
-        // If not, assign a new style and store it in the map
-        indicatorStyle = useListEnabled ? textStyles[(colorToStyleMap.size() % (textStyles.size() - 1)) + 1] : textStyles[0];
-        colorToStyleMap[color] = indicatorStyle;
-    }
-    else {
-        // If yes, use the existing style
-        indicatorStyle = colorToStyleMap[color];
+    std::wstring findText = getTextFromDialogItem(_hSelf, IDC_FIND_EDIT);
+    bool wholeWord = (IsDlgButtonChecked(_hSelf, IDC_WHOLE_WORD_CHECKBOX) == BST_CHECKED);
+    bool matchCase = (IsDlgButtonChecked(_hSelf, IDC_MATCH_CASE_CHECKBOX) == BST_CHECKED);
+    bool regex = (IsDlgButtonChecked(_hSelf, IDC_REGEX_RADIO) == BST_CHECKED);
+    bool extended = (IsDlgButtonChecked(_hSelf, IDC_EXTENDED_RADIO) == BST_CHECKED);
+    int fuzzyEdits = getFuzzyEditsFromDialog();
+    int searchFlags = searchFlagsOf(wholeWord, matchCase, regex, fuzzyEdits);
+
+    // Regex counts differ on the copy and can take long in Scintilla. Column scope needs the
+    // delimiter scan and larger documents a full copy for their selections, both would block.
+    LRESULT documentLength = ::SendMessage(_hScintilla, SCI_GETLENGTH, 0, 0);
+    bool sampled = static_cast<size_t>(documentLength) > LIVE_COUNT_SAMPLE_BYTES;
+    if (findText.empty() || (searchFlags & SCFIND_REGEXP) || engine.options.scope == SearchScope::Column ||
+        (sampled && engine.options.scope != SearchScope::AllText)) {
+        clearLiveCount();
+        return;
     }
 
-    // Set and apply highlighting style
-    ::SendMessage(_hScintilla, SCI_SETINDICATORCURRENT, indicatorStyle, 0);
-    ::SendMessage(_hScintilla, SCI_INDICSETSTYLE, indicatorStyle, INDIC_STRAIGHTBOX);
+    CountRule rule;
+    rule.findTextUtf8 = convertAndExtend(findText, extended);
+    rule.searchFlags = searchFlags;
+    rule.maxCount = LIVE_COUNT_MAX_MATCHES;
+    rule.allowApproximate = true;
 
-    if (colorToStyleMap.size() < textStyles.size()) {
-        ::SendMessage(_hScintilla, SCI_INDICSETFORE, indicatorStyle, color);
+    // Keystrokes only change the search, the copy of an unchanged document is shared
+    if (!liveCountText || liveCountTextVersion != engine.getDocumentVersion()) {
+        liveCountText.reset();
+        liveCountText = CountSnapshot::captureText(sciBackend, LIVE_COUNT_SAMPLE_BYTES);
+        liveCountTextVersion = engine.getDocumentVersion();
     }
 
-    ::SendMessage(_hScintilla, SCI_INDICSETALPHA, indicatorStyle, 100);
-    ::SendMessage(_hScintilla, SCI_INDICATORFILLRANGE, pos, len);
+    liveCountJob = liveCounter.start(CountSnapshot::capture(sciBackend, engine, liveCountText), { rule },
+        [this](uint64_t job, const CountResult& result) {
+            // Runs on the worker thread
+            std::lock_guard<std::mutex> lock(liveCountMutex);
+            liveCountResultJob = job;
+            liveCountResult = result;
+            PostMessage(_hSelf, WM_LIVE_COUNT, 0, 0);
+        },
+        [](uint64_t, bool) {});
 }
 
-long MultiReplace::generateColorValue(const std::string& str) {
-    // DJB2 hash
-    unsigned long hash = 5381;
-    for (char c : str) {
-        hash = ((hash << 5) + hash) + c;  // hash * 33 + c
+void MultiReplace::showLiveCount() {
+    CountResult result;
+    {
+        std::lock_guard<std::mutex> lock(liveCountMutex);
+        if (liveCountResultJob != liveCountJob || liveCountJob == 0) {
+            return;
+        }
+        result = liveCountResult;
+    }
+
+    std::wstring countText = std::to_wstring(result.count);
+    if (result.count >= LIVE_COUNT_MAX_MATCHES) {
+        countText = std::to_wstring(LIVE_COUNT_MAX_MATCHES) + L"+";
+    }
+    else if (!result.exact) {
+        countText = L"\u2248" + countText;
     }
 
-    // Create an RGB color using the hash
-    int r = (hash >> 16) & 0xFF;
-    int g = (hash >> 8) & 0xFF;
-    int b = hash & 0xFF;
+    liveCountStatus = getLangStr(L"status_live_count", { countText });
+    showStatusMessage(liveCountStatus, result.count > 0 ? RGB(0, 128, 0) : RGB(255, 0, 0));
+}
 
-    // Convert RGB to long
-    long color = (r << 16) | (g << 8) | b;
+void MultiReplace::clearLiveCount() {
+    liveCountJob = 0;
+    liveCounter.requestCancel();
+    if (liveCountStatus.empty()) {
+        return;
+    }
 
-    return color;
+    // Messages of other operations stay
+    if (getTextFromDialogItem(_hSelf, IDC_STATUS_MESSAGE) == liveCountStatus) {
+        showStatusMessage(L"", RGB(0, 128, 0));
+    }
+    liveCountStatus.clear();
 }
 
 void MultiReplace::handleClearTextMarksButton()
 {
-    for (int style : textStyles)
+    for (int style : engine.textStyles)
     {
         ::SendMessage(_hScintilla, SCI_SETINDICATORCURRENT, style, 0);
         ::SendMessage(_hScintilla, SCI_INDICATORCLEARRANGE, 0, ::SendMessage(_hScintilla, SCI_GETLENGTH, 0, 0));
     }
 
-    markedStringsCount = 0;
-    colorToStyleMap.clear();    
+    engine.markedStringsCount = 0;
+    engine.colorToStyleMap.clear();    
 }
 
 void MultiReplace::handleCopyMarkedTextToClipboardButton()
@@ -3732,9 +3530,9 @@ void MultiReplace::handleCopyMarkedTextToClipboardButton()
 
     std::string markedText;
     std::string styleText;
-    std::string eol = getEOLStyle();
+    std::string eol = engine.getEOLStyle();
 
-    for (int style : textStyles)
+    for (int style : engine.textStyles)
     {
         ::SendMessage(_hScintilla, SCI_SETINDICATORCURRENT, style, 0);
         LRESULT pos = 0;
@@ -3831,8 +3629,8 @@ bool MultiReplace::confirmColumnDeletion() {
         return false;  // Parsing failed, exit with false indicating no confirmation
     }
 
-    // Now columnDelimiterData should be populated with the parsed column data
-    size_t columnCount = columnDelimiterData.columns.size();
+    // Now engine.columnDelimiterData should be populated with the parsed column data
+    size_t columnCount = engine.columnDelimiterData.columns.size();
     std::wstring confirmMessage = getLangStr(L"msgbox_confirm_delete_columns", { std::to_wstring(columnCount) });
     int msgboxID = MessageBox(NULL, confirmMessage.c_str(), getLangStr(L"msgbox_title_confirm").c_str(), MB_ICONQUESTION | MB_YESNO);
 
@@ -3841,136 +3639,29 @@ bool MultiReplace::confirmColumnDeletion() {
 
 void MultiReplace::handleDeleteColumns()
 {
-    if (!columnDelimiterData.isValid()) {
+    if (!engine.columnDelimiterData.isValid()) {
         showStatusMessage(getLangStr(L"status_invalid_column_or_delimiter"), RGB(255, 0, 0));
         return;
     }
 
-    ::SendMessage(_hScintilla, SCI_BEGINUNDOACTION, 0, 0);
-
-    int deletedFieldsCount = 0;
-    SIZE_T lineCount = lineDelimiterPositions.size();
-
-    // Loop from the last element down to the first
-    for (SIZE_T i = lineCount; i-- > 0; ) {
-        const auto& lineInfo = lineDelimiterPositions[i];
-
-        // Process each column in reverse
-        for (auto it = columnDelimiterData.columns.rbegin(); it != columnDelimiterData.columns.rend(); ++it) {
-            SIZE_T column = *it;
-
-            // Only process columns within the valid range
-            if (column <= lineInfo.positions.size() + 1) {
-
-                LRESULT startPos, endPos;
-
-                if (column == 1) {
-                    startPos = lineInfo.startPosition;
-                }
-                else if (column - 2 < lineInfo.positions.size()) {
-                    startPos = lineInfo.positions[column - 2].position;
-                }
-                else {
-                    continue;
-                }
-
-                if (column - 1 < lineInfo.positions.size()) {
-                    // Delete leading Delimiter if first column will be droped
-                    if (column == 1) {
-                        endPos = lineInfo.positions[column - 1].position + columnDelimiterData.delimiterLength;
-                    }
-                    else {
-                        endPos = lineInfo.positions[column - 1].position;
-                    }
-                }
-                else {
-                    endPos = lineInfo.endPosition;
-                }
-
-                send(SCI_DELETERANGE, startPos, endPos - startPos, false);
-
-                deletedFieldsCount++;
-            }
-        }
-
-    }
-    ::SendMessage(_hScintilla, SCI_ENDUNDOACTION, 0, 0);
+    beginOperationProfile("Delete Columns");
+    int deletedFieldsCount = engine.deleteColumns();
 
     // Show status message
-    showStatusMessage(getLangStr(L"status_deleted_fields_count", { std::to_wstring(deletedFieldsCount) }), RGB(0, 255, 0));
+    showStatusMessage(appendOperationStatus(getLangStr(L"status_deleted_fields_count", { std::to_wstring(deletedFieldsCount) })), RGB(0, 255, 0));
 }
 
 void MultiReplace::handleCopyColumnsToClipboard()
 {
-    if (!columnDelimiterData.isValid()) {
+    if (!engine.columnDelimiterData.isValid()) {
         showStatusMessage(getLangStr(L"status_invalid_column_or_delimiter"), RGB(255, 0, 0));
         return;
     }
 
-    std::string combinedText;
     int copiedFieldsCount = 0;
-    size_t lineCount = lineDelimiterPositions.size();
-
-    // Iterate through each line
-    for (size_t i = 0; i < lineCount; ++i) {
-        const auto& lineInfo = lineDelimiterPositions[i];
-
-        bool isFirstCopiedColumn = true;
-        std::string lineText;
-
-        // Process each column
-        for (SIZE_T column : columnDelimiterData.columns) {
-            if (column <= lineInfo.positions.size() + 1) {
-                LRESULT startPos, endPos;
-
-                if (column == 1) {
-                    startPos = lineInfo.startPosition;
-                    isFirstCopiedColumn = false;
-                }
-                else if (column - 2 < lineInfo.positions.size()) {
-                    startPos = lineInfo.positions[column - 2].position;
-                    // Drop first Delimiter if copied as first column
-                    if (isFirstCopiedColumn) {
-                        startPos += columnDelimiterData.delimiterLength;
-                        isFirstCopiedColumn = false;
-                    }
-                }
-                else {
-                    break;
-                }
-
-                if (column - 1 < lineInfo.positions.size()) {
-                    endPos = lineInfo.positions[column - 1].position;
-                }
-                else {
-                    endPos = lineInfo.endPosition;
-                }
-
-                // Buffer to hold the text
-                std::vector<char> buffer(static_cast<size_t>(endPos - startPos) + 1);
-
-                // Prepare TextRange structure for Scintilla
-                Sci_TextRangeFull tr;
-                tr.chrg.cpMin = startPos;
-                tr.chrg.cpMax = endPos;
-                tr.lpstrText = buffer.data();
-
-                // Extract text for the column
-                SendMessage(_hScintilla, SCI_GETTEXTRANGEFULL, 0, reinterpret_cast<LPARAM>(&tr));
-                lineText += std::string(buffer.data());
-
-                copiedFieldsCount++;
-            }
-        }
+    std::string combinedText = engine.copyColumns(copiedFieldsCount);
 
-        combinedText += lineText;
-        // Add a newline except after the last line
-        if (i < lineCount - 1) {
-            combinedText += "\n";
-        }
-    }
-
-    // Convert to Wide String and Copy to Clipboard (Ensure this line only occurs once and wstr is not redefined)
+    // Convert to Wide String and Copy to Clipboard
     std::wstring wstr = stringToWString(combinedText);
     copyTextToClipboard(wstr, copiedFieldsCount);
 }
@@ -3980,182 +3671,22 @@ void MultiReplace::handleCopyColumnsToClipboard()
 
 #pragma region CSV Sort
 
-std::vector<CombinedColumns> MultiReplace::extractColumnData(SIZE_T startLine, SIZE_T lineCount) {
-    std::vector<CombinedColumns> combinedData;
-    for (SIZE_T i = startLine; i < lineCount; ++i) {
-        const auto& lineInfo = lineDelimiterPositions[i]; // Stelle sicher, dass lineDelimiterPositions definiert ist
-        CombinedColumns rowData;
-        rowData.columns.resize(columnDelimiterData.inputColumns.size()); // Stelle sicher, dass columnDelimiterData definiert ist
-
-        size_t columnIndex = 0;
-        for (SIZE_T columnNumber : columnDelimiterData.inputColumns) {
-            LRESULT startPos, endPos;
-
-            // Berechne Start- und Endpositionen für jede Spalte
-            if (columnNumber == 1) {
-                startPos = lineInfo.startPosition;
-            }
-            else if (columnNumber - 2 < lineInfo.positions.size()) {
-                startPos = lineInfo.positions[columnNumber - 2].position + columnDelimiterData.delimiterLength;
-            }
-            else {
-                continue;
-            }
-
-            if (columnNumber - 1 < lineInfo.positions.size()) {
-                endPos = lineInfo.positions[columnNumber - 1].position;
-            }
-            else {
-                endPos = lineInfo.endPosition;
-            }
-
-            // Puffer, um den Text zu halten
-            std::vector<char> buffer(static_cast<size_t>(endPos - startPos) + 1);
-            Sci_TextRangeFull tr;
-            tr.chrg.cpMin = startPos;
-            tr.chrg.cpMax = endPos;
-            tr.lpstrText = buffer.data();
-
-            // Extrahiere Text für die Spalte
-            SendMessage(_hScintilla, SCI_GETTEXTRANGEFULL, 0, reinterpret_cast<LPARAM>(&tr));
-            rowData.columns[columnIndex++] = std::string(buffer.data());
-        }
-
-        combinedData.push_back(rowData);
-    }
-
-    return combinedData;
-}
-
 void MultiReplace::sortRowsByColumn(SortDirection sortDirection) {
     // Validate column delimiter data
-    if (!columnDelimiterData.isValid()) {
+    if (!engine.columnDelimiterData.isValid()) {
         showStatusMessage(getLangStr(L"status_invalid_column_or_delimiter"), RGB(255, 0, 0));
         return;
     }
-    SendMessage(_hScintilla, SCI_BEGINUNDOACTION, 0, 0);
-
-    size_t lineCount = lineDelimiterPositions.size();
-
-    // Check if there's nothing to sort or if the document has fewer lines than header lines
-    if (lineCount <= CSVheaderLinesCount) {
-        // Either nothing to sort or document consists only of header lines
-        SendMessage(_hScintilla, SCI_ENDUNDOACTION, 0, 0);
-        return;
-    }
-
-    std::vector<CombinedColumns> combinedData;
-    combinedData.reserve(lineCount); // Reserve space for all lines, including headers
-
-    // Initialize tempOrder with indices for all lines, including header lines
-    std::vector<size_t> tempOrder(lineCount);
-    for (size_t i = 0; i < lineCount; ++i) {
-        tempOrder[i] = i; // Manually filling tempOrder with 0, 1, ..., lineCount-1
-    }
-
-    // Extract content of specified columns, starting after header lines
-    combinedData = extractColumnData(CSVheaderLinesCount, lineDelimiterPositions.size());
-
-    // Sort the tempOrder based on combinedData, excluding header lines during comparison
-    std::sort(tempOrder.begin() + CSVheaderLinesCount, tempOrder.end(), [&](const size_t a, const size_t b) {
-        size_t adjustedA = a - CSVheaderLinesCount;
-        size_t adjustedB = b - CSVheaderLinesCount;
-        // Implement the sorting logic here, only for lines beyond the header lines
-        return sortDirection == SortDirection::Ascending ? combinedData[adjustedA].columns[0] < combinedData[adjustedB].columns[0] : combinedData[adjustedA].columns[0] > combinedData[adjustedB].columns[0];
-        });
-
-    // Adjust originalLineOrder based on the opposite sorting results
-    if (!originalLineOrder.empty()) {
-        std::vector<size_t> newOrder(originalLineOrder.size());
-        for (size_t i = 0; i < tempOrder.size(); ++i) {
-            size_t positionInOriginal = tempOrder[i];
-            size_t valueForNewOrder = originalLineOrder[positionInOriginal];
-            newOrder[i] = valueForNewOrder;
-        }
-        originalLineOrder = std::move(newOrder);
-    }
-    else {
-        originalLineOrder = tempOrder;
-    }
-
-    // Use tempOrder to reorder lines in Scintilla, adjusting for header lines
-    reorderLinesInScintilla(tempOrder);
-
-    SendMessage(_hScintilla, SCI_ENDUNDOACTION, 0, 0);
-}
-
-void MultiReplace::reorderLinesInScintilla(const std::vector<size_t>& sortedIndex) {
-    std::string lineBreak = getEOLStyle();
 
+    beginOperationProfile(sortDirection == SortDirection::Ascending ? "Sort Ascending" : "Sort Descending");
+    bool wasSortedColumn = isSortedColumn;
     isSortedColumn = false; // Stop logging changes
-    // Extract the text of each line based on the sorted index and include a line break after each
-    std::string combinedLines;
-    for (size_t i = 0; i < sortedIndex.size(); ++i) {
-        size_t idx = sortedIndex[i];
-        LRESULT lineStart = SendMessage(_hScintilla, SCI_POSITIONFROMLINE, idx, 0);
-        LRESULT lineEnd = SendMessage(_hScintilla, SCI_GETLINEENDPOSITION, idx, 0);
-        std::vector<char> buffer(static_cast<size_t>(lineEnd - lineStart) + 1); // Buffer size includes space for null terminator
-        Sci_TextRangeFull tr;
-        tr.chrg.cpMin = lineStart;
-        tr.chrg.cpMax = lineEnd;
-        tr.lpstrText = buffer.data();
-        SendMessage(_hScintilla, SCI_GETTEXTRANGEFULL, 0, reinterpret_cast<LPARAM>(&tr));
-        combinedLines += std::string(buffer.data(), buffer.size() - 1); // Exclude null terminator from the string
-        if (i < sortedIndex.size() - 1) {
-            combinedLines += lineBreak; // Add line break after each line except the last
-        }
-    }
-
-    // Clear all content from Scintilla
-    SendMessage(_hScintilla, SCI_CLEARALL, 0, 0);
-
-    // Re-insert the combined lines
-    SendMessage(_hScintilla, SCI_APPENDTEXT, combinedLines.length(), reinterpret_cast<LPARAM>(combinedLines.c_str()));
-
-    isSortedColumn = true; // Ready for logging changes
-}
-
-void MultiReplace::restoreOriginalLineOrder(const std::vector<size_t>& originalOrder) {
-
-    // Determine the total number of lines in the document
-    size_t totalLineCount = SendMessage(_hScintilla, SCI_GETLINECOUNT, 0, 0);
-
-    // Ensure the size of the originalOrder vector matches the number of lines in the document
-    auto maxElementIt = std::max_element(originalOrder.begin(), originalOrder.end());
-    if (maxElementIt == originalOrder.end() || *maxElementIt != totalLineCount - 1) {
-        return;
-    }
-
-    // Create a vector for the new sorted content of the document
-    std::vector<std::string> sortedLines(totalLineCount);
-    std::string lineBreak = getEOLStyle();
-
-    // Iterate through each line in the document and fill sortedLines according to originalOrder
-    for (size_t i = 0; i < totalLineCount; ++i) {
-        size_t newPosition = originalOrder[i];
-        LRESULT lineStart = SendMessage(_hScintilla, SCI_POSITIONFROMLINE, i, 0);
-        LRESULT lineEnd = SendMessage(_hScintilla, SCI_GETLINEENDPOSITION, i, 0);
-        std::vector<char> buffer(static_cast<size_t>(lineEnd - lineStart) + 1);
-        Sci_TextRangeFull tr;
-        tr.chrg.cpMin = lineStart;
-        tr.chrg.cpMax = lineEnd;
-        tr.lpstrText = buffer.data();
-        SendMessage(_hScintilla, SCI_GETTEXTRANGEFULL, 0, reinterpret_cast<LPARAM>(&tr));
-        sortedLines[newPosition] = std::string(buffer.data(), buffer.size() - 1); // Exclude null terminator
-    }
+    bool sorted = engine.sortRowsByColumn(sortDirection, originalLineOrder);
+    isSortedColumn = sorted || wasSortedColumn; // Ready for logging changes
 
-    // Clear the content of the editor
-    SendMessage(_hScintilla, SCI_CLEARALL, 0, 0);
-
-    // Re-insert the lines in their original order
-    for (size_t i = 0; i < sortedLines.size(); ++i) {
-        //std::string message = "Inserting line at position: " + std::to_string(i) + "\nContent: " + sortedLines[i];
-        //MessageBoxA(NULL, message.c_str(), "Debug Insert Line", MB_OK);
-        SendMessage(_hScintilla, SCI_APPENDTEXT, sortedLines[i].length(), reinterpret_cast<LPARAM>(sortedLines[i].c_str()));
-        // Add a line break after each line except the last one
-        if (i < sortedLines.size() - 1) {
-            SendMessage(_hScintilla, SCI_APPENDTEXT, lineBreak.length(), reinterpret_cast<LPARAM>(lineBreak.c_str()));
-        }
+    std::wstring profileSummary = finishOperationProfile();
+    if (!profileSummary.empty()) {
+        showStatusMessage(profileSummary, RGB(0, 0, 128));
     }
 }
 
@@ -4194,13 +3725,18 @@ void MultiReplace::handleSortStateAndSort(SortDirection direction) {
     if ((direction == SortDirection::Ascending && currentSortState == SortDirection::Ascending) ||
         (direction == SortDirection::Descending && currentSortState == SortDirection::Descending)) {
         isSortedColumn = false; //Disable logging of changes
-        restoreOriginalLineOrder(originalLineOrder);
+        beginOperationProfile("Restore Order");
+        engine.restoreOriginalLineOrder(originalLineOrder);
+        std::wstring profileSummary = finishOperationProfile();
+        if (!profileSummary.empty()) {
+            showStatusMessage(profileSummary, RGB(0, 0, 128));
+        }
         currentSortState = SortDirection::Unsorted;
         originalLineOrder.clear();
     }
     else {
         currentSortState = (direction == SortDirection::Ascending) ? SortDirection::Ascending : SortDirection::Descending;
-        if (columnDelimiterData.isValid()) {
+        if (engine.columnDelimiterData.isValid()) {
             sortRowsByColumn(direction);
         }
     }
@@ -4261,13 +3797,13 @@ bool MultiReplace::parseColumnAndDelimiterData() {
 
     std::string tempExtendedDelimiter = convertAndExtend(delimiterData, true);
 
-    columnDelimiterData.delimiterChanged = !(columnDelimiterData.extendedDelimiter == convertAndExtend(delimiterData, true));
-    columnDelimiterData.quoteCharChanged = !(columnDelimiterData.quoteChar == wstringToString(quoteCharString) );
+    engine.columnDelimiterData.delimiterChanged = !(engine.columnDelimiterData.extendedDelimiter == convertAndExtend(delimiterData, true));
+    engine.columnDelimiterData.quoteCharChanged = !(engine.columnDelimiterData.quoteChar == wstringToString(quoteCharString) );
 
     // Initilaize values in case it will return with an error
-    columnDelimiterData.extendedDelimiter = "";
-    columnDelimiterData.quoteChar = "";
-    columnDelimiterData.delimiterLength = 0;
+    engine.columnDelimiterData.extendedDelimiter = "";
+    engine.columnDelimiterData.quoteChar = "";
+    engine.columnDelimiterData.delimiterLength = 0;
 
     // Parse column data
     columnDataString.erase(0, columnDataString.find_first_not_of(L','));
@@ -4275,8 +3811,8 @@ bool MultiReplace::parseColumnAndDelimiterData() {
 
     if (columnDataString.empty() || delimiterData.empty()) {
         showStatusMessage(getLangStr(L"status_missing_column_or_delimiter_data"), RGB(255, 0, 0));
-        columnDelimiterData.columns.clear();
-        columnDelimiterData.extendedDelimiter = "";
+        engine.columnDelimiterData.columns.clear();
+        engine.columnDelimiterData.extendedDelimiter = "";
         return false;
     }
 
@@ -4298,7 +3834,7 @@ bool MultiReplace::parseColumnAndDelimiterData() {
 
                 if (startRange < 1 || endRange < startRange) {
                     showStatusMessage(getLangStr(L"status_invalid_range_in_column_data"), RGB(255, 0, 0));
-                    columnDelimiterData.columns.clear();
+                    engine.columnDelimiterData.columns.clear();
                     return false;
                 }
 
@@ -4310,7 +3846,7 @@ bool MultiReplace::parseColumnAndDelimiterData() {
             }
             catch (const std::exception&) {
                 showStatusMessage(getLangStr(L"status_syntax_error_in_column_data"), RGB(255, 0, 0));
-                columnDelimiterData.columns.clear();
+                engine.columnDelimiterData.columns.clear();
                 return false;
             }
         }
@@ -4321,7 +3857,7 @@ bool MultiReplace::parseColumnAndDelimiterData() {
 
                 if (column < 1) {
                     showStatusMessage(getLangStr(L"status_invalid_column_number"), RGB(255, 0, 0));
-                    columnDelimiterData.columns.clear();
+                    engine.columnDelimiterData.columns.clear();
                     return false;
                 }
 
@@ -4331,7 +3867,7 @@ bool MultiReplace::parseColumnAndDelimiterData() {
             }
             catch (const std::exception&) {
                 showStatusMessage(getLangStr(L"status_syntax_error_in_column_data"), RGB(255, 0, 0));
-                columnDelimiterData.columns.clear();
+                engine.columnDelimiterData.columns.clear();
                 return false;
             }
         }
@@ -4352,7 +3888,7 @@ bool MultiReplace::parseColumnAndDelimiterData() {
 
             if (startRange < 1 || endRange < startRange) {
                 showStatusMessage(getLangStr(L"status_invalid_range_in_column_data"), RGB(255, 0, 0));
-                columnDelimiterData.columns.clear();
+                engine.columnDelimiterData.columns.clear();
                 return false;
             }
 
@@ -4364,7 +3900,7 @@ bool MultiReplace::parseColumnAndDelimiterData() {
         }
         catch (const std::exception&) {
             showStatusMessage(getLangStr(L"status_syntax_error_in_column_data"), RGB(255, 0, 0));
-            columnDelimiterData.columns.clear();
+            engine.columnDelimiterData.columns.clear();
             return false;
         }
     }
@@ -4374,7 +3910,7 @@ bool MultiReplace::parseColumnAndDelimiterData() {
 
             if (column < 1) {
                 showStatusMessage(getLangStr(L"status_invalid_column_number"), RGB(255, 0, 0));
-                columnDelimiterData.columns.clear();
+                engine.columnDelimiterData.columns.clear();
                 return false;
             }
             auto insertResult = columns.insert(column);
@@ -4384,7 +3920,7 @@ bool MultiReplace::parseColumnAndDelimiterData() {
         }
         catch (const std::exception&) {
             showStatusMessage(getLangStr(L"status_syntax_error_in_column_data"), RGB(255, 0, 0));
-            columnDelimiterData.columns.clear();
+            engine.columnDelimiterData.columns.clear();
             return false;
         }
     }
@@ -4403,23 +3939,20 @@ bool MultiReplace::parseColumnAndDelimiterData() {
     }
 
     // Set dataChanged flag
-    columnDelimiterData.columnChanged = !(columnDelimiterData.columns == columns);
+    engine.columnDelimiterData.columnChanged = !(engine.columnDelimiterData.columns == columns);
 
-    // Set columnDelimiterData values
-    columnDelimiterData.inputColumns = inputColumns;
-    columnDelimiterData.columns = columns;
-    columnDelimiterData.extendedDelimiter = tempExtendedDelimiter;
-    columnDelimiterData.delimiterLength = tempExtendedDelimiter.length();
-    columnDelimiterData.quoteChar = wstringToString(quoteCharString);
+    // Set engine.columnDelimiterData values
+    engine.columnDelimiterData.inputColumns = inputColumns;
+    engine.columnDelimiterData.columns = columns;
+    engine.columnDelimiterData.extendedDelimiter = tempExtendedDelimiter;
+    engine.columnDelimiterData.delimiterLength = tempExtendedDelimiter.length();
+    engine.columnDelimiterData.quoteChar = wstringToString(quoteCharString);
 
     return true;
 }
 
 void MultiReplace::findAllDelimitersInDocument() {
 
-    // Clear list for new data
-    lineDelimiterPositions.clear();
-
     // Reset TextModiefeid Trigger
     textModified = false;
     logChanges.clear();
@@ -4427,18 +3960,17 @@ void MultiReplace::findAllDelimitersInDocument() {
     // Enable detailed logging for capturing delimiter positions
     isLoggingEnabled = true;
 
-    // Get total line count in document
-    LRESULT totalLines = ::SendMessage(_hScintilla, SCI_GETLINECOUNT, 0, 0);
-
-    // Resize the list to fit total lines
-    lineDelimiterPositions.resize(totalLines);
+    // Scans run on their own when columns are loaded, inside other operations they are one phase
+    bool isOwnOperation = engine.profiler.isEnabled() && !engine.profiler.isOperationActive();
+    if (isOwnOperation) {
+        beginOperationProfile("Scan Columns");
+    }
 
     // Find and store delimiter positions for each line
-    for (LRESULT line = 0; line < totalLines; ++line) {
-
-        // Find delimiters in line
-        findDelimitersInLine(line);
+    engine.findAllDelimitersInDocument();
 
+    if (isOwnOperation) {
+        showStatusMessage(finishOperationProfile(), RGB(0, 0, 128));
     }
 
     // Clear log queue
@@ -4446,97 +3978,6 @@ void MultiReplace::findAllDelimitersInDocument() {
 
 }
 
-void MultiReplace::findDelimitersInLine(LRESULT line) {
-    // Initialize LineInfo for this line
-    LineInfo lineInfo;
-
-    // Get start and end positions of the line
-    lineInfo.startPosition = send(SCI_POSITIONFROMLINE, line, 0);
-    lineInfo.endPosition = send(SCI_GETLINEENDPOSITION, line, 0);
-
-    // Get line length and allocate buffer
-    LRESULT lineLength = send(SCI_LINELENGTH, line, 0);
-    char* buf = new char[lineLength + 1];
-
-    // Get line content
-    send(SCI_GETLINE, line, reinterpret_cast<sptr_t>(buf));
-    std::string lineContent(buf, lineLength);
-    delete[] buf;
-
-    // Define structure to store delimiter position
-    DelimiterPosition delimiterPos = { 0 };
-
-    bool inQuotes = false;
-    std::string::size_type pos = 0;
-
-    bool hasQuoteChar = !columnDelimiterData.quoteChar.empty();
-    char currentQuoteChar = hasQuoteChar ? columnDelimiterData.quoteChar[0] : 0;
-
-    while (pos < lineContent.size()) {
-        // If there's a defined quote character and it matches, toggle inQuotes
-        if (hasQuoteChar && lineContent[pos] == currentQuoteChar) {
-            inQuotes = !inQuotes;
-            ++pos;
-            continue;
-        }
-
-        if (!inQuotes && lineContent.compare(pos, columnDelimiterData.delimiterLength, columnDelimiterData.extendedDelimiter) == 0) {
-            delimiterPos.position = pos + lineInfo.startPosition;
-            lineInfo.positions.push_back(delimiterPos);
-            pos += columnDelimiterData.delimiterLength;  // Skip delimiter for next iteration
-            continue;
-        }
-        ++pos;
-    }
-
-    // Convert size of lineDelimiterPositions to signed integer
-    LRESULT listSize = static_cast<LRESULT>(lineDelimiterPositions.size());
-
-    // Update lineDelimiterPositions with the LineInfo for this line
-    if (line < listSize) {
-        lineDelimiterPositions[line] = lineInfo;
-    }
-    else {
-        // If the line index is greater than the current size of the list,
-        // append new elements to the list
-        lineDelimiterPositions.resize(line + 1);
-        lineDelimiterPositions[line] = lineInfo;
-    }
-}
-
-ColumnInfo MultiReplace::getColumnInfo(LRESULT startPosition) {
-    if (IsDlgButtonChecked(_hSelf, IDC_COLUMN_MODE_RADIO) != BST_CHECKED ||
-        columnDelimiterData.columns.empty() || columnDelimiterData.extendedDelimiter.empty() ||
-        lineDelimiterPositions.empty()) {
-        return { 0, 0, 0 };
-    }
-
-    LRESULT totalLines = ::SendMessage(_hScintilla, SCI_GETLINECOUNT, 0, 0);
-    LRESULT startLine = ::SendMessage(_hScintilla, SCI_LINEFROMPOSITION, startPosition, 0);
-    SIZE_T startColumnIndex = 1;
-
-    // Check if the line exists in lineDelimiterPositions
-    LRESULT listSize = static_cast<LRESULT>(lineDelimiterPositions.size());
-    if (startLine < totalLines && startLine < listSize) {
-        const auto& linePositions = lineDelimiterPositions[startLine].positions;
-
-        SIZE_T i = 0;
-        for (; i < linePositions.size(); ++i) {
-            if (startPosition <= linePositions[i].position) {
-                startColumnIndex = i + 1;
-                break;
-            }
-        }
-
-        // Check if startPosition is in the last column only if the loop ran to completion
-        if (i == linePositions.size()) {
-            startColumnIndex = linePositions.size() + 1;  // We're in the last column
-        }
-
-    }
-    return { totalLines, startLine, startColumnIndex };
-}
-
 void MultiReplace::initializeColumnStyles() {
 
     int IDM_LANG_TEXT = 46016;  // Switch off Languages - > Normal Text
@@ -4558,8 +3999,8 @@ void MultiReplace::initializeColumnStyles() {
 } 
 
 void MultiReplace::handleHighlightColumnsInDocument() {
-    // Return early if columnDelimiterData is empty
-    if (columnDelimiterData.columns.empty() || columnDelimiterData.extendedDelimiter.empty()) {
+    // Return early if engine.columnDelimiterData is empty
+    if (engine.columnDelimiterData.columns.empty() || engine.columnDelimiterData.extendedDelimiter.empty()) {
         return;
     }
 
@@ -4568,13 +4009,13 @@ void MultiReplace::handleHighlightColumnsInDocument() {
 
     // Iterate over each line's delimiter positions
     LRESULT line = 0;
-    while (line < static_cast<LRESULT>(lineDelimiterPositions.size()) ) {
+    while (line < static_cast<LRESULT>(engine.lineDelimiterPositions.size()) ) {
         highlightColumnsInLine(line);
         ++line;
     }
 
     // Show Row and Column Position
-    if (!lineDelimiterPositions.empty() ) {
+    if (!engine.lineDelimiterPositions.empty() ) {
         LRESULT startPosition = ::SendMessage(_hScintilla, SCI_GETCURRENTPOS, 0, 0);
         showStatusMessage(getLangStr(L"status_actual_position", { addLineAndColumnMessage(startPosition) }), RGB(0, 128, 0));
     }
@@ -4588,55 +4029,62 @@ void MultiReplace::handleHighlightColumnsInDocument() {
 }
 
 void MultiReplace::highlightColumnsInLine(LRESULT line) {
-    const auto& lineInfo = lineDelimiterPositions[line];
+    const auto& lineInfo = engine.lineDelimiterPositions[line];
+    const LRESULT lineLength = lineInfo.endPosition - lineInfo.startPosition;
 
     // Check for empty line
-    if (lineInfo.endPosition - lineInfo.startPosition == 0) {
+    if (lineLength == 0) {
         return; // It's an empty line, so exit early
     }
 
-    // Prepare a vector for styles
-    std::vector<char> styles((lineInfo.endPosition) - lineInfo.startPosition, 0);
-
-    // If no delimiter present, highlight whole line as first column
-    if (lineInfo.positions.empty() &&
-        std::find(columnDelimiterData.columns.begin(), columnDelimiterData.columns.end(), 1) != columnDelimiterData.columns.end())
-    {
-        char style = static_cast<char>(hColumnStyles[0 % hColumnStyles.size()]);
-        std::fill(styles.begin(), styles.end(), style);
-    }
-    else {
-        // Highlight specific columns from columnDelimiterData
-        for (SIZE_T column : columnDelimiterData.columns) {
-            if (column <= lineInfo.positions.size() + 1) {
-                LRESULT start = 0;
-                LRESULT end = 0;
-
-                // Set start and end positions based on column index
-                if (column == 1) {
-                    start = 0;
-                }
-                else {
-                    start = lineInfo.positions[column - 2].position + columnDelimiterData.delimiterLength - lineInfo.startPosition;
-                }
+    // Styles are sent window by window, so a line of hundreds of megabytes needs no
+    // style buffer of its length
+    const size_t windowSize = static_cast<size_t>(std::min<LRESULT>(lineLength, MultiReplaceEngine::LINE_WINDOW_BYTES));
+    std::vector<char> styles;
+    styles.reserve(windowSize);
+    LRESULT styled = 0; // Offset in the line up to which styles are set
+    auto styleUpTo = [&](LRESULT end, char style) {
+        end = std::min(end, lineLength);
+        while (styled < end) {
+            const LRESULT run = std::min(end - styled, static_cast<LRESULT>(windowSize - styles.size()));
+            styles.insert(styles.end(), static_cast<size_t>(run), style);
+            styled += run;
+            if (styles.size() == windowSize) {
+                send(SCI_SETSTYLINGEX, styles.size(), reinterpret_cast<sptr_t>(styles.data()));
+                styles.clear();
+            }
+        }
+    };
 
-                if (column == lineInfo.positions.size() + 1) {
-                    end = (lineInfo.endPosition )- lineInfo.startPosition;
-                }
-                else {
-                    end = lineInfo.positions[column - 1].position - lineInfo.startPosition;
-                }
+    send(SCI_STARTSTYLING, lineInfo.startPosition, 0);
 
-                // Apply style to the specific range within the styles vector
-                char style = static_cast<char>(hColumnStyles[(column - 1) % hColumnStyles.size()]);
-                std::fill(styles.begin() + start, styles.begin() + end, style);
-            }
+    // Highlight specific columns from engine.columnDelimiterData, in ascending order. Without
+    // a delimiter the whole line is the first column.
+    for (SIZE_T column : engine.columnDelimiterData.columns) {
+        if (column > lineInfo.positions.size() + 1) {
+            break;
+        }
 
+        // Set start and end positions based on column index
+        LRESULT start = 0;
+        LRESULT end = 0;
+        if (column > 1) {
+            start = lineInfo.positions[column - 2].position + engine.columnDelimiterData.delimiterLength - lineInfo.startPosition;
+        }
+        if (column == lineInfo.positions.size() + 1) {
+            end = lineLength;
+        }
+        else {
+            end = lineInfo.positions[column - 1].position - lineInfo.startPosition;
         }
-    }
 
-    send(SCI_STARTSTYLING, lineInfo.startPosition, 0);
-    send(SCI_SETSTYLINGEX, styles.size(), reinterpret_cast<sptr_t>(&styles[0]));
+        styleUpTo(start, 0);
+        styleUpTo(end, static_cast<char>(hColumnStyles[(column - 1) % hColumnStyles.size()]));
+    }
+    styleUpTo(lineLength, 0);
+    if (!styles.empty()) {
+        send(SCI_SETSTYLINGEX, styles.size(), reinterpret_cast<sptr_t>(styles.data()));
+    }
 }
 
 void MultiReplace::handleClearColumnMarks() {
@@ -4654,13 +4102,14 @@ void MultiReplace::handleClearColumnMarks() {
 }
 
 std::wstring MultiReplace::addLineAndColumnMessage(LRESULT pos) {
-    if (!columnDelimiterData.isValid()) {
+    if (!engine.columnDelimiterData.isValid()) {
         return L"";
     }
-    ColumnInfo startInfo = getColumnInfo(pos);
+    updateEngineOptions();
+    CellLocation cell = engine.locateCell(pos);
     std::wstring lineAndColumnMessage = getLangStr(L"status_line_and_column_position",
-                                                   { std::to_wstring(startInfo.startLine + 1),
-                                                     std::to_wstring(startInfo.startColumnIndex) });
+                                                   { std::to_wstring(cell.line + 1),
+                                                     std::to_wstring(cell.column) });
 
     return lineAndColumnMessage;
 }
@@ -4688,8 +4137,8 @@ void MultiReplace::processLogForDelimiters()
                     ++modifyLogEntry.lineNumber;
                 }
             }
-            updateDelimitersInDocument(static_cast<int>(logEntry.lineNumber), ChangeType::Insert);
-            updateUnsortedDocument(static_cast<int>(logEntry.lineNumber), ChangeType::Insert);
+            engine.updateDelimitersInDocument(static_cast<size_t>(logEntry.lineNumber), ChangeType::Insert);
+            updateUnsortedDocument(static_cast<size_t>(logEntry.lineNumber), ChangeType::Insert);
             // this->messageBoxContent += "Line " + std::to_string(static_cast<int>(logEntry.lineNumber)) + " inserted.\n";
             // Add Insert entry as a Modify entry in modifyLogEntries
             logEntry.changeType = ChangeType::Modify;  // Convert Insert to Modify
@@ -4704,8 +4153,8 @@ void MultiReplace::processLogForDelimiters()
                     modifyLogEntry.lineNumber = -1;  // Mark for deletion
                 }
             }
-            updateDelimitersInDocument(static_cast<int>(logEntry.lineNumber), ChangeType::Delete);
-            updateUnsortedDocument(static_cast<int>(logEntry.lineNumber), ChangeType::Delete);
+            engine.updateDelimitersInDocument(static_cast<size_t>(logEntry.lineNumber), ChangeType::Delete);
+            updateUnsortedDocument(static_cast<size_t>(logEntry.lineNumber), ChangeType::Delete);
             // this->messageBoxContent += "Line " + std::to_string(static_cast<int>(logEntry.lineNumber)) + " deleted.\n";
             break;
         case ChangeType::Modify:
@@ -4720,7 +4169,7 @@ void MultiReplace::processLogForDelimiters()
     // Apply the saved "Modify" entries to the original delimiter list
     for (const auto& modifyLogEntry : modifyLogEntries) {
         if (modifyLogEntry.lineNumber != -1) {
-            updateDelimitersInDocument(static_cast<int>(modifyLogEntry.lineNumber), ChangeType::Modify);
+            engine.updateDelimitersInDocument(static_cast<size_t>(modifyLogEntry.lineNumber), ChangeType::Modify);
             if (isColumnHighlighted) {
                 //clearMarksInLine(modifyLogEntry.lineNumber);
                 highlightColumnsInLine(modifyLogEntry.lineNumber);
@@ -4742,101 +4191,21 @@ void MultiReplace::processLogForDelimiters()
     textModified = false;
 }
 
-void MultiReplace::updateDelimitersInDocument(SIZE_T lineNumber, ChangeType changeType) {
-
-    if (lineNumber > lineDelimiterPositions.size()) {
-        return; // invalid line number
-    }
-
-    LineInfo lineInfo;
-    switch (changeType) {
-    case ChangeType::Insert:
-        // Insert an empty line at the specified index
-        if (lineNumber > 0) { // not the first line
-            lineInfo.startPosition = lineDelimiterPositions[lineNumber - 1].endPosition + eolLength;
-            lineInfo.endPosition = lineInfo.startPosition;
-        }
-        else {
-            lineInfo.startPosition = 0;
-            lineInfo.endPosition = 0;
-        }
-        lineDelimiterPositions.insert(lineDelimiterPositions.begin() + lineNumber, lineInfo);
-        break;
-
-    case ChangeType::Delete:
-        // Delete the specified line
-        if (lineNumber < lineDelimiterPositions.size()) {
-            // Calculate the length of the deleted line (including EOL)
-            LRESULT deletedLineLength = lineDelimiterPositions[lineNumber].endPosition
-                - lineDelimiterPositions[lineNumber].startPosition
-                + eolLength;
-
-            lineDelimiterPositions.erase(lineDelimiterPositions.begin() + lineNumber);
-
-            // Update positions for subsequent lines
-            for (SIZE_T i = lineNumber; i < lineDelimiterPositions.size(); ++i) {
-                lineDelimiterPositions[i].startPosition -= deletedLineLength;
-                lineDelimiterPositions[i].endPosition -= deletedLineLength;
-                for (auto& delim : lineDelimiterPositions[i].positions) {
-                    delim.position -= deletedLineLength;
-                }
-            }
-        }
-        break;
-
-    case ChangeType::Modify:
-        // Modify the content of the specified line
-        if (lineNumber < lineDelimiterPositions.size()) {
-            // Re-analyze the line to find delimiters
-            findDelimitersInLine(lineNumber);
-
-            // Only adjust following lines if not at the last line
-            if (lineNumber < lineDelimiterPositions.size() - 1) {
-                // Calculate the difference to the next line start position (considering EOL)
-                LRESULT positionDifference = lineDelimiterPositions[lineNumber + 1].startPosition - lineDelimiterPositions[lineNumber].endPosition - eolLength;
-
-                // Update positions for subsequent lines
-                for (SIZE_T i = lineNumber + 1; i < lineDelimiterPositions.size(); ++i) {
-                    if (positionDifference > 0) { // The distance is too large, need to reduce
-                        lineDelimiterPositions[i].startPosition -= positionDifference;
-                        lineDelimiterPositions[i].endPosition -= positionDifference;
-                        for (auto& delim : lineDelimiterPositions[i].positions) {
-                            delim.position -= positionDifference;
-                        }
-                    }
-                    else if (positionDifference < 0) { // The distance is too small, need to increase
-                        lineDelimiterPositions[i].startPosition += abs(positionDifference);
-                        lineDelimiterPositions[i].endPosition += abs(positionDifference);
-                        for (auto& delim : lineDelimiterPositions[i].positions) {
-                            delim.position += abs(positionDifference);
-                        }
-                    }
-                }
-            }
-        }
-        break;
-
-    default:
-        break;
-    }
-
-}
-
 void MultiReplace::handleDelimiterPositions(DelimiterOperation operation) {
     // Check if IDC_COLUMN_MODE_RADIO checkbox is not checked, and if so, return early
     if (IsDlgButtonChecked(_hSelf, IDC_COLUMN_MODE_RADIO) != BST_CHECKED) {
         return;
     }
     //int currentBufferID = (int)::SendMessage(nppData._nppHandle, NPPM_GETCURRENTBUFFERID, 0, 0);
-    LRESULT updatedEolLength = getEOLLength();
+    LRESULT updatedEolLength = engine.getEOLLength();
 
     // If EOL length has changed or if there's been a change in the active window within Notepad++, reset all delimiter settings
-    if (updatedEolLength != eolLength || documentSwitched) {
+    if (updatedEolLength != engine.eolLength || documentSwitched) {
         handleClearDelimiterState();
         documentSwitched = false;
     }
 
-    eolLength = updatedEolLength;
+    engine.eolLength = updatedEolLength;
     //scannedDelimiterBufferID = currentBufferID;
 
     if (operation == DelimiterOperation::LoadAll) {
@@ -4846,20 +4215,20 @@ void MultiReplace::handleDelimiterPositions(DelimiterOperation operation) {
         }
 
         // If any conditions that warrant a refresh of delimiters are met, proceed
-        if (columnDelimiterData.isValid()) {
+        if (engine.columnDelimiterData.isValid()) {
             findAllDelimitersInDocument();
         }
     }
     else if (operation == DelimiterOperation::Update) {
         // Ensure the columns and delimiter data is present before processing updates
-        if (columnDelimiterData.isValid()) {
+        if (engine.columnDelimiterData.isValid()) {
             processLogForDelimiters();
         }
     }
 }
 
 void MultiReplace::handleClearDelimiterState() {
-    lineDelimiterPositions.clear();
+    engine.lineDelimiterPositions.clear();
     isLoggingEnabled = false;
     textModified = false;
     logChanges.clear();
@@ -4895,7 +4264,7 @@ void MultiReplace::displayLogChangesInMessageBox() {
         return ss.str();
         };
 
-    std::string startContent = listToString(lineDelimiterPositions);
+    std::string startContent = listToString(engine.lineDelimiterPositions);
     std::wstring wideStartContent = stringToWString(startContent);
     MessageBox(NULL, wideStartContent.c_str(), L"Content at the beginning", MB_OK);
 
@@ -4925,7 +4294,7 @@ void MultiReplace::displayLogChangesInMessageBox() {
     MessageBox(NULL, wideMessageBoxContent.c_str(), L"Final Result", MB_OK);
     messageBoxContent.clear();
 
-    std::string endContent = listToString(lineDelimiterPositions);
+    std::string endContent = listToString(engine.lineDelimiterPositions);
     std::wstring wideEndContent = stringToWString(endContent);
     MessageBox(NULL, wideEndContent.c_str(), L"Content at the end", MB_OK);
 
@@ -4938,136 +4307,6 @@ void MultiReplace::displayLogChangesInMessageBox() {
 
 #pragma region Utilities
 
-int MultiReplace::convertExtendedToString(const std::string& query, std::string& result)
-{
-    auto readBase = [](const char* str, int* value, int base, int size) -> bool
-    {
-        int i = 0, temp = 0;
-        *value = 0;
-        char max = '0' + static_cast<char>(base) - 1;
-        char current;
-        while (i < size)
-        {
-            current = str[i];
-            if (current >= 'A')
-            {
-                current &= 0xdf;
-                current -= ('A' - '0' - 10);
-            }
-            else if (current > '9')
-                return false;
-
-            if (current >= '0' && current <= max)
-            {
-                temp *= base;
-                temp += (current - '0');
-            }
-            else
-            {
-                return false;
-            }
-            ++i;
-        }
-        *value = temp;
-        return true;
-    };
-
-    int i = 0, j = 0;
-    int charLeft = static_cast<int>(query.length());
-    char current;
-    result.clear();
-    result.resize(query.length()); // Preallocate memory for optimal performance
-
-    while (i < static_cast<int>(query.length()))
-    {
-        current = query[i];
-        --charLeft;
-        if (current == '\\' && charLeft)
-        {
-            ++i;
-            --charLeft;
-            current = query[i];
-            switch (current)
-            {
-            case 'r':
-                result[j] = '\r';
-                break;
-            case 'n':
-                result[j] = '\n';
-                break;
-            case '0':
-                result[j] = '\0';
-                break;
-            case 't':
-                result[j] = '\t';
-                break;
-            case '\\':
-                result[j] = '\\';
-                break;
-            case 'b':
-            case 'd':
-            case 'o':
-            case 'x':
-            case 'u':
-            {
-                int size = 0, base = 0;
-                if (current == 'b')
-                {
-                    size = 8, base = 2;
-                }
-                else if (current == 'o')
-                {
-                    size = 3, base = 8;
-                }
-                else if (current == 'd')
-                {
-                    size = 3, base = 10;
-                }
-                else if (current == 'x')
-                {
-                    size = 2, base = 16;
-                }
-                else if (current == 'u')
-                {
-                    size = 4, base = 16;
-                }
-
-                if (charLeft >= size)
-                {
-                    int res = 0;
-                    if (readBase(query.c_str() + (i + 1), &res, base, size))
-                    {
-                        result[j] = static_cast<char>(res);
-                        i += size;
-                        break;
-                    }
-                }
-                // not enough chars to make parameter, use default method as fallback
-            }
-            [[fallthrough]];
-            default:
-                // unknown sequence, treat as regular text
-                result[j] = '\\';
-                ++j;
-                result[j] = current;
-                break;
-            }
-        }
-        else
-        {
-            result[j] = query[i];
-        }
-        ++i;
-        ++j;
-    }
-
-    // Nullterminate the result-String
-    result.resize(j);
-
-    // Return length of result-Strings
-    return j;
-}
-
 std::string MultiReplace::convertAndExtend(const std::wstring& input, bool extended)
 {
     std::string output = wstringToString(input);
@@ -5075,21 +4314,7 @@ std::string MultiReplace::convertAndExtend(const std::wstring& input, bool exten
     if (extended)
     {
         std::string outputExtended;
-        convertExtendedToString(output, outputExtended);
-        output = outputExtended;
-    }
-
-    return output;
-}
-
-std::string MultiReplace::convertAndExtend(const std::string& input, bool extended)
-{
-    std::string output = input;
-
-    if (extended)
-    {
-        std::string outputExtended;
-        convertExtendedToString(output, outputExtended);
+        MultiReplaceEngine::convertExtendedToString(output, outputExtended);
         output = outputExtended;
     }
 
@@ -5240,6 +4465,7 @@ void MultiReplace::showStatusMessage(const std::wstring& messageText, COLORREF c
     // Set the new message
     _statusMessageColor = color;
     SetWindowText(hStatusMessage, strMessage.c_str());
+    shownCaretPosition = -1; // The caret position is no longer what the status shows
 
     // Invalidate the area of the parent where the control resides
     RECT rect;
@@ -5268,33 +4494,6 @@ std::wstring MultiReplace::getSelectedText() {
     return wstr;
 }
 
-LRESULT MultiReplace::getEOLLength() {
-    LRESULT eolMode = ::SendMessage(getScintillaHandle(), SCI_GETEOLMODE, 0, 0);
-    switch (eolMode) {
-    case SC_EOL_CRLF:
-        return 2;
-    case SC_EOL_CR:
-    case SC_EOL_LF:
-        return 1;
-    default:
-        return 2; // Default to CRLF
-    }
-}
-
-std::string MultiReplace::getEOLStyle() {
-    LRESULT eolMode = SendMessage(_hScintilla, SCI_GETEOLMODE, 0, 0);
-    switch (eolMode) {
-    case SC_EOL_CRLF:
-        return "\r\n";
-    case SC_EOL_CR:
-        return "\r";
-    case SC_EOL_LF:
-        return "\n";
-    default:
-        return "\n";  // Defaulting to LF
-    }
-}
-
 void MultiReplace::setElementsState(const std::vector<int>& elements, bool enable) {
     for (int id : elements) {
         EnableWindow(GetDlgItem(_hSelf, id), enable ? TRUE : FALSE);
@@ -5302,14 +4501,179 @@ void MultiReplace::setElementsState(const std::vector<int>& elements, bool enabl
 }
 
 sptr_t MultiReplace::send(unsigned int iMessage, uptr_t wParam, sptr_t lParam, bool useDirect) {
-    if (useDirect && pSciMsg) {
-        return pSciMsg(pSciWndData, iMessage, wParam, lParam);
+    if (useDirect) {
+        return recordingBackend.send(iMessage, wParam, lParam);
     }
     else {
         return ::SendMessage(_hScintilla, iMessage, wParam, lParam);
     }
 }
 
+void MultiReplace::beginOperationProfile(const std::string& operationName) {
+    if (engine.profiler.isEnabled()) {
+        engine.profiler.beginOperation(operationName);
+    }
+}
+
+std::wstring MultiReplace::finishOperationProfile() {
+    if (!engine.profiler.isEnabled()) {
+        return L"";
+    }
+    engine.profiler.endOperation();
+
+    if (!profilingTraceFile.empty()) {
+        std::ofstream traceFile(profilingTraceFile);
+        if (traceFile.is_open()) {
+            engine.profiler.writeChromeTrace(traceFile);
+        }
+    }
+
+    return utf8ToWString(engine.profiler.summary().c_str());
+}
+
+std::wstring MultiReplace::appendOperationStatus(const std::wstring& messageText) {
+    std::wstring statusText = messageText;
+    std::wstring timeoutText = regexTimeoutStatus();
+    if (!timeoutText.empty()) {
+        statusText += L" | " + timeoutText;
+    }
+    std::wstring profileSummary = finishOperationProfile();
+    if (!profileSummary.empty()) {
+        statusText += L" | " + profileSummary;
+    }
+
+    enforceMemoryLimit();
+    if (showMemoryInStatus) {
+        statusText += L" | " + utf8ToWString(formatBytes(totalBytes(memoryUsage())).c_str());
+    }
+    return statusText;
+}
+
+// Names the regex rules the watchdog stopped by their number in the list, the Find field
+// has none
+std::wstring MultiReplace::regexTimeoutStatus() const {
+    const std::vector<RegexWatchdog::Timeout>& timeouts = engine.regexWatchdog.timeouts();
+    if (timeouts.empty()) {
+        return L"";
+    }
+
+    std::wstring entries;
+    if (engine.options.useList) {
+        for (size_t i = 0; i < replaceListData.size(); ++i) {
+            const ReplaceItemData& item = replaceListData[i];
+            const std::string findTextUtf8 = wstringToString(item.findText);
+            const bool stopped = item.isEnabled && item.regex && std::any_of(timeouts.begin(), timeouts.end(), [&](const RegexWatchdog::Timeout& timeout) {
+                return timeout.pattern == findTextUtf8;
+                });
+            if (stopped) {
+                entries += (entries.empty() ? L"" : L", ") + std::to_wstring(i + 1);
+            }
+        }
+    }
+
+    const std::wstring budget = std::to_wstring(engine.regexWatchdog.budgetMilliseconds());
+    if (entries.empty()) {
+        return getLangStr(L"status_regex_stopped", { budget });
+    }
+    return getLangStr(L"status_regex_stopped_entries", { budget, entries });
+}
+
+// A search that found nothing because the watchdog stopped it says so
+void MultiReplace::showNoMatchStatus(const std::wstring& messageText) {
+    std::wstring timeoutText = regexTimeoutStatus();
+    showStatusMessage(timeoutText.empty() ? messageText : timeoutText, RGB(255, 0, 0));
+}
+
+MemoryReport MultiReplace::memoryUsage() const {
+    MemoryReport report = engine.memoryUsage();
+
+    MemoryUsage replaceList{ "replaceListData", MemorySize::shallow(replaceListData), replaceListData.size() };
+    for (const ReplaceItemData& item : replaceListData) {
+        replaceList.bytes += MemorySize::of(item.findCount) + MemorySize::of(item.replaceCount)
+            + MemorySize::of(item.findText) + MemorySize::of(item.replaceText);
+    }
+    report.push_back(replaceList);
+
+    report.push_back({ "originalLineOrder", MemorySize::shallow(originalLineOrder), originalLineOrder.size() });
+    report.push_back({ "logChanges", MemorySize::shallow(logChanges), logChanges.size() });
+    report.push_back({ "session recording", sessionRecorder.memoryBytes(), sessionRecorder.session().messages.size() });
+    report.push_back({ "live count text", liveCountText ? liveCountText->capacity() : 0, static_cast<size_t>(liveCountText ? 1 : 0) });
+    const size_t lookAheadBytes = searchPrefetcher.memoryBytes();
+    report.push_back({ "look-ahead copy", lookAheadBytes, static_cast<size_t>(lookAheadBytes ? 1 : 0) });
+    return report;
+}
+
+void MultiReplace::enforceMemoryLimit() {
+    if (memorySoftLimitMB == 0 || totalBytes(memoryUsage()) <= memorySoftLimitMB * 1024 * 1024) {
+        return;
+    }
+
+    engine.releaseCaches();
+    liveCountText.reset();
+    searchPrefetcher.stop();
+
+    // Delimiter positions are rescanned by the next column operation, unless they drive the highlighting
+    if (!isColumnHighlighted) {
+        handleClearDelimiterState();
+        std::vector<LineInfo>().swap(engine.lineDelimiterPositions);
+        std::vector<LogEntry>().swap(logChanges);
+    }
+}
+
+void MultiReplace::showMemoryReport() {
+    std::wstring message = utf8ToWString(formatMemoryReport(memoryUsage()).c_str());
+    if (memorySoftLimitMB > 0) {
+        message += L"\nSoft limit: " + std::to_wstring(memorySoftLimitMB) + L" MB";
+    }
+    MessageBox(nppData._nppHandle, message.c_str(), L"MultiReplace Memory", MB_OK | MB_ICONINFORMATION);
+}
+
+bool MultiReplace::toggleLiveReplace() {
+    liveReplaceEnabled = !liveReplaceEnabled;
+    clearLiveReplace();
+    showStatusMessage(getLangStr(liveReplaceEnabled ? L"status_live_replace_on" : L"status_live_replace_off"), RGB(0, 128, 0));
+    return liveReplaceEnabled;
+}
+
+bool MultiReplace::toggleSessionRecording() {
+    if (!sessionRecorder.isRecording() && !sessionLimitReached) {
+        // The recording counts towards the soft limit, the caches need the rest of it
+        sessionRecorder.setByteLimit(memorySoftLimitMB > 0 ? memorySoftLimitMB * 1024 * 1024 / 2 : MessageRecorder::DEFAULT_BYTE_LIMIT);
+        sessionRecorder.onLimitReached = [this]() {
+            sessionLimitReached = true;
+            PostMessage(_hSelf, WM_SESSION_LIMIT, 0, 0);
+        };
+        sessionRecorder.start(sciBackend);
+        return true;
+    }
+    sessionLimitReached = false;
+    sessionRecorder.stop();
+
+    // Session and histogram go next to the settings, the session can be replayed with MultiReplaceReplay
+    wchar_t configDir[MAX_PATH] = {};
+    ::SendMessage(nppData._nppHandle, NPPM_GETPLUGINSCONFIGDIR, MAX_PATH, (LPARAM)configDir);
+    configDir[MAX_PATH - 1] = '\0';
+    std::wstring sessionFilePath = std::wstring(configDir) + L"\\MultiReplaceSession.mrtrace";
+    std::wstring histogramFilePath = std::wstring(configDir) + L"\\MultiReplaceSession.txt";
+
+    std::string report = sessionRecorder.histogramReport();
+    std::ofstream histogramFile(histogramFilePath);
+    if (histogramFile.is_open()) {
+        histogramFile << sessionRecorder.histogramReport(sessionRecorder.histogram().size());
+    }
+
+    std::ofstream sessionFile(sessionFilePath, std::ios::binary);
+    bool saved = sessionFile.is_open() && sessionRecorder.save(sessionFile);
+
+    std::wstring message = (saved ? L"Session saved to " + sessionFilePath : L"Could not write " + sessionFilePath) + L"\n\n";
+    if (sessionRecorder.session().truncated) {
+        message += L"The memory limit for recording was reached. Recording stopped there, the session is incomplete.\n\n";
+    }
+    message += utf8ToWString(report.c_str());
+    MessageBox(nppData._nppHandle, message.c_str(), L"MultiReplace Session", MB_OK | (saved ? MB_ICONINFORMATION : MB_ICONWARNING));
+    return false;
+}
+
 /*
 sptr_t MultiReplace::send(unsigned int iMessage, uptr_t wParam, sptr_t lParam, bool useDirect) {
     sptr_t result;
@@ -5362,34 +4726,6 @@ sptr_t MultiReplace::send(unsigned int iMessage, uptr_t wParam, sptr_t lParam, b
 } 
 */
 
-bool MultiReplace::normalizeAndValidateNumber(std::string& str) {
-    if (str == "." || str == ",") {
-        return false;
-    }
-
-    int dotCount = 0;
-    std::string tempStr = str; // Temporary string to hold potentially modified string
-    for (char& c : tempStr) {
-        if (c == '.') {
-            dotCount++;
-        }
-        else if (c == ',') {
-            dotCount++;
-            c = '.';  // Potentially replace comma with dot in tempStr
-        }
-        else if (!isdigit(c)) {
-            return false;  // Contains non-numeric characters
-        }
-
-        if (dotCount > 1) {
-            return false;  // Contains more than one separator
-        }
-    }
-
-    str = tempStr;
-    return true;  // String is a valid number
-}
-
 #pragma endregion
 
 
@@ -5521,7 +4857,7 @@ bool MultiReplace::saveListToCsvSilent(const std::wstring& filePath, const std::
     }
 
     // Convert and Write CSV header
-    std::string utf8Header = wstringToString(L"Selected,Find,Replace,WholeWord,MatchCase,UseVariables,Regex,Extended\n");
+    std::string utf8Header = wstringToString(L"Selected,Find,Replace,WholeWord,MatchCase,UseVariables,Regex,Extended,FuzzyEdits\n");
     outFile << utf8Header;
 
     // Write list items to CSV file
@@ -5533,7 +4869,8 @@ bool MultiReplace::saveListToCsvSilent(const std::wstring& filePath, const std::
             std::to_wstring(item.matchCase) + L"," +
             std::to_wstring(item.useVariables) + L"," +
             std::to_wstring(item.extended) + L"," +
-            std::to_wstring(item.regex) + L"\n";
+            std::to_wstring(item.regex) + L"," +
+            std::to_wstring(item.fuzzyEdits) + L"\n";
         std::string utf8Line = wstringToString(line);
         outFile << utf8Line;
     }
@@ -5591,7 +4928,8 @@ void MultiReplace::loadListFromCsvSilent(const std::wstring& filePath, std::vect
         }
         columns.push_back(unescapeCsvValue(currentValue));
 
-        if (columns.size() != 8) {
+        // Lists saved before Fuzzy mode have no FuzzyEdits column
+        if (columns.size() != 8 && columns.size() != 9) {
             throw CsvLoadException("status_invalid_column_count");
         }
 
@@ -5605,6 +4943,9 @@ void MultiReplace::loadListFromCsvSilent(const std::wstring& filePath, std::vect
             item.useVariables = std::stoi(columns[5]) != 0;
             item.extended = std::stoi(columns[6]) != 0;
             item.regex = std::stoi(columns[7]) != 0;
+            if (columns.size() == 9) {
+                item.fuzzyEdits = std::clamp(std::stoi(columns[8]), 0, MAX_FUZZY_EDITS);
+            }
 
             tempList.push_back(item);
         }
@@ -5759,6 +5100,11 @@ void MultiReplace::exportToBashScript(const std::wstring& fileName) {
     file << "# processLine arguments: \"findString\" \"replaceString\" wholeWord matchCase normal extended regex\n";
     for (const auto& itemData : replaceListData) {
         if (!itemData.isEnabled) continue; // Skip if this item is not selected
+        if (itemData.fuzzyEdits > 0) {
+            // sed has no approximate matching
+            file << "# Skipped Fuzzy mode entry: " << replaceNewline(wstringToString(itemData.findText), ReplaceMode::Normal) << "\n";
+            continue;
+        }
 
         std::string find;
         std::string replace;
@@ -5969,6 +5315,9 @@ void MultiReplace::saveSettingsToIni(const std::wstring& iniFilePath) {
     int matchCase = IsDlgButtonChecked(_hSelf, IDC_MATCH_CASE_CHECKBOX) == BST_CHECKED ? 1 : 0;
     int extended = IsDlgButtonChecked(_hSelf, IDC_EXTENDED_RADIO) == BST_CHECKED ? 1 : 0;
     int regex = IsDlgButtonChecked(_hSelf, IDC_REGEX_RADIO) == BST_CHECKED ? 1 : 0;
+    int fuzzy = IsDlgButtonChecked(_hSelf, IDC_FUZZY_RADIO) == BST_CHECKED ? 1 : 0;
+    BOOL fuzzyEditsValid = FALSE;
+    int fuzzyEdits = std::clamp(static_cast<int>(GetDlgItemInt(_hSelf, IDC_FUZZY_EDITS_EDIT, &fuzzyEditsValid, FALSE)), 1, MAX_FUZZY_EDITS);
 	int replaceFirst = IsDlgButtonChecked(_hSelf, IDC_REPLACE_FIRST_CHECKBOX) == BST_CHECKED ? 1 : 0;
     int wrapAround = IsDlgButtonChecked(_hSelf, IDC_WRAP_AROUND_CHECKBOX) == BST_CHECKED ? 1 : 0;
     int useVariables = IsDlgButtonChecked(_hSelf, IDC_USE_VARIABLES_CHECKBOX) == BST_CHECKED ? 1 : 0;
@@ -5980,6 +5329,8 @@ void MultiReplace::saveSettingsToIni(const std::wstring& iniFilePath) {
     outFile << wstringToString(L"MatchCase=" + std::to_wstring(matchCase) + L"\n");
     outFile << wstringToString(L"Extended=" + std::to_wstring(extended) + L"\n");
     outFile << wstringToString(L"Regex=" + std::to_wstring(regex) + L"\n");
+    outFile << wstringToString(L"Fuzzy=" + std::to_wstring(fuzzy) + L"\n");
+    outFile << wstringToString(L"FuzzyEdits=" + std::to_wstring(fuzzyEditsValid ? fuzzyEdits : 1) + L"\n");
 	outFile << wstringToString(L"ReplaceFirst=" + std::to_wstring(replaceFirst) + L"\n");
     outFile << wstringToString(L"WrapAround=" + std::to_wstring(wrapAround) + L"\n");
     outFile << wstringToString(L"UseVariables=" + std::to_wstring(useVariables) + L"\n");
@@ -5992,7 +5343,7 @@ void MultiReplace::saveSettingsToIni(const std::wstring& iniFilePath) {
     std::wstring columnNum = L"\"" + getTextFromDialogItem(_hSelf, IDC_COLUMN_NUM_EDIT) + L"\"";
     std::wstring delimiter = L"\"" + getTextFromDialogItem(_hSelf, IDC_DELIMITER_EDIT) + L"\"";
     std::wstring quoteChar = L"\"" + getTextFromDialogItem(_hSelf, IDC_QUOTECHAR_EDIT) + L"\"";
-    std::wstring headerLines = std::to_wstring(CSVheaderLinesCount);
+    std::wstring headerLines = std::to_wstring(engine.CSVheaderLinesCount);
 
     outFile << wstringToString(L"[Scope]\n");
     outFile << wstringToString(L"Selection=" + std::to_wstring(selection) + L"\n");
@@ -6002,6 +5353,41 @@ void MultiReplace::saveSettingsToIni(const std::wstring& iniFilePath) {
     outFile << wstringToString(L"QuoteChar=" + quoteChar + L"\n");
     outFile << wstringToString(L"HeaderLines=" + headerLines + L"\n");
 
+    // Store the profiling options
+    outFile << wstringToString(L"[Profiling]\n");
+    outFile << wstringToString(L"Enabled=" + std::to_wstring(engine.profiler.isEnabled() ? 1 : 0) + L"\n");
+    outFile << wstringToString(L"TraceFile=" + escapeCsvValue(profilingTraceFile) + L"\n");
+
+    // Store the memory options
+    outFile << wstringToString(L"[Memory]\n");
+    outFile << wstringToString(L"SoftLimitMB=" + std::to_wstring(memorySoftLimitMB) + L"\n");
+    outFile << wstringToString(L"ShowInStatus=" + std::to_wstring(showMemoryInStatus ? 1 : 0) + L"\n");
+
+    // Store the live count options
+    outFile << wstringToString(L"[LiveCount]\n");
+    outFile << wstringToString(L"Enabled=" + std::to_wstring(liveCountEnabled ? 1 : 0) + L"\n");
+    outFile << wstringToString(L"DelayMs=" + std::to_wstring(liveCountDelayMs) + L"\n");
+
+    // Store the live replace delay, live replace itself is switched on per session
+    outFile << wstringToString(L"[LiveReplace]\n");
+    outFile << wstringToString(L"DelayMs=" + std::to_wstring(liveReplaceDelayMs) + L"\n");
+
+    // Store the folding option
+    outFile << wstringToString(L"[Folding]\n");
+    outFile << wstringToString(L"Enabled=" + std::to_wstring(foldCharacters ? 1 : 0) + L"\n");
+
+    // Store the trigram index option
+    outFile << wstringToString(L"[TrigramIndex]\n");
+    outFile << wstringToString(L"Enabled=" + std::to_wstring(indexTrigrams ? 1 : 0) + L"\n");
+
+    // Store the combined regex search option
+    outFile << wstringToString(L"[RegexUnion]\n");
+    outFile << wstringToString(L"Enabled=" + std::to_wstring(unionRegex ? 1 : 0) + L"\n");
+
+    // Store the regex time budget
+    outFile << wstringToString(L"[RegexWatchdog]\n");
+    outFile << wstringToString(L"BudgetMs=" + std::to_wstring(regexBudgetMs) + L"\n");
+
     // Convert and Store "Find what" history
     LRESULT findWhatCount = SendMessage(GetDlgItem(_hSelf, IDC_FIND_EDIT), CB_GETCOUNT, 0, 0);
     outFile << wstringToString(L"[History]\n");
@@ -6083,15 +5469,22 @@ void MultiReplace::loadSettingsFromIni(const std::wstring& iniFilePath) {
     // Selecting the appropriate search mode radio button based on the settings
     bool extended = readBoolFromIniFile(iniFilePath, L"Options", L"Extended", false);
     bool regex = readBoolFromIniFile(iniFilePath, L"Options", L"Regex", false);
-    if (regex) {
-        CheckRadioButton(_hSelf, IDC_NORMAL_RADIO, IDC_REGEX_RADIO, IDC_REGEX_RADIO);
+    bool fuzzy = readBoolFromIniFile(iniFilePath, L"Options", L"Fuzzy", false);
+    int fuzzyEdits = std::clamp(readIntFromIniFile(iniFilePath, L"Options", L"FuzzyEdits", 1), 1, MAX_FUZZY_EDITS);
+    SetDlgItemInt(_hSelf, IDC_FUZZY_EDITS_EDIT, static_cast<UINT>(fuzzyEdits), FALSE);
+    if (fuzzy) {
+        CheckRadioButton(_hSelf, IDC_NORMAL_RADIO, IDC_FUZZY_RADIO, IDC_FUZZY_RADIO);
+        EnableWindow(GetDlgItem(_hSelf, IDC_WHOLE_WORD_CHECKBOX), SW_HIDE);
+    }
+    else if (regex) {
+        CheckRadioButton(_hSelf, IDC_NORMAL_RADIO, IDC_FUZZY_RADIO, IDC_REGEX_RADIO);
         EnableWindow(GetDlgItem(_hSelf, IDC_WHOLE_WORD_CHECKBOX), SW_HIDE);
     }
     else if (extended) {
-        CheckRadioButton(_hSelf, IDC_NORMAL_RADIO, IDC_REGEX_RADIO, IDC_EXTENDED_RADIO);
+        CheckRadioButton(_hSelf, IDC_NORMAL_RADIO, IDC_FUZZY_RADIO, IDC_EXTENDED_RADIO);
     }
     else {
-        CheckRadioButton(_hSelf, IDC_NORMAL_RADIO, IDC_REGEX_RADIO, IDC_NORMAL_RADIO);
+        CheckRadioButton(_hSelf, IDC_NORMAL_RADIO, IDC_FUZZY_RADIO, IDC_NORMAL_RADIO);
     }
 
     // Setting additional options
@@ -6123,7 +5516,35 @@ void MultiReplace::loadSettingsFromIni(const std::wstring& iniFilePath) {
     std::wstring quoteChar = readStringFromIniFile(iniFilePath, L"Scope", L"QuoteChar", L"\"");
     setTextInDialogItem(_hSelf, IDC_QUOTECHAR_EDIT, quoteChar);
 
-    CSVheaderLinesCount = readIntFromIniFile(iniFilePath, L"Scope", L"HeaderLines", 1);
+    engine.CSVheaderLinesCount = readIntFromIniFile(iniFilePath, L"Scope", L"HeaderLines", 1);
+
+    // Timing of operations, shown in the status line and optionally written as Chrome trace
+    engine.profiler.setEnabled(readBoolFromIniFile(iniFilePath, L"Profiling", L"Enabled", false));
+    profilingTraceFile = readStringFromIniFile(iniFilePath, L"Profiling", L"TraceFile", L"");
+    engine.profiler.setTraceEnabled(!profilingTraceFile.empty());
+
+    // Releasing caches once the plugin holds more than the soft limit
+    memorySoftLimitMB = static_cast<size_t>(std::max(0, readIntFromIniFile(iniFilePath, L"Memory", L"SoftLimitMB", 256)));
+    showMemoryInStatus = readBoolFromIniFile(iniFilePath, L"Memory", L"ShowInStatus", false);
+
+    // Match count of the Find field, shown after a typing pause
+    liveCountEnabled = readBoolFromIniFile(iniFilePath, L"LiveCount", L"Enabled", true);
+    liveCountDelayMs = static_cast<UINT>(std::max(10, readIntFromIniFile(iniFilePath, L"LiveCount", L"DelayMs", 300)));
+
+    // Typing pause after which live replace applies the list to the new text
+    liveReplaceDelayMs = static_cast<UINT>(std::max(10, readIntFromIniFile(iniFilePath, L"LiveReplace", L"DelayMs", 500)));
+
+    // Accents, combining marks and full-width forms are ignored by literal rules
+    foldCharacters = readBoolFromIniFile(iniFilePath, L"Folding", L"Enabled", false);
+
+    // Literal list entries skip the parts of the document they cannot occur in
+    indexTrigrams = readBoolFromIniFile(iniFilePath, L"TrigramIndex", L"Enabled", true);
+
+    // Regex list entries are searched together in one pass, off until it has seen more use
+    unionRegex = readBoolFromIniFile(iniFilePath, L"RegexUnion", L"Enabled", false);
+
+    // Regex rules that search longer than this per operation are stopped
+    regexBudgetMs = std::max(0, readIntFromIniFile(iniFilePath, L"RegexWatchdog", L"BudgetMs", RegexWatchdog::DEFAULT_BUDGET_MS));
 
     // Adjusting UI elements based on the selected scope
     setElementsState(columnRadioDependentElements, columnMode);
@@ -6372,6 +5793,12 @@ LPWSTR MultiReplace::getLangStrLPWSTR(const std::wstring& id) {
 #pragma region Event Handling -- triggered in beNotified() in MultiReplace.cpp
 
 void MultiReplace::processTextChange(SCNotification* notifyCode) {
+    // Live replace also follows typing while the panel is hidden, but only in the view the
+    // ranges belong to
+    if (instance != nullptr && notifyCode->nmhdr.hwndFrom == getScintillaHandle()) {
+        instance->trackLiveReplace(notifyCode);
+    }
+
     if (!isWindowOpen || !isLoggingEnabled) {
         return;
     }
@@ -6430,6 +5857,11 @@ void MultiReplace::processLog() {
 }
 
 void MultiReplace::onDocumentSwitched() {
+    // Pending live replace ranges are positions in the previous document
+    if (instance != nullptr) {
+        instance->clearLiveReplace();
+    }
+
     if (!isWindowOpen) {
         return;
     }
@@ -6463,8 +5895,25 @@ void MultiReplace::pointerToScintilla() {
     }
 
     if (instance->_hScintilla) { // just to supress Warning
-        instance->pSciMsg = (SciFnDirect)::SendMessage(instance->_hScintilla, SCI_GETDIRECTFUNCTION, 0, 0);
-        instance->pSciWndData = (sptr_t)::SendMessage(instance->_hScintilla, SCI_GETDIRECTPOINTER, 0, 0);
+        SciFnDirect pSciMsg = (SciFnDirect)::SendMessage(instance->_hScintilla, SCI_GETDIRECTFUNCTION, 0, 0);
+        sptr_t pSciWndData = (sptr_t)::SendMessage(instance->_hScintilla, SCI_GETDIRECTPOINTER, 0, 0);
+        instance->sciBackend.attach(instance->_hScintilla, pSciMsg, pSciWndData);
+        instance->engine.notifyDocumentModified(); // Another document or view
+        instance->searchPrefetcher.stop();
+        if (isWindowOpen) {
+            instance->scheduleLiveCount();
+        }
+
+        // Counts of the previous document would end up next to the rules
+        if (instance->isCounting()) {
+            instance->cancelCount();
+            instance->showStatusMessage(instance->getLangStr(L"status_count_cancelled"), RGB(255, 0, 0));
+        }
+
+        // A recorded session has to know the text of every document it touched
+        if (instance->sessionRecorder.isRecording()) {
+            instance->sessionRecorder.snapshot(instance->sciBackend);
+        }
     }
 }
 
@@ -6474,17 +5923,17 @@ void MultiReplace::onSelectionChanged() {
         return;
     }
 
-    static bool wasTextSelected = false;  // This stores the previous state
-    const std::vector<int> selectionRadioDisabledButtons = {
-    IDC_FIND_BUTTON, IDC_FIND_NEXT_BUTTON, IDC_FIND_PREV_BUTTON, IDC_REPLACE_BUTTON
-    };
-
     // Get the start and end of the selection
     Sci_Position start = ::SendMessage(MultiReplace::getScintillaHandle(), SCI_GETSELECTIONSTART, 0, 0);
     Sci_Position end = ::SendMessage(MultiReplace::getScintillaHandle(), SCI_GETSELECTIONEND, 0, 0);
 
-    // Enable or disable IDC_SELECTION_RADIO depending on whether text is selected
+    // Moving or extending a selection does not change the controls, only selecting or unselecting does
     bool isTextSelected = (start != end);
+    if (isTextSelected == wasTextSelected) {
+        return;
+    }
+
+    // Enable or disable IDC_SELECTION_RADIO depending on whether text is selected
     ::EnableWindow(::GetDlgItem(getDialogHandle(), IDC_SELECTION_RADIO), isTextSelected);
 
     // If no text is selected and IDC_SELECTION_RADIO is checked, check IDC_ALL_TEXT_RADIO instead
@@ -6496,27 +5945,58 @@ void MultiReplace::onSelectionChanged() {
     // Check if there was a switch from selected to not selected
     if (wasTextSelected && !isTextSelected) {
         if (instance != nullptr) {
-            instance->setElementsState(selectionRadioDisabledButtons, true);
+            instance->setElementsState(instance->selectionRadioDisabledButtons, true);
         }
     }
     wasTextSelected = isTextSelected;  // Update the previous state
 }
 
-void MultiReplace::onTextChanged() {
+void MultiReplace::onTextChanged(SCNotification* notifyCode) {
     textModified = true;
+    // A document shown in both views notifies from both, the other view may also edit
+    // another document. Only the view the engine is attached to is followed.
+    if (instance != nullptr && notifyCode->nmhdr.hwndFrom == getScintillaHandle()) {
+        // Cached match sets are stale now, the folded text follows the edit
+        instance->engine.notifyTextModified(notifyCode->modificationType, notifyCode->position, notifyCode->length, notifyCode->text);
+    }
+}
+
+void MultiReplace::onCharAdded(SCNotification* notifyCode) {
+    // Only typing in the view live replace follows
+    if (instance != nullptr && notifyCode->nmhdr.hwndFrom == getScintillaHandle()) {
+        instance->trackTypedCharacter();
+    }
 }
 
 void MultiReplace::onCaretPositionChanged()
 {
-    if (!isWindowOpen || !isCaretPositionEnabled) {
+    if (!isWindowOpen || !isCaretPositionEnabled || instance == nullptr) {
         return;
     }
 
-    LRESULT startPosition = ::SendMessage(MultiReplace::getScintillaHandle(), SCI_GETCURRENTPOS, 0, 0);
-    if (instance != nullptr) {
-        instance->showStatusMessage(instance->getLangStr(L"status_actual_position", { instance->addLineAndColumnMessage(startPosition) }), RGB(0, 128, 0));
+    // Holding an arrow key sends SCN_UPDATEUI for every step, the status follows at most
+    // every CARET_STATUS_DELAY_MS
+    if (!instance->caretStatusPending) {
+        instance->caretStatusPending = true;
+        SetTimer(instance->_hSelf, CARET_STATUS_TIMER_ID, CARET_STATUS_DELAY_MS, NULL);
+    }
+}
+
+void MultiReplace::showCaretPosition()
+{
+    if (!isWindowOpen || !isCaretPositionEnabled) {
+        return;
     }
 
+    // Scrolling and restyling also send SCN_UPDATEUI, the text stays as long as the caret
+    // and the document do
+    LRESULT startPosition = ::SendMessage(_hScintilla, SCI_GETCURRENTPOS, 0, 0);
+    if (startPosition == shownCaretPosition && engine.getDocumentVersion() == shownCaretVersion) {
+        return;
+    }
+    showStatusMessage(getLangStr(L"status_actual_position", { addLineAndColumnMessage(startPosition) }), RGB(0, 128, 0));
+    shownCaretPosition = startPosition;
+    shownCaretVersion = engine.getDocumentVersion();
 }
 
 #pragma endregion
\ No newline at end of file
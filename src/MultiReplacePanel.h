@@ -19,6 +19,12 @@
 #include "StaticDialog/StaticDialog.h"
 #include "StaticDialog/resource.h"
 #include "PluginInterface.h"
+#include "ScintillaBackend.h"
+#include "Engine/MessageRecorder.h"
+#include "Engine/MultiReplaceEngine.h"
+#include "Engine/BackgroundCounter.h"
+#include "Engine/SearchPrefetcher.h"
+#include "Engine/TypedText.h"
 
 #include <string>
 #include <vector>
@@ -28,8 +34,8 @@
 #include <algorithm>
 #include <unordered_map>
 #include <set>
+#include <mutex>
 #include <commctrl.h>
-#include <lua.hpp>
 
 extern NppData nppData;
 
@@ -49,6 +55,7 @@ struct ReplaceItemData
     bool useVariables = false;
     bool extended = false;
     bool regex = false;
+    int fuzzyEdits = 0;  // Fuzzy mode if above 0
 
     bool operator==(const ReplaceItemData& rhs) const {
         return
@@ -58,7 +65,8 @@ struct ReplaceItemData
             wholeWord == rhs.wholeWord &&
             matchCase == rhs.matchCase &&
             extended == rhs.extended &&
-            regex == rhs.regex;
+            regex == rhs.regex &&
+            fuzzyEdits == rhs.fuzzyEdits;
     }
 
     bool operator!=(const ReplaceItemData& rhs) const {
@@ -83,60 +91,6 @@ struct ControlInfo
 };
 
 
-struct SearchResult {
-    LRESULT pos = -1;
-    LRESULT length = 0;
-    std::string foundText = "";
-};
-
-struct SelectionInfo {
-    std::string text;
-    Sci_Position startPos;
-    Sci_Position length;
-};
-
-struct SelectionRange {
-    LRESULT start = 0;
-    LRESULT end = 0;
-};
-
-struct ColumnDelimiterData {
-    std::vector<int> inputColumns; // original order of the columns
-    std::set<int> columns;
-    std::string extendedDelimiter;
-    std::string quoteChar;
-    SIZE_T delimiterLength = 0;
-    bool delimiterChanged = false;
-    bool quoteCharChanged = false;
-    bool columnChanged = false;
-
-    bool isValid() const {
-        bool isQuoteCharValid = quoteChar.empty() ||
-            (quoteChar.length() == 1 && (quoteChar[0] == '"' || quoteChar[0] == '\''));
-        return !columns.empty() && !extendedDelimiter.empty() && isQuoteCharValid;
-    }
-};
-
-struct DelimiterPosition {
-    LRESULT position;
-};
-
-struct CombinedColumns {
-    std::vector<std::string> columns;
-};
-
-struct LineInfo {
-    std::vector<DelimiterPosition> positions;
-    LRESULT startPosition = 0;
-    LRESULT endPosition = 0;
-};
-
-struct ColumnInfo {
-    LRESULT totalLines;
-    LRESULT startLine;
-    SIZE_T startColumnIndex;
-};
-
 struct CountColWidths {
     HWND listView;
     int listViewWidth;
@@ -151,6 +105,15 @@ struct ContextMenuInfo {
     int clickedColumn = -1;
 };
 
+// Queued by the count worker thread, handled on the UI thread
+struct CountProgress {
+    uint64_t job = 0;
+    size_t index = 0;
+    int count = 0;
+    bool finished = false;
+    bool cancelled = false;
+};
+
 struct MenuState {
     bool listNotEmpty = false;
     bool canEdit = false;
@@ -172,48 +135,12 @@ enum class ItemAction {
 };
 
 
-enum class SortDirection {
-    Unsorted,
-    Ascending,
-    Descending
-};
-
-// Lua Engine
-struct LuaVariables {
-    int CNT = 0;
-    int LINE = 0;
-    int LPOS = 0;
-    int LCNT = 0;
-    int APOS = 0;
-    int COL = 1;
-    std::string MATCH;
-};
-
-enum class LuaVariableType {
-    String,
-    Number,
-    Boolean,
-    None
-};
-
 enum class SortState {
     Unsorted,
     SortedAscending,
     SortedDescending
 };
 
-struct LuaVariable {
-    std::string name;
-    LuaVariableType type;
-    std::string stringValue;
-    double numberValue;
-    bool booleanValue;
-
-    LuaVariable() : name(""), type(LuaVariableType::None), numberValue(0.0), booleanValue(false) {}
-};
-
-using LuaVariablesMap = std::map<std::string, LuaVariable>;
-
 class CsvLoadException : public std::exception {
 public:
     explicit CsvLoadException(const std::string& message) : message_(message) {}
@@ -268,6 +195,16 @@ public:
         return s_hDlg;
     }
 
+    // Starts or stops recording the Scintilla messages of the engine, returns true while recording
+    bool toggleSessionRecording();
+
+    // Starts or stops applying the list to typed and pasted text, returns true while on
+    bool toggleLiveReplace();
+
+    // Bytes held per plugin data structure
+    MemoryReport memoryUsage() const;
+    void showMemoryReport();
+
     static bool isWindowOpen;
     static bool textModified;
     static bool documentSwitched;
@@ -282,14 +219,15 @@ public:
 
     // Static methods for Event Handling
     static void onSelectionChanged();
-    static void onTextChanged();
+    static void onTextChanged(SCNotification* notifyCode);
     static void onDocumentSwitched();
     static void pointerToScintilla();
     static void processLog();
     static void processTextChange(SCNotification* notifyCode);
+    static void onCharAdded(SCNotification* notifyCode);
     static void onCaretPositionChanged();
 
-    enum class ChangeType { Insert, Delete, Modify };
+    using ChangeType = ::ChangeType;
     enum class ReplaceMode { Normal, Extended, Regex };
 
     struct LogEntry {
@@ -307,12 +245,25 @@ private:
     static constexpr int MAX_TEXT_LENGTH = 4096; // Maximum Textlength for Find and Replace String
     static constexpr const TCHAR* FONT_NAME = TEXT("MS Shell Dlg");
     static constexpr int FONT_SIZE = 16;
-    static constexpr long MARKER_COLOR = 0x007F00; // Color for non-list Marker
     static constexpr LRESULT PROGRESS_THRESHOLD = 50000; // Will show progress bar if total exceeds defined threshold
     bool isReplaceAllInDocs = false;   // True if replacing in all open documents, false for current document only.
     static constexpr int COUNT_COLUMN_WIDTH = 50; // Initial Size for Count Column
     static constexpr int MIN_COLUMN_WIDTH = 60;  // Minimum size of Find and Replace Column
     static constexpr int STEP_SIZE = 5; // Speed for opening and closing Count Columns
+    static constexpr UINT WM_COUNT_PROGRESS = WM_APP + 1; // Posted by the count worker thread
+    static constexpr UINT WM_LIVE_COUNT = WM_APP + 2; // Posted by the live count worker thread
+    static constexpr UINT WM_SESSION_LIMIT = WM_APP + 3; // Posted when the session recorder reached its byte limit
+    static constexpr UINT_PTR LIVE_COUNT_TIMER_ID = 1;
+    static constexpr UINT_PTR CARET_STATUS_TIMER_ID = 2;
+    static constexpr UINT_PTR LIVE_REPLACE_TIMER_ID = 3;
+    static constexpr UINT_PTR DEFERRED_COUNT_TIMER_ID = 4;
+    static constexpr UINT_PTR PREFETCH_COPY_TIMER_ID = 5;
+    static constexpr UINT DEFERRED_COUNT_STEP_MS = 30; // Editor search time per timer tick of the deferred count
+    static constexpr Sci_Position DEFERRED_COUNT_SLICE_BYTES = 1024 * 1024;
+    static constexpr UINT CARET_STATUS_DELAY_MS = 50; // The caret position is shown at most this often
+    static constexpr int LIVE_COUNT_MAX_MATCHES = 100000; // Shown as "100000+" beyond
+    static constexpr size_t LIVE_COUNT_SAMPLE_BYTES = 32 * 1024 * 1024; // Larger documents are estimated from their start
+    static constexpr Sci_Position PREFETCH_MIN_LENGTH = 8 * 1024 * 1024; // Smaller documents are searched fast enough on each step
     static constexpr wchar_t* symbolSortAsc = L"▼";
     static constexpr wchar_t* symbolSortDesc = L"▲";
     static constexpr wchar_t* symbolSortAscUnsorted = L"▽";
@@ -321,6 +272,7 @@ private:
     // Static variables related to GUI 
     static HWND s_hScintilla;
     static HWND s_hDlg;
+    static bool wasTextSelected; // Selection state the scope controls were last set for
     HWND hwndEdit = NULL;
     WNDPROC originalListViewProc;
     static std::map<int, ControlInfo> ctrlMap;
@@ -350,24 +302,16 @@ private:
        Styles 0 - 7 are reserved for syntax style.
        Styles 21 - 29, 31 are reserved by N++ (see SciLexer.h).
     */
-    std::vector<int> textStyles = { 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 30, 32, 33, 34, 35, 36, 37, 38, 39, 40, 41, 42, 43 };
     std::vector<int> hColumnStyles = { STYLE1, STYLE2, STYLE3, STYLE4, STYLE5, STYLE6, STYLE7, STYLE8, STYLE9, STYLE10 };
     std::vector<long> columnColors = { 0xFFE0E0, 0xC0E0FF, 0x80FF80, 0xFFE0FF,  0xB0E0E0, 0xFFFF80, 0xE0C0C0, 0x80FFFF, 0xFFB0FF, 0xC0FFC0 };
 
     // Data-related variables 
-    size_t markedStringsCount = 0;
     bool allSelected = true;
-    std::unordered_map<long, int> colorToStyleMap;
     int lastColumn = -1;
     std::map<int, SortDirection> columnSortOrder;
-    ColumnDelimiterData columnDelimiterData;
-    LRESULT eolLength = -1; // Stores the length of the EOL character sequence
     std::vector<ReplaceItemData> replaceListData;
-    std::vector<LineInfo> lineDelimiterPositions;
     bool isColumnHighlighted = false;
     std::map<int, bool> stateSnapshot; // stores the state of the Elements
-    LuaVariablesMap globalLuaVariablesMap; // stores Lua Global Variables
-    SIZE_T CSVheaderLinesCount = 1; // Number of header lines not included in CSV sorting
     bool isStatisticsColumnsExpanded = false;
 
 
@@ -379,8 +323,61 @@ private:
     std::wstring findNextButtonText;        // member variable to ensure persists for button label throughout the object's lifetime.
 
     // Scintilla related 
-    SciFnDirect pSciMsg = nullptr;
-    sptr_t pSciWndData = 0;
+    ScintillaBackend sciBackend;
+    MessageRecorder sessionRecorder;
+    RecordingBackend recordingBackend{ sciBackend, sessionRecorder };
+    MultiReplaceEngine engine{ recordingBackend }; // declared after the backends, which it refers to
+    std::wstring profilingTraceFile; // Chrome trace of the last profiled operation, empty for none
+    size_t memorySoftLimitMB = 256; // Caches are released above this, 0 for no limit
+    bool showMemoryInStatus = false;
+    bool foldCharacters = false;    // Accent- and width-insensitive search, set in the INI file only as it keeps a folded copy of the document
+    bool indexTrigrams = true;      // Trigram index for list operations, set in the INI file only
+    bool unionRegex = false;        // Combined regex search of list entries, set in the INI file only
+    int regexBudgetMs = RegexWatchdog::DEFAULT_BUDGET_MS; // Search time of each regex rule per operation, 0 for no limit
+
+    // Background count
+    std::mutex countProgressMutex;
+    std::vector<CountProgress> countProgressQueue; // Filled by the worker thread
+    std::vector<CountRule> countRules;             // Rules of the running count in list order
+    std::vector<CountRule> deferredCountRules;     // Counted on the UI thread in timer steps when the worker is done
+    size_t countedRules = 0;
+    int countedMatches = 0;
+    uint64_t countDocumentVersion = 0;
+    EngineOptions countOptions;                    // Scope and flags the count started with
+    bool deferredCountActive = false;
+    size_t deferredCountedRules = 0;
+    Sci_Position deferredCountFrom = 0;            // Where the current deferred rule goes on
+    int deferredCount = 0;                         // Its matches so far
+    std::vector<size_t> deferredStoppedRules;      // Rows whose regex the watchdog stopped, left without a count
+    BackgroundCounter backgroundCounter;           // After the queue, so its thread is joined before the queue goes away
+
+    // Live count of the Find field, started after a typing pause
+    bool liveCountEnabled = true;
+    UINT liveCountDelayMs = 300;
+    uint64_t liveCountJob = 0;                     // Job whose result is shown, 0 while none is wanted
+    std::wstring liveCountStatus;                  // Last status shown, cleared when there is nothing to count
+    std::shared_ptr<const std::string> liveCountText; // Document copy, reused while the document is unchanged
+    uint64_t liveCountTextVersion = 0;
+    std::mutex liveCountMutex;
+    uint64_t liveCountResultJob = 0;               // Written by the worker thread
+    CountResult liveCountResult;
+    BackgroundCounter liveCounter;                 // Last, so its thread is joined before the result goes away
+
+    // Look-ahead of Find Next and Replace on large documents
+    SearchPrefetcher searchPrefetcher;
+
+    // Caret position in the status line, refreshed by a timer instead of every SCN_UPDATEUI
+    bool caretStatusPending = false;
+    Sci_Position shownCaretPosition = -1;
+    uint64_t shownCaretVersion = 0;
+
+    // Live replace of typed text, applied after a typing pause
+    bool liveReplaceEnabled = false;
+    UINT liveReplaceDelayMs = 500;
+    TypedText typedText;       // Typed since the last pass
+    int panelMessageDepth = 0; // Text changes while above 0 are made by the panel itself
+
+    bool sessionLimitReached = false; // The recorder stopped itself, the session is saved on WM_SESSION_LIMIT
 
     // GUI control-related constants
     const std::vector<int> selectionRadioDisabledButtons = {
@@ -403,6 +400,7 @@ private:
     void initializeCtrlMap();
     bool createAndShowWindows();
     void initializePluginStyle();
+    void initializeEngine();
     void initializeListView();
     void moveAndResizeControls();
     void updateButtonVisibilityBasedOnMode();
@@ -445,30 +443,43 @@ private:
     //Replace
     void handleReplaceAllButton();
     void handleReplaceButton();
-    void replaceAll(const ReplaceItemData& itemData, int& findCount, int& replaceCount);
-    bool replaceOne(const ReplaceItemData& itemData, const SelectionInfo& selection, SearchResult& searchResult, Sci_Position& newPos);
-    Sci_Position performReplace(const std::string& replaceTextUtf8, Sci_Position pos, Sci_Position length);
-    Sci_Position performRegexReplace(const std::string& replaceTextUtf8, Sci_Position pos, Sci_Position length);
-    SelectionInfo getSelectionInfo();
-    void captureLuaGlobals(lua_State* L);
-    void loadLuaGlobals(lua_State* L);
-    bool resolveLuaSyntax(std::string& inputString, const LuaVariables& vars, bool& skip, bool regex);
-    void setLuaVariable(lua_State* L, const std::string& varName, std::string value, bool regex);
+    void updateEngineOptions();
+    void beginEngineOperation();
+    ReplaceRule toReplaceRule(const ReplaceItemData& itemData) const;
+    int getFuzzyEditsFromDialog();
+    bool checkFuzzyFindText(const std::wstring& findText, int fuzzyEdits);
+    std::vector<ReplaceRule> getReplaceRules() const;
+    void trackLiveReplace(const SCNotification* notifyCode);
+    void trackTypedCharacter();
+    void applyLiveReplace();
+    void clearLiveReplace();
 
     //Find
     void handleFindNextButton();
     void handleFindPrevButton();
-    SearchResult performSingleSearch(const std::string& findTextUtf8, int searchFlags, bool selectMatch, SelectionRange range);
-    SearchResult performSearchForward(const std::string& findTextUtf8, int searchFlags, bool selectMatch, LRESULT start);
-    SearchResult performSearchBackward(const std::string& findTextUtf8, int searchFlags, LRESULT start);
-    SearchResult performListSearchForward(const std::vector<ReplaceItemData>& list, LRESULT cursorPos, size_t& closestMatchIndex);
-    SearchResult performListSearchBackward(const std::vector<ReplaceItemData>& list, LRESULT cursorPos, size_t& closestMatchIndex);
+    std::vector<CountRule> prefetchRules();
+    std::vector<CountRule> prefetchRules(const std::string& findTextUtf8, int searchFlags) const;
+    bool findPrefetched(const std::vector<CountRule>& rules, Sci_Position pos, SearchResult& result, size_t& matchIndex);
+    bool mayReplaceAt(const std::vector<CountRule>& rules, size_t index, const SelectionInfo& selection);
+    SearchPrefetcher::RangeSearch prefetchSearch();
+    void prefetchReplacement(const SearchResult& replaced, Sci_Position newPos, uint64_t previousVersion);
 
     //Mark
     void handleMarkMatchesButton();
-    int markString(const std::string& findTextUtf8, int searchFlags);
-    void highlightTextRange(LRESULT pos, LRESULT len, const std::string& findTextUtf8);
-    long generateColorValue(const std::string& str);
+    void handleCountMatches();
+    CountRule makeCountRule(size_t index);
+    void queueCountProgress(const CountProgress& progress);
+    void processCountProgress();
+    void finishCount();
+    void continueDeferredCount();
+    void cancelCount();
+    bool isCounting() const {
+        return backgroundCounter.isRunning() || deferredCountActive;
+    }
+    void scheduleLiveCount();
+    void startLiveCount();
+    void showLiveCount();
+    void clearLiveCount();
     void handleClearTextMarksButton();
     void handleCopyMarkedTextToClipboardButton();
     void copyTextToClipboard(const std::wstring& text, int textCount);
@@ -479,10 +490,7 @@ private:
     void handleDeleteColumns();
 
     //CSV Sort
-    std::vector<CombinedColumns> extractColumnData(SIZE_T startLine, SIZE_T lineCount);
     void sortRowsByColumn(SortDirection sortDirection);
-    void reorderLinesInScintilla(const std::vector<size_t>& sortedIndex);
-    void restoreOriginalLineOrder(const std::vector<size_t>& originalOrder);
     void extractLineContent(size_t idx, std::string& content, const std::string& lineBreak);
     void UpdateSortButtonSymbols();
     void handleSortStateAndSort(SortDirection direction);
@@ -491,35 +499,33 @@ private:
     //Scope
     bool parseColumnAndDelimiterData();
     void findAllDelimitersInDocument();
-    void findDelimitersInLine(LRESULT line);
-    ColumnInfo getColumnInfo(LRESULT startPosition);
     void initializeColumnStyles();
     void handleHighlightColumnsInDocument();
     void highlightColumnsInLine(LRESULT line);
     void handleClearColumnMarks();
     std::wstring addLineAndColumnMessage(LRESULT pos);
-    void updateDelimitersInDocument(SIZE_T lineNumber, ChangeType changeType);
+    void showCaretPosition();
     void processLogForDelimiters();
     void handleDelimiterPositions(DelimiterOperation operation);
     void handleClearDelimiterState();
 
     //Utilities
-    int convertExtendedToString(const std::string& query, std::string& result);
     std::string convertAndExtend(const std::wstring& input, bool extended);
-    std::string convertAndExtend(const std::string& input, bool extended);
     static void addStringToComboBoxHistory(HWND hComboBox, const std::wstring& str, int maxItems = 10);
     std::wstring getTextFromDialogItem(HWND hwnd, int itemID);
     void setSelections(bool select, bool onlySelected = false);
     void updateHeaderSelection();
     void updateHeaderSortDirection();
     void showStatusMessage(const std::wstring& messageText, COLORREF color);
-    void displayResultCentered(size_t posStart, size_t posEnd, bool isDownwards);
     std::wstring getSelectedText();
-    LRESULT getEOLLength();
-    std::string getEOLStyle();
     void setElementsState(const std::vector<int>& elements, bool enable);
     sptr_t send(unsigned int iMessage, uptr_t wParam = 0, sptr_t lParam = 0, bool useDirect = true);
-    bool normalizeAndValidateNumber(std::string& str);
+    void beginOperationProfile(const std::string& operationName);
+    std::wstring finishOperationProfile();
+    std::wstring appendOperationStatus(const std::wstring& messageText);
+    std::wstring regexTimeoutStatus() const;
+    void showNoMatchStatus(const std::wstring& messageText);
+    void enforceMemoryLimit();
 
     //StringHandling
     std::wstring stringToWString(const std::string& encodedInput) const;
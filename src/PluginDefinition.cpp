@@ -72,6 +72,9 @@ void commandMenuInit()
     setCommand(1, TEXT("SEPARATOR"), NULL, NULL, false);
     setCommand(2, TEXT("&Documentation"), openHelpLink, NULL, false);
     setCommand(3, TEXT("&About"), about, NULL, false);
+    setCommand(4, TEXT("Record &Session"), recordSession, NULL, false);
+    setCommand(5, TEXT("&Memory Report"), memoryReport, NULL, false);
+    setCommand(6, TEXT("&Live Replace"), liveReplace, NULL, false);
 }
 
 //
@@ -127,4 +130,26 @@ void about()
     ShowAboutDialog(nppData._nppHandle);
 }
 
+void recordSession()
+{
+    bool recording = _MultiReplace.toggleSessionRecording();
+    ::SendMessage(nppData._nppHandle, NPPM_SETMENUITEMCHECK, funcItem[4]._cmdID, recording);
+}
+
+void memoryReport()
+{
+    _MultiReplace.showMemoryReport();
+}
+
+void liveReplace()
+{
+    // The rules come from the list of the panel
+    if (!_MultiReplace.isCreated())
+    {
+        multiReplace();
+    }
+    bool enabled = _MultiReplace.toggleLiveReplace();
+    ::SendMessage(nppData._nppHandle, NPPM_SETMENUITEMCHECK, funcItem[6]._cmdID, enabled);
+}
+
 
@@ -36,7 +36,7 @@ const TCHAR NPP_PLUGIN_NAME[] = TEXT("MultiReplace");
 //
 // Here define the number of your plugin commands
 //
-const int nbFunc = 4;
+const int nbFunc = 7;
 
 
 //
@@ -73,5 +73,8 @@ bool setCommand(size_t index, TCHAR *cmdName, PFUNCPLUGINCMD pFunc, ShortcutKey
 void multiReplace();
 void openHelpLink();
 void about();
+void recordSession();
+void memoryReport();
+void liveReplace();
 
 #endif //PLUGINDEFINITION_H
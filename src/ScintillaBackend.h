@@ -0,0 +1,55 @@
+// This file is part of Notepad++ project
+// Copyright (C)2023 Thomas Knoefel
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef SCINTILLA_BACKEND_H
+#define SCINTILLA_BACKEND_H
+
+#include "Engine/DocumentBackend.h"
+
+#include <windows.h>
+
+// DocumentBackend for the active Scintilla view of Notepad++. Messages go through
+// the direct function when available and fall back to SendMessage otherwise.
+class ScintillaBackend : public DocumentBackend
+{
+public:
+    inline void attach(HWND hScintilla, SciFnDirect pSciMsg, sptr_t pSciWndData) {
+        _hScintilla = hScintilla;
+        _pSciMsg = pSciMsg;
+        _pSciWndData = pSciWndData;
+    }
+
+    sptr_t send(unsigned int iMessage, uptr_t wParam = 0, sptr_t lParam = 0) override {
+        if (_pSciMsg) {
+            return _pSciMsg(_pSciWndData, iMessage, wParam, lParam);
+        }
+        return ::SendMessage(_hScintilla, iMessage, wParam, lParam);
+    }
+
+    void setRedraw(bool enable) override {
+        ::SendMessage(_hScintilla, WM_SETREDRAW, enable ? TRUE : FALSE, 0);
+        if (enable) {
+            ::InvalidateRect(_hScintilla, NULL, TRUE);
+        }
+    }
+
+private:
+    HWND _hScintilla = nullptr;
+    SciFnDirect _pSciMsg = nullptr;
+    sptr_t _pSciWndData = 0;
+};
+
+#endif // SCINTILLA_BACKEND_H
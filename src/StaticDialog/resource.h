@@ -68,6 +68,8 @@
 #define IDC_NORMAL_RADIO                5301
 #define IDC_EXTENDED_RADIO              5302
 #define IDC_REGEX_RADIO                 5303
+#define IDC_FUZZY_RADIO                 5304
+#define IDC_FUZZY_EDITS_EDIT            5305
 
 #define IDC_SCOPE_GROUP                 5451
 #define IDC_ALL_TEXT_RADIO              5452
@@ -106,6 +108,7 @@
 #define IDM_SELECT_ALL                  5708
 #define IDM_ENABLE_LINES                5709
 #define IDM_DISABLE_LINES               5710
+#define IDM_COUNT_MATCHES               5711
 
 
 #define STYLE1							60
@@ -13,6 +13,7 @@ std::unordered_map<std::wstring, std::wstring> languageMap = {
 { L"panel_normal", L"Normal" },
 { L"panel_extended", L"Extended (\\n, \\r, \\t, \\0, \\x...)" },
 { L"panel_regular_expression", L"Regular expression" },
+{ L"panel_fuzzy", L"Fuzzy, edits:" },
 { L"panel_scope", L"Scope" },
 { L"panel_all_text", L"All Text" },
 { L"panel_selection", L"Selection" },
@@ -49,6 +50,7 @@ std::unordered_map<std::wstring, std::wstring> languageMap = {
 { L"tooltip_columns", L"Columns: '1,3,5-12' (individuals, ranges)" },
 { L"tooltip_delimiter", L"Delimiter: Single/combined chars, \t for Tab" },
 { L"tooltip_quote", L"Quote: ', \", or empty" },
+{ L"tooltip_fuzzy_edits", L"Most inserted, deleted or replaced characters (1-9)" },
 { L"tooltip_sort_descending", L"Sort Descending" },
 { L"tooltip_sort_ascending", L"Sort Ascending" },
 { L"tooltip_drop_columns", L"Drop Columns" },
@@ -67,6 +69,7 @@ std::unordered_map<std::wstring, std::wstring> languageMap = {
 { L"header_use_variables", L"V" },
 { L"header_extended", L"E" },
 { L"header_regex", L"R" },
+{ L"header_fuzzy", L"F" },
 
 // tooltip entries
 { L"tooltip_header_whole_word", L"Whole Word" },
@@ -74,6 +77,7 @@ std::unordered_map<std::wstring, std::wstring> languageMap = {
 { L"tooltip_header_use_variables", L"Use Variables" },
 { L"tooltip_header_extended", L"Extended" },
 { L"tooltip_header_regex", L"Regex" },
+{ L"tooltip_header_fuzzy", L"Fuzzy: maximum edits" },
 
 // SplitButton entries
 { L"split_menu_replace_all", L"Replace All" },
@@ -132,6 +136,17 @@ std::unordered_map<std::wstring, std::wstring> languageMap = {
 { L"status_wrapped_position", L"Wrapped at $REPLACE_STRING" },
 { L"status_deleted_fields", L"Deleted $REPLACE_STRING fields." },
 { L"status_occurrences_marked", L"$REPLACE_STRING occurrences were marked." },
+{ L"status_occurrences_counted", L"$REPLACE_STRING occurrences counted." },
+{ L"status_counting", L"Counting: $REPLACE_STRING of $REPLACE_STRING2 rules done." },
+{ L"status_count_cancelled", L"Count cancelled." },
+{ L"status_fuzzy_text_too_long", L"Fuzzy mode supports find strings of up to $REPLACE_STRING characters." },
+{ L"status_live_count", L"Matches: $REPLACE_STRING" },
+{ L"status_live_replace_on", L"Live replace on: the list is applied to typed text." },
+{ L"status_live_replace_off", L"Live replace off." },
+{ L"status_live_replaced", L"Live replace: $REPLACE_STRING occurrences replaced." },
+{ L"status_regex_stopped", L"Regular expression stopped after $REPLACE_STRING ms." },
+{ L"status_regex_stopped_entries", L"Regular expression of entry $REPLACE_STRING2 stopped after $REPLACE_STRING ms." },
+{ L"status_regex_replacements_undone", L"Replacements of stopped regular expressions were undone." },
 { L"status_items_copied_to_clipboard", L"$REPLACE_STRING items copied into Clipboard." },
 { L"status_no_matches_after_wrap_for", L"No matches found for '$REPLACE_STRING' after wrap." },
 { L"status_deleted_fields_count", L"Deleted $REPLACE_STRING fields." },
@@ -160,6 +175,8 @@ std::unordered_map<std::wstring, std::wstring> languageMap = {
 // Context Menu Strings
 { L"ctxmenu_transfer_to_input_fields", L"&Transfer to Input Fields\tAlt+Up" },
 { L"ctxmenu_search_in_list", L"&Search in List\tCtrl+F" },
+{ L"ctxmenu_count_matches", L"C&ount Matches" },
+{ L"ctxmenu_cancel_count", L"Cancel C&ount" },
 { L"ctxmenu_cut", L"Cu&t\tCtrl+X" },
 { L"ctxmenu_copy", L"&Copy\tCtrl+C" },
 { L"ctxmenu_paste", L"&Paste\tCtrl+V" },